@@ -0,0 +1,27 @@
+#include <stdlib.h>
+
+#include "lavandula.h"
+
+// the smallest possible request: no body, no middleware, a constant response
+appRoute(hello, ctx) {
+    (void)ctx;
+
+    return ok("Hello, World!", TEXT_PLAIN);
+}
+
+int main(int argc, char *argv[]) {
+    AppBuilder builder = createBuilder();
+    usePort(&builder, argc > 1 ? atoi(argv[1]) : 3000);
+    // e.g. unix:/tmp/hello.sock
+    if (argc > 2) {
+        useBindAddress(&builder, argv[2]);
+    }
+
+    App app = build(builder);
+
+    get(&app, "/", hello);
+
+    runApp(&app);
+
+    return 0;
+}
@@ -0,0 +1,28 @@
+#include <stdlib.h>
+
+#include "lavandula.h"
+
+// parses the request body and serializes it straight back
+appRoute(echo, ctx) {
+    if (!ctx.hasBody || !ctx.body) {
+        return badRequest("Expected a JSON body", TEXT_PLAIN);
+    }
+
+    HttpResponse response = ok(jsonStringify(ctx.body), APPLICATION_JSON);
+    response.ownsContent = true;
+
+    return response;
+}
+
+int main(int argc, char *argv[]) {
+    AppBuilder builder = createBuilder();
+    usePort(&builder, argc > 1 ? atoi(argv[1]) : 3000);
+
+    App app = build(builder);
+
+    post(&app, "/echo", echo);
+
+    runApp(&app);
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lavandula.h"
+
+#define ITEM_COUNT 1000
+
+static void seed(DbContext *db) {
+    dbExec(db, "create table if not exists items (id integer primary key, name text not null, price real not null)", NULL, 0);
+
+    DbResult *existing = dbQueryRows(db, "select count(*) from items", NULL, 0);
+    bool seeded = existing && existing->rowCount == 1 && atoi(existing->rows[0].colValues[0]) >= ITEM_COUNT;
+    freeDbResult(existing);
+
+    if (seeded) return;
+
+    dbExec(db, "delete from items", NULL, 0);
+    dbExec(db, "begin", NULL, 0);
+
+    char name[32];
+    for (int i = 1; i <= ITEM_COUNT; i++) {
+        snprintf(name, sizeof(name), "item %d", i);
+        dbExec(db, "insert into items (id, name, price) values (?, ?, ?)",
+            DB_PARAMS(PARAM_INT(i), PARAM_TEXT(name), PARAM_DOUBLE(i * 0.25)), 3);
+    }
+
+    dbExec(db, "commit", NULL, 0);
+}
+
+// a page of rows read through a prepared statement and rendered as JSON
+appRoute(listItems, ctx) {
+    DbResult *result = dbQueryRows(ctx.db, "select id, name, price from items order by id limit 20", NULL, 0);
+    if (!result) {
+        return internalServerError("Failed to query database", TEXT_PLAIN);
+    }
+
+    JsonBuilder *root = jsonBuilder();
+
+    JsonArray items = jsonArray();
+    for (int i = 0; i < result->rowCount; i++) {
+        DbRow *row = &result->rows[i];
+
+        JsonBuilder *item = jsonBuilder();
+        jsonPutInteger(item, "id", atoi(row->colValues[0]));
+        jsonPutString(item, "name", row->colValues[1]);
+        jsonPutString(item, "price", row->colValues[2]);
+
+        jsonArrayAppend(&items, jsonObject(item));
+    }
+    jsonPutArray(root, "items", &items);
+
+    char *json = jsonStringify(root);
+    freeJsonBuilder(root);
+    freeDbResult(result);
+
+    HttpResponse response = ok(json, APPLICATION_JSON);
+    response.ownsContent = true;
+
+    return response;
+}
+
+int main(int argc, char *argv[]) {
+    AppBuilder builder = createBuilder();
+    usePort(&builder, argc > 1 ? atoi(argv[1]) : 3000);
+    useSqlLite3(&builder, argc > 2 ? argv[2] : "bench.db");
+
+    App app = build(builder);
+    seed(app.dbContext);
+
+    get(&app, "/items", listItems);
+
+    runApp(&app);
+
+    return 0;
+}
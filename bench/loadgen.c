@@ -0,0 +1,690 @@
+// A small HTTP/1.1 load generator for the Lavandula benchmarks.
+//
+// Closed loop (the default): every connection sends its next request as soon as the
+// previous one completes, so the offered load adapts to the server.
+// Open loop (-r): requests are issued on a fixed schedule whatever the server does, and
+// latency is measured from the moment a request was *due*, not when it was finally sent.
+//
+// Either way two sets of percentiles are reported: the plain service time of each request
+// and one corrected for coordinated omission. A closed loop stops sending while the server
+// stalls, so the requests that would have been sent are back-filled HdrHistogram style,
+// using the median warmup latency as the expected interval between requests.
+//
+// Results are printed as a single JSON object on stdout, a human summary goes to stderr.
+
+#ifdef __linux__
+
+#define _GNU_SOURCE // memmem
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+// Latencies are kept in nanoseconds in a log-linear histogram with 128 buckets per power
+// of two, finer than the 8 the server's /metrics uses, so percentiles are within 1%.
+#define SUB_BUCKET_BITS     7
+#define SUB_BUCKETS         (1 << SUB_BUCKET_BITS)
+#define MAX_EXPONENT        40 // about 18 minutes
+#define HISTOGRAM_BUCKETS   ((MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS)
+
+#define MAX_CONNECTIONS     1024
+#define HEADER_BUFFER_SIZE  8192
+#define READ_CHUNK_SIZE     16384
+
+#define NANOS_PER_SECOND    1000000000ULL
+
+typedef struct {
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+} Histogram;
+
+typedef enum {
+    SLOT_IDLE,
+    SLOT_CONNECTING,
+    SLOT_WRITING,
+    SLOT_READING,
+} SlotState;
+
+typedef struct {
+    SlotState state;
+    int       fd;
+
+    uint64_t  dueAt;     // when the schedule wanted the request sent
+    uint64_t  startedAt; // when it actually was
+
+    size_t    written;
+
+    char      header[HEADER_BUFFER_SIZE];
+    size_t    headerLength;
+    bool      headerDone;
+    int       status;
+    long long contentLength; // -1 reads until the server closes
+    long long bodyRead;
+} Slot;
+
+typedef struct {
+    const char *name;
+    const char *host;
+    int         port;
+    const char *unixSocket;      // connect here instead of host and port
+    const char *method;
+    const char *path;
+    const char *body;
+    const char *contentType;
+
+    int         connections;
+    double      durationSeconds;
+    double      warmupSeconds;
+    double      rate;            // requests per second, 0 runs a closed loop
+    double      timeoutSeconds;
+} Options;
+
+typedef struct {
+    Options                 options;
+    struct sockaddr_storage address;
+    socklen_t               addressLength;
+
+    char              *request;
+    size_t             requestLength;
+
+    int                epoll;
+    Slot              *slots;
+
+    uint64_t           measureFrom;
+    bool               draining;         // the run is over, in-flight requests finish uncounted
+    uint64_t           expectedInterval; // closed loop coordinated omission correction, 0 until known
+
+    Histogram          warmup;
+    Histogram          latency;
+    Histogram          corrected;
+
+    uint64_t           completed;
+    uint64_t           errors;
+    uint64_t           timeouts;
+    uint64_t           non2xx;
+    uint64_t           bytes;
+} LoadGenerator;
+
+static uint64_t nowNanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * NANOS_PER_SECOND + (uint64_t)now.tv_nsec;
+}
+
+static int bucketIndex(uint64_t value) {
+    if (value < SUB_BUCKETS) return (int)value;
+
+    int exponent = 63 - __builtin_clzll(value);
+    if (exponent > MAX_EXPONENT) return HISTOGRAM_BUCKETS - 1;
+
+    int subBucket = (value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + subBucket;
+}
+
+static uint64_t bucketUpperBound(int index) {
+    if (index < SUB_BUCKETS) return (uint64_t)index;
+
+    int shift = index / SUB_BUCKETS - 1;
+    int subBucket = index % SUB_BUCKETS;
+
+    return ((uint64_t)(SUB_BUCKETS + subBucket + 1) << shift) - 1;
+}
+
+static void histogramRecord(Histogram *histogram, uint64_t value) {
+    histogram->buckets[bucketIndex(value)]++;
+    histogram->sum += value;
+
+    if (histogram->count == 0 || value < histogram->min) histogram->min = value;
+    if (value > histogram->max) histogram->max = value;
+
+    histogram->count++;
+}
+
+// Also records the requests a stalled closed loop never got to send: one every
+// expectedInterval for as long as this request took.
+static void histogramRecordCorrected(Histogram *histogram, uint64_t value, uint64_t expectedInterval) {
+    histogramRecord(histogram, value);
+    if (expectedInterval == 0 || value <= expectedInterval) return;
+
+    for (uint64_t missing = value - expectedInterval; missing >= expectedInterval; missing -= expectedInterval) {
+        histogramRecord(histogram, missing);
+    }
+}
+
+static uint64_t histogramQuantile(const Histogram *histogram, double q) {
+    if (histogram->count == 0) return 0;
+
+    uint64_t target = (uint64_t)(q * histogram->count + 0.5);
+    if (target < 1) target = 1;
+    if (target > histogram->count) target = histogram->count;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= target) {
+            uint64_t bound = bucketUpperBound(i);
+            return bound < histogram->max ? bound : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -n name          label for the results (default \"run\")\n"
+        "  -H host          IPv4 address of the server (default 127.0.0.1)\n"
+        "  -p port          (default 3000)\n"
+        "  -u path          connect to a Unix domain socket instead of host and port\n"
+        "  -m method        (default GET)\n"
+        "  -P path          (default /)\n"
+        "  -b body          request body, sent as application/json\n"
+        "  -c connections   concurrent connections (default 8)\n"
+        "  -d seconds       measured duration (default 10)\n"
+        "  -w seconds       warmup before measuring (default 2)\n"
+        "  -r rate          open loop at this many requests per second (default closed loop)\n"
+        "  -t seconds       request timeout (default 5)\n",
+        program);
+}
+
+static bool parseOptions(int argc, char **argv, Options *options) {
+    *options = (Options){
+        .name = "run",
+        .host = "127.0.0.1",
+        .port = 3000,
+        .method = "GET",
+        .path = "/",
+        .connections = 8,
+        .durationSeconds = 10,
+        .warmupSeconds = 2,
+        .timeoutSeconds = 5,
+    };
+
+    int option;
+    while ((option = getopt(argc, argv, "n:H:p:u:m:P:b:c:d:w:r:t:h")) != -1) {
+        switch (option) {
+            case 'n': options->name = optarg; break;
+            case 'H': options->host = optarg; break;
+            case 'p': options->port = atoi(optarg); break;
+            case 'u': options->unixSocket = optarg; break;
+            case 'm': options->method = optarg; break;
+            case 'P': options->path = optarg; break;
+            case 'b': options->body = optarg; options->contentType = "application/json"; break;
+            case 'c': options->connections = atoi(optarg); break;
+            case 'd': options->durationSeconds = atof(optarg); break;
+            case 'w': options->warmupSeconds = atof(optarg); break;
+            case 'r': options->rate = atof(optarg); break;
+            case 't': options->timeoutSeconds = atof(optarg); break;
+            default: return false;
+        }
+    }
+
+    if (options->connections < 1 || options->connections > MAX_CONNECTIONS) {
+        fprintf(stderr, "connections must be between 1 and %d\n", MAX_CONNECTIONS);
+        return false;
+    }
+
+    if (options->port <= 0 || options->durationSeconds <= 0 || options->warmupSeconds < 0 ||
+        options->rate < 0 || options->timeoutSeconds <= 0) {
+        fprintf(stderr, "port, duration and timeout must be positive\n");
+        return false;
+    }
+
+    return true;
+}
+
+static void buildRequest(LoadGenerator *generator) {
+    const Options *options = &generator->options;
+    size_t bodyLength = options->body ? strlen(options->body) : 0;
+    size_t size = strlen(options->method) + strlen(options->path) + strlen(options->host) + bodyLength + 256;
+
+    generator->request = malloc(size);
+    if (!generator->request) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int length = snprintf(generator->request, size,
+        "%s %s HTTP/1.1\r\n"
+        "Host: %s:%d\r\n"
+        "User-Agent: lavandula-loadgen\r\n"
+        "Connection: close\r\n",
+        options->method, options->path, options->host, options->port);
+
+    if (options->body) {
+        length += snprintf(generator->request + length, size - length,
+            "Content-Type: %s\r\nContent-Length: %zu\r\n\r\n%s", options->contentType, bodyLength, options->body);
+    } else {
+        length += snprintf(generator->request + length, size - length, "\r\n");
+    }
+
+    generator->requestLength = (size_t)length;
+}
+
+static void closeSlot(LoadGenerator *generator, Slot *slot) {
+    if (slot->fd >= 0) {
+        epoll_ctl(generator->epoll, EPOLL_CTL_DEL, slot->fd, NULL);
+        close(slot->fd);
+    }
+
+    slot->fd = -1;
+    slot->state = SLOT_IDLE;
+}
+
+static bool isMeasured(const LoadGenerator *generator, const Slot *slot) {
+    return slot->startedAt >= generator->measureFrom && !generator->draining;
+}
+
+static void failSlot(LoadGenerator *generator, Slot *slot) {
+    if (isMeasured(generator, slot)) {
+        generator->errors++;
+    }
+
+    closeSlot(generator, slot);
+}
+
+static void startRequest(LoadGenerator *generator, Slot *slot, int index, uint64_t dueAt, uint64_t now) {
+    memset(slot, 0, sizeof(*slot));
+    slot->fd = -1;
+    slot->dueAt = dueAt;
+    slot->startedAt = now;
+    slot->contentLength = -1;
+
+    int family = generator->address.ss_family;
+
+    int fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        failSlot(generator, slot);
+        return;
+    }
+
+    if (family == AF_INET) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    // reset rather than linger in TIME_WAIT, a long run would run out of ephemeral ports
+    struct linger linger = { .l_onoff = 1, .l_linger = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+
+    slot->fd = fd;
+    slot->state = SLOT_CONNECTING;
+
+    if (connect(fd, (struct sockaddr *)&generator->address, generator->addressLength) < 0 && errno != EINPROGRESS) {
+        failSlot(generator, slot);
+        return;
+    }
+
+    struct epoll_event event = { .events = EPOLLOUT, .data.u32 = (uint32_t)index };
+    if (epoll_ctl(generator->epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+        perror("epoll_ctl");
+        failSlot(generator, slot);
+    }
+}
+
+static void completeRequest(LoadGenerator *generator, Slot *slot, uint64_t now) {
+    uint64_t serviceTime = now - slot->startedAt;
+
+    if (generator->draining) {
+        // finished after the end of the run, not counted
+    } else if (slot->startedAt < generator->measureFrom) {
+        histogramRecord(&generator->warmup, serviceTime);
+    } else {
+        histogramRecord(&generator->latency, serviceTime);
+
+        if (generator->options.rate > 0) {
+            histogramRecord(&generator->corrected, now - slot->dueAt);
+        } else {
+            histogramRecordCorrected(&generator->corrected, serviceTime, generator->expectedInterval);
+        }
+
+        generator->completed++;
+        generator->bytes += slot->headerLength + slot->bodyRead;
+        if (slot->status < 200 || slot->status > 299) {
+            generator->non2xx++;
+        }
+    }
+
+    closeSlot(generator, slot);
+}
+
+static bool parseHeader(Slot *slot) {
+    char *end = memmem(slot->header, slot->headerLength, "\r\n\r\n", 4);
+    if (!end) return false;
+
+    size_t headerSize = (size_t)(end - slot->header) + 4;
+
+    // whatever followed the blank line is the start of the body
+    slot->bodyRead = (long long)(slot->headerLength - headerSize);
+    slot->headerLength = headerSize;
+    slot->headerDone = true;
+
+    *end = '\0';
+
+    if (strncmp(slot->header, "HTTP/1.", 7) == 0 && slot->headerLength > 12) {
+        slot->status = atoi(slot->header + 9);
+    }
+
+    for (char *line = strstr(slot->header, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+            slot->contentLength = atoll(line + 17);
+            break;
+        }
+    }
+
+    return true;
+}
+
+static void handleRead(LoadGenerator *generator, Slot *slot, uint64_t now) {
+    char chunk[READ_CHUNK_SIZE];
+
+    for (;;) {
+        char *into = chunk;
+        size_t room = sizeof(chunk);
+
+        if (!slot->headerDone) {
+            into = slot->header + slot->headerLength;
+            room = sizeof(slot->header) - slot->headerLength - 1;
+
+            if (room == 0) {
+                failSlot(generator, slot);
+                return;
+            }
+        }
+
+        ssize_t bytesRead = read(slot->fd, into, room);
+        if (bytesRead < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            if (errno == EINTR) continue;
+
+            failSlot(generator, slot);
+            return;
+        }
+
+        if (bytesRead == 0) {
+            // without a Content-Length the server closing the connection ends the body
+            if (slot->headerDone && slot->contentLength < 0) {
+                completeRequest(generator, slot, now);
+            } else {
+                failSlot(generator, slot);
+            }
+            return;
+        }
+
+        if (slot->headerDone) {
+            slot->bodyRead += bytesRead;
+        } else {
+            slot->headerLength += (size_t)bytesRead;
+            if (!parseHeader(slot)) continue;
+        }
+
+        if (slot->contentLength >= 0 && slot->bodyRead >= slot->contentLength) {
+            completeRequest(generator, slot, now);
+            return;
+        }
+    }
+}
+
+static void handleEvent(LoadGenerator *generator, Slot *slot, uint32_t events, uint64_t now) {
+    if (slot->state == SLOT_CONNECTING) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+
+        if (getsockopt(slot->fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+            failSlot(generator, slot);
+            return;
+        }
+
+        slot->state = SLOT_WRITING;
+    }
+
+    if (slot->state == SLOT_WRITING) {
+        while (slot->written < generator->requestLength) {
+            ssize_t written = write(slot->fd, generator->request + slot->written, generator->requestLength - slot->written);
+            if (written < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+                if (errno == EINTR) continue;
+
+                failSlot(generator, slot);
+                return;
+            }
+
+            slot->written += (size_t)written;
+        }
+
+        struct epoll_event event = { .events = EPOLLIN | EPOLLRDHUP, .data.u32 = (uint32_t)(slot - generator->slots) };
+        epoll_ctl(generator->epoll, EPOLL_CTL_MOD, slot->fd, &event);
+        slot->state = SLOT_READING;
+        return;
+    }
+
+    if (slot->state == SLOT_READING && (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+        handleRead(generator, slot, now);
+    }
+}
+
+static void expireSlots(LoadGenerator *generator, uint64_t now) {
+    uint64_t timeout = (uint64_t)(generator->options.timeoutSeconds * NANOS_PER_SECOND);
+
+    for (int i = 0; i < generator->options.connections; i++) {
+        Slot *slot = &generator->slots[i];
+
+        if (slot->state != SLOT_IDLE && now - slot->startedAt > timeout) {
+            if (isMeasured(generator, slot)) {
+                generator->timeouts++;
+            }
+            failSlot(generator, slot);
+        }
+    }
+}
+
+static void run(LoadGenerator *generator) {
+    const Options *options = &generator->options;
+
+    uint64_t start = nowNanos();
+    generator->measureFrom = start + (uint64_t)(options->warmupSeconds * NANOS_PER_SECOND);
+    uint64_t end = generator->measureFrom + (uint64_t)(options->durationSeconds * NANOS_PER_SECOND);
+
+    uint64_t interval = options->rate > 0 ? (uint64_t)(NANOS_PER_SECOND / options->rate) : 0;
+    uint64_t nextDue = start;
+
+    struct epoll_event events[MAX_CONNECTIONS];
+    bool measuring = false;
+
+    for (uint64_t now = start; now < end; now = nowNanos()) {
+        if (!measuring && now >= generator->measureFrom) {
+            measuring = true;
+
+            // the typical closed loop gap between requests on a connection is its service time
+            if (options->rate == 0) {
+                generator->expectedInterval = histogramQuantile(&generator->warmup, 0.5);
+            }
+        }
+
+        bool idle = false;
+        for (int i = 0; i < options->connections; i++) {
+            Slot *slot = &generator->slots[i];
+            if (slot->state != SLOT_IDLE) continue;
+
+            if (interval == 0) {
+                startRequest(generator, slot, i, now, now);
+            } else if (nextDue <= now) {
+                // a late request keeps its original due time, the wait counts against it
+                startRequest(generator, slot, i, nextDue, now);
+                nextDue += interval;
+            } else {
+                idle = true;
+            }
+        }
+
+        uint64_t wakeAt = end;
+        if (idle && nextDue < wakeAt) wakeAt = nextDue;
+        if (now + 100 * 1000000ULL < wakeAt) wakeAt = now + 100 * 1000000ULL;
+
+        int timeout = (int)((wakeAt - now + 999999) / 1000000);
+
+        int ready = epoll_wait(generator->epoll, events, options->connections, timeout);
+        if (ready < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            exit(EXIT_FAILURE);
+        }
+
+        now = nowNanos();
+        for (int i = 0; i < ready; i++) {
+            handleEvent(generator, &generator->slots[events[i].data.u32], events[i].events, now);
+        }
+
+        expireSlots(generator, now);
+    }
+
+    // let the requests still in flight finish rather than resetting connections the
+    // server is in the middle of answering, they are not counted
+    generator->draining = true;
+
+    for (bool busy = true; busy; ) {
+        int ready = epoll_wait(generator->epoll, events, options->connections, 100);
+        if (ready < 0 && errno != EINTR) break;
+
+        uint64_t now = nowNanos();
+        for (int i = 0; i < ready; i++) {
+            handleEvent(generator, &generator->slots[events[i].data.u32], events[i].events, now);
+        }
+
+        expireSlots(generator, now);
+
+        busy = false;
+        for (int i = 0; i < options->connections; i++) {
+            if (generator->slots[i].state != SLOT_IDLE) busy = true;
+        }
+    }
+}
+
+static void printLatency(const char *key, const Histogram *histogram) {
+    double mean = histogram->count ? (double)histogram->sum / histogram->count : 0;
+
+    printf("\"%s\":{\"min\":%.1f,\"mean\":%.1f,\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f}",
+        key,
+        histogram->min / 1000.0,
+        mean / 1000.0,
+        histogramQuantile(histogram, 0.5) / 1000.0,
+        histogramQuantile(histogram, 0.9) / 1000.0,
+        histogramQuantile(histogram, 0.99) / 1000.0,
+        histogramQuantile(histogram, 0.999) / 1000.0,
+        histogram->max / 1000.0);
+}
+
+static void report(const LoadGenerator *generator) {
+    const Options *options = &generator->options;
+    double throughput = generator->completed / options->durationSeconds;
+
+    printf("{\"name\":\"%s\",\"mode\":\"%s\",\"method\":\"%s\",\"path\":\"%s\",\"connections\":%d,"
+        "\"rate\":%.1f,\"durationSeconds\":%.1f,\"warmupSeconds\":%.1f,",
+        options->name, options->rate > 0 ? "open" : "closed", options->method, options->path, options->connections,
+        options->rate, options->durationSeconds, options->warmupSeconds);
+
+    printf("\"requests\":%llu,\"errors\":%llu,\"timeouts\":%llu,\"non2xx\":%llu,\"bytes\":%llu,\"throughput\":%.1f,"
+        "\"expectedIntervalMicros\":%.1f,",
+        (unsigned long long)generator->completed, (unsigned long long)generator->errors,
+        (unsigned long long)generator->timeouts, (unsigned long long)generator->non2xx,
+        (unsigned long long)generator->bytes, throughput, generator->expectedInterval / 1000.0);
+
+    printLatency("latencyMicros", &generator->latency);
+    printf(",");
+    printLatency("correctedLatencyMicros", &generator->corrected);
+    printf("}\n");
+
+    fprintf(stderr, "%-12s %-6s %8.0f req/s  p50 %8.1fus  p99 %8.1fus  p99 corrected %8.1fus  errors %llu\n",
+        options->name, options->rate > 0 ? "open" : "closed", throughput,
+        histogramQuantile(&generator->latency, 0.5) / 1000.0,
+        histogramQuantile(&generator->latency, 0.99) / 1000.0,
+        histogramQuantile(&generator->corrected, 0.99) / 1000.0,
+        (unsigned long long)(generator->errors + generator->timeouts));
+}
+
+int main(int argc, char **argv) {
+    static LoadGenerator generator;
+
+    if (!parseOptions(argc, argv, &generator.options)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (generator.options.unixSocket) {
+        struct sockaddr_un *address = (struct sockaddr_un *)&generator.address;
+        if (strlen(generator.options.unixSocket) >= sizeof(address->sun_path)) {
+            fprintf(stderr, "socket path '%s' is too long\n", generator.options.unixSocket);
+            return EXIT_FAILURE;
+        }
+
+        address->sun_family = AF_UNIX;
+        strcpy(address->sun_path, generator.options.unixSocket);
+        generator.addressLength = sizeof(*address);
+    } else {
+        struct sockaddr_in *address = (struct sockaddr_in *)&generator.address;
+        address->sin_family = AF_INET;
+        address->sin_port = htons(generator.options.port);
+        if (inet_pton(AF_INET, generator.options.host, &address->sin_addr) != 1) {
+            fprintf(stderr, "invalid IPv4 address '%s'\n", generator.options.host);
+            return EXIT_FAILURE;
+        }
+        generator.addressLength = sizeof(*address);
+    }
+
+    buildRequest(&generator);
+
+    generator.epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (generator.epoll < 0) {
+        perror("epoll_create1");
+        return EXIT_FAILURE;
+    }
+
+    generator.slots = calloc(generator.options.connections, sizeof(Slot));
+    if (!generator.slots) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < generator.options.connections; i++) {
+        generator.slots[i].fd = -1;
+    }
+
+    run(&generator);
+    report(&generator);
+
+    close(generator.epoll);
+    free(generator.slots);
+    free(generator.request);
+
+    return EXIT_SUCCESS;
+}
+
+#else
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(void) {
+    fprintf(stderr, "the load generator is built on epoll and only runs on Linux\n");
+    return EXIT_FAILURE;
+}
+
+#endif
@@ -0,0 +1,104 @@
+#!/bin/bash
+
+# Runs every benchmark app under the load generator, once closed loop and once open loop,
+# and collects the results in build/bench/results.json. Invoked by `make bench`.
+#
+#   BENCH_DURATION     measured seconds per run (default 10)
+#   BENCH_WARMUP       warmup seconds per run (default 2)
+#   BENCH_CONNECTIONS  concurrent connections (default 8)
+#   BENCH_RATE         open loop requests per second (default 500)
+#   BENCH_PORT         port the apps listen on (default 3900)
+#
+# hello also runs behind a Unix domain socket, reported as hello_unix.
+
+set -e
+
+BUILD=build/bench
+DURATION=${BENCH_DURATION:-10}
+WARMUP=${BENCH_WARMUP:-2}
+CONNECTIONS=${BENCH_CONNECTIONS:-8}
+RATE=${BENCH_RATE:-500}
+PORT=${BENCH_PORT:-3900}
+
+SOCKET=$BUILD/bench.sock
+
+RESULTS=$BUILD/results.json
+RUNS=$BUILD/runs.jsonl
+: > "$RUNS"
+
+# waitForListener [socket path]
+waitForListener() {
+    for _ in $(seq 1 50); do
+        if [ -n "$1" ]; then
+            if [ -S "$1" ]; then
+                return 0
+            fi
+        elif (echo > /dev/tcp/127.0.0.1/"$PORT") 2> /dev/null; then
+            return 0
+        fi
+        sleep 0.1
+    done
+
+    echo "❌ Error: the app did not start listening on ${1:-port $PORT}" >&2
+    return 1
+}
+
+# bench <app> <loadgen options...>, UNIX=1 runs it on $SOCKET instead of TCP
+bench() {
+    local app=$1
+    shift
+
+    local name=$app
+    local args=("$PORT")
+    local target=(-p "$PORT")
+    local socket=""
+    if [ "$app" = "sqlite_read" ]; then
+        args+=("$BUILD/bench.db")
+    elif [ -n "$UNIX" ]; then
+        name=${app}_unix
+        socket=$SOCKET
+        args+=("unix:$socket")
+        target=(-u "$socket")
+    fi
+
+    "$BUILD/$app" "${args[@]}" < /dev/null > "$BUILD/$name.log" 2>&1 &
+    local pid=$!
+    trap 'kill $pid 2> /dev/null' EXIT
+
+    waitForListener "$socket"
+
+    for mode in closed open; do
+        if ! kill -0 "$pid" 2> /dev/null; then
+            echo "❌ Error: $app exited, see $BUILD/$name.log" >&2
+            return 1
+        fi
+
+        local rate=()
+        if [ "$mode" = "open" ]; then
+            rate=(-r "$RATE")
+        fi
+
+        "$BUILD/loadgen" -n "$name" "${target[@]}" -c "$CONNECTIONS" -d "$DURATION" -w "$WARMUP" "${rate[@]}" "$@" >> "$RUNS"
+    done
+
+    kill "$pid"
+    wait "$pid" 2> /dev/null || true
+    trap - EXIT
+}
+
+bench hello -P /
+UNIX=1 bench hello -P /
+bench json_echo -m POST -P /echo -b '{"name":"lavandula","tags":["c","web"],"count":3,"active":true}'
+bench sqlite_read -P /items
+
+{
+    printf '{"timestamp":"%s",' "$(date -u +%Y-%m-%dT%H:%M:%SZ)"
+    printf '"commit":"%s",' "$(git rev-parse --short HEAD 2> /dev/null || echo unknown)"
+    printf '"cpus":%s,' "$(getconf _NPROCESSORS_ONLN)"
+    printf '"runs":['
+    paste -sd, "$RUNS"
+    printf ']}\n'
+} > "$RESULTS"
+
+rm -f "$RUNS"
+echo "results written to $RESULTS"
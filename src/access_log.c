@@ -0,0 +1,298 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "include/access_log.h"
+
+static uint64_t nextGeneration = 1;
+
+static __thread AccessLogRing *localRing = NULL;
+static __thread uint64_t localGeneration = 0;
+
+// close on exec so a reload (execv) does not carry the old descriptor into the new image
+static int openLogFile(const char *path, size_t *size) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    *size = fstat(fd, &st) == 0 ? (size_t)st.st_size : 0;
+
+    return fd;
+}
+
+static void *accessLogWriter(void *arg) {
+    AccessLog *log = arg;
+
+    while (__atomic_load_n(&log->running, __ATOMIC_ACQUIRE)) {
+        usleep(ACCESS_LOG_FLUSH_MS * 1000);
+        drainAccessLog(log);
+    }
+
+    return NULL;
+}
+
+AccessLog *initAccessLog(const char *path, size_t maxBytes) {
+    AccessLog *log = calloc(1, sizeof(AccessLog));
+    if (!log) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    log->maxBytes = maxBytes > 0 ? maxBytes : ACCESS_LOG_MAX_BYTES;
+    log->fileDescriptor = STDOUT_FILENO;
+
+    if (path) {
+        log->path = strdup(path);
+        log->fileDescriptor = openLogFile(path, &log->fileSize);
+
+        if (log->fileDescriptor < 0) {
+            fprintf(stderr, "Failed to open access log '%s': %s\n", path, strerror(errno));
+            free(log->path);
+            free(log);
+            return NULL;
+        }
+    }
+
+    log->generation = __atomic_fetch_add(&nextGeneration, 1, __ATOMIC_RELAXED);
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_mutex_init(&log->drainLock, NULL);
+
+    log->running = true;
+    if (pthread_create(&log->writer, NULL, accessLogWriter, log) != 0) {
+        perror("Failed to start the access log writer");
+        exit(EXIT_FAILURE);
+    }
+
+    return log;
+}
+
+void freeAccessLog(AccessLog *log) {
+    if (!log) return;
+
+    __atomic_store_n(&log->running, false, __ATOMIC_RELEASE);
+    pthread_join(log->writer, NULL);
+
+    // whatever was queued after the writer's last pass
+    drainAccessLog(log);
+
+    AccessLogRing *ring = log->rings;
+    while (ring) {
+        AccessLogRing *nextRing = ring->next;
+        free(ring);
+        ring = nextRing;
+    }
+
+    if (log->path) {
+        close(log->fileDescriptor);
+        free(log->path);
+    }
+
+    pthread_mutex_destroy(&log->lock);
+    pthread_mutex_destroy(&log->drainLock);
+    free(log);
+}
+
+static AccessLogRing *threadRing(AccessLog *log) {
+    if (localRing && localGeneration == log->generation) {
+        return localRing;
+    }
+
+    AccessLogRing *ring = calloc(1, sizeof(AccessLogRing));
+    if (!ring) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_lock(&log->lock);
+    ring->next = log->rings;
+    log->rings = ring;
+    pthread_mutex_unlock(&log->lock);
+
+    localRing = ring;
+    localGeneration = log->generation;
+
+    return ring;
+}
+
+void logAccess(AccessLog *log, const AccessLogRecord *record) {
+    if (!log) return;
+
+    AccessLogRing *ring = threadRing(log);
+
+    uint64_t head = ring->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail >= ACCESS_LOG_RING_SIZE) {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    ring->records[head & (ACCESS_LOG_RING_SIZE - 1)] = *record;
+
+    // publish the record only once it is fully written
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+uint64_t accessLogDropped(AccessLog *log) {
+    uint64_t dropped = 0;
+
+    pthread_mutex_lock(&log->lock);
+    for (AccessLogRing *ring = log->rings; ring; ring = ring->next) {
+        dropped += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&log->lock);
+
+    return dropped;
+}
+
+static size_t appendJsonString(char *out, size_t size, size_t length, const char *value) {
+    for (const unsigned char *p = (const unsigned char *)value; *p && length + 7 < size; p++) {
+        if (*p == '"' || *p == '\\') {
+            out[length++] = '\\';
+            out[length++] = *p;
+        } else if (*p < 0x20) {
+            length += snprintf(out + length, size - length, "\\u%04x", *p);
+        } else {
+            out[length++] = *p;
+        }
+    }
+
+    return length;
+}
+
+int formatAccessLogRecord(const AccessLogRecord *record, char *out, size_t size) {
+    time_t seconds = record->timestampMillis / 1000;
+    struct tm utc;
+    gmtime_r(&seconds, &utc);
+
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &utc);
+
+    size_t length = snprintf(out, size, "{\"time\":\"%s.%03dZ\",\"ip\":\"%s\",\"method\":\"%s\",\"path\":\"",
+        timestamp, (int)(record->timestampMillis % 1000), record->clientIp, httpMethodToStr(record->method));
+    if (length >= size) return 0;
+
+    length = appendJsonString(out, size, length, record->path);
+
+    int tailLength = snprintf(out + length, size - length, "\",\"status\":%d,\"bytes\":%llu,\"durationMicros\":%llu}\n",
+        record->status, (unsigned long long)record->bytes, (unsigned long long)record->durationMicros);
+    if (tailLength < 0 || (size_t)tailLength >= size - length) return 0;
+
+    return (int)(length + tailLength);
+}
+
+static void rotate(AccessLog *log) {
+    close(log->fileDescriptor);
+
+    size_t pathLength = strlen(log->path) + 16;
+    char *from = malloc(pathLength);
+    char *to = malloc(pathLength);
+    if (!from || !to) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // path.4 -> path.5, ..., path -> path.1, the oldest falls off the end
+    for (int i = ACCESS_LOG_KEEP_FILES - 1; i >= 1; i--) {
+        snprintf(from, pathLength, "%s.%d", log->path, i);
+        snprintf(to, pathLength, "%s.%d", log->path, i + 1);
+        rename(from, to);
+    }
+
+    snprintf(to, pathLength, "%s.1", log->path);
+    rename(log->path, to);
+
+    free(from);
+    free(to);
+
+    log->fileDescriptor = openLogFile(log->path, &log->fileSize);
+    if (log->fileDescriptor < 0) {
+        // keep going on stderr rather than losing every record from now on
+        perror("Failed to reopen the access log");
+        log->fileDescriptor = STDERR_FILENO;
+        free(log->path);
+        log->path = NULL;
+    }
+}
+
+static void writeOut(AccessLog *log, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(log->fileDescriptor, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+
+        data += written;
+        length -= written;
+        log->fileSize += written;
+    }
+}
+
+int drainAccessLog(AccessLog *log) {
+    char *buffer = log->buffer;
+    size_t buffered = 0;
+    int written = 0;
+
+    pthread_mutex_lock(&log->drainLock);
+
+    pthread_mutex_lock(&log->lock);
+    AccessLogRing *rings = log->rings;
+    pthread_mutex_unlock(&log->lock);
+
+    for (AccessLogRing *ring = rings; ring; ring = ring->next) {
+        uint64_t tail = ring->tail;
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+        for (; tail != head; tail++) {
+            char line[1024];
+            int length = formatAccessLogRecord(&ring->records[tail & (ACCESS_LOG_RING_SIZE - 1)], line, sizeof(line));
+            if (length <= 0) continue;
+
+            if (log->path && log->fileSize + buffered + length > log->maxBytes) {
+                writeOut(log, buffer, buffered);
+                buffered = 0;
+                rotate(log);
+            }
+
+            if (buffered + length > ACCESS_LOG_BUFFER_SIZE) {
+                writeOut(log, buffer, buffered);
+                buffered = 0;
+            }
+
+            memcpy(buffer + buffered, line, length);
+            buffered += length;
+            written++;
+        }
+
+        // hand the slots back to the producer
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+
+    uint64_t dropped = 0;
+    for (AccessLogRing *ring = rings; ring; ring = ring->next) {
+        dropped += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    }
+
+    // make losses visible in the log itself, once per batch
+    if (dropped > log->droppedReported) {
+        int length = snprintf(buffer + buffered, ACCESS_LOG_BUFFER_SIZE - buffered, "{\"event\":\"dropped\",\"count\":%llu,\"total\":%llu}\n",
+            (unsigned long long)(dropped - log->droppedReported), (unsigned long long)dropped);
+
+        if (length > 0 && (size_t)length < ACCESS_LOG_BUFFER_SIZE - buffered) {
+            buffered += length;
+        }
+        log->droppedReported = dropped;
+    }
+
+    writeOut(log, buffer, buffered);
+
+    pthread_mutex_unlock(&log->drainLock);
+
+    return written;
+}
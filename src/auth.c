@@ -50,10 +50,10 @@ void addBasicCredentials(BasicAuthenticator *auth, const char *const username, c
 }
 
 HttpResponse basicAuth(RequestContext ctx, MiddlewareHandler *n) {
-    char *authHeader = NULL;
+    const char *authHeader = NULL;
     for (size_t i = 0; i < ctx.request.headerCount; i++) {
         if (strcmp(ctx.request.headers[i].name, "Authorization") == 0) {
-            authHeader = ctx.request.headers[i].value;
+            authHeader = wholeHeaderValue(&ctx.request.headers[i]);
             break;
         }
     }
@@ -62,7 +62,7 @@ HttpResponse basicAuth(RequestContext ctx, MiddlewareHandler *n) {
         return unauthorized("Unauthorized", TEXT_PLAIN);
     }
 
-    char *encodedCredentials = authHeader + 6;
+    const char *encodedCredentials = authHeader + 6;
 
     if (checkBasicCredentials(&ctx.app->auth, encodedCredentials)) {
         return next(ctx, n);
@@ -1,82 +1,329 @@
 #include "include/base64.h"
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
-char base64Map[] = {
-    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',
-    'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd', 'e', 'f',
-    'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v',
-    'w', 'x', 'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '+', '/'
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define BASE64_AVX2
+#endif
+
+// inputs shorter than this are not worth the vector setup
+#define BASE64_SIMD_THRESHOLD 64
+
+static const char base64Map[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char base64UrlMap[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// reverse lookup tables, 0xff marks a character outside the alphabet
+static const unsigned char base64DecodeTable[256] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3e, 0xff, 0xff, 0xff, 0x3f,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
 };
 
-char *base64Encode(const char *const plain) {
-    int counts = 0;
-    char buffer[3];
-    char *cipher = malloc(strlen(plain) * 4 / 3 + 4);
-    
-    if (!cipher) {
-        fprintf(stderr, "Fatal: out of memory\n");
-        exit(EXIT_FAILURE);
+static const unsigned char base64UrlDecodeTable[256] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3e, 0xff, 0xff,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0x3f,
+    0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+#ifdef BASE64_AVX2
+
+// Vectorised encode/decode for the standard alphabet, after Mula and Lemire,
+// "Faster Base64 Encoding and Decoding Using AVX2 Instructions" (2018).
+
+__attribute__((target("avx2")))
+static size_t encodeAvx2(const unsigned char *in, size_t length, char *out) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10
+    );
+    const __m256i shiftLut = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0
+    );
+
+    size_t consumed = 0;
+
+    // each iteration reads 28 bytes and uses 24 of them
+    while (length - consumed >= 32) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(in + consumed));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(in + consumed + 12));
+        __m256i input = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+        // split every 3 bytes into four 6-bit indices
+        input = _mm256_shuffle_epi8(input, shuffle);
+        __m256i t0 = _mm256_and_si256(input, _mm256_set1_epi32(0x0fc0fc00));
+        __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        __m256i t2 = _mm256_and_si256(input, _mm256_set1_epi32(0x003f03f0));
+        __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(t1, t3);
+
+        // map the indices to ASCII by adding a per-range offset
+        __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        range = _mm256_or_si256(range, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+        __m256i result = _mm256_add_epi8(_mm256_shuffle_epi8(shiftLut, range), indices);
+
+        _mm256_storeu_si256((__m256i *)out, result);
+
+        out += 32;
+        consumed += 24;
     }
 
-    int i = 0, c = 0;
+    return consumed;
+}
 
-    for(i = 0; plain[i] != '\0'; i++) {
-        buffer[counts++] = plain[i];
-        if(counts == 3) {
-            cipher[c++] = base64Map[buffer[0] >> 2];
-            cipher[c++] = base64Map[((buffer[0] & 0x03) << 4) + (buffer[1] >> 4)];
-            cipher[c++] = base64Map[((buffer[1] & 0x0f) << 2) + (buffer[2] >> 6)];
-            cipher[c++] = base64Map[buffer[2] & 0x3f];
-            counts = 0;
-        }
+// Stops at the first block containing a character outside the alphabet, the scalar tail reports it.
+// The last quantum is always left to the scalar tail too, which checks its trailing bits.
+__attribute__((target("avx2")))
+static size_t decodeAvx2(const char *in, size_t length, unsigned char *out) {
+    const __m256i lutLo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a
+    );
+    const __m256i lutHi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+    );
+    const __m256i lutRoll = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0
+    );
+    const __m256i pack = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+    );
+    const __m256i mask2F = _mm256_set1_epi8(0x2f);
+
+    size_t consumed = 0;
+
+    // the 32 byte store writes 8 bytes past the 24 decoded ones, keeping 13 characters
+    // in reserve guarantees that slack is still inside the output buffer
+    while (length - consumed >= 45) {
+        __m256i str = _mm256_loadu_si256((const __m256i *)(in + consumed));
+
+        __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask2F);
+        __m256i loNibbles = _mm256_and_si256(str, mask2F);
+        __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+        __m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+
+        if (!_mm256_testz_si256(lo, hi)) break;
+
+        __m256i eq2F = _mm256_cmpeq_epi8(str, mask2F);
+        __m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(eq2F, hiNibbles));
+        str = _mm256_add_epi8(str, roll);
+
+        // merge four 6-bit values into three bytes per 32-bit lane
+        __m256i merged = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+        merged = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+        merged = _mm256_shuffle_epi8(merged, pack);
+        merged = _mm256_permutevar8x32_epi32(merged, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1));
+
+        _mm256_storeu_si256((__m256i *)out, merged);
+
+        out += 24;
+        consumed += 32;
+    }
+
+    return consumed;
+}
+
+static bool useAvx2(size_t length) {
+    return length >= BASE64_SIMD_THRESHOLD && __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+static size_t encodeScalar(const unsigned char *in, size_t length, char *out, const char *map, bool pad) {
+    size_t i = 0, c = 0;
+
+    for (; i + 2 < length; i += 3) {
+        uint32_t triple = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+
+        out[c++] = map[(triple >> 18) & 0x3f];
+        out[c++] = map[(triple >> 12) & 0x3f];
+        out[c++] = map[(triple >> 6) & 0x3f];
+        out[c++] = map[triple & 0x3f];
     }
 
-    if(counts > 0) {
-        cipher[c++] = base64Map[buffer[0] >> 2];
-        if(counts == 1) {
-            cipher[c++] = base64Map[(buffer[0] & 0x03) << 4];
-            cipher[c++] = '=';
-        } else {
-            cipher[c++] = base64Map[((buffer[0] & 0x03) << 4) + (buffer[1] >> 4)];
-            cipher[c++] = base64Map[(buffer[1] & 0x0f) << 2];
+    size_t remaining = length - i;
+    if (remaining > 0) {
+        uint32_t triple = (uint32_t)in[i] << 16;
+        if (remaining == 2) triple |= (uint32_t)in[i + 1] << 8;
+
+        out[c++] = map[(triple >> 18) & 0x3f];
+        out[c++] = map[(triple >> 12) & 0x3f];
+
+        if (remaining == 2) {
+            out[c++] = map[(triple >> 6) & 0x3f];
+        } else if (pad) {
+            out[c++] = '=';
         }
-        cipher[c++] = '=';
+
+        if (pad) out[c++] = '=';
     }
 
+    return c;
+}
+
+static bool decodeScalar(const char *in, size_t length, unsigned char *out, size_t *written, const unsigned char *table) {
+    size_t i = 0, p = 0;
+
+    for (; i + 4 <= length; i += 4) {
+        uint32_t a = table[(unsigned char)in[i]];
+        uint32_t b = table[(unsigned char)in[i + 1]];
+        uint32_t c = table[(unsigned char)in[i + 2]];
+        uint32_t d = table[(unsigned char)in[i + 3]];
+
+        if ((a | b | c | d) & 0x80) return false;
+
+        uint32_t triple = (a << 18) | (b << 12) | (c << 6) | d;
+        out[p++] = (unsigned char)(triple >> 16);
+        out[p++] = (unsigned char)(triple >> 8);
+        out[p++] = (unsigned char)triple;
+    }
+
+    size_t remaining = length - i;
+    if (remaining > 0) {
+        uint32_t a = table[(unsigned char)in[i]];
+        uint32_t b = table[(unsigned char)in[i + 1]];
+        uint32_t c = remaining == 3 ? table[(unsigned char)in[i + 2]] : 0;
+
+        if ((a | b | c) & 0x80) return false;
+
+        // the bits past the last whole byte must be zero, "QR==" is not another spelling of "QQ=="
+        if (remaining == 2 ? (b & 0x0f) : (c & 0x03)) return false;
+
+        uint32_t triple = (a << 18) | (b << 12) | (c << 6);
+        out[p++] = (unsigned char)(triple >> 16);
+        if (remaining == 3) out[p++] = (unsigned char)(triple >> 8);
+    }
+
+    *written = p;
+    return true;
+}
+
+static char *encode(const unsigned char *data, size_t length, size_t *outLength, const char *map, bool pad) {
+    char *cipher = malloc(base64EncodedLength(length) + 1);
+
+    if (!cipher) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t consumed = 0, c = 0;
+
+#ifdef BASE64_AVX2
+    if (map == base64Map && useAvx2(length)) {
+        consumed = encodeAvx2(data, length, cipher);
+        c = consumed / 3 * 4;
+    }
+#endif
+
+    c += encodeScalar(data + consumed, length - consumed, cipher + c, map, pad);
     cipher[c] = '\0';
+
+    if (outLength) *outLength = c;
     return cipher;
 }
 
+static unsigned char *decode(const char *cipher, size_t length, size_t *outLength, const unsigned char *table) {
+    // up to two '=' are accepted, but only on a whole number of quanta
+    size_t padding = 0;
+    while (padding < 2 && length > 0 && cipher[length - 1] == '=') {
+        length--;
+        padding++;
+    }
+
+    if (padding > 0 && (length + padding) % 4 != 0) return NULL;
+    if (length % 4 == 1) return NULL;
+
+    unsigned char *plain = malloc(length / 4 * 3 + 3);
 
-char *base64Decode(const char *const cipher) {
-    int counts = 0;
-    char buffer[4];
-    char *plain = malloc(strlen(cipher) * 3 / 4 + 1);
-        
     if (!plain) {
         fprintf(stderr, "Fatal: out of memory\n");
         exit(EXIT_FAILURE);
     }
 
-    int i = 0, p = 0;
-
-    for(i = 0; cipher[i] != '\0'; i++) {
-        int k;
-        for(k = 0 ; k < 64 && base64Map[k] != cipher[i]; k++);
-        buffer[counts++] = k;
-        if(counts == 4) {
-            plain[p++] = (buffer[0] << 2) + (buffer[1] >> 4);
-            if(buffer[2] != 64)
-                plain[p++] = (buffer[1] << 4) + (buffer[2] >> 2);
-            if(buffer[3] != 64)
-                plain[p++] = (buffer[2] << 6) + buffer[3];
-            counts = 0;
-        }
+    size_t consumed = 0, p = 0;
+
+#ifdef BASE64_AVX2
+    if (table == base64DecodeTable && useAvx2(length)) {
+        consumed = decodeAvx2(cipher, length, plain);
+        p = consumed / 4 * 3;
+    }
+#endif
+
+    size_t written = 0;
+    if (!decodeScalar(cipher + consumed, length - consumed, plain + p, &written, table)) {
+        free(plain);
+        return NULL;
     }
+    p += written;
 
     plain[p] = '\0';
+
+    if (outLength) *outLength = p;
     return plain;
+}
+
+size_t base64EncodedLength(size_t length) {
+    return (length + 2) / 3 * 4;
+}
+
+char *base64EncodeBytes(const void *const data, size_t length, size_t *outLength) {
+    return encode(data, length, outLength, base64Map, true);
+}
+
+unsigned char *base64DecodeBytes(const char *const cipher, size_t length, size_t *outLength) {
+    return decode(cipher, length, outLength, base64DecodeTable);
+}
+
+char *base64Encode(const char *const plain) {
+    return encode((const unsigned char *)plain, strlen(plain), NULL, base64Map, true);
+}
+
+char *base64Decode(const char *const cipher) {
+    return (char *)decode(cipher, strlen(cipher), NULL, base64DecodeTable);
+}
+
+// base64url (RFC 4648 section 5) without padding, as used by JWTs
+char *base64UrlEncode(const unsigned char *const data, size_t length) {
+    return encode(data, length, NULL, base64UrlMap, false);
+}
+
+// padding is optional, returns NULL on invalid input
+unsigned char *base64UrlDecode(const char *const cipher, size_t length, size_t *outLength) {
+    return decode(cipher, length, outLength, base64UrlDecodeTable);
 }
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/un.h>
+
+#include "include/bind_address.h"
+
+static bool resolveInterface(const char *name, int port, BindAddress *out) {
+    struct ifaddrs *interfaces;
+    if (getifaddrs(&interfaces) < 0) return false;
+
+    // an interface usually has one IPv4 address, prefer it to its IPv6 ones
+    const struct ifaddrs *match = NULL;
+    for (const struct ifaddrs *interface = interfaces; interface; interface = interface->ifa_next) {
+        if (!interface->ifa_addr || strcmp(interface->ifa_name, name) != 0) continue;
+
+        int family = interface->ifa_addr->sa_family;
+        if (family == AF_INET) {
+            match = interface;
+            break;
+        }
+        if (family == AF_INET6 && !match) {
+            match = interface;
+        }
+    }
+
+    if (match && match->ifa_addr->sa_family == AF_INET) {
+        struct sockaddr_in *address = (struct sockaddr_in *)&out->address;
+        memcpy(address, match->ifa_addr, sizeof(*address));
+        address->sin_port = htons(port);
+        out->length = sizeof(*address);
+    } else if (match) {
+        struct sockaddr_in6 *address = (struct sockaddr_in6 *)&out->address;
+        memcpy(address, match->ifa_addr, sizeof(*address));
+        address->sin6_port = htons(port);
+        // a link-local address means nothing without its interface
+        address->sin6_scope_id = if_nametoindex(name);
+        out->length = sizeof(*address);
+    }
+
+    freeifaddrs(interfaces);
+
+    return match != NULL;
+}
+
+bool resolveBindAddress(const char *address, int port, BindAddress *out) {
+    memset(out, 0, sizeof(*out));
+
+    if (!address) {
+        address = DEFAULT_BIND_ADDRESS;
+    }
+
+    size_t prefixLength = strlen(UNIX_ADDRESS_PREFIX);
+    if (strncmp(address, UNIX_ADDRESS_PREFIX, prefixLength) == 0) {
+        const char *path = address + prefixLength;
+
+        struct sockaddr_un *unixAddress = (struct sockaddr_un *)&out->address;
+        if (!*path || strlen(path) >= sizeof(unixAddress->sun_path)) return false;
+
+        unixAddress->sun_family = AF_UNIX;
+        strcpy(unixAddress->sun_path, path);
+        out->length = sizeof(*unixAddress);
+
+        return true;
+    }
+
+    if (strcmp(address, "localhost") == 0) {
+        address = "127.0.0.1";
+    }
+
+    struct sockaddr_in *ipv4 = (struct sockaddr_in *)&out->address;
+    if (inet_pton(AF_INET, address, &ipv4->sin_addr) == 1) {
+        ipv4->sin_family = AF_INET;
+        ipv4->sin_port = htons(port);
+        out->length = sizeof(*ipv4);
+
+        return true;
+    }
+
+    // brackets as in a URL, "[::1]"
+    char unbracketed[INET6_ADDRSTRLEN];
+    size_t length = strlen(address);
+    if (length > 2 && address[0] == '[' && address[length - 1] == ']' && length - 2 < sizeof(unbracketed)) {
+        memcpy(unbracketed, address + 1, length - 2);
+        unbracketed[length - 2] = '\0';
+        address = unbracketed;
+    }
+
+    struct sockaddr_in6 *ipv6 = (struct sockaddr_in6 *)&out->address;
+    if (inet_pton(AF_INET6, address, &ipv6->sin6_addr) == 1) {
+        ipv6->sin6_family = AF_INET6;
+        ipv6->sin6_port = htons(port);
+        out->length = sizeof(*ipv6);
+        out->dualStack = IN6_IS_ADDR_UNSPECIFIED(&ipv6->sin6_addr);
+
+        return true;
+    }
+
+    return resolveInterface(address, port, out);
+}
+
+bool sameBindAddress(const struct sockaddr *a, const struct sockaddr *b) {
+    if (a->sa_family != b->sa_family) return false;
+
+    if (a->sa_family == AF_INET) {
+        const struct sockaddr_in *ipv4A = (const struct sockaddr_in *)a;
+        const struct sockaddr_in *ipv4B = (const struct sockaddr_in *)b;
+
+        return ipv4A->sin_port == ipv4B->sin_port && ipv4A->sin_addr.s_addr == ipv4B->sin_addr.s_addr;
+    }
+
+    if (a->sa_family == AF_INET6) {
+        const struct sockaddr_in6 *ipv6A = (const struct sockaddr_in6 *)a;
+        const struct sockaddr_in6 *ipv6B = (const struct sockaddr_in6 *)b;
+
+        return ipv6A->sin6_port == ipv6B->sin6_port &&
+            memcmp(&ipv6A->sin6_addr, &ipv6B->sin6_addr, sizeof(ipv6A->sin6_addr)) == 0;
+    }
+
+    if (a->sa_family == AF_UNIX) {
+        return strcmp(((const struct sockaddr_un *)a)->sun_path, ((const struct sockaddr_un *)b)->sun_path) == 0;
+    }
+
+    return false;
+}
+
+void formatListenUrl(const BindAddress *address, char *out, size_t size) {
+    const struct sockaddr *socketAddress = (const struct sockaddr *)&address->address;
+    char host[INET6_ADDRSTRLEN] = "";
+
+    if (socketAddress->sa_family == AF_INET) {
+        const struct sockaddr_in *ipv4 = (const struct sockaddr_in *)socketAddress;
+        inet_ntop(AF_INET, &ipv4->sin_addr, host, sizeof(host));
+        snprintf(out, size, "http://%s:%d", host, ntohs(ipv4->sin_port));
+    } else if (socketAddress->sa_family == AF_INET6) {
+        const struct sockaddr_in6 *ipv6 = (const struct sockaddr_in6 *)socketAddress;
+        inet_ntop(AF_INET6, &ipv6->sin6_addr, host, sizeof(host));
+        snprintf(out, size, "http://[%s]:%d", host, ntohs(ipv6->sin6_port));
+    } else if (socketAddress->sa_family == AF_UNIX) {
+        snprintf(out, size, "%s%s", UNIX_ADDRESS_PREFIX, ((const struct sockaddr_un *)socketAddress)->sun_path);
+    } else if (size > 0) {
+        out[0] = '\0';
+    }
+}
+
+void formatClientAddress(const struct sockaddr *address, char *out, size_t size) {
+    if (size == 0) return;
+    out[0] = '\0';
+
+    if (address->sa_family == AF_INET) {
+        inet_ntop(AF_INET, &((const struct sockaddr_in *)address)->sin_addr, out, size);
+    } else if (address->sa_family == AF_INET6) {
+        const struct in6_addr *ipv6 = &((const struct sockaddr_in6 *)address)->sin6_addr;
+
+        // an IPv4 client of a dual-stack listener, ::ffff:a.b.c.d
+        if (IN6_IS_ADDR_V4MAPPED(ipv6)) {
+            inet_ntop(AF_INET, &ipv6->s6_addr[12], out, size);
+        } else {
+            inet_ntop(AF_INET6, ipv6, out, size);
+        }
+    } else if (address->sa_family == AF_UNIX) {
+        snprintf(out, size, "unix");
+    }
+}
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/buffer_pool.h"
+
+struct BufferSlab {
+    BufferSlab *next;
+    // the buffers follow, aligned for whatever is stored in them
+    _Alignas(max_align_t) char buffers[];
+};
+
+static void *checked(void *memory) {
+    if (!memory) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return memory;
+}
+
+BufferPool *initBufferPool(size_t bufferSize) {
+    BufferPool *pool = checked(calloc(1, sizeof(BufferPool)));
+
+    // a returned buffer holds the free list's next pointer
+    pool->bufferSize = bufferSize < sizeof(void *) ? sizeof(void *) : bufferSize;
+    // no slab yet, the first buffer taken allocates one
+    pool->slabUsed = POOL_SLAB_BUFFERS;
+
+    return pool;
+}
+
+void freeBufferPool(BufferPool *pool) {
+    if (!pool) return;
+
+    while (pool->slabs) {
+        BufferSlab *slab = pool->slabs;
+        pool->slabs = slab->next;
+        free(slab);
+    }
+
+    free(pool);
+}
+
+char *takeBuffer(BufferPool *pool) {
+    pool->inUse++;
+
+    if (pool->free) {
+        char *buffer = pool->free;
+        memcpy(&pool->free, buffer, sizeof(void *));
+        return buffer;
+    }
+
+    // handed out in order, so the pages of a new slab are only touched as they are needed
+    if (pool->slabUsed == POOL_SLAB_BUFFERS) {
+        BufferSlab *slab = checked(malloc(sizeof(BufferSlab) + pool->bufferSize * POOL_SLAB_BUFFERS));
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        pool->slabUsed = 0;
+        pool->slabCount++;
+    }
+
+    return pool->slabs->buffers + pool->bufferSize * pool->slabUsed++;
+}
+
+char *growBuffer(BufferPool *pool, char *buffer, size_t capacity, size_t newCapacity) {
+    if (capacity > pool->bufferSize) {
+        return checked(realloc(buffer, newCapacity));
+    }
+
+    char *grown = checked(malloc(newCapacity));
+    memcpy(grown, buffer, capacity < newCapacity ? capacity : newCapacity);
+    releaseBuffer(pool, buffer, capacity);
+
+    return grown;
+}
+
+void releaseBuffer(BufferPool *pool, char *buffer, size_t capacity) {
+    if (!buffer) return;
+
+    if (capacity > pool->bufferSize) {
+        free(buffer);
+        return;
+    }
+
+    memcpy(buffer, &pool->free, sizeof(void *));
+    pool->free = buffer;
+    pool->inUse--;
+}
@@ -164,8 +164,8 @@ int createMakefile(Project *project) {
     const char *content =
         "SRCS_LAVANDULA = $(filter-out lavandula/main.c, $(shell find lavandula -name \"*.c\"))\n\n"
         "SRCS = app/app.c app/routes.c $(wildcard app/controllers/*.c) $(wildcard app/middleware/*.c)\n"
-        "CFLAGS = -Wall -Wextra -lsqlite3 -Isrc -Ilavandula/include\n\n"
-        "CFLAGS = -Wall -Wextra -Werror -fstack-protector-strong -Wstrict-overflow -Wformat-security -Wno-unused-parameter -D_FORTIFY_SOURCE=2 -O2 -lsqlite3 -Isrc -Ilavandula/include\n\n"
+        "CFLAGS = -Wall -Wextra -lsqlite3 -lz -Isrc -Ilavandula/include\n\n"
+        "CFLAGS = -Wall -Wextra -Werror -fstack-protector-strong -Wstrict-overflow -Wformat-security -Wno-unused-parameter -D_FORTIFY_SOURCE=2 -O2 -lsqlite3 -lz -Isrc -Ilavandula/include\n\n"
         "all:\n"
         "\tmkdir -p build\n"
         "\tgcc $(SRCS) $(SRCS_LAVANDULA) $(CFLAGS) -o build/a\n";
@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <zlib.h>
+
+#include "include/compress.h"
+
+static uint64_t hashResource(const char *resource, ContentEncoding encoding) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char *)resource; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+
+    hash ^= (uint64_t)encoding;
+    hash *= 1099511628211ULL;
+
+    return hash;
+}
+
+Compressor *initCompressor(size_t minSize) {
+    Compressor *compressor = calloc(1, sizeof(Compressor));
+    if (!compressor) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    compressor->minSize = minSize > 0 ? minSize : COMPRESS_MIN_SIZE;
+
+    compressor->bucketCount = 256;
+    compressor->buckets = calloc(compressor->bucketCount, sizeof(CompressCacheEntry *));
+    if (!compressor->buckets) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_init(&compressor->lock, NULL);
+
+    return compressor;
+}
+
+static void unlinkEntry(Compressor *compressor, CompressCacheEntry *entry) {
+    if (entry->prev) entry->prev->next = entry->next;
+    else compressor->head = entry->next;
+
+    if (entry->next) entry->next->prev = entry->prev;
+    else compressor->tail = entry->prev;
+
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+static void pushFront(Compressor *compressor, CompressCacheEntry *entry) {
+    entry->prev = NULL;
+    entry->next = compressor->head;
+
+    if (compressor->head) compressor->head->prev = entry;
+    compressor->head = entry;
+
+    if (!compressor->tail) compressor->tail = entry;
+}
+
+static void removeEntry(Compressor *compressor, CompressCacheEntry *entry) {
+    CompressCacheEntry **slot = &compressor->buckets[entry->hash & (compressor->bucketCount - 1)];
+    while (*slot && *slot != entry) {
+        slot = &(*slot)->bucketNext;
+    }
+    if (*slot) *slot = entry->bucketNext;
+
+    unlinkEntry(compressor, entry);
+    compressor->cachedBytes -= entry->sourceLength + entry->compressedLength;
+
+    free(entry->resource);
+    free(entry->source);
+    free(entry->compressed);
+    free(entry);
+}
+
+void freeCompressor(Compressor *compressor) {
+    if (!compressor) return;
+
+    while (compressor->head) {
+        removeEntry(compressor, compressor->head);
+    }
+
+    free(compressor->buckets);
+    pthread_mutex_destroy(&compressor->lock);
+    free(compressor);
+}
+
+const char *contentEncodingName(ContentEncoding encoding) {
+    switch (encoding) {
+        case ENCODING_GZIP:    return "gzip";
+        case ENCODING_DEFLATE: return "deflate";
+        case ENCODING_BR:      return "br";
+        default:               return "identity";
+    }
+}
+
+// parses a qvalue ("0", "0.5", "1.000") into thousandths
+static int parseQuality(const char *p) {
+    if (*p == '1') return 1000;
+    if (*p != '0') return 0;
+    if (*++p != '.') return 0;
+
+    int quality = 0;
+    int scale = 100;
+    for (p++; *p >= '0' && *p <= '9' && scale > 0; p++) {
+        quality += (*p - '0') * scale;
+        scale /= 10;
+    }
+
+    return quality;
+}
+
+// quality of coding in thousandths, falling back to a "*" entry, or -1 when neither is listed
+static int encodingQuality(const char *acceptEncoding, const char *coding) {
+    size_t codingLength = strlen(coding);
+    int wildcard = -1;
+
+    const char *p = acceptEncoding;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') p++;
+        if (!*p) break;
+
+        const char *token = p;
+        while (*p && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') p++;
+        size_t tokenLength = p - token;
+
+        int quality = 1000;
+        while (*p && *p != ',') {
+            if (*p == ';') {
+                p++;
+                while (*p == ' ' || *p == '\t') p++;
+
+                if ((*p == 'q' || *p == 'Q') && p[1] == '=') {
+                    quality = parseQuality(p + 2);
+                }
+                continue;
+            }
+            p++;
+        }
+
+        if (tokenLength == codingLength && strncasecmp(token, coding, codingLength) == 0) {
+            return quality;
+        }
+
+        if (tokenLength == 1 && *token == '*') {
+            wildcard = quality;
+        }
+    }
+
+    return wildcard;
+}
+
+ContentEncoding negotiateEncoding(const char *acceptEncoding, unsigned available) {
+    if (!acceptEncoding) return ENCODING_IDENTITY;
+
+    // in order of preference when the client rates them equally
+    static const ContentEncoding candidates[] = { ENCODING_BR, ENCODING_GZIP, ENCODING_DEFLATE };
+
+    ContentEncoding best = ENCODING_IDENTITY;
+    int bestQuality = 0;
+
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        if (!(available & ENCODING_MASK(candidates[i]))) continue;
+
+        int quality = encodingQuality(acceptEncoding, contentEncodingName(candidates[i]));
+        if (quality > bestQuality) {
+            best = candidates[i];
+            bestQuality = quality;
+        }
+    }
+
+    return best;
+}
+
+unsigned char *compressBody(const void *data, size_t length, ContentEncoding encoding, size_t *outLength) {
+    if (encoding != ENCODING_GZIP && encoding != ENCODING_DEFLATE) return NULL;
+
+    z_stream stream = {0};
+
+    // 15 + 16 asks zlib for a gzip wrapper, plain 15 is the zlib format HTTP calls "deflate"
+    int windowBits = encoding == ENCODING_GZIP ? 15 + 16 : 15;
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return NULL;
+    }
+
+    uLong bound = deflateBound(&stream, length);
+    unsigned char *out = malloc(bound);
+    if (!out) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = length;
+    stream.next_out = out;
+    stream.avail_out = bound;
+
+    int status = deflate(&stream, Z_FINISH);
+    size_t written = stream.total_out;
+    deflateEnd(&stream);
+
+    if (status != Z_STREAM_END) {
+        free(out);
+        return NULL;
+    }
+
+    *outLength = written;
+    return out;
+}
+
+bool isCompressibleType(const char *contentType) {
+    if (!contentType) return false;
+
+    static const char *const types[] = {
+        "text/",
+        "application/json",
+        "application/javascript",
+        "application/xml",
+        "application/wasm",
+        "image/svg+xml",
+    };
+
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        if (strncasecmp(contentType, types[i], strlen(types[i])) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool hasHeaderLine(const HttpResponse *response, const char *line) {
+    if (!response->headers) return false;
+
+    size_t length = strlen(line);
+    for (const char *p = response->headers; *p; p++) {
+        if (strncasecmp(p, line, length) == 0) return true;
+    }
+
+    return false;
+}
+
+// the compressed body is a different representation, so a strong validator has to become weak
+static void weakenEtag(HttpResponse *response) {
+    if (!response->headers) return;
+
+    char *etag = strstr(response->headers, "ETag: \"");
+    if (!etag) return;
+
+    size_t prefix = etag + 6 - response->headers;
+    size_t length = strlen(response->headers);
+
+    char *headers = malloc(length + 3);
+    if (!headers) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(headers, response->headers, prefix);
+    memcpy(headers + prefix, "W/", 2);
+    memcpy(headers + prefix + 2, response->headers + prefix, length - prefix + 1);
+
+    free(response->headers);
+    response->headers = headers;
+}
+
+// a response may be reused for a later request only when nothing marks it as per-user
+static bool isCacheable(const HttpRequest *request, const HttpResponse *response) {
+    return request->method == HTTP_GET && response->status == HTTP_OK &&
+        !hasHeaderLine(response, "Set-Cookie:") &&
+        !hasHeaderLine(response, "no-store") &&
+        !hasHeaderLine(response, "private");
+}
+
+// copies out the cached body for resource if the source bytes are unchanged
+static unsigned char *cacheLookup(Compressor *compressor, const char *resource, ContentEncoding encoding,
+                                  const void *source, size_t sourceLength, size_t *outLength) {
+    uint64_t hash = hashResource(resource, encoding);
+    unsigned char *compressed = NULL;
+
+    pthread_mutex_lock(&compressor->lock);
+
+    CompressCacheEntry *entry = compressor->buckets[hash & (compressor->bucketCount - 1)];
+    while (entry && !(entry->hash == hash && entry->encoding == encoding && strcmp(entry->resource, resource) == 0)) {
+        entry = entry->bucketNext;
+    }
+
+    if (entry && entry->sourceLength == sourceLength && memcmp(entry->source, source, sourceLength) == 0) {
+        unlinkEntry(compressor, entry);
+        pushFront(compressor, entry);
+
+        compressed = malloc(entry->compressedLength);
+        if (!compressed) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(compressed, entry->compressed, entry->compressedLength);
+        *outLength = entry->compressedLength;
+    }
+
+    pthread_mutex_unlock(&compressor->lock);
+
+    return compressed;
+}
+
+static void cacheInsert(Compressor *compressor, const char *resource, ContentEncoding encoding,
+                        const void *source, size_t sourceLength, const unsigned char *compressed, size_t compressedLength) {
+    CompressCacheEntry *entry = malloc(sizeof(CompressCacheEntry));
+    unsigned char *sourceCopy = malloc(sourceLength);
+    unsigned char *compressedCopy = malloc(compressedLength);
+    if (!entry || !sourceCopy || !compressedCopy) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(sourceCopy, source, sourceLength);
+    memcpy(compressedCopy, compressed, compressedLength);
+
+    *entry = (CompressCacheEntry) {
+        .resource = strdup(resource),
+        .encoding = encoding,
+        .hash = hashResource(resource, encoding),
+        .source = sourceCopy,
+        .sourceLength = sourceLength,
+        .compressed = compressedCopy,
+        .compressedLength = compressedLength,
+    };
+
+    pthread_mutex_lock(&compressor->lock);
+
+    CompressCacheEntry **bucket = &compressor->buckets[entry->hash & (compressor->bucketCount - 1)];
+
+    // the route now renders something else, the stale body is replaced
+    for (CompressCacheEntry *existing = *bucket; existing; existing = existing->bucketNext) {
+        if (existing->hash == entry->hash && existing->encoding == encoding && strcmp(existing->resource, resource) == 0) {
+            removeEntry(compressor, existing);
+            break;
+        }
+    }
+
+    entry->bucketNext = *bucket;
+    *bucket = entry;
+
+    pushFront(compressor, entry);
+    compressor->cachedBytes += sourceLength + compressedLength;
+
+    while (compressor->cachedBytes > COMPRESS_CACHE_MAX_BYTES && compressor->tail != entry) {
+        removeEntry(compressor, compressor->tail);
+    }
+
+    pthread_mutex_unlock(&compressor->lock);
+}
+
+void compressResponse(Compressor *compressor, const HttpRequest *request, HttpResponse *response) {
+    if (!compressor || !request || !response->content || response->bodyFile) return;
+    if (response->status < HTTP_OK || response->status == HTTP_NO_CONTENT || response->status == HTTP_NOT_MODIFIED) return;
+    if (!isCompressibleType(response->contentType) || hasHeaderLine(response, "Content-Encoding:")) return;
+
+    size_t length = response->contentLength ? response->contentLength : strlen(response->content);
+    if (length < compressor->minSize) return;
+
+    // caches in front of us must keep the compressed and plain variants apart
+    if (!hasHeaderLine(response, "Vary: Accept-Encoding")) {
+        addResponseHeader(response, "Vary", "Accept-Encoding");
+    }
+
+    ContentEncoding encoding = negotiateEncoding(findHeader(request, "Accept-Encoding"),
+        ENCODING_MASK(ENCODING_GZIP) | ENCODING_MASK(ENCODING_DEFLATE));
+    if (encoding == ENCODING_IDENTITY) return;
+
+    bool cacheable = isCacheable(request, response) && length <= COMPRESS_CACHE_MAX_ENTRY;
+
+    size_t compressedLength = 0;
+    unsigned char *compressed = cacheable
+        ? cacheLookup(compressor, request->resource, encoding, response->content, length, &compressedLength)
+        : NULL;
+
+    if (!compressed) {
+        compressed = compressBody(response->content, length, encoding, &compressedLength);
+        if (!compressed) return;
+
+        if (compressedLength >= length) {
+            free(compressed);
+            return;
+        }
+
+        if (cacheable) {
+            cacheInsert(compressor, request->resource, encoding, response->content, length, compressed, compressedLength);
+        }
+    }
+
+    releaseResponseContent(response);
+
+    response->content = (char *)compressed;
+    response->contentLength = compressedLength;
+    response->ownsContent = true;
+
+    addResponseHeader(response, "Content-Encoding", contentEncodingName(encoding));
+    weakenEtag(response);
+}
@@ -0,0 +1,329 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <ucontext.h>
+#endif
+
+#include "include/coroutine.h"
+#include "include/app.h"
+
+// AddressSanitizer has to be told when the stack changes, or it reports the switches as overflows
+#if defined(__SANITIZE_ADDRESS__)
+#define COROUTINE_ASAN
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define COROUTINE_ASAN
+#endif
+#endif
+#ifdef COROUTINE_ASAN
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+struct Coroutine {
+    CoroutineFunction function;
+    void             *arg;
+    bool              done;
+    CoroutineWait     wait;
+
+#ifdef __linux__
+    ucontext_t        context;
+    ucontext_t        caller;
+    char             *stack;           // the lowest page is a guard
+    size_t            stackSize;
+#endif
+#ifdef COROUTINE_ASAN
+    void             *fakeStack;
+    const void       *callerStack;
+    size_t            callerStackSize;
+#endif
+
+    Coroutine        *nextFree;
+};
+
+static __thread Coroutine *current = NULL;
+
+// finished coroutines, their stacks already mapped
+static __thread Coroutine *freeList = NULL;
+static __thread int freeCount = 0;
+
+static uint64_t monotonicMillis(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+#ifdef __linux__
+
+static Coroutine *takeCoroutine(void) {
+    if (freeList) {
+        Coroutine *coroutine = freeList;
+        freeList = coroutine->nextFree;
+        freeCount--;
+
+        return coroutine;
+    }
+
+    Coroutine *coroutine = calloc(1, sizeof(Coroutine));
+    if (!coroutine) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    coroutine->stackSize = COROUTINE_STACK_SIZE;
+    coroutine->stack = mmap(NULL, coroutine->stackSize, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (coroutine->stack == MAP_FAILED) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // running off the end of the stack faults instead of overwriting whatever is mapped below
+    mprotect(coroutine->stack, sysconf(_SC_PAGESIZE), PROT_NONE);
+
+    return coroutine;
+}
+
+static void releaseCoroutine(Coroutine *coroutine) {
+    munmap(coroutine->stack, coroutine->stackSize);
+    free(coroutine);
+}
+
+// from whoever resumes the coroutine onto its stack, returns when it awaits or finishes
+static void switchIn(Coroutine *coroutine) {
+#ifdef COROUTINE_ASAN
+    void *fakeStack = NULL;
+    __sanitizer_start_switch_fiber(&fakeStack, coroutine->stack, coroutine->stackSize);
+#endif
+    swapcontext(&coroutine->caller, &coroutine->context);
+#ifdef COROUTINE_ASAN
+    __sanitizer_finish_switch_fiber(fakeStack, NULL, NULL);
+#endif
+}
+
+// back to whoever resumed it, returns when it is resumed again. Never returns once done
+static void switchOut(Coroutine *coroutine) {
+#ifdef COROUTINE_ASAN
+    __sanitizer_start_switch_fiber(coroutine->done ? NULL : &coroutine->fakeStack,
+        coroutine->callerStack, coroutine->callerStackSize);
+#endif
+    swapcontext(&coroutine->context, &coroutine->caller);
+#ifdef COROUTINE_ASAN
+    __sanitizer_finish_switch_fiber(coroutine->fakeStack, &coroutine->callerStack, &coroutine->callerStackSize);
+#endif
+}
+
+static void coroutineEntry(void) {
+    Coroutine *coroutine = current;
+#ifdef COROUTINE_ASAN
+    __sanitizer_finish_switch_fiber(NULL, &coroutine->callerStack, &coroutine->callerStackSize);
+#endif
+
+    coroutine->function(coroutine->arg);
+
+    coroutine->done = true;
+    switchOut(coroutine);
+}
+
+// apart from coroutineStart, as the compiler takes getcontext for setjmp and would keep its locals out of registers
+static void initContext(Coroutine *volatile coroutine) {
+    getcontext(&coroutine->context);
+    coroutine->context.uc_stack.ss_sp = coroutine->stack;
+    coroutine->context.uc_stack.ss_size = coroutine->stackSize;
+    coroutine->context.uc_link = NULL;
+    makecontext(&coroutine->context, coroutineEntry, 0);
+}
+
+Coroutine *coroutineStart(CoroutineFunction function, void *arg) {
+    Coroutine *coroutine = takeCoroutine();
+    coroutine->function = function;
+    coroutine->arg = arg;
+    coroutine->done = false;
+    coroutine->wait = (CoroutineWait){ .fd = -1 };
+
+    initContext(coroutine);
+    coroutineResume(coroutine);
+
+    return coroutine;
+}
+
+bool coroutineResume(Coroutine *coroutine) {
+    if (coroutine->done) return true;
+
+    // a coroutine may start another, it returns here rather than to the outer one's caller
+    Coroutine *previous = current;
+    current = coroutine;
+    switchIn(coroutine);
+    current = previous;
+
+    return coroutine->done;
+}
+
+void freeCoroutine(Coroutine *coroutine) {
+    if (!coroutine) return;
+
+    if (freeCount >= COROUTINE_POOL_SIZE) {
+        releaseCoroutine(coroutine);
+        return;
+    }
+
+    coroutine->nextFree = freeList;
+    freeList = coroutine;
+    freeCount++;
+}
+
+// until the resumer has set wait.ready or wait.cancelled
+static void suspend(Coroutine *coroutine) {
+    switchOut(coroutine);
+    coroutine->wait.kind = AWAIT_NONE;
+}
+
+#else
+
+// without ucontext the function runs to completion and the awaits block
+Coroutine *coroutineStart(CoroutineFunction function, void *arg) {
+    Coroutine *coroutine = calloc(1, sizeof(Coroutine));
+    if (!coroutine) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    coroutine->function = function;
+    coroutine->arg = arg;
+    coroutine->wait = (CoroutineWait){ .fd = -1 };
+
+    function(arg);
+    coroutine->done = true;
+
+    return coroutine;
+}
+
+bool coroutineResume(Coroutine *coroutine) {
+    return coroutine->done;
+}
+
+void freeCoroutine(Coroutine *coroutine) {
+    free(coroutine);
+}
+
+static void suspend(Coroutine *coroutine) {
+    (void)coroutine;
+}
+
+#endif
+
+bool coroutineDone(const Coroutine *coroutine) {
+    return coroutine->done;
+}
+
+CoroutineWait *coroutineWait(Coroutine *coroutine) {
+    return &coroutine->wait;
+}
+
+Coroutine *currentCoroutine(void) {
+    return current;
+}
+
+static bool awaitFd(int fd, short events, int timeoutMillis) {
+    Coroutine *coroutine = current;
+    uint64_t deadline = timeoutMillis >= 0 ? monotonicMillis() + timeoutMillis : 0;
+
+    if (!coroutine) {
+        struct pollfd wait = { .fd = fd, .events = events };
+
+        for (;;) {
+            int timeout = -1;
+            if (timeoutMillis >= 0) {
+                uint64_t now = monotonicMillis();
+                timeout = deadline > now ? (int)(deadline - now) : 0;
+            }
+
+            int ready = poll(&wait, fd >= 0 ? 1 : 0, timeout);
+            if (ready < 0 && errno == EINTR) continue;
+
+            return ready > 0;
+        }
+    }
+
+    if (coroutine->wait.cancelled) return false;
+
+    coroutine->wait = (CoroutineWait){ .kind = AWAIT_FD, .fd = fd, .events = events, .deadlineMillis = deadline };
+    suspend(coroutine);
+
+    return coroutine->wait.ready && !coroutine->wait.cancelled;
+}
+
+bool awaitReadable(int fd, int timeoutMillis) {
+    return awaitFd(fd, POLLIN, timeoutMillis);
+}
+
+bool awaitWritable(int fd, int timeoutMillis) {
+    return awaitFd(fd, POLLOUT, timeoutMillis);
+}
+
+void awaitSleep(int millis) {
+    awaitFd(-1, 0, millis > 0 ? millis : 0);
+}
+
+void awaitJob(App *app, JobFunction function, void *arg) {
+    Coroutine *coroutine = current;
+
+    // the job still runs when the request is cancelled, it may own arg
+    if (!coroutine || coroutine->wait.cancelled) {
+        function((JobContext){ .app = app, .db = app ? app->dbContext : NULL, .arg = arg });
+        return;
+    }
+
+    coroutine->wait = (CoroutineWait){ .kind = AWAIT_JOB, .fd = -1, .job = function, .jobArg = arg, .app = app };
+    suspend(coroutine);
+}
+
+bool awaitFlight(Flight *flight) {
+    Coroutine *coroutine = current;
+    if (!coroutine || coroutine->wait.cancelled) return false;
+
+    coroutine->wait = (CoroutineWait){ .kind = AWAIT_FLIGHT, .fd = -1, .flight = flight };
+    suspend(coroutine);
+
+    return !coroutine->wait.cancelled;
+}
+
+// a query awaited from a coroutine, on its stack until the worker is done with it
+typedef struct {
+    DbContext      *db;
+    const char     *query;
+    const DbParam  *params;
+    int             paramCount;
+
+    DbResult       *rows;
+    bool            executed;
+} AwaitedQuery;
+
+static void runQueryRows(JobContext ctx) {
+    AwaitedQuery *query = ctx.arg;
+    query->rows = dbQueryRows(query->db, query->query, (DbParam *)query->params, query->paramCount);
+}
+
+static void runExec(JobContext ctx) {
+    AwaitedQuery *query = ctx.arg;
+    query->executed = dbExec(query->db, query->query, query->params, query->paramCount);
+}
+
+DbResult *awaitQueryRows(DbContext *db, const char *query, DbParam *params, int paramCount) {
+    AwaitedQuery awaited = { .db = db, .query = query, .params = params, .paramCount = paramCount };
+    awaitJob(NULL, runQueryRows, &awaited);
+
+    return awaited.rows;
+}
+
+bool awaitExec(DbContext *db, const char *query, const DbParam *params, int paramCount) {
+    AwaitedQuery awaited = { .db = db, .query = query, .params = params, .paramCount = paramCount };
+    awaitJob(NULL, runExec, &awaited);
+
+    return awaited.executed;
+}
@@ -79,4 +79,194 @@ CorsConfig corsAllowAll(void) {
     allowAnyMethod(&config);
 
     return config;
+}
+static uint64_t hashOrigin(const char *origin) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char *)origin; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static void addToOriginSet(CorsHeaders *cors, const char *origin) {
+    uint64_t hash = hashOrigin(origin);
+    size_t mask = cors->originCapacity - 1;
+
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        if (!cors->origins[i]) {
+            cors->origins[i] = strdup(origin);
+            cors->originHashes[i] = hash;
+            return;
+        }
+
+        if (cors->originHashes[i] == hash && strcmp(cors->origins[i], origin) == 0) {
+            return;
+        }
+    }
+}
+
+static void appendString(char **buffer, size_t *length, size_t *capacity, const char *str) {
+    size_t strLength = strlen(str);
+
+    if (*length + strLength + 1 > *capacity) {
+        while (*length + strLength + 1 > *capacity) {
+            *capacity *= 2;
+        }
+
+        *buffer = realloc(*buffer, *capacity);
+        if (!*buffer) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    memcpy(*buffer + *length, str, strLength + 1);
+    *length += strLength;
+}
+
+CorsHeaders *compileCorsPolicy(const CorsConfig *const config) {
+    if (!config || !config->allowOrigin) return NULL;
+
+    CorsHeaders *cors = calloc(1, sizeof(CorsHeaders));
+    if (!cors) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // keep the set at most half full so probe sequences stay short
+    cors->originCapacity = 8;
+    while (cors->originCapacity < (size_t)config->allowOriginCount * 2) {
+        cors->originCapacity *= 2;
+    }
+
+    cors->origins = calloc(cors->originCapacity, sizeof(char *));
+    cors->originHashes = calloc(cors->originCapacity, sizeof(uint64_t));
+    if (!cors->origins || !cors->originHashes) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < config->allowOriginCount; i++) {
+        if (strcmp(config->allowOrigin[i], "*") == 0) {
+            cors->anyOrigin = true;
+        } else {
+            addToOriginSet(cors, config->allowOrigin[i]);
+        }
+    }
+
+    // a wildcard response does not depend on the origin so it must not be varied on it
+    size_t length = 0, capacity = 64;
+    char *suffix = malloc(capacity);
+    if (!suffix) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    suffix[0] = '\0';
+
+    appendString(&suffix, &length, &capacity, cors->anyOrigin ? "\r\n" : "\r\nVary: Origin\r\n");
+
+    cors->headerSuffix = strdup(suffix);
+    cors->headerSuffixLength = length;
+
+    if (!cors->headerSuffix) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (config->methodCount > 0) {
+        appendString(&suffix, &length, &capacity, "Access-Control-Allow-Methods: ");
+        for (int i = 0; i < config->methodCount; i++) {
+            if (i > 0) appendString(&suffix, &length, &capacity, ", ");
+            appendString(&suffix, &length, &capacity, httpMethodToStr(config->allowMethods[i]));
+        }
+        appendString(&suffix, &length, &capacity, "\r\n");
+    }
+
+    if (config->headerCount > 0) {
+        appendString(&suffix, &length, &capacity, "Access-Control-Allow-Headers: ");
+        for (int i = 0; i < config->headerCount; i++) {
+            if (i > 0) appendString(&suffix, &length, &capacity, ", ");
+            appendString(&suffix, &length, &capacity, config->allowHeaders[i]);
+        }
+        appendString(&suffix, &length, &capacity, "\r\n");
+    }
+
+    char maxAge[64];
+    snprintf(maxAge, sizeof(maxAge), "Access-Control-Max-Age: %d\r\n", CORS_MAX_AGE);
+    appendString(&suffix, &length, &capacity, maxAge);
+    appendString(&suffix, &length, &capacity, "Content-Length: 0\r\nConnection: close\r\n\r\n");
+
+    cors->preflightSuffix = suffix;
+    cors->preflightSuffixLength = length;
+
+    return cors;
+}
+
+void freeCorsHeaders(CorsHeaders *cors) {
+    if (!cors) return;
+
+    for (size_t i = 0; i < cors->originCapacity; i++) {
+        free(cors->origins[i]);
+    }
+
+    free(cors->origins);
+    free(cors->originHashes);
+    free(cors->headerSuffix);
+    free(cors->preflightSuffix);
+    free(cors);
+}
+
+bool corsOriginAllowed(const CorsHeaders *const cors, const char *const origin) {
+    if (!cors || !origin) return false;
+    if (cors->anyOrigin) return true;
+
+    uint64_t hash = hashOrigin(origin);
+    size_t mask = cors->originCapacity - 1;
+
+    for (size_t i = hash & mask; cors->origins[i]; i = (i + 1) & mask) {
+        if (cors->originHashes[i] == hash && strcmp(cors->origins[i], origin) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static const char allowOriginLine[] = "Access-Control-Allow-Origin: ";
+static const char preflightStatusLine[] = "HTTP/1.1 204 No Content\r\nAccess-Control-Allow-Origin: ";
+
+static void renderOrigin(const CorsHeaders *const cors, const char *const origin, struct iovec *iov) {
+    if (cors->anyOrigin) {
+        iov->iov_base = "*";
+        iov->iov_len = 1;
+    } else {
+        iov->iov_base = (void *)origin;
+        iov->iov_len = strlen(origin);
+    }
+}
+
+int corsResponseHeaders(const CorsHeaders *const cors, const char *const origin, struct iovec *iov) {
+    if (!corsOriginAllowed(cors, origin)) return 0;
+
+    iov[0].iov_base = (void *)allowOriginLine;
+    iov[0].iov_len = sizeof(allowOriginLine) - 1;
+    renderOrigin(cors, origin, &iov[1]);
+    iov[2].iov_base = cors->headerSuffix;
+    iov[2].iov_len = cors->headerSuffixLength;
+
+    return 3;
+}
+
+int corsPreflightResponse(const CorsHeaders *const cors, const char *const origin, struct iovec *iov) {
+    if (!corsOriginAllowed(cors, origin)) return 0;
+
+    iov[0].iov_base = (void *)preflightStatusLine;
+    iov[0].iov_len = sizeof(preflightStatusLine) - 1;
+    renderOrigin(cors, origin, &iov[1]);
+    iov[2].iov_base = cors->preflightSuffix;
+    iov[2].iov_len = cors->preflightSuffixLength;
+
+    return 3;
 }
\ No newline at end of file
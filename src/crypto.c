@@ -0,0 +1,290 @@
+#include <string.h>
+
+#include "include/crypto.h"
+
+static const uint32_t sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotr32(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static void sha256Transform(Sha256Context *ctx, const unsigned char *block) {
+    uint32_t w[64];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+    }
+
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+    uint32_t e = ctx->state[4], f = ctx->state[5], g = ctx->state[6], h = ctx->state[7];
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + ch + sha256K[i] + w[i];
+        uint32_t s0 = rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+    ctx->state[4] += e;
+    ctx->state[5] += f;
+    ctx->state[6] += g;
+    ctx->state[7] += h;
+}
+
+void sha256Init(Sha256Context *ctx) {
+    ctx->state[0] = 0x6a09e667;
+    ctx->state[1] = 0xbb67ae85;
+    ctx->state[2] = 0x3c6ef372;
+    ctx->state[3] = 0xa54ff53a;
+    ctx->state[4] = 0x510e527f;
+    ctx->state[5] = 0x9b05688c;
+    ctx->state[6] = 0x1f83d9ab;
+    ctx->state[7] = 0x5be0cd19;
+
+    ctx->length = 0;
+    ctx->blockLength = 0;
+}
+
+void sha256Update(Sha256Context *ctx, const void *data, size_t length) {
+    const unsigned char *bytes = data;
+    ctx->length += length;
+
+    if (ctx->blockLength > 0) {
+        size_t take = SHA256_BLOCK_SIZE - ctx->blockLength;
+        if (take > length) take = length;
+
+        memcpy(ctx->block + ctx->blockLength, bytes, take);
+        ctx->blockLength += take;
+        bytes += take;
+        length -= take;
+
+        if (ctx->blockLength < SHA256_BLOCK_SIZE) return;
+
+        sha256Transform(ctx, ctx->block);
+        ctx->blockLength = 0;
+    }
+
+    while (length >= SHA256_BLOCK_SIZE) {
+        sha256Transform(ctx, bytes);
+        bytes += SHA256_BLOCK_SIZE;
+        length -= SHA256_BLOCK_SIZE;
+    }
+
+    memcpy(ctx->block, bytes, length);
+    ctx->blockLength = length;
+}
+
+void sha256Final(Sha256Context *ctx, unsigned char digest[SHA256_DIGEST_SIZE]) {
+    uint64_t bitLength = ctx->length * 8;
+
+    ctx->block[ctx->blockLength++] = 0x80;
+    if (ctx->blockLength > SHA256_BLOCK_SIZE - 8) {
+        memset(ctx->block + ctx->blockLength, 0, SHA256_BLOCK_SIZE - ctx->blockLength);
+        sha256Transform(ctx, ctx->block);
+        ctx->blockLength = 0;
+    }
+
+    memset(ctx->block + ctx->blockLength, 0, SHA256_BLOCK_SIZE - 8 - ctx->blockLength);
+    for (int i = 0; i < 8; i++) {
+        ctx->block[SHA256_BLOCK_SIZE - 1 - i] = (unsigned char)(bitLength >> (i * 8));
+    }
+    sha256Transform(ctx, ctx->block);
+
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4]     = (unsigned char)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char)(ctx->state[i]);
+    }
+}
+
+void sha256(const void *data, size_t length, unsigned char digest[SHA256_DIGEST_SIZE]) {
+    Sha256Context ctx;
+    sha256Init(&ctx);
+    sha256Update(&ctx, data, length);
+    sha256Final(&ctx, digest);
+}
+
+void hmacSha256(const void *key, size_t keyLength, const void *data, size_t dataLength, unsigned char mac[SHA256_DIGEST_SIZE]) {
+    unsigned char keyBlock[SHA256_BLOCK_SIZE] = {0};
+
+    // keys longer than the block size are hashed first
+    if (keyLength > SHA256_BLOCK_SIZE) {
+        sha256(key, keyLength, keyBlock);
+    } else if (keyLength > 0) {
+        memcpy(keyBlock, key, keyLength);
+    }
+
+    unsigned char pad[SHA256_BLOCK_SIZE];
+    unsigned char innerDigest[SHA256_DIGEST_SIZE];
+
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = keyBlock[i] ^ 0x36;
+    }
+
+    Sha256Context ctx;
+    sha256Init(&ctx);
+    sha256Update(&ctx, pad, SHA256_BLOCK_SIZE);
+    sha256Update(&ctx, data, dataLength);
+    sha256Final(&ctx, innerDigest);
+
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = keyBlock[i] ^ 0x5c;
+    }
+
+    sha256Init(&ctx);
+    sha256Update(&ctx, pad, SHA256_BLOCK_SIZE);
+    sha256Update(&ctx, innerDigest, SHA256_DIGEST_SIZE);
+    sha256Final(&ctx, mac);
+}
+
+static inline uint32_t rotl32(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+static void sha1Transform(Sha1Context *ctx, const unsigned char *block) {
+    uint32_t w[80];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+    }
+
+    for (int i = 16; i < 80; i++) {
+        w[i] = rotl32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3], e = ctx->state[4];
+
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+
+        uint32_t t = rotl32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotl32(b, 30);
+        b = a;
+        a = t;
+    }
+
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+    ctx->state[4] += e;
+}
+
+void sha1Init(Sha1Context *ctx) {
+    ctx->state[0] = 0x67452301;
+    ctx->state[1] = 0xefcdab89;
+    ctx->state[2] = 0x98badcfe;
+    ctx->state[3] = 0x10325476;
+    ctx->state[4] = 0xc3d2e1f0;
+
+    ctx->length = 0;
+    ctx->blockLength = 0;
+}
+
+void sha1Update(Sha1Context *ctx, const void *data, size_t length) {
+    const unsigned char *bytes = data;
+    ctx->length += length;
+
+    if (ctx->blockLength > 0) {
+        size_t take = SHA1_BLOCK_SIZE - ctx->blockLength;
+        if (take > length) take = length;
+
+        memcpy(ctx->block + ctx->blockLength, bytes, take);
+        ctx->blockLength += take;
+        bytes += take;
+        length -= take;
+
+        if (ctx->blockLength < SHA1_BLOCK_SIZE) return;
+
+        sha1Transform(ctx, ctx->block);
+        ctx->blockLength = 0;
+    }
+
+    while (length >= SHA1_BLOCK_SIZE) {
+        sha1Transform(ctx, bytes);
+        bytes += SHA1_BLOCK_SIZE;
+        length -= SHA1_BLOCK_SIZE;
+    }
+
+    memcpy(ctx->block, bytes, length);
+    ctx->blockLength = length;
+}
+
+void sha1Final(Sha1Context *ctx, unsigned char digest[SHA1_DIGEST_SIZE]) {
+    uint64_t bitLength = ctx->length * 8;
+
+    ctx->block[ctx->blockLength++] = 0x80;
+    if (ctx->blockLength > SHA1_BLOCK_SIZE - 8) {
+        memset(ctx->block + ctx->blockLength, 0, SHA1_BLOCK_SIZE - ctx->blockLength);
+        sha1Transform(ctx, ctx->block);
+        ctx->blockLength = 0;
+    }
+
+    memset(ctx->block + ctx->blockLength, 0, SHA1_BLOCK_SIZE - 8 - ctx->blockLength);
+    for (int i = 0; i < 8; i++) {
+        ctx->block[SHA1_BLOCK_SIZE - 1 - i] = (unsigned char)(bitLength >> (i * 8));
+    }
+    sha1Transform(ctx, ctx->block);
+
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4]     = (unsigned char)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char)(ctx->state[i]);
+    }
+}
+
+void sha1(const void *data, size_t length, unsigned char digest[SHA1_DIGEST_SIZE]) {
+    Sha1Context ctx;
+    sha1Init(&ctx);
+    sha1Update(&ctx, data, length);
+    sha1Final(&ctx, digest);
+}
@@ -197,6 +197,7 @@ void dotenvClean() {
     }
 
     free(map.entries);
+    map = (Map){0};
 }
 
 void dotenv(char *path) {
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 #include "include/http.h"
 
@@ -23,6 +24,9 @@ static HttpMethod toHttpMethod(char *s) {
     if (strcmp(s, "DELETE") == 0) {
         return HTTP_DELETE;
     }
+    if (strcmp(s, "OPTIONS") == 0) {
+        return HTTP_OPTIONS;
+    }
 
     return HTTP_GET;
 }
@@ -332,17 +336,24 @@ static void parseHeaders(HttpParser *parser) {
             exit(EXIT_FAILURE);
         }
 
-        int headerCount = parser->request.headerCount;
+        Header *header = &parser->request.headers[parser->request.headerCount];
+
+        strncpy(header->name, name, MAX_HEADER_NAME - 1);
+        header->name[MAX_HEADER_NAME - 1] = '\0';
+        strncpy(header->value, value, MAX_HEADER_VALUE - 1);
+        header->value[MAX_HEADER_VALUE - 1] = '\0';
 
-        strncpy(parser->request.headers[headerCount].name, name, MAX_HEADER_NAME - 1);
-        parser->request.headers[headerCount].name[MAX_HEADER_NAME - 1] = '\0';
-        strncpy(parser->request.headers[headerCount].value, value, MAX_HEADER_VALUE - 1);
-        parser->request.headers[headerCount].value[MAX_HEADER_VALUE - 1] = '\0';
+        // longer values, such as bearer tokens, are kept whole out of line
+        if (strlen(value) >= MAX_HEADER_VALUE) {
+            header->longValue = value;
+        } else {
+            header->longValue = NULL;
+            free(value);
+        }
 
         parser->request.headerCount++;
 
         free(name);
-        free(value);
     }
 }
 
@@ -353,7 +364,7 @@ void printHeaders(HttpParser *parser) {
 
     printf("Headers (%ld):\n", parser->request.headerCount);
     for (size_t i = 0; i < parser->request.headerCount; i++) {
-        printf("  HEADER '%s':  %s\n", parser->request.headers[i].name, parser->request.headers[i].value);
+        printf("  HEADER '%s':  %s\n", parser->request.headers[i].name, wholeHeaderValue(&parser->request.headers[i]));
     }
 }
 
@@ -459,12 +470,173 @@ HttpParser parseRequest(char *request) {
     return parser;
 }
 
+enum {
+    CHUNK_SIZE,
+    CHUNK_EXTENSION, // ";name=value" after the size, ignored
+    CHUNK_SIZE_LF,
+    CHUNK_DATA,
+    CHUNK_DATA_CR,
+    CHUNK_DATA_LF,
+    CHUNK_TRAILER_START,
+    CHUNK_TRAILER,   // trailer fields after the last chunk, ignored
+    CHUNK_FINAL_LF,
+    CHUNK_DONE,
+};
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+ChunkedProgress decodeChunked(ChunkedDecoder *decoder, char *body, size_t length) {
+    // the decoded body never outgrows the input, so it is written over what has been read
+    size_t position = decoder->decoded;
+
+    while (position < length && decoder->state != CHUNK_DONE) {
+        char c = body[position];
+
+        switch (decoder->state) {
+            case CHUNK_SIZE: {
+                int digit = hexValue(c);
+                if (digit >= 0) {
+                    if (decoder->remaining > (SIZE_MAX >> 4)) return CHUNKED_INVALID;
+                    decoder->remaining = (decoder->remaining << 4) | digit;
+                    decoder->digits++;
+                } else if (decoder->digits == 0) {
+                    return CHUNKED_INVALID;
+                } else if (c == ';' || c == ' ' || c == '\t') {
+                    decoder->state = CHUNK_EXTENSION;
+                } else if (c == '\r') {
+                    decoder->state = CHUNK_SIZE_LF;
+                } else {
+                    return CHUNKED_INVALID;
+                }
+                position++;
+                break;
+            }
+            case CHUNK_EXTENSION:
+                if (c == '\r') decoder->state = CHUNK_SIZE_LF;
+                position++;
+                break;
+            case CHUNK_SIZE_LF:
+                if (c != '\n') return CHUNKED_INVALID;
+                decoder->state = decoder->remaining ? CHUNK_DATA : CHUNK_TRAILER_START;
+                position++;
+                break;
+            case CHUNK_DATA: {
+                size_t available = length - position;
+                size_t take = available < decoder->remaining ? available : decoder->remaining;
+
+                memmove(body + decoder->decoded, body + position, take);
+                decoder->decoded += take;
+                decoder->remaining -= take;
+                position += take;
+
+                if (!decoder->remaining) decoder->state = CHUNK_DATA_CR;
+                break;
+            }
+            case CHUNK_DATA_CR:
+                if (c != '\r') return CHUNKED_INVALID;
+                decoder->state = CHUNK_DATA_LF;
+                position++;
+                break;
+            case CHUNK_DATA_LF:
+                if (c != '\n') return CHUNKED_INVALID;
+                decoder->state = CHUNK_SIZE;
+                decoder->digits = 0;
+                position++;
+                break;
+            case CHUNK_TRAILER_START:
+                decoder->state = c == '\r' ? CHUNK_FINAL_LF : CHUNK_TRAILER;
+                position++;
+                break;
+            case CHUNK_TRAILER:
+                if (c == '\n') decoder->state = CHUNK_TRAILER_START;
+                position++;
+                break;
+            case CHUNK_FINAL_LF:
+                if (c != '\n') return CHUNKED_INVALID;
+                decoder->state = CHUNK_DONE;
+                position++;
+                break;
+        }
+    }
+
+    return decoder->state == CHUNK_DONE ? CHUNKED_COMPLETE : CHUNKED_INCOMPLETE;
+}
+
+void addResponseHeader(HttpResponse *response, const char *name, const char *value) {
+    size_t existing = response->headers ? strlen(response->headers) : 0;
+    size_t line = strlen(name) + strlen(value) + 4;
+
+    char *headers = realloc(response->headers, existing + line + 1);
+    if (!headers) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    snprintf(headers + existing, line + 1, "%s: %s\r\n", name, value);
+    response->headers = headers;
+}
+
+const char *findResponseHeader(const HttpResponse *response, const char *name) {
+    if (!response->headers) return NULL;
+
+    size_t nameLength = strlen(name);
+    const char *line = response->headers;
+
+    while (*line) {
+        if (strncasecmp(line, name, nameLength) == 0 && line[nameLength] == ':') {
+            const char *value = line + nameLength + 1;
+            while (*value == ' ') value++;
+            return value;
+        }
+
+        const char *end = strstr(line, "\r\n");
+        if (!end) break;
+        line = end + 2;
+    }
+
+    return NULL;
+}
+
+void releaseResponseContent(HttpResponse *response) {
+    if (response->ownsContent) {
+        free(response->content);
+    } else if (response->releaseContent) {
+        response->releaseContent(response->contentOwner);
+    }
+
+    response->ownsContent = false;
+    response->releaseContent = NULL;
+    response->contentOwner = NULL;
+}
+
+const char *wholeHeaderValue(const Header *header) {
+    return header->longValue ? header->longValue : header->value;
+}
+
+const char *findHeader(const HttpRequest *request, const char *name) {
+    for (size_t i = 0; i < request->headerCount; i++) {
+        if (strcasecmp(request->headers[i].name, name) == 0) {
+            return wholeHeaderValue(&request->headers[i]);
+        }
+    }
+
+    return NULL;
+}
+
 void freeParser(HttpParser *parser) {
     if (!parser) return;
 
     free(parser->requestBuffer);
     free(parser->request.resource);
 
+    for (size_t i = 0; i < parser->request.headerCount; i++) {
+        free(parser->request.headers[i].longValue);
+    }
     free(parser->request.headers);
 
     free(parser->request.body);
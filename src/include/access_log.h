@@ -0,0 +1,75 @@
+#ifndef access_log_h
+#define access_log_h
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "http.h"
+
+// records each request thread can have queued before new ones are dropped, a power of two
+#define ACCESS_LOG_RING_SIZE    4096
+#define ACCESS_LOG_MAX_PATH     256
+// how often the writer wakes up to drain the rings
+#define ACCESS_LOG_FLUSH_MS     50
+#define ACCESS_LOG_MAX_BYTES    (64 * 1024 * 1024)
+// rotated files kept as path.1 (newest) to path.N
+#define ACCESS_LOG_KEEP_FILES   5
+#define ACCESS_LOG_BUFFER_SIZE  (64 * 1024)
+
+typedef struct {
+    int64_t    timestampMillis;
+    HttpMethod method;
+    int        status;
+    uint64_t   bytes;
+    uint64_t   durationMicros;
+    char       clientIp[46];
+    char       path[ACCESS_LOG_MAX_PATH];
+} AccessLogRecord;
+
+typedef struct AccessLogRing AccessLogRing;
+
+// Single producer (the request thread that owns it), single consumer (the writer thread).
+struct AccessLogRing {
+    AccessLogRecord records[ACCESS_LOG_RING_SIZE];
+    uint64_t        head;    // next slot to write, only advanced by the producer
+    uint64_t        tail;    // next slot to read, only advanced by the writer
+    uint64_t        dropped; // records lost because the ring was full
+
+    AccessLogRing  *next;
+};
+
+typedef struct {
+    char           *path;    // NULL logs to stdout without rotation
+    int             fileDescriptor;
+    size_t          fileSize;
+    size_t          maxBytes;
+
+    uint64_t        generation;
+    AccessLogRing  *rings;
+    pthread_mutex_t lock;    // only taken when a thread registers its ring
+    pthread_mutex_t drainLock; // keeps drainAccessLog the single consumer of every ring
+
+    uint64_t        droppedReported;
+    char            buffer[ACCESS_LOG_BUFFER_SIZE]; // lines are batched here before each write(2)
+    bool            running;
+    pthread_t       writer;
+} AccessLog;
+
+// opens path for appending and starts the writer thread, returns NULL if the file cannot be opened
+AccessLog *initAccessLog(const char *path, size_t maxBytes);
+// stops the writer after it has written everything queued so far
+void freeAccessLog(AccessLog *log);
+
+// queues a record without blocking, dropping it if this thread's ring is full
+void logAccess(AccessLog *log, const AccessLogRecord *record);
+
+// writes out everything queued, returns the number of records written
+int drainAccessLog(AccessLog *log);
+
+uint64_t accessLogDropped(AccessLog *log);
+
+// formats one record as a JSON line, returns its length
+int formatAccessLogRecord(const AccessLogRecord *record, char *out, size_t size);
+
+#endif
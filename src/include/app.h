@@ -4,6 +4,15 @@
 #include "server.h"
 #include "cors.h"
 #include "auth.h"
+#include "jwt.h"
+#include "static.h"
+#include "compress.h"
+#include "response_cache.h"
+#include "metrics.h"
+#include "access_log.h"
+#include "tracing.h"
+#include "sse.h"
+#include "jobs.h"
 
 struct App {
     int                port;
@@ -15,8 +24,18 @@ struct App {
     bool               useLavender;     
     MiddlewareHandler  middleware;
     CorsConfig          corsPolicy;
+    CorsHeaders       *cors;
     DbContext         *dbContext;
     BasicAuthenticator auth;
+    JwtAuthenticator  *jwtAuth;
+    StaticFiles       *staticFiles;
+    Compressor        *compressor;
+    ResponseCache     *responseCache;
+    Metrics           *metrics;
+    AccessLog         *accessLog;
+    Tracer            *tracer;
+    EventHub          *events;
+    JobQueue          *jobs;
 };
 
 #endif
\ No newline at end of file
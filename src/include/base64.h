@@ -1,7 +1,19 @@
 #ifndef base64_h
 #define base64_h
 
+#include <stddef.h>
+
+// NUL-terminated helpers, decoding returns NULL on malformed input
 char *base64Encode(const char *const input);
 char *base64Decode(const char *const input);
 
+// length-explicit and binary safe, outLength may be NULL
+// the returned buffers are NUL-terminated for convenience
+size_t base64EncodedLength(size_t length);
+char *base64EncodeBytes(const void *const data, size_t length, size_t *outLength);
+unsigned char *base64DecodeBytes(const char *const input, size_t length, size_t *outLength);
+
+char *base64UrlEncode(const unsigned char *const data, size_t length);
+unsigned char *base64UrlDecode(const char *const input, size_t length, size_t *outLength);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef bind_address_h
+#define bind_address_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/socket.h>
+
+#define DEFAULT_BIND_ADDRESS "127.0.0.1"
+#define UNIX_ADDRESS_PREFIX  "unix:"
+
+typedef struct {
+    struct sockaddr_storage address;
+    socklen_t               length;
+
+    // "::" also takes IPv4 clients, which then appear as IPv4-mapped IPv6 addresses
+    bool                    dualStack;
+} BindAddress;
+
+// resolves an IPv4 or IPv6 address ("0.0.0.0", "::", "[::1]"), "localhost", a network interface
+// name ("eth0") or "unix:/path/to.sock" into what to bind, false if it is none of those
+bool resolveBindAddress(const char *address, int port, BindAddress *out);
+
+// whether a and b are the same family, address and port, or the same socket path
+bool sameBindAddress(const struct sockaddr *a, const struct sockaddr *b);
+
+// where the listener can be reached, e.g. "http://[::1]:3000" or "unix:/run/app.sock"
+void formatListenUrl(const BindAddress *address, char *out, size_t size);
+
+// a client address for logs, IPv4-mapped IPv6 addresses are shown as IPv4 and Unix socket clients as "unix"
+void formatClientAddress(const struct sockaddr *address, char *out, size_t size);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef buffer_pool_h
+#define buffer_pool_h
+
+#include <stddef.h>
+
+// the size connections start reading a request into, most requests fit
+#define POOL_BUFFER_SIZE  4096
+// buffers carved from one allocation, so a burst of connections does not scatter small blocks
+#define POOL_SLAB_BUFFERS 64
+
+typedef struct BufferSlab BufferSlab;
+
+// Fixed-size buffers recycled between connections and requests. Slabs are only freed with the
+// pool, so it holds at most as many buffers as were ever in use at once. Not thread safe, it
+// belongs to whoever runs the event loop.
+typedef struct {
+    size_t      bufferSize;
+    BufferSlab *slabs;        // newest first
+    int         slabUsed;     // buffers of the newest slab handed out so far
+    void       *free;         // returned buffers, each holds the next
+    size_t      inUse;
+    size_t      slabCount;
+} BufferPool;
+
+BufferPool *initBufferPool(size_t bufferSize);
+// every buffer taken from the pool goes with it
+void freeBufferPool(BufferPool *pool);
+
+// bufferSize bytes, not cleared
+char *takeBuffer(BufferPool *pool);
+// Grows a buffer of capacity bytes to newCapacity, keeping its contents. Beyond the pool's size
+// it moves to the heap and the pooled one is returned.
+char *growBuffer(BufferPool *pool, char *buffer, size_t capacity, size_t newCapacity);
+// returns a buffer from takeBuffer or growBuffer, capacity tells them apart. NULL is ignored
+void releaseBuffer(BufferPool *pool, char *buffer, size_t capacity);
+
+#endif
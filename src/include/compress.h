@@ -0,0 +1,73 @@
+#ifndef compress_h
+#define compress_h
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "http.h"
+
+// bodies smaller than this are sent as they are, the framing overhead eats the savings
+#define COMPRESS_MIN_SIZE          1024
+// total bytes (source and compressed) held by the compressed-response cache
+#define COMPRESS_CACHE_MAX_BYTES   (8 * 1024 * 1024)
+// bodies larger than this are compressed on every request rather than cached
+#define COMPRESS_CACHE_MAX_ENTRY   (1024 * 1024)
+
+typedef enum {
+    ENCODING_IDENTITY,
+    ENCODING_GZIP,
+    ENCODING_DEFLATE,
+    ENCODING_BR,
+} ContentEncoding;
+
+#define ENCODING_MASK(encoding) (1u << (encoding))
+
+typedef struct CompressCacheEntry CompressCacheEntry;
+
+// One compressed body per resource and encoding. The source body is kept so a
+// hit is only taken when the controller produced exactly the same bytes again.
+struct CompressCacheEntry {
+    char               *resource;
+    ContentEncoding     encoding;
+    uint64_t            hash;
+
+    unsigned char      *source;
+    size_t              sourceLength;
+    unsigned char      *compressed;
+    size_t              compressedLength;
+
+    CompressCacheEntry *bucketNext;
+    CompressCacheEntry *prev;
+    CompressCacheEntry *next;
+};
+
+typedef struct {
+    size_t               minSize;
+
+    CompressCacheEntry **buckets;
+    size_t               bucketCount;
+    CompressCacheEntry  *head; // most recently used
+    CompressCacheEntry  *tail;
+    size_t               cachedBytes;
+
+    pthread_mutex_t      lock;
+} Compressor;
+
+Compressor *initCompressor(size_t minSize);
+void freeCompressor(Compressor *compressor);
+
+// the best encoding in the available mask the client accepts, honouring q-values, or ENCODING_IDENTITY
+ContentEncoding negotiateEncoding(const char *acceptEncoding, unsigned available);
+const char *contentEncodingName(ContentEncoding encoding);
+
+// deflates data as gzip or zlib framing, returns a malloc'd buffer or NULL
+unsigned char *compressBody(const void *data, size_t length, ContentEncoding encoding, size_t *outLength);
+
+// compresses the response body in place when the client accepts it and it is worth it
+void compressResponse(Compressor *compressor, const HttpRequest *request, HttpResponse *response);
+
+// true for text-like types where deflate pays off
+bool isCompressibleType(const char *contentType);
+
+#endif
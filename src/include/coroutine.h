@@ -0,0 +1,77 @@
+#ifndef coroutine_h
+#define coroutine_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "jobs.h"
+#include "sql.h"
+
+// Stacks are mapped lazily, a coroutine only takes the pages it touches
+#define COROUTINE_STACK_SIZE (256 * 1024)
+// finished coroutines kept per thread for reuse, beyond it their stacks are unmapped
+#define COROUTINE_POOL_SIZE  256
+
+typedef struct Flight Flight;
+
+typedef enum {
+    AWAIT_NONE,   // running, or done
+    AWAIT_FD,     // fd becoming ready for events, or deadlineMillis, whichever comes first
+    AWAIT_JOB,    // job running on the server's blocking pool
+    AWAIT_FLIGHT, // flight->done, set by the coroutine leading a nextShared flight on this thread
+} AwaitKind;
+
+// what a suspended coroutine waits for, read by whoever resumes it
+typedef struct {
+    AwaitKind   kind;
+
+    int         fd;             // -1 to wait for the deadline alone
+    short       events;         // POLLIN or POLLOUT
+    uint64_t    deadlineMillis; // CLOCK_MONOTONIC, 0 for none
+
+    JobFunction job;
+    void       *jobArg;
+    App        *app;
+
+    Flight     *flight;
+
+    bool        ready;          // set before resuming, false when the deadline passed instead
+    bool        cancelled;      // set before resuming: nobody waits for the result, every await returns at once
+} CoroutineWait;
+
+typedef struct Coroutine Coroutine;
+
+typedef void (*CoroutineFunction)(void *arg);
+
+// Runs function(arg) on a pooled stack until it finishes or first awaits. The caller resumes it
+// with coroutineResume once what coroutineWait describes has happened.
+Coroutine *coroutineStart(CoroutineFunction function, void *arg);
+// returns true once the function has returned, the coroutine can then be freed
+bool coroutineResume(Coroutine *coroutine);
+bool coroutineDone(const Coroutine *coroutine);
+CoroutineWait *coroutineWait(Coroutine *coroutine);
+// returns a finished coroutine's stack to the pool
+void freeCoroutine(Coroutine *coroutine);
+
+// the coroutine running on this thread, NULL outside one
+Coroutine *currentCoroutine(void);
+
+// For controllers of useAsync routes: each suspends the controller and lets the event loop serve
+// other requests meanwhile. Outside a coroutine they block the calling thread instead.
+
+// false on timeout (timeoutMillis < 0 waits for good) or when the request was cancelled
+bool awaitReadable(int fd, int timeoutMillis);
+bool awaitWritable(int fd, int timeoutMillis);
+void awaitSleep(int millis);
+
+// runs function on the server's blocking pool, returning once it has
+void awaitJob(App *app, JobFunction function, void *arg);
+// waits for another coroutine's run of the pipeline to finish, see nextShared. False when the
+// request was cancelled meanwhile, or outside a coroutine
+bool awaitFlight(Flight *flight);
+// dbQueryRows and dbExec on the blocking pool
+DbResult *awaitQueryRows(DbContext *db, const char *query, DbParam *params, int paramCount);
+bool awaitExec(DbContext *db, const char *query, const DbParam *params, int paramCount);
+
+#endif
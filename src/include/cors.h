@@ -1,8 +1,14 @@
 #ifndef cors_h
 #define cors_h
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
 #include "http.h"
 
+#define CORS_MAX_AGE 86400
+
 typedef struct {
     char     **allowOrigin;
     int        allowOriginCount;
@@ -14,6 +20,25 @@ typedef struct {
     int        headerCount;
 } CorsConfig;
 
+// A CorsConfig compiled at build() time. Origins live in an open-addressed
+// hash set and every header line that does not depend on the request origin
+// is rendered once, so answering a request is a lookup plus a writev.
+typedef struct {
+    bool      anyOrigin;
+
+    char    **origins;
+    uint64_t *originHashes;
+    size_t    originCapacity;
+
+    // follows the echoed origin on regular responses
+    char     *headerSuffix;
+    size_t    headerSuffixLength;
+
+    // follows the echoed origin on preflight responses, up to and including the blank line
+    char     *preflightSuffix;
+    size_t    preflightSuffixLength;
+} CorsHeaders;
+
 CorsConfig corsPolicy(void);
 void freeCorsPolicy(CorsConfig config);
 
@@ -28,4 +53,15 @@ void allowAnyHeader(CorsConfig *const config);
 
 CorsConfig corsAllowAll(void);
 
+CorsHeaders *compileCorsPolicy(const CorsConfig *const config);
+void freeCorsHeaders(CorsHeaders *cors);
+
+bool corsOriginAllowed(const CorsHeaders *const cors, const char *const origin);
+
+// fills iov with the Access-Control-* lines for an allowed origin, returns the number of entries used (at most 3)
+int corsResponseHeaders(const CorsHeaders *const cors, const char *const origin, struct iovec *iov);
+
+// fills iov with a complete 204 preflight response for an allowed origin, returns the number of entries used (at most 3)
+int corsPreflightResponse(const CorsHeaders *const cors, const char *const origin, struct iovec *iov);
+
 #endif
\ No newline at end of file
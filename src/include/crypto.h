@@ -0,0 +1,49 @@
+#ifndef crypto_h
+#define crypto_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_BLOCK_SIZE  64
+
+#define SHA1_DIGEST_SIZE   20
+#define SHA1_BLOCK_SIZE    64
+
+typedef struct {
+    uint32_t      state[8];
+    uint64_t      length;
+
+    unsigned char block[SHA256_BLOCK_SIZE];
+    size_t        blockLength;
+} Sha256Context;
+
+void sha256Init(Sha256Context *ctx);
+void sha256Update(Sha256Context *ctx, const void *data, size_t length);
+void sha256Final(Sha256Context *ctx, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+void sha256(const void *data, size_t length, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+// SHA-1 is broken for signatures, it is here for protocols that require it (the WebSocket handshake)
+typedef struct {
+    uint32_t      state[5];
+    uint64_t      length;
+
+    unsigned char block[SHA1_BLOCK_SIZE];
+    size_t        blockLength;
+} Sha1Context;
+
+void sha1Init(Sha1Context *ctx);
+void sha1Update(Sha1Context *ctx, const void *data, size_t length);
+void sha1Final(Sha1Context *ctx, unsigned char digest[SHA1_DIGEST_SIZE]);
+
+void sha1(const void *data, size_t length, unsigned char digest[SHA1_DIGEST_SIZE]);
+
+// HMAC-SHA256 as defined in RFC 2104
+void hmacSha256(
+    const void *key, size_t keyLength,
+    const void *data, size_t dataLength,
+    unsigned char mac[SHA256_DIGEST_SIZE]
+);
+
+#endif
@@ -94,6 +94,8 @@ typedef enum {
 typedef struct {
     char name[MAX_HEADER_NAME];
     char value[MAX_HEADER_VALUE];
+    // the whole value when it is too long for value, which keeps only its start; owned by the parser
+    char *longValue;
 } Header;
 
 typedef struct {
@@ -109,10 +111,45 @@ typedef struct {
     size_t     bodyLength;
 } HttpRequest;
 
+typedef struct ResponseStream ResponseStream;
+typedef struct WebSocket WebSocket;
+
+typedef enum {
+    STREAM_MORE,  // call the producer again once the client has taken what it wrote
+    STREAM_PAUSE, // wait for streamResume, or for chunks written from elsewhere
+    STREAM_DONE,  // the body is complete
+} StreamStatus;
+
+// writes the next part of a streamed body with streamWrite
+typedef StreamStatus (*StreamProducer)(ResponseStream *stream, void *state);
+
 typedef struct {
     char          *content;
     HttpStatusCode status;
     char          *contentType;
+
+    // extra "Name: value\r\n" lines, owned by the response and freed once it is written
+    char          *headers;
+
+    // length of content when it is binary rather than a NUL-terminated string
+    size_t         contentLength;
+    // content was allocated by the framework (e.g. a compressed body) and is freed once written
+    bool           ownsContent;
+    // or content is shared and must not be changed, releaseContent(contentOwner) once written
+    void         (*releaseContent)(void *owner);
+    void          *contentOwner;
+
+    // the body is sent from fileDescriptor with sendfile(2), the server closes it afterwards
+    bool           bodyFile;
+    int            fileDescriptor;
+
+    // the body is streamed with chunked transfer encoding instead, see streamResponse
+    StreamProducer producer;
+    void          *streamState;
+    void         (*releaseStream)(void *state);
+
+    // a 101 handshake, the connection carries this WebSocket afterwards, see acceptWebSocket
+    WebSocket     *webSocket;
 } HttpResponse;
 
 typedef struct {
@@ -127,6 +164,39 @@ typedef struct {
 HttpParser parseRequest(char *request);
 void       freeParser(HttpParser *parser);
 
+typedef enum {
+    CHUNKED_INCOMPLETE,
+    CHUNKED_COMPLETE,
+    CHUNKED_INVALID,
+} ChunkedProgress;
+
+// where a chunked body decoding has got to, zero it before the first call
+typedef struct {
+    int    state;
+    size_t remaining; // size of the chunk being read, then the bytes of it still to come
+    int    digits;
+    size_t decoded;   // body bytes decoded so far
+} ChunkedDecoder;
+
+// Decodes a chunked body in place as it arrives. body holds the decoded bytes so far followed
+// by newly received ones, up to length. Afterwards only the first decoder->decoded bytes matter.
+ChunkedProgress decodeChunked(ChunkedDecoder *decoder, char *body, size_t length);
+
+// appends a "name: value" line to the response headers
+void addResponseHeader(HttpResponse *response, const char *name, const char *value);
+
+// the value of an extra response header, running up to its "\r\n", or NULL
+const char *findResponseHeader(const HttpResponse *response, const char *name);
+
+// frees or releases content as ownsContent and releaseContent say, once it is no longer needed
+void releaseResponseContent(HttpResponse *response);
+
+// a header's whole value, however long
+const char *wholeHeaderValue(const Header *header);
+
+// case-insensitive header lookup, returns NULL when the header is absent
+const char *findHeader(const HttpRequest *request, const char *name);
+
 const char      *httpMethodToStr(HttpMethod method);
 const char      *httpStatusCodeToStr(HttpStatusCode status);
 
@@ -0,0 +1,55 @@
+#ifndef io_loop_h
+#define io_loop_h
+
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// How the event loop waits, accepts, reads and closes. poll(2) and plain system calls by default.
+// Built with LAVANDULA_IO_URING (make IO_URING=1) it goes through an io_uring on Linux instead:
+// one io_uring_enter a round submits everything queued and waits, the listener accepts with a
+// multishot accept, sockets are read into a ring of provided buffers, and the last response of a
+// connection goes out as a send linked to its close. Kernels without the features it needs
+// (5.19 or later) fall back to poll.
+typedef struct IoLoop IoLoop;
+
+// capacity is the most connections open at once
+IoLoop *openIoLoop(int capacity);
+// sends what is still queued, until the write deadlines, then frees the loop
+void closeIoLoop(IoLoop *loop);
+
+bool ioUsesUring(const IoLoop *loop);
+
+// the listening socket, accepted from when it is in the poll set with POLLIN
+void ioListen(IoLoop *loop, int listener);
+
+// poll(2) on fds, with the same results
+int ioWait(IoLoop *loop, struct pollfd *fds, int count, int timeoutMillis);
+// fd stays open as long as the loop, what ioWait arms for it is kept between waits
+void ioWatch(IoLoop *loop, int fd);
+
+// a connection from the listener, non-blocking and close on exec. address is left AF_UNSPEC when
+// the backend does not learn it, getpeername finds it. -1 with EAGAIN when there is none
+int ioAccept(IoLoop *loop, int listener, struct sockaddr_storage *address, socklen_t *addressLength);
+// connections accepted and not yet taken with ioAccept, they are already open
+bool ioAcceptQueued(const IoLoop *loop);
+
+// An accepted connection, read with ioRead and closed with ioClose from here on.
+// ioRead is read(2), except that the io_uring backend may have received the data already.
+void    ioAdopt(IoLoop *loop, int fd);
+ssize_t ioRead(IoLoop *loop, int fd, void *buffer, size_t length);
+void    ioClose(IoLoop *loop, int fd);
+
+// Queues the whole of iov as the last thing fd sends, the next ioClose(fd) goes after it. A send
+// still going at deadlineMillis (0 for never) is cut off. Returns false when the backend cannot,
+// the caller writes it as usual.
+bool ioSendAndClose(IoLoop *loop, int fd, const struct iovec *iov, int count, uint64_t deadlineMillis);
+
+// waits until queued sends and closes are done, before the process is replaced
+void ioDrain(IoLoop *loop);
+
+#endif
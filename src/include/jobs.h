@@ -0,0 +1,123 @@
+#ifndef jobs_h
+#define jobs_h
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "sql.h"
+
+typedef struct App App;
+
+#define JOB_DEFAULT_WORKERS  4
+// jobs waiting at once across all workers, enqueueJob fails beyond it
+#define JOB_DEFAULT_CAPACITY 1024
+
+typedef struct {
+    App       *app;
+    DbContext *db;   // the app's database, shared with the controllers
+    void      *arg;
+} JobContext;
+
+typedef void (*JobFunction)(JobContext ctx);
+
+typedef struct ScheduledJob ScheduledJob;
+
+typedef struct {
+    JobFunction   function;
+    void         *arg;
+    App          *app;
+    ScheduledJob *scheduled; // the schedule this run came from, NULL for an enqueued job
+} Job;
+
+typedef struct JobQueue JobQueue;
+
+// One per worker thread, jobs are taken oldest first. A worker with nothing of its own steals
+// from the others, so a long job does not hold up the ones queued behind it.
+typedef struct {
+    pthread_mutex_t lock;
+    Job            *jobs;     // ring of capacity
+    size_t          head;
+    size_t          count;
+    size_t          capacity;
+
+    uint64_t        stolen;   // jobs other workers took from this one
+    JobQueue       *queue;
+    pthread_t       thread;
+} JobWorker;
+
+// when a scheduled job runs: minutes, hours, days, months and weekdays as bit sets, or a fixed interval
+typedef struct {
+    uint64_t minutes;
+    uint32_t hours;
+    uint32_t days;           // bit 1 is the first of the month
+    uint16_t months;         // bit 1 is January
+    uint8_t  weekdays;       // bit 0 is Sunday
+    bool     anyDay;         // the day of month field was *
+    bool     anyWeekday;     // the day of week field was *
+
+    time_t   intervalSeconds; // @every, the bit sets are unused when set
+} JobSchedule;
+
+struct ScheduledJob {
+    JobSchedule   schedule;
+    JobFunction   function;
+    void         *arg;
+    App          *app;
+
+    time_t        nextRun;
+    bool          running;   // a run is queued or in progress, the next one is skipped rather than overlapping
+
+    ScheduledJob *next;
+};
+
+struct JobQueue {
+    JobWorker      *workers;
+    int             workerCount;
+    size_t          nextWorker; // where the next job goes, round robin
+
+    // read with atomics for the metrics, queued + running is 0 only when the queue is idle
+    size_t          queued;
+    size_t          running;
+    uint64_t        completed;
+    uint64_t        rejected;   // enqueued while every worker was full
+    uint64_t        skipped;    // scheduled runs dropped because the previous one had not finished
+
+    pthread_mutex_t lock;       // guards sleeping, stopping and the schedules
+    pthread_cond_t  wake;       // a job was queued
+    pthread_cond_t  idle;       // the last job finished
+    int             sleeping;
+    bool            stopping;
+
+    ScheduledJob   *scheduled;
+    pthread_cond_t  scheduleChanged;
+    bool            schedulerStarted;
+    pthread_t       scheduler;
+};
+
+// starts workerCount threads sharing capacity queued jobs, 0 for the defaults
+JobQueue *initJobQueue(int workerCount, size_t capacity);
+// runs what is still queued, then stops the workers and the scheduler
+void freeJobQueue(JobQueue *queue);
+
+// waits until nothing is queued or running
+void drainJobQueue(JobQueue *queue);
+
+// Runs function(ctx) on a worker thread, ctx.arg is arg. Safe from any thread, including jobs.
+// Returns false when the queue is full, the caller decides whether to drop the work or do it inline.
+bool enqueueJob(App *app, JobFunction function, void *arg);
+// the same on a queue other than the app's, such as the server's pool for useBlocking routes
+bool submitJob(JobQueue *queue, App *app, JobFunction function, void *arg);
+
+// Runs function periodically on a worker, from a cron expression ("*/5 * * * *" is every five
+// minutes, in local time), @hourly, @daily, @weekly, @monthly or "@every 30s" (s, m or h).
+// Returns false if the schedule cannot be parsed.
+bool scheduleJob(App *app, const char *schedule, JobFunction function, void *arg);
+
+bool parseJobSchedule(const char *text, JobSchedule *schedule);
+// the first time the schedule fires after after, 0 if it never does (the 31st of February)
+time_t nextScheduledRun(const JobSchedule *schedule, time_t after);
+
+#endif
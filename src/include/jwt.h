@@ -0,0 +1,59 @@
+#ifndef jwt_h
+#define jwt_h
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "http.h"
+#include "router.h"
+#include "middleware.h"
+
+#define JWT_CACHE_CAPACITY 1024
+
+typedef struct JwtCacheEntry JwtCacheEntry;
+
+struct JwtCacheEntry {
+    uint64_t       hash;
+    char          *token;
+    char          *payload;
+    time_t         expiresAt; // 0 when the token has no exp claim
+
+    JwtCacheEntry *bucketNext;
+    JwtCacheEntry *prev;
+    JwtCacheEntry *next;
+};
+
+// Bounded LRU of already verified tokens so repeat requests skip the HMAC.
+// Entries are keyed by a hash of the token but always compared in full.
+typedef struct {
+    JwtCacheEntry **buckets;
+    size_t          bucketCount;
+
+    JwtCacheEntry  *head; // most recently used
+    JwtCacheEntry  *tail; // least recently used
+    int             count;
+    int             capacity;
+
+    pthread_mutex_t lock;
+} JwtCache;
+
+typedef struct {
+    unsigned char *secret;
+    size_t         secretLength;
+
+    JwtCache       cache;
+} JwtAuthenticator;
+
+JwtAuthenticator *initJwtAuth(const char *const secret, int cacheCapacity);
+void freeJwtAuth(JwtAuthenticator *auth);
+
+// verifies a compact HS256 token, returns the parsed claims (caller frees) or NULL
+JsonBuilder *verifyJwt(JwtAuthenticator *auth, const char *const token, time_t now);
+
+// signs the claims with HS256, mostly useful for issuing tokens in login routes and tests
+char *signJwt(JwtAuthenticator *auth, JsonBuilder *claims);
+
+HttpResponse jwtAuth(RequestContext context, MiddlewareHandler *);
+
+#endif
@@ -20,7 +20,20 @@
 #include "lavender.h"
 #include "utils.h"
 #include "auth.h"
+#include "jwt.h"
 #include "api_response.h"
+#include "static.h"
+#include "compress.h"
+#include "response_cache.h"
+#include "metrics.h"
+#include "access_log.h"
+#include "tracing.h"
+#include "bind_address.h"
+#include "stream.h"
+#include "sse.h"
+#include "websocket.h"
+#include "jobs.h"
+#include "coroutine.h"
 
 #include "version.h"
 #include "app.h"
@@ -30,9 +43,7 @@
 #define appRoute(name, ctx) HttpResponse name(RequestContext ctx)
 
 #define appRouteStatic(name, path) appRoute(name, ctx) {  \
-    if (!ctx.app) exit(1); \
-    char *content = readFile(path); \
-    return ok(content ? content : "Not Found", TEXT_HTML); \
+    return staticFile(ctx, path); \
 } \
 
 typedef struct {
@@ -45,6 +56,20 @@ App createApp();
 // sets the port for the application (default is 3000)
 void usePort(AppBuilder *builder, int port);
 
+// sets the address to listen on (default 127.0.0.1): an IPv4 or IPv6 address ("0.0.0.0", "::" for
+// IPv4 and IPv6 at once), a network interface name ("eth0") or a Unix domain socket ("unix:/run/app.sock")
+void useBindAddress(AppBuilder *builder, const char *address);
+
+// listens on a Unix domain socket at path instead of TCP, with the file permissions in mode (0660 when 0),
+// for a reverse proxy on the same machine
+void useUnixSocket(AppBuilder *builder, const char *path, mode_t mode);
+
+// how long a shutdown (SIGTERM, SIGINT) keeps answering the connections already queued, default 10 seconds
+void useShutdownTimeout(AppBuilder *builder, int milliseconds);
+
+// sets the listen backlog, the connection cap, the read and write timeouts and the request size limit
+void useServerLimits(AppBuilder *builder, ServerLimits limits);
+
 // adds a middleware function to the application pipeline for all requests
 void useGlobalMiddleware(AppBuilder *builder, MiddlewareFunc);
 
@@ -54,6 +79,44 @@ void useVerboseLogging(AppBuilder *builder);
 // loads environment variables from a .env file
 void useDotenv(char *path);
 
+// serves the files in directory under the URL prefix, before routing and middleware
+void useStaticFiles(AppBuilder *builder, const char *prefix, const char *directory);
+
+// gzip/deflate compresses text responses of at least minSize bytes (0 for the default) for clients that accept it
+void useCompression(AppBuilder *builder, size_t minSize);
+
+// caches whole GET responses in memory, skipping later middleware and the controller on a hit.
+// defaultTtl applies to every GET route (0 caches only routes given to cacheRoute), maxBytes 0 means 32MB
+void useResponseCache(AppBuilder *builder, int defaultTtl, size_t maxBytes);
+
+// caches the responses of this route for ttlSeconds, see useResponseCache
+void cacheRoute(App *app, Route *route, int ttlSeconds);
+
+// drops the cached responses for path, whatever their query string, e.g. after a controller changes the data
+void invalidateCachedPath(App *app, const char *path);
+
+// records request counts and latency histograms per route and serves them in Prometheus format on GET /metrics
+void useMetrics(AppBuilder *builder);
+
+// writes a JSON line per request (time, client ip, method, path, status, bytes, duration) to path, or stdout when path is NULL.
+// records are queued without blocking and written by a background thread, the file rotates at 64MB
+void useAccessLog(AppBuilder *builder, const char *path);
+
+// times each phase of every request (accept, read, parse, route, middleware, controller, JSON, write)
+// and prints the breakdown of requests slower than slowThresholdMicros (0 never) to stderr
+void useTracing(AppBuilder *builder, uint64_t slowThresholdMicros);
+// serves the last 1024 requests as a Chrome trace on GET path, turning tracing on if it is not yet.
+// The paths and timings of everyone's requests, guard it with useLocalMiddleware on the route
+Route useTraceEndpoint(AppBuilder *builder, char *path);
+
+// lets controllers answer with subscribeEvents(ctx, topic), a text/event-stream held open in the event loop,
+// and publishEvent(app->events, topic, name, data) send to every subscriber of a topic from any thread
+void useServerSentEvents(AppBuilder *builder);
+
+// starts worker threads (0 for 4) that run enqueueJob and scheduleJob work off the request path,
+// with at most capacity jobs waiting (0 for 1024). Queue depth is reported on GET /metrics with useMetrics
+void useJobQueue(AppBuilder *builder, int workers, size_t capacity);
+
 // adds CORS policy to the application
 void useCorsPolicy(AppBuilder *builder, CorsConfig);
 
@@ -78,6 +141,9 @@ void useLavender(AppBuilder *builder);
 // puts basic authentication on all routes
 void useBasicAuth(AppBuilder *builder);
 
+// puts HS256 bearer token authentication on all routes, claims are exposed as ctx.claims
+void useJwtAuth(AppBuilder *builder, const char *secret);
+
 bool isDevelopment(AppBuilder *builder);
 bool isProduction(AppBuilder *builder);
 bool isTesting(AppBuilder *builder);
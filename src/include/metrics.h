@@ -0,0 +1,65 @@
+#ifndef metrics_h
+#define metrics_h
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "http.h"
+#include "router.h"
+
+// Latencies are kept in microseconds in a log-linear (HDR style) histogram: values
+// below 8 get exact buckets, above that every power of two is split into 8 buckets,
+// so any recorded value is within 12.5% of its bucket's bounds.
+#define METRICS_SUB_BUCKET_BITS 3
+#define METRICS_SUB_BUCKETS     (1 << METRICS_SUB_BUCKET_BITS)
+#define METRICS_MAX_EXPONENT    36 // about 19 hours, anything slower lands in the last bucket
+#define METRICS_BUCKETS         ((METRICS_MAX_EXPONENT - METRICS_SUB_BUCKET_BITS + 2) * METRICS_SUB_BUCKETS)
+
+// distinct route, method and status combinations each thread can record
+#define METRICS_MAX_SERIES      256
+
+typedef struct {
+    char      *route;
+    HttpMethod method;
+    int        status;
+    uint64_t   hash;
+
+    // written only by the owning thread, read with relaxed loads when scraped
+    uint64_t   count;
+    uint64_t   sumMicros;
+    uint64_t   buckets[METRICS_BUCKETS];
+} MetricsSeries;
+
+typedef struct MetricsShard MetricsShard;
+
+// One per recording thread, so recording never takes a lock or bounces a cache line.
+struct MetricsShard {
+    MetricsSeries *series[METRICS_MAX_SERIES]; // open addressing, slots are published once and never move
+    uint64_t       dropped;                    // records lost because the table was full
+
+    MetricsShard  *next;
+};
+
+typedef struct {
+    uint64_t        generation; // tells a thread its cached shard belongs to an older registry
+    MetricsShard   *shards;
+    pthread_mutex_t lock;       // only taken when a thread registers its shard
+} Metrics;
+
+Metrics *initMetrics(void);
+void freeMetrics(Metrics *metrics);
+
+void recordRequest(Metrics *metrics, const char *route, HttpMethod method, int status, uint64_t micros);
+
+int metricsBucketIndex(uint64_t micros);
+// the highest value that falls into the bucket
+uint64_t metricsBucketUpperBound(int index);
+// the value at quantile q (0..1) of a histogram, in microseconds
+uint64_t metricsQuantile(const uint64_t *buckets, uint64_t count, double q);
+
+// the Prometheus text exposition of everything recorded so far, caller frees
+char *renderMetrics(Metrics *metrics);
+
+HttpResponse metricsController(RequestContext ctx);
+
+#endif
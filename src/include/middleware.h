@@ -4,6 +4,10 @@
 #ifndef lavandula_middleware_h
 #define lavandula_middleware_h
 
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "http.h"
 #include "router.h"
 
@@ -19,10 +23,57 @@ struct MiddlewareHandler {
     int capacity;
     int current;
     Controller finalHandler;
+
+    bool blocking; // see useBlocking
+    bool async;    // see useAsync
 };
 
+#define SINGLE_FLIGHT_BUCKETS 64
+
+typedef struct Flight Flight;
+
+// One in-progress run of the pipeline for a key. Callers arriving while it runs
+// wait for it to be done and take a copy of the leader's response.
+struct Flight {
+    char          *key;
+    uint64_t       hash;
+    bool           onLoop;    // led by a useAsync coroutine, only coroutines wait for it
+
+    bool           done;
+    bool           shareable; // false when the response cannot be copied, e.g. a file body
+    int            waiters;
+    HttpResponse   response;  // the copy handed to waiters, owned by the flight
+
+    pthread_cond_t finished;  // signalled for waiters on blocking workers
+    Flight        *bucketNext;
+};
+
+typedef struct {
+    Flight         *buckets[SINGLE_FLIGHT_BUCKETS];
+    pthread_mutex_t lock;
+} SingleFlight;
+
 HttpResponse next(RequestContext context, MiddlewareHandler *middleware);
+
+void initSingleFlight(SingleFlight *group);
+// called by the server on each blocking pool thread, nextShared coalesces there
+void markBlockingWorker(void);
+void freeSingleFlight(SingleFlight *group);
+
+// Like next(), but concurrent callers with the same key share one run of the rest of the pipeline.
+// leader is set to false for callers that got a copy of another caller's response.
+// On a blocking worker (useBlocking routes) a caller waits for the leader by blocking its thread.
+// In a useAsync coroutine it suspends until the coroutine leading the flight is done, and the event
+// loop serves other requests meanwhile. The two never wait for each other. Run straight on the event
+// loop, which must not wait, it is next() and leader is always true.
+HttpResponse nextShared(SingleFlight *group, const char *key, RequestContext context, MiddlewareHandler *middleware, bool *leader);
 void useLocalMiddleware(Route *route, MiddlewareFunc handler);
+// Runs the route's middleware and controller on the server's blocking thread pool, for controllers
+// that wait on slow queries or other I/O. The event loop goes on serving other connections meanwhile.
+void useBlocking(Route *route);
+// Runs the route's middleware and controller as a coroutine on the event loop. The controller
+// suspends while it awaits (awaitReadable, awaitQueryRows, ...) and other requests are served meanwhile.
+void useAsync(Route *route);
 MiddlewareHandler combineMiddleware(MiddlewareHandler *globalMiddleware, MiddlewareHandler *routeMiddleware);
 
 #endif
\ No newline at end of file
@@ -15,6 +15,9 @@ typedef struct {
 
     JsonBuilder *body;
     bool         hasBody;
+
+    // verified JWT claims, set by the jwtAuth middleware
+    JsonBuilder *claims;
 } RequestContext;
 
 RequestContext requestContext(App *app, HttpRequest request);
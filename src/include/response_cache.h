@@ -0,0 +1,85 @@
+#ifndef response_cache_h
+#define response_cache_h
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "http.h"
+#include "router.h"
+#include "middleware.h"
+
+// shards are locked independently so lookups for different keys rarely contend
+#define RESPONSE_CACHE_SHARDS    16
+#define RESPONSE_CACHE_MAX_BYTES (32 * 1024 * 1024)
+
+typedef struct ResponseCacheEntry ResponseCacheEntry;
+
+// A complete response for one method, path and query. The body and content type
+// share one allocation so a hit is a single copy.
+struct ResponseCacheEntry {
+    char               *key;
+    uint64_t            hash;
+    uint64_t            pathHash; // hash of the path without the query, for invalidation
+
+    HttpStatusCode      status;
+    char               *block;    // body, NUL, content type, NUL
+    size_t              bodyLength;
+    size_t              blockLength;
+    char               *headers;
+    size_t              size;     // bytes charged against the shard's cap
+
+    time_t              expiresAt;
+
+    ResponseCacheEntry *bucketNext;
+    ResponseCacheEntry *prev;
+    ResponseCacheEntry *next;
+};
+
+typedef struct {
+    ResponseCacheEntry **buckets;
+    size_t               bucketCount;
+    ResponseCacheEntry  *head; // most recently used
+    ResponseCacheEntry  *tail;
+    size_t               bytes;
+    size_t               maxBytes;
+
+    pthread_mutex_t      lock;
+} ResponseCacheShard;
+
+typedef struct {
+    HttpMethod method;
+    char      *path;
+    int        ttlSeconds;
+} ResponseCacheRule;
+
+typedef struct {
+    ResponseCacheShard  shards[RESPONSE_CACHE_SHARDS];
+
+    // routes without a rule use defaultTtl, 0 leaves them uncached
+    int                 defaultTtl;
+    ResponseCacheRule  *rules;
+    int                 ruleCount;
+    int                 ruleCapacity;
+
+    // identical misses arriving together run the controller once
+    SingleFlight        flights;
+} ResponseCache;
+
+ResponseCache *initResponseCache(int defaultTtl, size_t maxBytes);
+void freeResponseCache(ResponseCache *cache);
+
+// caches GET responses of this route for ttlSeconds
+void setCacheTtl(ResponseCache *cache, HttpMethod method, const char *path, int ttlSeconds);
+
+// fills response with a copy of the cached entry, returns false on a miss or an expired entry
+bool responseCacheLookup(ResponseCache *cache, const char *key, HttpResponse *response, time_t now);
+void responseCacheStore(ResponseCache *cache, const char *key, const HttpResponse *response, int ttlSeconds, time_t now);
+
+// drops every cached variant (any query string) of path
+void responseCacheInvalidate(ResponseCache *cache, const char *path);
+void responseCacheClear(ResponseCache *cache);
+
+HttpResponse responseCache(RequestContext context, MiddlewareHandler *);
+
+#endif
@@ -1,18 +1,47 @@
 #ifndef server_h
 #define server_h
 
+#include <sys/types.h>
+
 #include "router.h"
 #include "middleware.h"
 
 typedef struct App App;
 
+#define SHUTDOWN_TIMEOUT_MILLIS 10000
+// owner and group may connect, e.g. a reverse proxy running in the app's group
+#define UNIX_SOCKET_MODE 0660
+
+// how much the server takes on at once and how long a client may hold a connection, see serverLimits for the defaults
+typedef struct {
+    int    backlog;            // connections the kernel queues before they are accepted
+    int    maxConnections;     // open at once, further ones are answered with 503 and closed
+    int    readTimeoutMillis;  // to receive the whole request, counted from accepting the connection
+    int    writeTimeoutMillis; // to send the whole response
+    size_t maxRequestSize;     // bytes of headers and body buffered per connection, 431 or 413 beyond it
+    int    blockingThreads;    // run the controllers of useBlocking routes, 0 for the default
+} ServerLimits;
+
 typedef struct {
     Router router;
     
     int port;
     int fileDescriptor;
+
+    // an address, interface or unix:<path> to listen on, NULL for 127.0.0.1
+    char *bindAddress;
+    // permissions of the socket file when bindAddress is unix:<path>
+    mode_t unixSocketMode;
+
+    // queued connections are still answered for this long after a shutdown signal
+    int shutdownTimeoutMillis;
+
+    ServerLimits limits;
 } Server;
 
+// backlog SOMAXCONN, 1024 connections, 10 second read and write timeouts, 1MB requests, 8 blocking threads
+ServerLimits serverLimits(void);
+
 Server initServer(int port);
 void freeServer(Server *server);
 
@@ -62,5 +62,7 @@ DbContext *createSqlLite3DbContext(char *dbPath);
 
 bool dbExec(DbContext *db, const char *query, const DbParam *params, int paramCount);
 DbResult *dbQueryRows(DbContext *db, const char *query, DbParam *params, int paramCount);
+void freeDbResult(DbResult *result);
+bool dbClose(DbContext *db);
 
 #endif
\ No newline at end of file
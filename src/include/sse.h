@@ -0,0 +1,67 @@
+#ifndef sse_h
+#define sse_h
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "http.h"
+#include "request_context.h"
+#include "stream.h"
+
+// events a subscriber may have waiting before it is disconnected, it reconnects and carries on
+#define SSE_MAX_PENDING (1024 * 1024)
+
+typedef struct EventSubscriber EventSubscriber;
+
+typedef struct {
+    char             *name;
+    EventSubscriber **subscribers;
+    size_t            count;
+    size_t            capacity;
+} EventTopic;
+
+// published from any thread, not yet handed to the subscribers
+typedef struct PublishedEvent {
+    char                  *topic;
+    StreamChunk           *frame;
+    struct PublishedEvent *next;
+} PublishedEvent;
+
+typedef struct {
+    pthread_mutex_t lock;      // guards the published queue, the topics belong to the server's thread
+    PublishedEvent *head;
+    PublishedEvent *tail;
+
+    // readable once something is published, the server polls it. wakeFds[0] == wakeFds[1] for an eventfd
+    int             wakeFds[2];
+
+    EventTopic     *topics;
+    size_t          topicCount;
+    size_t          topicCapacity;
+
+    size_t          dropped;   // subscribers disconnected for falling behind
+} EventHub;
+
+EventHub *initEventHub(void);
+void freeEventHub(EventHub *hub);
+
+// the fd the server polls, readable when there are events to deliver
+int eventHubFd(const EventHub *hub);
+
+// Frames the event once and queues it for every subscriber of topic. Safe from any thread,
+// the server fans it out on its own. name may be NULL for the default "message" event,
+// and data may span several lines.
+void publishEvent(EventHub *hub, const char *topic, const char *name, const char *data);
+
+// hands what has been published to the subscribers, called by the server when the hub's fd is readable
+void deliverEvents(EventHub *hub);
+
+// A text/event-stream response that stays open and receives the events published to topic.
+// The controller returns it: appRoute(orders, ctx) { return subscribeEvents(ctx, "orders"); }
+HttpResponse subscribeEvents(RequestContext ctx, const char *topic);
+
+// subscribers of topic right now, on the server's thread
+size_t topicSubscribers(const EventHub *hub, const char *topic);
+
+#endif
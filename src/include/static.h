@@ -0,0 +1,73 @@
+#ifndef static_h
+#define static_h
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "http.h"
+#include "request_context.h"
+
+// files up to this size are read into memory and kept there, responses share the cached contents
+#define STATIC_CACHE_MAX_FILE  (64 * 1024)
+// total bytes of cached files before least recently used ones are dropped
+#define STATIC_CACHE_MAX_BYTES (16 * 1024 * 1024)
+
+typedef struct StaticCacheEntry StaticCacheEntry;
+
+struct StaticCacheEntry {
+    char             *path;
+    uint64_t          hash;
+
+    // identity of the file when it was read, checked against stat(2) on every hit
+    ino_t             inode;
+    off_t             size;
+    struct timespec   modified;
+
+    // never changed once read, responses point into it while they hold a reference
+    char             *data;
+    int               refs;
+
+    StaticCacheEntry *bucketNext;
+    StaticCacheEntry *prev;
+    StaticCacheEntry *next;
+};
+
+typedef struct {
+    char *prefix;
+    char *directory;
+} StaticMount;
+
+typedef struct {
+    StaticMount       *mounts;
+    int                mountCount;
+    int                mountCapacity;
+
+    StaticCacheEntry **buckets;
+    size_t             bucketCount;
+    StaticCacheEntry  *head; // most recently used
+    StaticCacheEntry  *tail;
+    size_t             cachedBytes;
+
+    pthread_mutex_t    lock;
+} StaticFiles;
+
+StaticFiles *initStaticFiles(void);
+void freeStaticFiles(StaticFiles *files);
+
+void addStaticMount(StaticFiles *files, const char *prefix, const char *directory);
+
+// serves path from the first mount whose prefix matches, returns false when no file matched
+bool serveStaticMount(StaticFiles *files, const HttpRequest *request, const char *path, HttpResponse *response);
+
+// serves a single file from disk, with ETag/Last-Modified validation and caching unless files is NULL
+HttpResponse serveFile(StaticFiles *files, const HttpRequest *request, const char *filePath);
+
+// serves a single file for a controller, see appRouteStatic. Uses the cache build creates
+HttpResponse staticFile(RequestContext ctx, const char *filePath);
+
+const char *mimeTypeForPath(const char *path);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef stream_h
+#define stream_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+#include "http.h"
+
+// the producer is not asked for more while this much is still waiting for the client
+#define STREAM_HIGH_WATER (64 * 1024)
+// chunks handed to one writev
+#define STREAM_MAX_IOVECS 64
+
+// Framed bytes waiting on one or more streams. Chunks written to a single stream are appended
+// to until they fill up, a shared one is framed once and queued as is on every stream it goes to.
+typedef struct {
+    size_t refs;
+    size_t length;
+    size_t capacity;
+    bool   shared;
+    char   data[];
+} StreamChunk;
+
+// a streamed response body, owned by the server from the moment its headers are sent
+struct ResponseStream {
+    StreamChunk  **queue;    // waiting to be sent, in order from first
+    size_t         first;
+    size_t         count;
+    size_t         capacity;
+    size_t         offset;   // bytes of the first chunk already sent
+    size_t         pending;
+
+    StreamProducer producer;
+    void          *state;
+    void         (*release)(void *state);
+
+    bool           raw;      // bytes go out as written, without chunk framing, on an upgraded connection
+    bool           paused;
+    bool           ended;    // the last chunk is queued, nothing more can be written
+    bool           aborted;  // the connection is closed without finishing the body
+};
+
+// A 200 response whose body is written piece by piece. The server sends the headers, then calls
+// producer each time the client has taken what was written so far, until it returns STREAM_DONE.
+// release (may be NULL) is called with state once the stream is over, finished or not.
+HttpResponse streamResponse(char *contentType, StreamProducer producer, void (*release)(void *state), void *state);
+
+// Queues data as one chunk (as is on a raw stream). The stream buffers whatever the client has not taken yet, so a slow
+// client costs memory rather than time: check streamPending before writing more than a producer is asked for.
+// Returns false once the stream has ended. Streams belong to the server's thread, write to them from nowhere else.
+bool streamWrite(ResponseStream *stream, const void *data, size_t length);
+bool streamPrintf(ResponseStream *stream, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+// Frames data once as a chunk for any number of streams, e.g. an event going to every subscriber.
+// The caller holds one reference and drops it with releaseChunk.
+StreamChunk *frameChunk(const void *data, size_t length);
+void releaseChunk(StreamChunk *chunk);
+// queues a framed chunk, false once the stream has ended
+bool streamWriteChunk(ResponseStream *stream, StreamChunk *chunk);
+
+// bytes queued that the client has not taken yet
+size_t streamPending(const ResponseStream *stream);
+
+// calls a paused producer again
+void streamResume(ResponseStream *stream);
+// finishes the body without asking the producer, it is not called again
+void streamEnd(ResponseStream *stream);
+// has the server close the connection without finishing the body, e.g. for a client too far behind
+void streamAbort(ResponseStream *stream);
+
+// used by the server
+ResponseStream *openStream(const HttpResponse *response);
+// whether the producer should be called now
+bool streamReady(const ResponseStream *stream);
+void streamProduce(ResponseStream *stream);
+// fills iov with what is waiting to be sent, returns how many it used
+int  streamIovecs(const ResponseStream *stream, struct iovec *iov, int max);
+void streamSent(ResponseStream *stream, size_t bytes);
+void closeStream(ResponseStream *stream);
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef tracing_h
+#define tracing_h
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "http.h"
+#include "router.h"
+
+// spans a single request can hold, later ones are counted but not kept
+#define TRACE_MAX_SPANS  32
+#define TRACE_MAX_PATH   128
+// finished requests kept for the Chrome trace export, a power of two
+#define TRACE_RING_SIZE  1024
+
+typedef enum {
+    TRACE_ACCEPT,
+    TRACE_READ,
+    TRACE_PARSE,
+    TRACE_ROUTE,
+    TRACE_STATIC,
+    TRACE_JSON_PARSE,
+    TRACE_MIDDLEWARE,
+    TRACE_CONTROLLER,
+    TRACE_JSON_STRINGIFY,
+    TRACE_COMPRESS,
+    TRACE_WRITE,
+} TracePhase;
+
+typedef struct {
+    TracePhase phase;
+    uint64_t   startNanos;
+    uint64_t   endNanos;
+} TraceSpan;
+
+typedef struct {
+    uint64_t   id;
+    uint32_t   threadId;
+    HttpMethod method;
+    char       path[TRACE_MAX_PATH];
+    int        status;
+
+    uint64_t   startNanos;
+    uint64_t   endNanos;
+
+    TraceSpan  spans[TRACE_MAX_SPANS];
+    int        spanCount;
+    int        droppedSpans;
+} RequestTrace;
+
+typedef struct {
+    uint64_t        slowThresholdNanos; // 0 never dumps
+    uint64_t        originNanos;        // exported timestamps are relative to this
+
+    RequestTrace   *ring;
+    uint64_t        finished;
+    pthread_mutex_t lock;
+} Tracer;
+
+// slowThresholdMicros 0 keeps the traces for export without dumping any
+Tracer *initTracer(uint64_t slowThresholdMicros);
+void freeTracer(Tracer *tracer);
+
+// CLOCK_MONOTONIC in nanoseconds
+uint64_t traceNow(void);
+
+// makes trace the calling thread's current request, spans are recorded into it until traceFinish
+void traceStart(RequestTrace *trace, uint64_t startNanos);
+// a request moving to another thread: traceSuspend on the thread it leaves, traceResume on the one it continues on
+void traceSuspend(void);
+void traceResume(RequestTrace *trace);
+
+// opens a span on the current request, returns -1 (and costs nothing more) when no request is being traced
+int traceBegin(TracePhase phase);
+void traceEnd(int span);
+// records a span measured by the caller
+void traceAddSpan(RequestTrace *trace, TracePhase phase, uint64_t startNanos, uint64_t endNanos);
+
+// stops tracing on this thread, keeps the trace for export and dumps it to stderr if it was slow.
+// path is kept up to its query string
+void traceFinish(Tracer *tracer, RequestTrace *trace, HttpMethod method, const char *path, int status);
+
+const char *tracePhaseName(TracePhase phase);
+
+// one line with the duration of each span, returns its length
+int formatTrace(const RequestTrace *trace, char *out, size_t size);
+
+// the kept traces in Chrome trace-event format (chrome://tracing, Perfetto), caller frees
+char *renderChromeTrace(Tracer *tracer);
+
+HttpResponse traceController(RequestContext ctx);
+
+#endif
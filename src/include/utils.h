@@ -3,4 +3,12 @@
 
 char *readFile(const char *filename);
 
+// Wakes a poll from another thread: fds[0] becomes readable after wakeUp(fds). An eventfd on
+// Linux, where fds[0] == fds[1], otherwise a pipe. Both ends are non-blocking and close on exec.
+void openWakeFds(int fds[2]);
+void closeWakeFds(int fds[2]);
+void wakeUp(const int fds[2]);
+// reads the wake-ups so far, fds[0] is no longer readable until the next one
+void clearWakeUps(int fd);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,89 @@
+#ifndef websocket_h
+#define websocket_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "http.h"
+#include "request_context.h"
+#include "stream.h"
+
+// appended to the client's key before hashing, from RFC 6455
+#define WEBSOCKET_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+// base64 of a SHA-1 digest, and its NUL
+#define WEBSOCKET_ACCEPT_SIZE 29
+
+// close codes
+#define WEBSOCKET_NORMAL          1000
+#define WEBSOCKET_GOING_AWAY      1001
+#define WEBSOCKET_PROTOCOL_ERROR  1002
+#define WEBSOCKET_NO_STATUS       1005
+#define WEBSOCKET_ABNORMAL        1006
+#define WEBSOCKET_INVALID_DATA    1007
+#define WEBSOCKET_TOO_BIG         1009
+
+typedef struct {
+    // the connection has been upgraded, messages can be sent from here on
+    void (*onOpen)(WebSocket *socket);
+    // a whole message, reassembled from its frames. data is NUL terminated for convenience
+    void (*onMessage)(WebSocket *socket, const char *data, size_t length, bool binary);
+    // the socket is gone after this: code is what the client sent, or 1006 if it just disconnected
+    void (*onClose)(WebSocket *socket, int code);
+} WebSocketHandlers;
+
+struct WebSocket {
+    WebSocketHandlers handlers;
+    void             *data;         // for the application, untouched by the server
+
+    ResponseStream   *stream;       // frames on their way to the client
+    size_t            maxMessage;
+    bool              opened;
+    int               closeCode;
+    bool              awaitingClose; // the server sent a close frame and waits for the client's
+
+    // the frame being received
+    bool              inFrame;
+    int               opcode;
+    bool              final;
+    uint64_t          remaining;
+    unsigned char     mask[4];
+    size_t            maskOffset;   // payload bytes of this frame unmasked so far
+
+    // the message being reassembled, messageOpcode is 0 between messages
+    int               messageOpcode;
+    char             *message;
+    size_t            messageLength;
+    size_t            messageCapacity;
+
+    // a control frame's payload, 125 bytes at most
+    unsigned char     control[125];
+    size_t            controlLength;
+};
+
+// The answer to a WebSocket handshake: a 101 response upgrading the connection, or 400/426 if the
+// request is not a valid handshake. The controller returns it, after any authentication has run:
+// appRoute(chat, ctx) { return acceptWebSocket(ctx, chatHandlers, NULL); }
+HttpResponse acceptWebSocket(RequestContext ctx, WebSocketHandlers handlers, void *data);
+
+// queue a message, false once the socket is closing. Only from the server's thread, like streams
+bool webSocketSend(WebSocket *socket, const void *data, size_t length, bool binary);
+bool webSocketSendText(WebSocket *socket, const char *text);
+// starts the closing handshake, reason may be NULL
+void webSocketClose(WebSocket *socket, int code, const char *reason);
+
+// Sec-WebSocket-Accept for a Sec-WebSocket-Key
+void webSocketAccept(const char *key, char out[WEBSOCKET_ACCEPT_SIZE]);
+
+// XORs data with mask, starting offset bytes into the masked payload
+void webSocketUnmask(unsigned char *data, size_t length, const unsigned char mask[4], size_t offset);
+
+// used by the server
+void webSocketOpened(WebSocket *socket);
+// false once the closing handshake is over, the connection can go
+bool webSocketListening(const WebSocket *socket);
+// parses frames from what the client sent, returns the bytes used. The rest is part of a frame
+// header, to be passed again with what follows it
+size_t webSocketReceive(WebSocket *socket, const unsigned char *data, size_t length);
+
+#endif
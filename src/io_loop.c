@@ -0,0 +1,931 @@
+#ifdef __linux__
+#define _GNU_SOURCE // accept4
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "include/io_loop.h"
+#include "include/buffer_pool.h"
+
+#if defined(LAVANDULA_IO_URING) && defined(__linux__)
+#define IO_URING_BACKEND
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef IO_URING_BACKEND
+
+#define RING_ENTRIES       1024
+#define RECV_BUFFERS       512          // provided to the kernel for receives, a power of two
+#define RECV_BUFFER_SIZE   4096
+#define RECV_BUFFER_GROUP  0
+#define SEND_COPY_LIMIT    (64 * 1024)  // larger responses are written by the caller
+
+// the low bits of an operation's user_data, above them the fd or send slot, then a serial
+enum {
+    OP_POLL,
+    OP_RECV,
+    OP_ACCEPT,
+    OP_SEND,
+    OP_IGNORED = 7, // cancellations and closes, nothing to do when they complete
+};
+
+// what the ring has armed for one descriptor, indexed by the fd
+typedef struct {
+    bool     socket;       // adopted, POLLIN means a receive into a provided buffer
+    bool     watched;      // its poll stays armed between waits
+    bool     closing;      // ioSendAndClose queued its close
+
+    bool     recvArmed;
+    uint32_t recvSerial;   // completions of earlier receives are stale
+    short    pollArmed;    // events of the armed poll, 0 for none
+    uint32_t pollSerial;
+    short    ready;        // poll events since it was last reported
+
+    // a completed receive not yet read
+    int      buffer;       // -1 for none
+    uint32_t offset;
+    uint32_t length;
+    bool     eof;
+    int      error;
+    bool     readDirectly; // more is likely waiting, or the buffers ran out, read(2) until EAGAIN
+} IoFd;
+
+typedef struct {
+    uint64_t userData;
+    char    *data;         // NULL for a free slot
+    size_t   capacity;     // of data, pooled up to POOL_BUFFER_SIZE
+    uint64_t deadlineMillis;
+    bool     cancelled;
+} PendingSend;
+
+#endif
+
+struct IoLoop {
+    bool                     uring;
+    int                      listener;
+
+#ifdef IO_URING_BACKEND
+    int                      ringFd;
+    void                    *ringMemory;
+    size_t                   ringSize;
+    struct io_uring_sqe     *sqes;
+    size_t                   sqesSize;
+
+    unsigned                *sqHead;
+    unsigned                *sqTail;
+    unsigned                *sqArray;
+    unsigned                 sqMask;
+    unsigned                 sqEntries;
+    unsigned                 sqQueued;     // our tail, ahead of the kernel's head by what is not yet consumed
+    unsigned                 toSubmit;
+
+    unsigned                *cqHead;
+    unsigned                *cqTail;
+    unsigned                 cqMask;
+    struct io_uring_cqe     *cqes;
+
+    struct io_uring_buf_ring *buffers;
+    size_t                   buffersSize;
+    char                    *bufferMemory;
+    uint16_t                 buffersTail;
+
+    IoFd                    *fds;
+    int                      fdCount;
+
+    bool                     multishotAccept;
+    bool                     acceptArmed;
+    uint32_t                 acceptSerial;
+    int                     *accepted;     // a ring of accepted connections not yet taken
+    int                      acceptedHead;
+    int                      acceptedCount;
+    int                      acceptedCapacity;
+
+    PendingSend             *sends;
+    BufferPool              *sendBuffers;  // copies of the small responses, most of them
+    int                      sendCapacity;
+    int                      sendCount;
+    uint32_t                 sendSerial;
+#endif
+};
+
+#ifdef IO_URING_BACKEND
+
+static uint64_t monotonicMillis(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static uint64_t userData(uint32_t serial, int index, int kind) {
+    return (uint64_t)serial << 32 | (uint64_t)index << 3 | (uint64_t)kind;
+}
+
+static int ringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argSize) {
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+static int ringRegister(int fd, unsigned opcode, void *arg, unsigned count) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+static void *allocate(size_t size) {
+    void *memory = calloc(1, size);
+    if (!memory) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return memory;
+}
+
+static IoFd *fdEntry(IoLoop *loop, int fd) {
+    if (fd >= loop->fdCount) {
+        int count = loop->fdCount ? loop->fdCount : 64;
+        while (count <= fd) count *= 2;
+
+        loop->fds = realloc(loop->fds, sizeof(IoFd) * count);
+        if (!loop->fds) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = loop->fdCount; i < count; i++) {
+            loop->fds[i] = (IoFd){ .buffer = -1 };
+        }
+        loop->fdCount = count;
+    }
+
+    return &loop->fds[fd];
+}
+
+static IoFd *knownFd(IoLoop *loop, int fd) {
+    return fd >= 0 && fd < loop->fdCount ? &loop->fds[fd] : NULL;
+}
+
+// gives a provided buffer back to the kernel. bufs[0] shares its last field with the ring's tail,
+// so the fields are set one by one
+static void recycleBuffer(IoLoop *loop, int buffer) {
+    struct io_uring_buf *entry = &loop->buffers->bufs[loop->buffersTail & (RECV_BUFFERS - 1)];
+    entry->addr = (uint64_t)(uintptr_t)(loop->bufferMemory + (size_t)buffer * RECV_BUFFER_SIZE);
+    entry->len = RECV_BUFFER_SIZE;
+    entry->bid = buffer;
+
+    loop->buffersTail++;
+    __atomic_store_n(&loop->buffers->tail, loop->buffersTail, __ATOMIC_RELEASE);
+}
+
+// the descriptor was closed, or is about to be, anything still armed on it completes as stale
+static void forgetFd(IoLoop *loop, IoFd *entry) {
+    if (entry->buffer >= 0) {
+        recycleBuffer(loop, entry->buffer);
+    }
+
+    *entry = (IoFd){ .buffer = -1, .recvSerial = entry->recvSerial, .pollSerial = entry->pollSerial };
+}
+
+static void pushAccepted(IoLoop *loop, int fd) {
+    if (loop->acceptedCount == loop->acceptedCapacity) {
+        int capacity = loop->acceptedCapacity ? loop->acceptedCapacity * 2 : 64;
+        int *accepted = allocate(sizeof(int) * capacity);
+
+        for (int i = 0; i < loop->acceptedCount; i++) {
+            accepted[i] = loop->accepted[(loop->acceptedHead + i) % loop->acceptedCapacity];
+        }
+        free(loop->accepted);
+        loop->accepted = accepted;
+        loop->acceptedHead = 0;
+        loop->acceptedCapacity = capacity;
+    }
+
+    loop->accepted[(loop->acceptedHead + loop->acceptedCount++) % loop->acceptedCapacity] = fd;
+}
+
+static int popAccepted(IoLoop *loop) {
+    int fd = loop->accepted[loop->acceptedHead];
+    loop->acceptedHead = (loop->acceptedHead + 1) % loop->acceptedCapacity;
+    loop->acceptedCount--;
+
+    return fd;
+}
+
+static void complete(IoLoop *loop, const struct io_uring_cqe *cqe) {
+    int kind = cqe->user_data & 7;
+    int index = (cqe->user_data >> 3) & 0x1fffffff;
+    uint32_t serial = cqe->user_data >> 32;
+    int buffer = cqe->flags & IORING_CQE_F_BUFFER ? (int)(cqe->flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+
+    switch (kind) {
+        case OP_POLL: {
+            IoFd *entry = knownFd(loop, index);
+            if (!entry || !entry->pollArmed || entry->pollSerial != serial) break;
+
+            entry->pollArmed = 0;
+            if (cqe->res != -ECANCELED) {
+                entry->ready |= cqe->res >= 0 ? cqe->res : POLLNVAL;
+            }
+            break;
+        }
+        case OP_RECV: {
+            IoFd *entry = knownFd(loop, index);
+            if (!entry || !entry->recvArmed || entry->recvSerial != serial) break;
+
+            entry->recvArmed = false;
+            if (cqe->res > 0 && buffer >= 0) {
+                entry->buffer = buffer;
+                entry->offset = 0;
+                entry->length = cqe->res;
+                buffer = -1;
+            } else if (cqe->res == 0) {
+                entry->eof = true;
+            } else if (cqe->res == -ENOBUFS) {
+                entry->readDirectly = true;
+            } else if (cqe->res != -ECANCELED) {
+                entry->error = -cqe->res;
+            }
+            break;
+        }
+        case OP_ACCEPT:
+            // already open, whether or not the accept is still wanted
+            if (cqe->res >= 0) {
+                pushAccepted(loop, cqe->res);
+            } else if (cqe->res == -EINVAL && serial == loop->acceptSerial) {
+                // no multishot accept here, the listener is polled instead
+                loop->multishotAccept = false;
+            } else if (cqe->res != -ECANCELED && cqe->res != -EAGAIN && cqe->res != -ECONNABORTED) {
+                fprintf(stderr, "accept failed: %s\n", strerror(-cqe->res));
+            }
+            if (!(cqe->flags & IORING_CQE_F_MORE) && serial == loop->acceptSerial) {
+                loop->acceptArmed = false;
+            }
+            break;
+        case OP_SEND: {
+            PendingSend *send = index < loop->sendCapacity ? &loop->sends[index] : NULL;
+            if (!send || !send->data || send->userData != cqe->user_data) break;
+
+            if (cqe->res < 0) {
+                fprintf(stderr, "write response failed: %s\n",
+                    strerror(cqe->res == -ECANCELED ? ETIMEDOUT : -cqe->res));
+            }
+            releaseBuffer(loop->sendBuffers, send->data, send->capacity);
+            send->data = NULL;
+            loop->sendCount--;
+            break;
+        }
+    }
+
+    if (buffer >= 0) {
+        recycleBuffer(loop, buffer);
+    }
+}
+
+static void reap(IoLoop *loop) {
+    unsigned head = *loop->cqHead;
+    unsigned tail = __atomic_load_n(loop->cqTail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head++) {
+        complete(loop, &loop->cqes[head & loop->cqMask]);
+    }
+
+    __atomic_store_n(loop->cqHead, head, __ATOMIC_RELEASE);
+}
+
+// hands the queued entries to the kernel without waiting for any
+static void submit(IoLoop *loop) {
+    while (loop->toSubmit) {
+        int submitted = ringEnter(loop->ringFd, loop->toSubmit, 0, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (submitted < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EBUSY) {
+                reap(loop);
+                continue;
+            }
+            perror("io_uring_enter failed");
+            return;
+        }
+        if (submitted == 0) return;
+
+        loop->toSubmit -= submitted;
+    }
+}
+
+// Room for count more entries next to each other, so a linked chain is never split between submissions
+static void reserveEntries(IoLoop *loop, unsigned count) {
+    unsigned head = __atomic_load_n(loop->sqHead, __ATOMIC_ACQUIRE);
+    if (loop->sqQueued - head + count <= loop->sqEntries) return;
+
+    submit(loop);
+}
+
+// The kernel only reads entries in io_uring_enter, so the tail moves before the caller fills in the rest
+static struct io_uring_sqe *queueEntry(IoLoop *loop, int opcode, int fd, uint64_t data) {
+    reserveEntries(loop, 1);
+
+    unsigned index = loop->sqQueued & loop->sqMask;
+    struct io_uring_sqe *sqe = &loop->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = data;
+
+    loop->sqArray[index] = index;
+    loop->sqQueued++;
+    __atomic_store_n(loop->sqTail, loop->sqQueued, __ATOMIC_RELEASE);
+    loop->toSubmit++;
+
+    return sqe;
+}
+
+static void setPollEvents(struct io_uring_sqe *sqe, short events) {
+    uint32_t mask = (unsigned short)events;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    mask = mask << 16 | mask >> 16;
+#endif
+    sqe->poll32_events = mask;
+}
+
+static void armPoll(IoLoop *loop, int fd, IoFd *entry, short events) {
+    if (entry->pollArmed) {
+        struct io_uring_sqe *sqe = queueEntry(loop, IORING_OP_POLL_REMOVE, -1, userData(0, 0, OP_IGNORED));
+        sqe->addr = userData(entry->pollSerial, fd, OP_POLL);
+    }
+
+    entry->pollSerial++;
+    entry->pollArmed = events;
+    setPollEvents(queueEntry(loop, IORING_OP_POLL_ADD, fd, userData(entry->pollSerial, fd, OP_POLL)), events);
+}
+
+static void disarmPoll(IoLoop *loop, int fd, IoFd *entry) {
+    struct io_uring_sqe *sqe = queueEntry(loop, IORING_OP_POLL_REMOVE, -1, userData(0, 0, OP_IGNORED));
+    sqe->addr = userData(entry->pollSerial, fd, OP_POLL);
+    entry->pollArmed = 0;
+}
+
+static void armRecv(IoLoop *loop, int fd, IoFd *entry) {
+    entry->recvSerial++;
+    entry->recvArmed = true;
+
+    struct io_uring_sqe *sqe = queueEntry(loop, IORING_OP_RECV, fd, userData(entry->recvSerial, fd, OP_RECV));
+    sqe->len = RECV_BUFFER_SIZE;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BUFFER_GROUP;
+}
+
+// cancels whatever is armed on fd, the entry linked after it runs once that is done
+static void cancelFd(IoLoop *loop, int fd) {
+    struct io_uring_sqe *sqe = queueEntry(loop, IORING_OP_ASYNC_CANCEL, fd, userData(0, 0, OP_IGNORED));
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->flags = IOSQE_IO_HARDLINK;
+}
+
+static void armAccept(IoLoop *loop) {
+    loop->acceptSerial++;
+    loop->acceptArmed = true;
+
+    struct io_uring_sqe *sqe = queueEntry(loop, IORING_OP_ACCEPT, loop->listener,
+        userData(loop->acceptSerial, loop->listener, OP_ACCEPT));
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+}
+
+static void disarmAccept(IoLoop *loop) {
+    struct io_uring_sqe *sqe = queueEntry(loop, IORING_OP_ASYNC_CANCEL, -1, userData(0, 0, OP_IGNORED));
+    sqe->addr = userData(loop->acceptSerial, loop->listener, OP_ACCEPT);
+    loop->acceptArmed = false;
+}
+
+static bool hasInput(const IoFd *entry) {
+    return entry->buffer >= 0 || entry->eof || entry->error || entry->readDirectly;
+}
+
+// arms what fd needs to report events, true when it can already
+static bool armFor(IoLoop *loop, int fd, short events, bool *listening) {
+    if (fd == loop->listener && loop->multishotAccept) {
+        *listening = true;
+        if (loop->acceptedCount) return true;
+        if (!loop->acceptArmed) armAccept(loop);
+        return false;
+    }
+
+    IoFd *entry = fdEntry(loop, fd);
+    bool ready = false;
+
+    if (entry->socket && (events & POLLIN)) {
+        if (hasInput(entry)) {
+            ready = true;
+        } else if (!entry->recvArmed) {
+            armRecv(loop, fd, entry);
+        }
+        events &= ~POLLIN;
+    }
+
+    if (entry->ready & (events | POLLERR | POLLHUP | POLLNVAL)) return true;
+
+    if (events && (entry->pollArmed & events) != events) {
+        armPoll(loop, fd, entry, events | entry->pollArmed);
+    }
+
+    return ready;
+}
+
+static short readiness(IoLoop *loop, int fd, short events) {
+    if (fd == loop->listener && loop->multishotAccept) {
+        return loop->acceptedCount ? POLLIN : 0;
+    }
+
+    IoFd *entry = fdEntry(loop, fd);
+    short revents = entry->ready & (events | POLLERR | POLLHUP | POLLNVAL);
+    if (entry->socket && (events & POLLIN) && hasInput(entry)) {
+        revents |= POLLIN;
+    }
+
+    return revents;
+}
+
+// overdue sends are cancelled, their close still follows. Returns the next deadline, 0 for none.
+// A send without a deadline (0) waits for good
+static uint64_t expireSends(IoLoop *loop, uint64_t now) {
+    uint64_t next = 0;
+
+    for (int i = 0; i < loop->sendCapacity && loop->sendCount; i++) {
+        PendingSend *send = &loop->sends[i];
+        if (!send->data || send->cancelled || !send->deadlineMillis) continue;
+
+        if (send->deadlineMillis <= now) {
+            struct io_uring_sqe *sqe = queueEntry(loop, IORING_OP_ASYNC_CANCEL, -1, userData(0, 0, OP_IGNORED));
+            sqe->addr = send->userData;
+            send->cancelled = true;
+        } else if (!next || send->deadlineMillis < next) {
+            next = send->deadlineMillis;
+        }
+    }
+
+    return next;
+}
+
+// submits what is queued and waits up to timeoutMillis for a completion, 0 only submits
+static int enterAndWait(IoLoop *loop, int timeoutMillis) {
+    if (timeoutMillis == 0 && !loop->toSubmit) return 0;
+
+    struct __kernel_timespec timeout = { .tv_sec = timeoutMillis / 1000, .tv_nsec = (timeoutMillis % 1000) * 1000000LL };
+    struct io_uring_getevents_arg arg = { .ts = (uint64_t)(uintptr_t)&timeout };
+
+    unsigned flags = IORING_ENTER_GETEVENTS;
+    if (timeoutMillis > 0) flags |= IORING_ENTER_EXT_ARG;
+
+    for (;;) {
+        int submitted = ringEnter(loop->ringFd, loop->toSubmit, timeoutMillis ? 1 : 0, flags,
+            timeoutMillis > 0 ? &arg : NULL, timeoutMillis > 0 ? sizeof(arg) : 0);
+        if (submitted >= 0) {
+            loop->toSubmit -= submitted;
+            return 0;
+        }
+
+        if (errno == ETIME) return 0;
+        if (errno == EAGAIN || errno == EBUSY) {
+            reap(loop);
+            return 0;
+        }
+        if (errno != EINTR) {
+            perror("io_uring_enter failed");
+        }
+        return -1;
+    }
+}
+
+static const char *openRing(IoLoop *loop, int capacity) {
+    struct io_uring_params params = {
+        .flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER,
+        .cq_entries = RING_ENTRIES * 4,
+    };
+    loop->ringFd = (int)syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+    if (loop->ringFd < 0 && errno == EINVAL) {
+        params = (struct io_uring_params){ .flags = IORING_SETUP_CQSIZE, .cq_entries = RING_ENTRIES * 4 };
+        loop->ringFd = (int)syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+    }
+    if (loop->ringFd < 0) return strerror(errno);
+
+    unsigned needed = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((params.features & needed) != needed) return "the kernel is older than 5.19";
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    loop->ringSize = sqSize > cqSize ? sqSize : cqSize;
+    loop->ringMemory = mmap(NULL, loop->ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        loop->ringFd, IORING_OFF_SQ_RING);
+    if (loop->ringMemory == MAP_FAILED) {
+        loop->ringMemory = NULL;
+        return strerror(errno);
+    }
+
+    loop->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    loop->sqes = mmap(NULL, loop->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        loop->ringFd, IORING_OFF_SQES);
+    if (loop->sqes == MAP_FAILED) {
+        loop->sqes = NULL;
+        return strerror(errno);
+    }
+
+    char *ring = loop->ringMemory;
+    loop->sqHead = (unsigned *)(ring + params.sq_off.head);
+    loop->sqTail = (unsigned *)(ring + params.sq_off.tail);
+    loop->sqArray = (unsigned *)(ring + params.sq_off.array);
+    loop->sqMask = *(unsigned *)(ring + params.sq_off.ring_mask);
+    loop->sqEntries = params.sq_entries;
+    loop->sqQueued = *loop->sqTail;
+    loop->cqHead = (unsigned *)(ring + params.cq_off.head);
+    loop->cqTail = (unsigned *)(ring + params.cq_off.tail);
+    loop->cqMask = *(unsigned *)(ring + params.cq_off.ring_mask);
+    loop->cqes = (struct io_uring_cqe *)(ring + params.cq_off.cqes);
+
+    static const int opcodes[] = {
+        IORING_OP_POLL_ADD, IORING_OP_POLL_REMOVE, IORING_OP_ASYNC_CANCEL, IORING_OP_ACCEPT,
+        IORING_OP_CLOSE, IORING_OP_SEND, IORING_OP_RECV,
+    };
+    struct io_uring_probe *probe = allocate(sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op));
+    bool supported = ringRegister(loop->ringFd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (size_t i = 0; supported && i < sizeof(opcodes) / sizeof(opcodes[0]); i++) {
+        supported = opcodes[i] <= probe->last_op && (probe->ops[opcodes[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    if (!supported) return "the kernel is older than 5.19";
+
+    loop->buffersSize = RECV_BUFFERS * sizeof(struct io_uring_buf);
+    loop->buffers = mmap(NULL, loop->buffersSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (loop->buffers == MAP_FAILED) {
+        loop->buffers = NULL;
+        return strerror(errno);
+    }
+
+    struct io_uring_buf_reg registration = {
+        .ring_addr = (uint64_t)(uintptr_t)loop->buffers,
+        .ring_entries = RECV_BUFFERS,
+        .bgid = RECV_BUFFER_GROUP,
+    };
+    if (ringRegister(loop->ringFd, IORING_REGISTER_PBUF_RING, &registration, 1) != 0) {
+        return "the kernel is older than 5.19";
+    }
+
+    loop->bufferMemory = allocate((size_t)RECV_BUFFERS * RECV_BUFFER_SIZE);
+    for (int i = 0; i < RECV_BUFFERS; i++) {
+        recycleBuffer(loop, i);
+    }
+
+    loop->multishotAccept = true;
+    loop->sendCapacity = capacity;
+    loop->sends = allocate(sizeof(PendingSend) * capacity);
+    loop->sendBuffers = initBufferPool(POOL_BUFFER_SIZE);
+
+    return NULL;
+}
+
+static void closeRing(IoLoop *loop) {
+    if (loop->ringFd >= 0) close(loop->ringFd);
+    if (loop->ringMemory) munmap(loop->ringMemory, loop->ringSize);
+    if (loop->sqes) munmap(loop->sqes, loop->sqesSize);
+    if (loop->buffers) munmap(loop->buffers, loop->buffersSize);
+    free(loop->bufferMemory);
+    free(loop->fds);
+
+    while (loop->acceptedCount) {
+        close(popAccepted(loop));
+    }
+    free(loop->accepted);
+
+    for (int i = 0; i < loop->sendCapacity; i++) {
+        releaseBuffer(loop->sendBuffers, loop->sends[i].data, loop->sends[i].capacity);
+    }
+    free(loop->sends);
+    freeBufferPool(loop->sendBuffers);
+}
+
+#endif
+
+IoLoop *openIoLoop(int capacity) {
+    IoLoop *loop = calloc(1, sizeof(IoLoop));
+    if (!loop) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    loop->listener = -1;
+
+#ifdef IO_URING_BACKEND
+    const char *unavailable = openRing(loop, capacity > 0 ? capacity : 1);
+    if (unavailable) {
+        fprintf(stderr, "io_uring is not available (%s), using poll.\n", unavailable);
+        closeRing(loop);
+
+        *loop = (IoLoop){ .listener = -1 };
+    } else {
+        loop->uring = true;
+    }
+#else
+    (void)capacity;
+#endif
+
+    return loop;
+}
+
+void closeIoLoop(IoLoop *loop) {
+    if (!loop) return;
+
+#ifdef IO_URING_BACKEND
+    if (loop->uring) {
+        ioDrain(loop);
+        closeRing(loop);
+    }
+#endif
+
+    free(loop);
+}
+
+bool ioUsesUring(const IoLoop *loop) {
+    return loop->uring;
+}
+
+void ioListen(IoLoop *loop, int listener) {
+    loop->listener = listener;
+}
+
+int ioWait(IoLoop *loop, struct pollfd *fds, int count, int timeoutMillis) {
+#ifdef IO_URING_BACKEND
+    if (loop->uring) {
+        reap(loop);
+
+        bool immediate = false;
+        bool listening = false;
+        for (int i = 0; i < count; i++) {
+            fds[i].revents = 0;
+            if (fds[i].fd >= 0 && armFor(loop, fds[i].fd, fds[i].events, &listening)) {
+                immediate = true;
+            }
+        }
+        if (loop->acceptArmed && !listening) {
+            disarmAccept(loop);
+        }
+
+        // the next send deadline also ends the wait
+        uint64_t now = monotonicMillis();
+        uint64_t nextSend = loop->sendCount ? expireSends(loop, now) : 0;
+        if (nextSend) {
+            int untilSend = nextSend > now ? (int)(nextSend - now) : 0;
+            if (timeoutMillis < 0 || untilSend < timeoutMillis) timeoutMillis = untilSend;
+        }
+
+        int entered = enterAndWait(loop, immediate ? 0 : timeoutMillis);
+        int error = errno;
+        reap(loop);
+
+        int ready = 0;
+        for (int i = 0; i < count; i++) {
+            if (fds[i].fd < 0) continue;
+
+            fds[i].revents = readiness(loop, fds[i].fd, fds[i].events);
+            if (fds[i].revents) ready++;
+        }
+
+        // level triggered like poll: what was reported is armed again next time if still wanted.
+        // Polls on descriptors that may be closed and reused before the next wait do not outlive this one
+        for (int i = 0; i < count; i++) {
+            if (fds[i].fd < 0 || (fds[i].fd == loop->listener && loop->multishotAccept)) continue;
+
+            IoFd *entry = fdEntry(loop, fds[i].fd);
+
+            entry->ready = 0;
+            if (entry->pollArmed && !entry->socket && !entry->watched) {
+                disarmPoll(loop, fds[i].fd, entry);
+            }
+        }
+
+        if (entered < 0 && ready == 0) {
+            errno = error;
+            return -1;
+        }
+        return ready;
+    }
+#else
+    (void)loop;
+#endif
+
+    return poll(fds, count, timeoutMillis);
+}
+
+int ioAccept(IoLoop *loop, int listener, struct sockaddr_storage *address, socklen_t *addressLength) {
+#ifdef IO_URING_BACKEND
+    if (loop->uring && loop->multishotAccept && listener == loop->listener) {
+        if (!loop->acceptedCount) reap(loop);
+        if (!loop->acceptedCount) {
+            errno = EAGAIN;
+            return -1;
+        }
+
+        address->ss_family = AF_UNSPEC;
+        *addressLength = 0;
+        return popAccepted(loop);
+    }
+#endif
+    (void)loop;
+
+#ifdef __linux__
+    return accept4(listener, (struct sockaddr *)address, addressLength, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    int fd = accept(listener, (struct sockaddr *)address, addressLength);
+    if (fd >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return fd;
+#endif
+}
+
+bool ioAcceptQueued(const IoLoop *loop) {
+#ifdef IO_URING_BACKEND
+    return loop->uring && loop->acceptedCount > 0;
+#else
+    (void)loop;
+    return false;
+#endif
+}
+
+void ioWatch(IoLoop *loop, int fd) {
+#ifdef IO_URING_BACKEND
+    if (loop->uring && fd >= 0) {
+        fdEntry(loop, fd)->watched = true;
+    }
+#else
+    (void)loop;
+    (void)fd;
+#endif
+}
+
+void ioAdopt(IoLoop *loop, int fd) {
+#ifdef IO_URING_BACKEND
+    if (loop->uring) {
+        IoFd *entry = fdEntry(loop, fd);
+        forgetFd(loop, entry);
+        entry->socket = true;
+    }
+#else
+    (void)loop;
+    (void)fd;
+#endif
+}
+
+ssize_t ioRead(IoLoop *loop, int fd, void *buffer, size_t length) {
+#ifdef IO_URING_BACKEND
+    IoFd *entry = loop->uring ? knownFd(loop, fd) : NULL;
+
+    if (entry && entry->socket && length > 0) {
+        if (entry->buffer >= 0) {
+            size_t available = entry->length - entry->offset;
+            size_t count = available < length ? available : length;
+            memcpy(buffer, loop->bufferMemory + (size_t)entry->buffer * RECV_BUFFER_SIZE + entry->offset, count);
+            entry->offset += count;
+
+            if (entry->offset == entry->length) {
+                recycleBuffer(loop, entry->buffer);
+                entry->buffer = -1;
+                // a full buffer, likely the start of a large body, the rest is read straight from the socket
+                entry->readDirectly = entry->length == RECV_BUFFER_SIZE;
+            }
+            return count;
+        }
+        if (entry->error) {
+            errno = entry->error;
+            return -1;
+        }
+        if (entry->eof) return 0;
+        if (!entry->readDirectly) {
+            errno = EAGAIN;
+            return -1;
+        }
+
+        ssize_t count = read(fd, buffer, length);
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            entry->readDirectly = false;
+        }
+        return count;
+    }
+#else
+    (void)loop;
+#endif
+
+    return read(fd, buffer, length);
+}
+
+void ioClose(IoLoop *loop, int fd) {
+#ifdef IO_URING_BACKEND
+    if (loop->uring) {
+        IoFd *entry = knownFd(loop, fd);
+        if (entry && entry->closing) {
+            entry->closing = false;
+            return;
+        }
+
+        // queued with the next wait rather than a system call of its own
+        reserveEntries(loop, 2);
+        if (entry && (entry->recvArmed || entry->pollArmed)) {
+            cancelFd(loop, fd);
+        }
+        queueEntry(loop, IORING_OP_CLOSE, fd, userData(0, 0, OP_IGNORED));
+
+        if (entry) forgetFd(loop, entry);
+        return;
+    }
+#else
+    (void)loop;
+#endif
+
+    close(fd);
+}
+
+bool ioSendAndClose(IoLoop *loop, int fd, const struct iovec *iov, int count, uint64_t deadlineMillis) {
+#ifdef IO_URING_BACKEND
+    if (!loop->uring || fd < 0 || loop->sendCount == loop->sendCapacity) return false;
+
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += iov[i].iov_len;
+    }
+    if (total == 0 || total > SEND_COPY_LIMIT) return false;
+
+    int slot = 0;
+    while (loop->sends[slot].data) slot++;
+
+    // the caller frees its buffers as soon as this returns
+    size_t capacity = total <= POOL_BUFFER_SIZE ? POOL_BUFFER_SIZE : total;
+    char *data = capacity == POOL_BUFFER_SIZE ? takeBuffer(loop->sendBuffers) : malloc(capacity);
+    if (!data) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t offset = 0;
+    for (int i = 0; i < count; i++) {
+        memcpy(data + offset, iov[i].iov_base, iov[i].iov_len);
+        offset += iov[i].iov_len;
+    }
+
+    PendingSend *send = &loop->sends[slot];
+    *send = (PendingSend){
+        .userData = userData(++loop->sendSerial, slot, OP_SEND),
+        .data = data,
+        .capacity = capacity,
+        .deadlineMillis = deadlineMillis,
+    };
+    loop->sendCount++;
+
+    // hard links, so the close follows whether or not the send went through
+    IoFd *entry = fdEntry(loop, fd);
+    reserveEntries(loop, 3);
+    if (entry->recvArmed || entry->pollArmed) {
+        cancelFd(loop, fd);
+    }
+
+    struct io_uring_sqe *sqe = queueEntry(loop, IORING_OP_SEND, fd, send->userData);
+    sqe->addr = (uint64_t)(uintptr_t)data;
+    sqe->len = total;
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    sqe->flags = IOSQE_IO_HARDLINK;
+
+    queueEntry(loop, IORING_OP_CLOSE, fd, userData(0, 0, OP_IGNORED));
+
+    forgetFd(loop, entry);
+    entry->closing = true;
+
+    return true;
+#else
+    (void)loop;
+    (void)fd;
+    (void)iov;
+    (void)count;
+    (void)deadlineMillis;
+
+    return false;
+#endif
+}
+
+void ioDrain(IoLoop *loop) {
+#ifdef IO_URING_BACKEND
+    if (!loop->uring) return;
+
+    for (;;) {
+        submit(loop);
+        reap(loop);
+        if (loop->sendCount == 0) return;
+
+        uint64_t now = monotonicMillis();
+        uint64_t nextSend = expireSends(loop, now);
+        enterAndWait(loop, nextSend ? (nextSend > now ? (int)(nextSend - now) : 0) : -1);
+    }
+#else
+    (void)loop;
+#endif
+}
@@ -0,0 +1,497 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/jobs.h"
+#include "include/app.h"
+
+static void *runWorker(void *arg);
+static void *runScheduler(void *arg);
+
+JobQueue *initJobQueue(int workerCount, size_t capacity) {
+    if (workerCount <= 0) workerCount = JOB_DEFAULT_WORKERS;
+    if (capacity == 0) capacity = JOB_DEFAULT_CAPACITY;
+
+    JobQueue *queue = calloc(1, sizeof(JobQueue));
+    JobWorker *workers = calloc(workerCount, sizeof(JobWorker));
+    if (!queue || !workers) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    queue->workers = workers;
+    queue->workerCount = workerCount;
+
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->wake, NULL);
+    pthread_cond_init(&queue->idle, NULL);
+    pthread_cond_init(&queue->scheduleChanged, NULL);
+
+    // the capacity is split between the workers, rounded up
+    size_t perWorker = (capacity + workerCount - 1) / workerCount;
+
+    for (int i = 0; i < workerCount; i++) {
+        JobWorker *worker = &workers[i];
+
+        worker->jobs = malloc(perWorker * sizeof(Job));
+        if (!worker->jobs) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        worker->capacity = perWorker;
+        worker->queue = queue;
+        pthread_mutex_init(&worker->lock, NULL);
+    }
+
+    // started once every worker exists, as any of them may steal from the others
+    for (int i = 0; i < workerCount; i++) {
+        if (pthread_create(&workers[i].thread, NULL, runWorker, &workers[i]) != 0) {
+            perror("job worker thread failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return queue;
+}
+
+void freeJobQueue(JobQueue *queue) {
+    if (!queue) return;
+
+    // the workers still run everything queued, including jobs those jobs enqueue
+    pthread_mutex_lock(&queue->lock);
+    queue->stopping = true;
+    pthread_cond_broadcast(&queue->scheduleChanged);
+    pthread_cond_broadcast(&queue->wake);
+    pthread_mutex_unlock(&queue->lock);
+
+    if (queue->schedulerStarted) {
+        pthread_join(queue->scheduler, NULL);
+    }
+
+    for (int i = 0; i < queue->workerCount; i++) {
+        pthread_join(queue->workers[i].thread, NULL);
+    }
+
+    for (int i = 0; i < queue->workerCount; i++) {
+        free(queue->workers[i].jobs);
+        pthread_mutex_destroy(&queue->workers[i].lock);
+    }
+    free(queue->workers);
+
+    ScheduledJob *scheduled = queue->scheduled;
+    while (scheduled) {
+        ScheduledJob *next = scheduled->next;
+        free(scheduled);
+        scheduled = next;
+    }
+
+    pthread_cond_destroy(&queue->scheduleChanged);
+    pthread_cond_destroy(&queue->idle);
+    pthread_cond_destroy(&queue->wake);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue);
+}
+
+void drainJobQueue(JobQueue *queue) {
+    if (!queue) return;
+
+    pthread_mutex_lock(&queue->lock);
+    while (__atomic_load_n(&queue->queued, __ATOMIC_ACQUIRE) || __atomic_load_n(&queue->running, __ATOMIC_ACQUIRE)) {
+        pthread_cond_wait(&queue->idle, &queue->lock);
+    }
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static bool pushJob(JobQueue *queue, Job job) {
+    size_t start = __atomic_fetch_add(&queue->nextWorker, 1, __ATOMIC_RELAXED);
+
+    // round robin, passing over workers whose share is full
+    for (int i = 0; i < queue->workerCount; i++) {
+        JobWorker *worker = &queue->workers[(start + i) % queue->workerCount];
+
+        pthread_mutex_lock(&worker->lock);
+        if (worker->count == worker->capacity) {
+            pthread_mutex_unlock(&worker->lock);
+            continue;
+        }
+
+        worker->jobs[(worker->head + worker->count++) % worker->capacity] = job;
+        __atomic_add_fetch(&queue->queued, 1, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&worker->lock);
+
+        // the sleepers check queued under this lock, so none of them can miss the job
+        pthread_mutex_lock(&queue->lock);
+        if (queue->sleeping) {
+            pthread_cond_signal(&queue->wake);
+        }
+        pthread_mutex_unlock(&queue->lock);
+
+        return true;
+    }
+
+    __atomic_add_fetch(&queue->rejected, 1, __ATOMIC_RELAXED);
+    return false;
+}
+
+static bool takeJob(JobWorker *worker, Job *job, bool steal) {
+    pthread_mutex_lock(&worker->lock);
+    if (worker->count == 0) {
+        pthread_mutex_unlock(&worker->lock);
+        return false;
+    }
+
+    *job = worker->jobs[worker->head];
+    worker->head = (worker->head + 1) % worker->capacity;
+    worker->count--;
+    if (steal) worker->stolen++;
+
+    // counted as running first, so queued + running never reads 0 while a job is in hand
+    __atomic_add_fetch(&worker->queue->running, 1, __ATOMIC_RELEASE);
+    __atomic_sub_fetch(&worker->queue->queued, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&worker->lock);
+
+    return true;
+}
+
+static bool findJob(JobWorker *self, Job *job) {
+    JobQueue *queue = self->queue;
+
+    if (takeJob(self, job, false)) return true;
+
+    int index = (int)(self - queue->workers);
+    for (int i = 1; i < queue->workerCount; i++) {
+        if (takeJob(&queue->workers[(index + i) % queue->workerCount], job, true)) return true;
+    }
+
+    return false;
+}
+
+static void runJob(JobQueue *queue, Job *job) {
+    JobContext ctx = {
+        .app = job->app,
+        .db = job->app ? job->app->dbContext : NULL,
+        .arg = job->arg,
+    };
+    job->function(ctx);
+
+    if (job->scheduled) {
+        __atomic_store_n(&job->scheduled->running, false, __ATOMIC_RELEASE);
+    }
+
+    __atomic_add_fetch(&queue->completed, 1, __ATOMIC_RELAXED);
+    size_t running = __atomic_sub_fetch(&queue->running, 1, __ATOMIC_ACQ_REL);
+
+    if (running == 0 && __atomic_load_n(&queue->queued, __ATOMIC_ACQUIRE) == 0) {
+        pthread_mutex_lock(&queue->lock);
+        pthread_cond_broadcast(&queue->idle);
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+static void *runWorker(void *arg) {
+    JobWorker *self = arg;
+    JobQueue *queue = self->queue;
+
+    for (;;) {
+        Job job;
+        if (findJob(self, &job)) {
+            runJob(queue, &job);
+            continue;
+        }
+
+        pthread_mutex_lock(&queue->lock);
+        while (__atomic_load_n(&queue->queued, __ATOMIC_ACQUIRE) == 0 && !queue->stopping) {
+            queue->sleeping++;
+            pthread_cond_wait(&queue->wake, &queue->lock);
+            queue->sleeping--;
+        }
+        bool done = queue->stopping && __atomic_load_n(&queue->queued, __ATOMIC_ACQUIRE) == 0;
+        pthread_mutex_unlock(&queue->lock);
+
+        if (done) return NULL;
+    }
+}
+
+bool enqueueJob(App *app, JobFunction function, void *arg) {
+    if (!app->jobs) {
+        fprintf(stderr, "enqueueJob: call useJobQueue before enqueueing jobs\n");
+        return false;
+    }
+
+    return submitJob(app->jobs, app, function, arg);
+}
+
+bool submitJob(JobQueue *queue, App *app, JobFunction function, void *arg) {
+    return pushJob(queue, (Job){ .function = function, .arg = arg, .app = app });
+}
+
+// "5", "1-5", "*", each optionally "/step", separated by commas
+static bool parseField(const char *text, int min, int max, uint64_t *bits, bool *any) {
+    *bits = 0;
+    *any = strcmp(text, "*") == 0;
+
+    const char *c = text;
+    for (;;) {
+        int from = min;
+        int to = max;
+        bool single = false;
+
+        if (*c == '*') {
+            c++;
+        } else {
+            if (!isdigit((unsigned char)*c)) return false;
+            from = to = (int)strtol(c, (char **)&c, 10);
+            single = true;
+
+            if (*c == '-') {
+                c++;
+                if (!isdigit((unsigned char)*c)) return false;
+                to = (int)strtol(c, (char **)&c, 10);
+                single = false;
+            }
+        }
+
+        int step = 1;
+        if (*c == '/') {
+            c++;
+            if (!isdigit((unsigned char)*c)) return false;
+            step = (int)strtol(c, (char **)&c, 10);
+
+            // "5/15" is 5, 20, 35 and 50
+            if (single) to = max;
+        }
+
+        if (from < min || to > max || from > to || step <= 0) return false;
+
+        for (int value = from; value <= to; value += step) {
+            *bits |= 1ULL << value;
+        }
+
+        if (*c == '\0') return true;
+        if (*c++ != ',') return false;
+    }
+}
+
+bool parseJobSchedule(const char *text, JobSchedule *schedule) {
+    *schedule = (JobSchedule){0};
+
+    static const struct {
+        const char *name;
+        const char *expression;
+    } macros[] = {
+        { "@hourly",  "0 * * * *" },
+        { "@daily",   "0 0 * * *" },
+        { "@weekly",  "0 0 * * 0" },
+        { "@monthly", "0 0 1 * *" },
+    };
+
+    for (size_t i = 0; i < sizeof(macros) / sizeof(macros[0]); i++) {
+        if (strcmp(text, macros[i].name) == 0) return parseJobSchedule(macros[i].expression, schedule);
+    }
+
+    if (strncmp(text, "@every ", 7) == 0) {
+        char *unit;
+        long amount = strtol(text + 7, &unit, 10);
+        if (amount <= 0 || unit[0] == '\0' || unit[1] != '\0') return false;
+
+        switch (*unit) {
+            case 's': schedule->intervalSeconds = amount; break;
+            case 'm': schedule->intervalSeconds = amount * 60; break;
+            case 'h': schedule->intervalSeconds = amount * 3600; break;
+            default: return false;
+        }
+
+        return true;
+    }
+
+    char fields[5][64];
+    int count = sscanf(text, "%63s %63s %63s %63s %63s", fields[0], fields[1], fields[2], fields[3], fields[4]);
+    if (count != 5) return false;
+
+    // nothing may follow the fifth field
+    const char *end = text;
+    for (int i = 0; i < 5; i++) {
+        while (isspace((unsigned char)*end)) end++;
+        end += strlen(fields[i]);
+    }
+    while (isspace((unsigned char)*end)) end++;
+    if (*end) return false;
+
+    uint64_t bits;
+    bool any;
+
+    if (!parseField(fields[0], 0, 59, &bits, &any)) return false;
+    schedule->minutes = bits;
+    if (!parseField(fields[1], 0, 23, &bits, &any)) return false;
+    schedule->hours = (uint32_t)bits;
+    if (!parseField(fields[2], 1, 31, &bits, &schedule->anyDay)) return false;
+    schedule->days = (uint32_t)bits;
+    if (!parseField(fields[3], 1, 12, &bits, &any)) return false;
+    schedule->months = (uint16_t)bits;
+
+    // 7 is also Sunday
+    if (!parseField(fields[4], 0, 7, &bits, &schedule->anyWeekday)) return false;
+    schedule->weekdays = (uint8_t)((bits | (bits >> 7)) & 0x7f);
+
+    return true;
+}
+
+// when both day fields are given either may match, as in cron
+static bool dayMatches(const JobSchedule *schedule, const struct tm *tm) {
+    bool day = schedule->days & (1U << tm->tm_mday);
+    bool weekday = schedule->weekdays & (1U << tm->tm_wday);
+
+    if (schedule->anyDay && schedule->anyWeekday) return true;
+    if (schedule->anyDay) return weekday;
+    if (schedule->anyWeekday) return day;
+
+    return day || weekday;
+}
+
+time_t nextScheduledRun(const JobSchedule *schedule, time_t after) {
+    if (schedule->intervalSeconds) return after + schedule->intervalSeconds;
+
+    struct tm tm;
+    localtime_r(&after, &tm);
+    int lastYear = tm.tm_year + 5;
+
+    // from the next whole minute, skipping a month, day or hour at a time where it cannot match
+    tm.tm_sec = 0;
+    tm.tm_min++;
+
+    while (tm.tm_year <= lastYear) {
+        tm.tm_isdst = -1;
+        time_t candidate = mktime(&tm);
+        if (candidate == (time_t)-1) return 0;
+
+        if (!(schedule->months & (1U << (tm.tm_mon + 1)))) {
+            tm.tm_mon++;
+            tm.tm_mday = 1;
+            tm.tm_hour = 0;
+            tm.tm_min = 0;
+        } else if (!dayMatches(schedule, &tm)) {
+            tm.tm_mday++;
+            tm.tm_hour = 0;
+            tm.tm_min = 0;
+        } else if (!(schedule->hours & (1U << tm.tm_hour))) {
+            tm.tm_hour++;
+            tm.tm_min = 0;
+        } else if (!(schedule->minutes & (1ULL << tm.tm_min))) {
+            tm.tm_min++;
+        } else {
+            return candidate;
+        }
+    }
+
+    return 0;
+}
+
+// a run that is still going when the next is due makes that one skip, runs never overlap
+static void fireScheduled(JobQueue *queue, ScheduledJob *scheduled) {
+    if (__atomic_exchange_n(&scheduled->running, true, __ATOMIC_ACQ_REL)) {
+        __atomic_add_fetch(&queue->skipped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    Job job = { .function = scheduled->function, .arg = scheduled->arg, .app = scheduled->app, .scheduled = scheduled };
+    if (!pushJob(queue, job)) {
+        __atomic_store_n(&scheduled->running, false, __ATOMIC_RELEASE);
+    }
+}
+
+static void *runScheduler(void *arg) {
+    JobQueue *queue = arg;
+
+    pthread_mutex_lock(&queue->lock);
+    while (!queue->stopping) {
+        time_t now = time(NULL);
+        time_t wakeAt = 0;
+        ScheduledJob *due = NULL;
+
+        for (ScheduledJob *scheduled = queue->scheduled; scheduled; scheduled = scheduled->next) {
+            if (!scheduled->nextRun) continue;
+
+            if (scheduled->nextRun <= now) {
+                due = scheduled;
+                break;
+            }
+            if (!wakeAt || scheduled->nextRun < wakeAt) {
+                wakeAt = scheduled->nextRun;
+            }
+        }
+
+        if (due) {
+            // an interval keeps its rhythm unless the process fell behind, e.g. while suspended
+            time_t from = due->schedule.intervalSeconds && due->nextRun + due->schedule.intervalSeconds > now
+                ? due->nextRun : now;
+            due->nextRun = nextScheduledRun(&due->schedule, from);
+
+            // pushing takes the worker locks and then this one
+            pthread_mutex_unlock(&queue->lock);
+            fireScheduled(queue, due);
+            pthread_mutex_lock(&queue->lock);
+            continue;
+        }
+
+        if (wakeAt) {
+            struct timespec until = { .tv_sec = wakeAt };
+            pthread_cond_timedwait(&queue->scheduleChanged, &queue->lock, &until);
+        } else {
+            pthread_cond_wait(&queue->scheduleChanged, &queue->lock);
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return NULL;
+}
+
+bool scheduleJob(App *app, const char *schedule, JobFunction function, void *arg) {
+    if (!app->jobs) {
+        fprintf(stderr, "scheduleJob: call useJobQueue before scheduling %s\n", schedule);
+        return false;
+    }
+
+    JobSchedule parsed;
+    if (!parseJobSchedule(schedule, &parsed)) {
+        fprintf(stderr, "scheduleJob: cannot parse the schedule '%s'\n", schedule);
+        return false;
+    }
+
+    time_t nextRun = nextScheduledRun(&parsed, time(NULL));
+    if (!nextRun) {
+        fprintf(stderr, "scheduleJob: '%s' never runs\n", schedule);
+        return false;
+    }
+
+    ScheduledJob *scheduled = malloc(sizeof(ScheduledJob));
+    if (!scheduled) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    *scheduled = (ScheduledJob){
+        .schedule = parsed,
+        .function = function,
+        .arg = arg,
+        .app = app,
+        .nextRun = nextRun,
+    };
+
+    JobQueue *queue = app->jobs;
+
+    pthread_mutex_lock(&queue->lock);
+    scheduled->next = queue->scheduled;
+    queue->scheduled = scheduled;
+
+    if (!queue->schedulerStarted) {
+        if (pthread_create(&queue->scheduler, NULL, runScheduler, queue) != 0) {
+            perror("job scheduler thread failed");
+            exit(EXIT_FAILURE);
+        }
+        queue->schedulerStarted = true;
+    }
+    pthread_cond_signal(&queue->scheduleChanged);
+    pthread_mutex_unlock(&queue->lock);
+
+    return true;
+}
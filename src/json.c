@@ -1,8 +1,10 @@
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "include/json.h"
+#include "include/tracing.h"
 
 JsonBuilder *jsonBuilder() {
     JsonBuilder *builder = malloc(sizeof(JsonBuilder));
@@ -185,7 +187,7 @@ void jsonArrayAppend(JsonArray *array, Json value) {
     array->items[array->count++] = value;
 }
 
-char *jsonStringify(JsonBuilder *builder) {
+static char *stringifyObject(JsonBuilder *builder) {
     if (!builder) return NULL;
     
     int capacity = 16;
@@ -251,7 +253,7 @@ char *jsonStringify(JsonBuilder *builder) {
                             snprintf(arrBuf, sizeof(arrBuf), "null");
                             break;
                         case JSON_OBJECT: {
-                            char *nested = jsonStringify(arrItem.object);
+                            char *nested = stringifyObject(arrItem.object);
                             snprintf(arrBuf, sizeof(arrBuf), "%s", nested);
                             free(nested);
                             break;
@@ -290,7 +292,7 @@ char *jsonStringify(JsonBuilder *builder) {
                 break;
             }
             case JSON_OBJECT: {
-                char *nestedJson = jsonStringify(node.object);
+                char *nestedJson = stringifyObject(node.object);
                 snprintf(buffer, sizeof(buffer), "\"%s\": %s", node.key, nestedJson);
                 free(nestedJson);
                 break;
@@ -326,6 +328,15 @@ char *jsonStringify(JsonBuilder *builder) {
     return json;
 }
 
+char *jsonStringify(JsonBuilder *builder) {
+    // one span for the whole document, not one per nested object
+    int span = traceBegin(TRACE_JSON_STRINGIFY);
+    char *json = stringifyObject(builder);
+    traceEnd(span);
+
+    return json;
+}
+
 static char *skipWhitespace(char *str) {
     while (*str && (*str == ' ' || *str == '\t' || *str == '\n' || *str == '\r')) {
         str++;
@@ -372,7 +383,10 @@ static int parseJsonNumber(char **str) {
     }
     
     while (*start >= '0' && *start <= '9') {
-        result = result * 10 + (*start - '0');
+        int digit = *start - '0';
+
+        // numbers past an int are held at INT_MAX rather than overflowing
+        result = result <= (INT_MAX - digit) / 10 ? result * 10 + digit : INT_MAX;
         start++;
     }
     
@@ -520,7 +534,10 @@ JsonBuilder *jsonParse(char *jsonString) {
     
     if (*str != '{') return NULL;
     
+    int span = traceBegin(TRACE_JSON_PARSE);
     JsonBuilder *builder = parseJsonObject(&str);
+    traceEnd(span);
+
     return builder;
 }
 
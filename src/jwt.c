@@ -0,0 +1,366 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/jwt.h"
+#include "include/auth.h"
+#include "include/base64.h"
+#include "include/crypto.h"
+#include "include/app.h"
+
+static uint64_t hashToken(const char *token) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char *)token; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static void initJwtCache(JwtCache *cache, int capacity) {
+    cache->capacity = capacity > 0 ? capacity : JWT_CACHE_CAPACITY;
+    cache->count = 0;
+    cache->head = NULL;
+    cache->tail = NULL;
+
+    // power of two so the bucket index is a mask
+    cache->bucketCount = 16;
+    while (cache->bucketCount < (size_t)cache->capacity) {
+        cache->bucketCount *= 2;
+    }
+
+    cache->buckets = calloc(cache->bucketCount, sizeof(JwtCacheEntry *));
+    if (!cache->buckets) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_init(&cache->lock, NULL);
+}
+
+static void unlinkEntry(JwtCache *cache, JwtCacheEntry *entry) {
+    if (entry->prev) entry->prev->next = entry->next;
+    else cache->head = entry->next;
+
+    if (entry->next) entry->next->prev = entry->prev;
+    else cache->tail = entry->prev;
+
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+static void pushFront(JwtCache *cache, JwtCacheEntry *entry) {
+    entry->prev = NULL;
+    entry->next = cache->head;
+
+    if (cache->head) cache->head->prev = entry;
+    cache->head = entry;
+
+    if (!cache->tail) cache->tail = entry;
+}
+
+static void removeEntry(JwtCache *cache, JwtCacheEntry *entry) {
+    JwtCacheEntry **slot = &cache->buckets[entry->hash & (cache->bucketCount - 1)];
+    while (*slot && *slot != entry) {
+        slot = &(*slot)->bucketNext;
+    }
+    if (*slot) *slot = entry->bucketNext;
+
+    unlinkEntry(cache, entry);
+    cache->count--;
+
+    free(entry->token);
+    free(entry->payload);
+    free(entry);
+}
+
+// returns a copy of the cached payload, or NULL on a miss or an expired entry
+static char *cacheLookup(JwtCache *cache, const char *token, uint64_t hash, time_t now) {
+    char *payload = NULL;
+
+    pthread_mutex_lock(&cache->lock);
+
+    JwtCacheEntry *entry = cache->buckets[hash & (cache->bucketCount - 1)];
+    while (entry && !(entry->hash == hash && strcmp(entry->token, token) == 0)) {
+        entry = entry->bucketNext;
+    }
+
+    if (entry) {
+        if (entry->expiresAt != 0 && now >= entry->expiresAt) {
+            removeEntry(cache, entry);
+        } else {
+            unlinkEntry(cache, entry);
+            pushFront(cache, entry);
+            payload = strdup(entry->payload);
+        }
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return payload;
+}
+
+static void cacheInsert(JwtCache *cache, const char *token, uint64_t hash, const char *payload, time_t expiresAt) {
+    JwtCacheEntry *entry = malloc(sizeof(JwtCacheEntry));
+    if (!entry) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *entry = (JwtCacheEntry) {
+        .hash = hash,
+        .token = strdup(token),
+        .payload = strdup(payload),
+        .expiresAt = expiresAt,
+    };
+
+    pthread_mutex_lock(&cache->lock);
+
+    if (cache->count >= cache->capacity && cache->tail) {
+        removeEntry(cache, cache->tail);
+    }
+
+    JwtCacheEntry **bucket = &cache->buckets[hash & (cache->bucketCount - 1)];
+    entry->bucketNext = *bucket;
+    *bucket = entry;
+
+    pushFront(cache, entry);
+    cache->count++;
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+static void freeJwtCache(JwtCache *cache) {
+    while (cache->head) {
+        removeEntry(cache, cache->head);
+    }
+
+    free(cache->buckets);
+    pthread_mutex_destroy(&cache->lock);
+}
+
+JwtAuthenticator *initJwtAuth(const char *const secret, int cacheCapacity) {
+    JwtAuthenticator *auth = malloc(sizeof(JwtAuthenticator));
+    if (!auth) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    auth->secretLength = strlen(secret);
+    auth->secret = malloc(auth->secretLength + 1);
+    if (!auth->secret) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(auth->secret, secret, auth->secretLength + 1);
+
+    initJwtCache(&auth->cache, cacheCapacity);
+
+    return auth;
+}
+
+void freeJwtAuth(JwtAuthenticator *auth) {
+    if (!auth) return;
+
+    freeJwtCache(&auth->cache);
+    free(auth->secret);
+    free(auth);
+}
+
+static char *signingInput(JwtAuthenticator *auth, const char *input, size_t length) {
+    unsigned char mac[SHA256_DIGEST_SIZE];
+    hmacSha256(auth->secret, auth->secretLength, input, length, mac);
+
+    return base64UrlEncode(mac, sizeof(mac));
+}
+
+static JsonBuilder *decodeSegment(const char *segment, size_t length, char **json) {
+    size_t decodedLength = 0;
+    unsigned char *decoded = base64UrlDecode(segment, length, &decodedLength);
+    if (!decoded) return NULL;
+
+    JsonBuilder *builder = jsonParse((char *)decoded);
+    if (!builder) {
+        free(decoded);
+        return NULL;
+    }
+
+    if (json) {
+        *json = (char *)decoded;
+    } else {
+        free(decoded);
+    }
+
+    return builder;
+}
+
+// the end of year 9999, later NumericDates are not dates anyone issues
+#define MAX_NUMERIC_DATE 253402300799.0
+
+static const char *skipJsonString(const char *p) {
+    for (p++; *p && *p != '"'; p++) {
+        if (*p == '\\' && p[1]) p++;
+    }
+
+    return *p ? p + 1 : p;
+}
+
+// Reads a top-level NumericDate claim from the decoded payload. The JSON library keeps numbers in
+// an int, which ends in 2038, so exp and nbf are parsed here as doubles. A missing claim leaves
+// present false; false is returned for one that is not a number, or is outside 0 to MAX_NUMERIC_DATE.
+static bool readTimeClaim(const char *payload, const char *key, bool *present, time_t *value) {
+    size_t keyLength = strlen(key);
+    int depth = 0;
+
+    *present = false;
+
+    for (const char *p = payload; *p; ) {
+        if (*p == '{' || *p == '[') depth++;
+        if (*p == '}' || *p == ']') depth--;
+        if (*p != '"') {
+            p++;
+            continue;
+        }
+
+        const char *name = p + 1;
+        p = skipJsonString(p);
+
+        const char *colon = p;
+        while (*colon == ' ' || *colon == '\t' || *colon == '\r' || *colon == '\n') colon++;
+
+        // a value or a nested key rather than one of the payload's own
+        if (depth != 1 || *colon != ':') continue;
+        if ((size_t)(p - 1 - name) != keyLength || strncmp(name, key, keyLength) != 0) continue;
+
+        *present = true;
+
+        const char *number = colon + 1;
+        while (*number == ' ' || *number == '\t' || *number == '\r' || *number == '\n') number++;
+        // strtod would also take inf and nan, which are not JSON numbers
+        if (*number != '-' && !isdigit((unsigned char)*number)) return false;
+
+        char *end = NULL;
+        double seconds = strtod(number, &end);
+        if (end == number) return false;
+
+        if (!(seconds >= 0 && seconds <= MAX_NUMERIC_DATE)) return false;
+
+        *value = (time_t)seconds;
+        return true;
+    }
+
+    return true;
+}
+
+JsonBuilder *verifyJwt(JwtAuthenticator *auth, const char *const token, time_t now) {
+    if (!auth || !token) return NULL;
+
+    uint64_t hash = hashToken(token);
+
+    char *cached = cacheLookup(&auth->cache, token, hash, now);
+    if (cached) {
+        JsonBuilder *claims = jsonParse(cached);
+        free(cached);
+        return claims;
+    }
+
+    const char *headerEnd = strchr(token, '.');
+    if (!headerEnd) return NULL;
+
+    const char *payloadEnd = strchr(headerEnd + 1, '.');
+    if (!payloadEnd || strchr(payloadEnd + 1, '.')) return NULL;
+
+    // reject anything other than HS256 before spending time on the signature, this also rules out "alg": "none"
+    JsonBuilder *header = decodeSegment(token, headerEnd - token, NULL);
+    if (!header) return NULL;
+
+    char *alg = jsonGetString(header, "alg");
+    bool isHs256 = alg && strcmp(alg, "HS256") == 0;
+    freeJsonBuilder(header);
+
+    if (!isHs256) return NULL;
+
+    char *expected = signingInput(auth, token, payloadEnd - token);
+    bool validSignature = consttimeStrcmp(expected, payloadEnd + 1);
+    free(expected);
+
+    if (!validSignature) return NULL;
+
+    char *payload = NULL;
+    JsonBuilder *claims = decodeSegment(headerEnd + 1, payloadEnd - headerEnd - 1, &payload);
+    if (!claims) return NULL;
+
+    bool hasExpiry = false, hasNotBefore = false;
+    time_t expiresAt = 0, notBefore = 0;
+
+    bool valid = readTimeClaim(payload, "exp", &hasExpiry, &expiresAt)
+        && readTimeClaim(payload, "nbf", &hasNotBefore, &notBefore)
+        && !(hasExpiry && now >= expiresAt)
+        && !(hasNotBefore && now < notBefore);
+
+    if (!valid) {
+        free(payload);
+        freeJsonBuilder(claims);
+        return NULL;
+    }
+
+    cacheInsert(&auth->cache, token, hash, payload, expiresAt);
+    free(payload);
+
+    return claims;
+}
+
+char *signJwt(JwtAuthenticator *auth, JsonBuilder *claims) {
+    static const char header[] = "{\"alg\":\"HS256\",\"typ\":\"JWT\"}";
+
+    char *encodedHeader = base64UrlEncode((const unsigned char *)header, strlen(header));
+
+    char *payload = jsonStringify(claims);
+    char *encodedPayload = base64UrlEncode((const unsigned char *)payload, strlen(payload));
+    free(payload);
+
+    size_t headerLength = strlen(encodedHeader);
+    size_t payloadLength = strlen(encodedPayload);
+
+    // header.payload.signature where the signature is at most 43 characters
+    char *token = malloc(headerLength + payloadLength + 48);
+    if (!token) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(token, encodedHeader, headerLength);
+    token[headerLength] = '.';
+    memcpy(token + headerLength + 1, encodedPayload, payloadLength);
+
+    size_t inputLength = headerLength + 1 + payloadLength;
+    char *signature = signingInput(auth, token, inputLength);
+
+    token[inputLength] = '.';
+    strcpy(token + inputLength + 1, signature);
+
+    free(signature);
+    free(encodedHeader);
+    free(encodedPayload);
+
+    return token;
+}
+
+HttpResponse jwtAuth(RequestContext ctx, MiddlewareHandler *n) {
+    const char *authHeader = findHeader(&ctx.request, "Authorization");
+    if (!authHeader || strncmp(authHeader, "Bearer ", 7) != 0) {
+        return unauthorized("Unauthorized", TEXT_PLAIN);
+    }
+
+    ctx.claims = verifyJwt(ctx.app->jwtAuth, authHeader + 7, time(NULL));
+    if (!ctx.claims) {
+        return unauthorized("Unauthorized", TEXT_PLAIN);
+    }
+
+    HttpResponse response = next(ctx, n);
+    freeJsonBuilder(ctx.claims);
+
+    return response;
+}
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #include "include/lavandula.h"
 
@@ -41,6 +42,32 @@ void usePort(AppBuilder *builder, int port) {
     builder->app.server.port = port;
 }
 
+void useBindAddress(AppBuilder *builder, const char *address) {
+    free(builder->app.server.bindAddress);
+
+    builder->app.server.bindAddress = strdup(address);
+    if (!builder->app.server.bindAddress) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void useUnixSocket(AppBuilder *builder, const char *path, mode_t mode) {
+    char address[sizeof(UNIX_ADDRESS_PREFIX) + PATH_MAX];
+    snprintf(address, sizeof(address), "%s%s", UNIX_ADDRESS_PREFIX, path);
+
+    useBindAddress(builder, address);
+    builder->app.server.unixSocketMode = mode ? mode : UNIX_SOCKET_MODE;
+}
+
+void useShutdownTimeout(AppBuilder *builder, int milliseconds) {
+    builder->app.server.shutdownTimeoutMillis = milliseconds;
+}
+
+void useServerLimits(AppBuilder *builder, ServerLimits limits) {
+    builder->app.server.limits = limits;
+}
+
 void useGlobalMiddleware(AppBuilder *builder, MiddlewareFunc middleware) {
     if (builder->app.middleware.count >= builder->app.middleware.capacity) {
         builder->app.middleware.capacity *= 2;
@@ -58,6 +85,82 @@ void useVerboseLogging(AppBuilder *builder) {
     builder->app.verboseLogging = true;
 }
 
+void useStaticFiles(AppBuilder *builder, const char *prefix, const char *directory) {
+    if (!builder->app.staticFiles) {
+        builder->app.staticFiles = initStaticFiles();
+    }
+
+    addStaticMount(builder->app.staticFiles, prefix, directory);
+}
+
+void useCompression(AppBuilder *builder, size_t minSize) {
+    freeCompressor(builder->app.compressor);
+    builder->app.compressor = initCompressor(minSize);
+}
+
+void useResponseCache(AppBuilder *builder, int defaultTtl, size_t maxBytes) {
+    freeResponseCache(builder->app.responseCache);
+    builder->app.responseCache = initResponseCache(defaultTtl, maxBytes);
+
+    useGlobalMiddleware(builder, responseCache);
+}
+
+void cacheRoute(App *app, Route *route, int ttlSeconds) {
+    if (!app->responseCache) {
+        fprintf(stderr, "cacheRoute: call useResponseCache before caching %s\n", route->path);
+        return;
+    }
+
+    setCacheTtl(app->responseCache, route->method, route->path, ttlSeconds);
+}
+
+void invalidateCachedPath(App *app, const char *path) {
+    if (!app->responseCache) return;
+
+    responseCacheInvalidate(app->responseCache, path);
+}
+
+void useMetrics(AppBuilder *builder) {
+    if (builder->app.metrics) return;
+
+    builder->app.metrics = initMetrics();
+    route(&builder->app.server.router, HTTP_GET, "/metrics", metricsController);
+}
+
+void useAccessLog(AppBuilder *builder, const char *path) {
+    freeAccessLog(builder->app.accessLog);
+    builder->app.accessLog = initAccessLog(path, ACCESS_LOG_MAX_BYTES);
+}
+
+void useTracing(AppBuilder *builder, uint64_t slowThresholdMicros) {
+    if (builder->app.tracer) {
+        builder->app.tracer->slowThresholdNanos = slowThresholdMicros * 1000;
+        return;
+    }
+
+    builder->app.tracer = initTracer(slowThresholdMicros);
+}
+
+Route useTraceEndpoint(AppBuilder *builder, char *path) {
+    if (!builder->app.tracer) {
+        builder->app.tracer = initTracer(0);
+    }
+
+    return route(&builder->app.server.router, HTTP_GET, path, traceController);
+}
+
+void useServerSentEvents(AppBuilder *builder) {
+    if (builder->app.events) return;
+
+    builder->app.events = initEventHub();
+}
+
+void useJobQueue(AppBuilder *builder, int workers, size_t capacity) {
+    if (builder->app.jobs) return;
+
+    builder->app.jobs = initJobQueue(workers, capacity);
+}
+
 void useCorsPolicy(AppBuilder *builder, CorsConfig corsPolicy) {
     builder->app.corsPolicy = corsPolicy;
 }
@@ -95,6 +198,13 @@ void useBasicAuth(AppBuilder *builder) {
     useGlobalMiddleware(builder, basicAuth);
 }
 
+void useJwtAuth(AppBuilder *builder, const char *secret) {
+    freeJwtAuth(builder->app.jwtAuth);
+    builder->app.jwtAuth = initJwtAuth(secret, JWT_CACHE_CAPACITY);
+
+    useGlobalMiddleware(builder, jwtAuth);
+}
+
 bool isDevelopment(AppBuilder *builder) {
     char *env = builder->app.environment;
     if (!env) return false;
@@ -133,6 +243,15 @@ void useDotenv(char *path) {
 }
 
 App build(AppBuilder builder) {
+    // render the CORS headers once rather than on every request
+    builder.app.cors = compileCorsPolicy(&builder.app.corsPolicy);
+
+    // staticFile shares the mounts' cache. Created here rather than on first use, controllers on
+    // blocking workers may be the first to need it at the same time
+    if (!builder.app.staticFiles) {
+        builder.app.staticFiles = initStaticFiles();
+    }
+
     return builder.app;
 }
 
@@ -143,14 +262,49 @@ void runApp(App *app) {
 
 void cleanupApp(App *app) {
     if (!app) return;
+
+    // first, the jobs still queued may use anything below
+    freeJobQueue(app->jobs);
+    app->jobs = NULL;
     
     freeServer(&app->server);
     dotenvClean();
     free(app->middleware.handlers);
+    app->middleware.handlers = NULL;
+
+    freeJwtAuth(app->jwtAuth);
+    app->jwtAuth = NULL;
+
+    freeStaticFiles(app->staticFiles);
+    app->staticFiles = NULL;
+
+    freeCompressor(app->compressor);
+    app->compressor = NULL;
+
+    freeResponseCache(app->responseCache);
+    app->responseCache = NULL;
+
+    freeMetrics(app->metrics);
+    app->metrics = NULL;
+
+    freeAccessLog(app->accessLog);
+    app->accessLog = NULL;
+
+    freeTracer(app->tracer);
+    app->tracer = NULL;
+
+    freeEventHub(app->events);
+    app->events = NULL;
+
+    freeCorsHeaders(app->cors);
+    app->cors = NULL;
+    freeCorsPolicy(app->corsPolicy);
+    app->corsPolicy = (CorsConfig){0};
 
-    if (!app->dbContext) return;
-    if (app->dbContext->type == SQLITE) {
-        free((char *)app->dbContext->connection);
+    if (app->dbContext) {
+        dbClose(app->dbContext);
+        free(app->dbContext);
+        app->dbContext = NULL;
     }
 }
 
@@ -0,0 +1,401 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/metrics.h"
+#include "include/app.h"
+
+static uint64_t nextGeneration = 1;
+
+static __thread MetricsShard *localShard = NULL;
+static __thread uint64_t localGeneration = 0;
+
+// a single writer per counter, so a relaxed load and store is enough and avoids a locked add
+static inline void counterAdd(uint64_t *counter, uint64_t value) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t counterRead(const uint64_t *counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+Metrics *initMetrics(void) {
+    Metrics *metrics = calloc(1, sizeof(Metrics));
+    if (!metrics) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    metrics->generation = __atomic_fetch_add(&nextGeneration, 1, __ATOMIC_RELAXED);
+    pthread_mutex_init(&metrics->lock, NULL);
+
+    return metrics;
+}
+
+void freeMetrics(Metrics *metrics) {
+    if (!metrics) return;
+
+    MetricsShard *shard = metrics->shards;
+    while (shard) {
+        MetricsShard *nextShard = shard->next;
+
+        for (int i = 0; i < METRICS_MAX_SERIES; i++) {
+            if (shard->series[i]) {
+                free(shard->series[i]->route);
+                free(shard->series[i]);
+            }
+        }
+        free(shard);
+
+        shard = nextShard;
+    }
+
+    pthread_mutex_destroy(&metrics->lock);
+    free(metrics);
+}
+
+static MetricsShard *threadShard(Metrics *metrics) {
+    if (localShard && localGeneration == metrics->generation) {
+        return localShard;
+    }
+
+    MetricsShard *shard = calloc(1, sizeof(MetricsShard));
+    if (!shard) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_lock(&metrics->lock);
+    shard->next = metrics->shards;
+    metrics->shards = shard;
+    pthread_mutex_unlock(&metrics->lock);
+
+    localShard = shard;
+    localGeneration = metrics->generation;
+
+    return shard;
+}
+
+int metricsBucketIndex(uint64_t micros) {
+    if (micros < METRICS_SUB_BUCKETS) return (int)micros;
+
+    int exponent = 63 - __builtin_clzll(micros);
+    if (exponent > METRICS_MAX_EXPONENT) return METRICS_BUCKETS - 1;
+
+    int subBucket = (micros >> (exponent - METRICS_SUB_BUCKET_BITS)) & (METRICS_SUB_BUCKETS - 1);
+
+    return (exponent - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS + subBucket;
+}
+
+uint64_t metricsBucketUpperBound(int index) {
+    if (index < METRICS_SUB_BUCKETS) return (uint64_t)index;
+
+    int exponent = index / METRICS_SUB_BUCKETS + METRICS_SUB_BUCKET_BITS - 1;
+    int subBucket = index % METRICS_SUB_BUCKETS;
+    int shift = exponent - METRICS_SUB_BUCKET_BITS;
+
+    uint64_t lower = (uint64_t)(METRICS_SUB_BUCKETS + subBucket) << shift;
+
+    return lower + ((uint64_t)1 << shift) - 1;
+}
+
+uint64_t metricsQuantile(const uint64_t *buckets, uint64_t count, double q) {
+    if (count == 0) return 0;
+
+    uint64_t target = (uint64_t)(q * count + 0.5);
+    if (target < 1) target = 1;
+    if (target > count) target = count;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            return metricsBucketUpperBound(i);
+        }
+    }
+
+    return metricsBucketUpperBound(METRICS_BUCKETS - 1);
+}
+
+static uint64_t hashSeries(const char *route, HttpMethod method, int status) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char *)route; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+
+    hash ^= (uint64_t)method << 16 | (uint64_t)status;
+    hash *= 1099511628211ULL;
+
+    return hash;
+}
+
+void recordRequest(Metrics *metrics, const char *route, HttpMethod method, int status, uint64_t micros) {
+    if (!metrics) return;
+
+    MetricsShard *shard = threadShard(metrics);
+    uint64_t hash = hashSeries(route, method, status);
+
+    MetricsSeries *series = NULL;
+    for (int probe = 0; probe < METRICS_MAX_SERIES; probe++) {
+        MetricsSeries **slot = &shard->series[(hash + probe) & (METRICS_MAX_SERIES - 1)];
+
+        if (!*slot) {
+            series = calloc(1, sizeof(MetricsSeries));
+            if (!series) {
+                fprintf(stderr, "Fatal: out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+
+            series->route = strdup(route);
+            series->method = method;
+            series->status = status;
+            series->hash = hash;
+
+            // the labels must be visible before the scraper can find the slot
+            __atomic_store_n(slot, series, __ATOMIC_RELEASE);
+            break;
+        }
+
+        if ((*slot)->hash == hash && (*slot)->method == method && (*slot)->status == status && strcmp((*slot)->route, route) == 0) {
+            series = *slot;
+            break;
+        }
+    }
+
+    if (!series) {
+        counterAdd(&shard->dropped, 1);
+        return;
+    }
+
+    counterAdd(&series->count, 1);
+    counterAdd(&series->sumMicros, micros);
+    counterAdd(&series->buckets[metricsBucketIndex(micros)], 1);
+}
+
+typedef struct {
+    char  *data;
+    size_t length;
+    size_t capacity;
+} TextBuffer;
+
+static void appendf(TextBuffer *buffer, const char *format, ...) {
+    for (;;) {
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(buffer->data + buffer->length, buffer->capacity - buffer->length, format, args);
+        va_end(args);
+
+        if (written < 0) return;
+
+        if ((size_t)written < buffer->capacity - buffer->length) {
+            buffer->length += written;
+            return;
+        }
+
+        buffer->capacity = buffer->capacity * 2 + written;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+        if (!buffer->data) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// label values may not contain raw quotes, backslashes or newlines
+static void appendLabels(TextBuffer *buffer, const MetricsSeries *series) {
+    appendf(buffer, "route=\"");
+    for (const char *p = series->route; *p; p++) {
+        if (*p == '"' || *p == '\\') appendf(buffer, "\\%c", *p);
+        else if (*p == '\n') appendf(buffer, "\\n");
+        else appendf(buffer, "%c", *p);
+    }
+    appendf(buffer, "\",method=\"%s\",status=\"%d\"", httpMethodToStr(series->method), series->status);
+}
+
+// sums every thread's series with the same labels
+static MetricsSeries *aggregate(Metrics *metrics, int *count, uint64_t *dropped) {
+    MetricsSeries *merged = NULL;
+    int mergedCount = 0;
+    int mergedCapacity = 0;
+
+    *dropped = 0;
+
+    pthread_mutex_lock(&metrics->lock);
+    MetricsShard *shards = metrics->shards;
+    pthread_mutex_unlock(&metrics->lock);
+
+    for (MetricsShard *shard = shards; shard; shard = shard->next) {
+        *dropped += counterRead(&shard->dropped);
+
+        for (int i = 0; i < METRICS_MAX_SERIES; i++) {
+            MetricsSeries *series = __atomic_load_n(&shard->series[i], __ATOMIC_ACQUIRE);
+            if (!series) continue;
+
+            MetricsSeries *target = NULL;
+            for (int j = 0; j < mergedCount; j++) {
+                if (merged[j].hash == series->hash && merged[j].method == series->method &&
+                    merged[j].status == series->status && strcmp(merged[j].route, series->route) == 0) {
+                    target = &merged[j];
+                    break;
+                }
+            }
+
+            if (!target) {
+                if (mergedCount >= mergedCapacity) {
+                    mergedCapacity = mergedCapacity ? mergedCapacity * 2 : 16;
+                    merged = realloc(merged, sizeof(MetricsSeries) * mergedCapacity);
+                    if (!merged) {
+                        fprintf(stderr, "Fatal: out of memory\n");
+                        exit(EXIT_FAILURE);
+                    }
+                }
+
+                target = &merged[mergedCount++];
+                memset(target, 0, sizeof(MetricsSeries));
+                target->route = series->route;
+                target->method = series->method;
+                target->status = series->status;
+                target->hash = series->hash;
+            }
+
+            target->count += counterRead(&series->count);
+            target->sumMicros += counterRead(&series->sumMicros);
+            for (int b = 0; b < METRICS_BUCKETS; b++) {
+                target->buckets[b] += counterRead(&series->buckets[b]);
+            }
+        }
+    }
+
+    *count = mergedCount;
+    return merged;
+}
+
+char *renderMetrics(Metrics *metrics) {
+    static const double bounds[] = { 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 };
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+    TextBuffer buffer = { .data = malloc(4096), .capacity = 4096 };
+    if (!buffer.data) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    buffer.data[0] = '\0';
+
+    int count = 0;
+    uint64_t dropped = 0;
+    MetricsSeries *series = metrics ? aggregate(metrics, &count, &dropped) : NULL;
+
+    appendf(&buffer, "# HELP lavandula_http_requests_total Requests handled, by route, method and status.\n");
+    appendf(&buffer, "# TYPE lavandula_http_requests_total counter\n");
+    for (int i = 0; i < count; i++) {
+        appendf(&buffer, "lavandula_http_requests_total{");
+        appendLabels(&buffer, &series[i]);
+        appendf(&buffer, "} %llu\n", (unsigned long long)series[i].count);
+    }
+
+    appendf(&buffer, "# HELP lavandula_http_request_duration_seconds Time spent producing the response.\n");
+    appendf(&buffer, "# TYPE lavandula_http_request_duration_seconds histogram\n");
+    for (int i = 0; i < count; i++) {
+        uint64_t cumulative = 0;
+        int bucket = 0;
+
+        for (size_t b = 0; b < sizeof(bounds) / sizeof(bounds[0]); b++) {
+            uint64_t limit = (uint64_t)(bounds[b] * 1e6);
+            while (bucket < METRICS_BUCKETS && metricsBucketUpperBound(bucket) <= limit) {
+                cumulative += series[i].buckets[bucket++];
+            }
+
+            appendf(&buffer, "lavandula_http_request_duration_seconds_bucket{");
+            appendLabels(&buffer, &series[i]);
+            appendf(&buffer, ",le=\"%g\"} %llu\n", bounds[b], (unsigned long long)cumulative);
+        }
+
+        appendf(&buffer, "lavandula_http_request_duration_seconds_bucket{");
+        appendLabels(&buffer, &series[i]);
+        appendf(&buffer, ",le=\"+Inf\"} %llu\n", (unsigned long long)series[i].count);
+
+        appendf(&buffer, "lavandula_http_request_duration_seconds_sum{");
+        appendLabels(&buffer, &series[i]);
+        appendf(&buffer, "} %.6f\n", series[i].sumMicros / 1e6);
+
+        appendf(&buffer, "lavandula_http_request_duration_seconds_count{");
+        appendLabels(&buffer, &series[i]);
+        appendf(&buffer, "} %llu\n", (unsigned long long)series[i].count);
+    }
+
+    appendf(&buffer, "# HELP lavandula_http_request_latency_seconds Latency quantiles, within 12.5%% of the true value.\n");
+    appendf(&buffer, "# TYPE lavandula_http_request_latency_seconds summary\n");
+    for (int i = 0; i < count; i++) {
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+            uint64_t micros = metricsQuantile(series[i].buckets, series[i].count, quantiles[q]);
+
+            appendf(&buffer, "lavandula_http_request_latency_seconds{");
+            appendLabels(&buffer, &series[i]);
+            appendf(&buffer, ",quantile=\"%g\"} %.6f\n", quantiles[q], micros / 1e6);
+        }
+
+        appendf(&buffer, "lavandula_http_request_latency_seconds_sum{");
+        appendLabels(&buffer, &series[i]);
+        appendf(&buffer, "} %.6f\n", series[i].sumMicros / 1e6);
+
+        appendf(&buffer, "lavandula_http_request_latency_seconds_count{");
+        appendLabels(&buffer, &series[i]);
+        appendf(&buffer, "} %llu\n", (unsigned long long)series[i].count);
+    }
+
+    appendf(&buffer, "# HELP lavandula_metrics_dropped_total Requests not recorded because a thread ran out of series.\n");
+    appendf(&buffer, "# TYPE lavandula_metrics_dropped_total counter\n");
+    appendf(&buffer, "lavandula_metrics_dropped_total %llu\n", (unsigned long long)dropped);
+
+    free(series);
+
+    return buffer.data;
+}
+
+// the background job queue's depth and throughput, after the request metrics
+static char *appendJobMetrics(char *text, JobQueue *jobs) {
+    size_t length = strlen(text);
+    TextBuffer buffer = { .data = text, .length = length, .capacity = length + 1 };
+
+    appendf(&buffer, "# HELP lavandula_jobs_queued Jobs waiting for a worker.\n");
+    appendf(&buffer, "# TYPE lavandula_jobs_queued gauge\n");
+    appendf(&buffer, "lavandula_jobs_queued %zu\n", __atomic_load_n(&jobs->queued, __ATOMIC_RELAXED));
+
+    appendf(&buffer, "# HELP lavandula_jobs_running Jobs being run.\n");
+    appendf(&buffer, "# TYPE lavandula_jobs_running gauge\n");
+    appendf(&buffer, "lavandula_jobs_running %zu\n", __atomic_load_n(&jobs->running, __ATOMIC_RELAXED));
+
+    appendf(&buffer, "# HELP lavandula_jobs_completed_total Jobs run to completion.\n");
+    appendf(&buffer, "# TYPE lavandula_jobs_completed_total counter\n");
+    appendf(&buffer, "lavandula_jobs_completed_total %llu\n",
+        (unsigned long long)__atomic_load_n(&jobs->completed, __ATOMIC_RELAXED));
+
+    appendf(&buffer, "# HELP lavandula_jobs_rejected_total Jobs not queued because the queue was full.\n");
+    appendf(&buffer, "# TYPE lavandula_jobs_rejected_total counter\n");
+    appendf(&buffer, "lavandula_jobs_rejected_total %llu\n",
+        (unsigned long long)__atomic_load_n(&jobs->rejected, __ATOMIC_RELAXED));
+
+    appendf(&buffer, "# HELP lavandula_jobs_skipped_total Scheduled runs skipped because the previous run had not finished.\n");
+    appendf(&buffer, "# TYPE lavandula_jobs_skipped_total counter\n");
+    appendf(&buffer, "lavandula_jobs_skipped_total %llu\n",
+        (unsigned long long)__atomic_load_n(&jobs->skipped, __ATOMIC_RELAXED));
+
+    return buffer.data;
+}
+
+HttpResponse metricsController(RequestContext ctx) {
+    char *text = renderMetrics(ctx.app->metrics);
+    if (ctx.app->jobs) {
+        text = appendJobMetrics(text, ctx.app->jobs);
+    }
+
+    HttpResponse response = ok(text, "text/plain; version=0.0.4; charset=utf-8");
+    response.ownsContent = true;
+
+    // a scrape must always see fresh numbers
+    addResponseHeader(&response, "Cache-Control", "no-store");
+
+    return response;
+}
@@ -1,8 +1,14 @@
+#include <assert.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "include/middleware.h"
+#include "include/tracing.h"
+#include "include/coroutine.h"
+
+static __thread bool blockingWorker = false;
 
 HttpResponse next(RequestContext context, MiddlewareHandler *middleware) {
     while (middleware->current < middleware->count) {
@@ -17,7 +23,11 @@ HttpResponse next(RequestContext context, MiddlewareHandler *middleware) {
     }
     
     if (middleware->finalHandler) {
-        return middleware->finalHandler(context);
+        int span = traceBegin(TRACE_CONTROLLER);
+        HttpResponse response = middleware->finalHandler(context);
+        traceEnd(span);
+
+        return response;
     }
     
     HttpResponse notFoundResponse = {
@@ -28,6 +38,183 @@ HttpResponse next(RequestContext context, MiddlewareHandler *middleware) {
     return notFoundResponse;
 }
 
+void initSingleFlight(SingleFlight *group) {
+    memset(group->buckets, 0, sizeof(group->buckets));
+    pthread_mutex_init(&group->lock, NULL);
+}
+
+void freeSingleFlight(SingleFlight *group) {
+    pthread_mutex_destroy(&group->lock);
+}
+
+void markBlockingWorker(void) {
+    blockingWorker = true;
+}
+
+static uint64_t hashKey(const char *key) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+// deep copy into one allocation (body, NUL, content type, NUL) so the copy outlives the original
+static HttpResponse copyResponse(const HttpResponse *response) {
+    size_t bodyLength = response->contentLength ? response->contentLength : strlen(response->content);
+    const char *contentType = response->contentType ? response->contentType : "";
+    size_t typeLength = strlen(contentType);
+
+    char *block = malloc(bodyLength + typeLength + 2);
+    if (!block) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(block, response->content, bodyLength);
+    block[bodyLength] = '\0';
+    memcpy(block + bodyLength + 1, contentType, typeLength + 1);
+
+    return (HttpResponse) {
+        .content = block,
+        .status = response->status,
+        .contentType = block + bodyLength + 1,
+        .headers = response->headers ? strdup(response->headers) : NULL,
+        .contentLength = bodyLength,
+        .ownsContent = true,
+    };
+}
+
+static void destroyFlight(Flight *flight) {
+    if (flight->shareable) {
+        free(flight->response.content);
+        free(flight->response.headers);
+    }
+
+    pthread_cond_destroy(&flight->finished);
+    free(flight->key);
+    free(flight);
+}
+
+static void unlinkFlight(SingleFlight *group, Flight *flight) {
+    Flight **slot = &group->buckets[flight->hash & (SINGLE_FLIGHT_BUCKETS - 1)];
+    while (*slot && *slot != flight) {
+        slot = &(*slot)->bucketNext;
+    }
+    if (*slot) *slot = flight->bucketNext;
+}
+
+HttpResponse nextShared(SingleFlight *group, const char *key, RequestContext context, MiddlewareHandler *middleware, bool *leader) {
+    // Blocking on the event loop would stall every connection. A coroutine waits by suspending, and
+    // only for another coroutine: a worker blocked on a coroutine's flight could be the one that
+    // coroutine needs to finish, and the loop is not woken when a worker's flight is done.
+    Coroutine *coroutine = currentCoroutine();
+    if (!blockingWorker && !coroutine) {
+        if (leader) *leader = true;
+        return next(context, middleware);
+    }
+    assert(!(blockingWorker && coroutine));
+
+    bool onLoop = coroutine != NULL;
+    uint64_t hash = hashKey(key);
+    Flight **bucket = &group->buckets[hash & (SINGLE_FLIGHT_BUCKETS - 1)];
+
+    pthread_mutex_lock(&group->lock);
+
+    Flight *flight = *bucket;
+    while (flight && !(flight->hash == hash && flight->onLoop == onLoop && strcmp(flight->key, key) == 0)) {
+        flight = flight->bucketNext;
+    }
+
+    if (flight) {
+        flight->waiters++;
+
+        if (onLoop) {
+            // the event loop resumes it once the leader is done
+            pthread_mutex_unlock(&group->lock);
+            bool finished = awaitFlight(flight);
+            pthread_mutex_lock(&group->lock);
+
+            // nobody waits for this response any more, the leader cleans up if it is still running
+            if (!finished) {
+                if (--flight->waiters == 0 && flight->done) {
+                    destroyFlight(flight);
+                }
+                pthread_mutex_unlock(&group->lock);
+
+                if (leader) *leader = false;
+                return serviceUnavailable("Service Unavailable", TEXT_PLAIN);
+            }
+            assert(flight->done);
+        } else {
+            while (!flight->done) {
+                pthread_cond_wait(&flight->finished, &group->lock);
+            }
+        }
+
+        bool shareable = flight->shareable;
+        HttpResponse response = shareable ? copyResponse(&flight->response) : (HttpResponse){0};
+
+        // the last waiter out cleans up, the leader has already unlinked the flight
+        if (--flight->waiters == 0) {
+            destroyFlight(flight);
+        }
+
+        pthread_mutex_unlock(&group->lock);
+
+        if (!shareable) {
+            return next(context, middleware);
+        }
+
+        if (leader) *leader = false;
+        return response;
+    }
+
+    flight = calloc(1, sizeof(Flight));
+    if (!flight) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    flight->key = strdup(key);
+    flight->hash = hash;
+    flight->onLoop = onLoop;
+    pthread_cond_init(&flight->finished, NULL);
+
+    flight->bucketNext = *bucket;
+    *bucket = flight;
+
+    pthread_mutex_unlock(&group->lock);
+
+    HttpResponse response = next(context, middleware);
+
+    // a cancelled coroutine's awaits failed along the way, the others run the pipeline themselves
+    bool cancelled = coroutine && coroutineWait(coroutine)->cancelled;
+
+    pthread_mutex_lock(&group->lock);
+
+    // later arrivals start a new flight, by then the caller has usually cached the response
+    unlinkFlight(group, flight);
+    flight->done = true;
+
+    if (flight->waiters == 0) {
+        destroyFlight(flight);
+    } else {
+        flight->shareable = response.content && !response.bodyFile && !cancelled;
+        if (flight->shareable) {
+            flight->response = copyResponse(&response);
+        }
+        pthread_cond_broadcast(&flight->finished);
+    }
+
+    pthread_mutex_unlock(&group->lock);
+
+    if (leader) *leader = true;
+    return response;
+}
+
 void useLocalMiddleware(Route *route, MiddlewareFunc handler) {
     if (route->middleware->count >= route->middleware->capacity) {
         route->middleware->capacity *= 2;
@@ -41,6 +228,14 @@ void useLocalMiddleware(Route *route, MiddlewareFunc handler) {
     route->middleware->handlers[route->middleware->count++] = handler;
 }
 
+void useBlocking(Route *route) {
+    route->middleware->blocking = true;
+}
+
+void useAsync(Route *route) {
+    route->middleware->async = true;
+}
+
 MiddlewareHandler combineMiddleware(MiddlewareHandler *globalMiddleware, MiddlewareHandler *routeMiddleware) {
     int totalCount = globalMiddleware->count + routeMiddleware->count;
     
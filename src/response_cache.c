@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "include/response_cache.h"
+#include "include/app.h"
+
+static uint64_t hashBytes(const char *data, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+// the path of a "METHOD /path?query" key, without the query
+static const char *keyPath(const char *key, size_t *length) {
+    const char *path = strchr(key, ' ');
+    path = path ? path + 1 : key;
+
+    *length = strcspn(path, "?");
+    return path;
+}
+
+static time_t monotonicSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec;
+}
+
+ResponseCache *initResponseCache(int defaultTtl, size_t maxBytes) {
+    ResponseCache *cache = calloc(1, sizeof(ResponseCache));
+    if (!cache) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    cache->defaultTtl = defaultTtl;
+    if (maxBytes == 0) {
+        maxBytes = RESPONSE_CACHE_MAX_BYTES;
+    }
+
+    for (int i = 0; i < RESPONSE_CACHE_SHARDS; i++) {
+        ResponseCacheShard *shard = &cache->shards[i];
+
+        shard->bucketCount = 64;
+        shard->buckets = calloc(shard->bucketCount, sizeof(ResponseCacheEntry *));
+        if (!shard->buckets) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+
+        shard->maxBytes = maxBytes / RESPONSE_CACHE_SHARDS;
+        pthread_mutex_init(&shard->lock, NULL);
+    }
+
+    initSingleFlight(&cache->flights);
+
+    return cache;
+}
+
+static void unlinkEntry(ResponseCacheShard *shard, ResponseCacheEntry *entry) {
+    if (entry->prev) entry->prev->next = entry->next;
+    else shard->head = entry->next;
+
+    if (entry->next) entry->next->prev = entry->prev;
+    else shard->tail = entry->prev;
+
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+static void pushFront(ResponseCacheShard *shard, ResponseCacheEntry *entry) {
+    entry->prev = NULL;
+    entry->next = shard->head;
+
+    if (shard->head) shard->head->prev = entry;
+    shard->head = entry;
+
+    if (!shard->tail) shard->tail = entry;
+}
+
+static void removeEntry(ResponseCacheShard *shard, ResponseCacheEntry *entry) {
+    ResponseCacheEntry **slot = &shard->buckets[(entry->hash >> 4) & (shard->bucketCount - 1)];
+    while (*slot && *slot != entry) {
+        slot = &(*slot)->bucketNext;
+    }
+    if (*slot) *slot = entry->bucketNext;
+
+    unlinkEntry(shard, entry);
+    shard->bytes -= entry->size;
+
+    free(entry->key);
+    free(entry->block);
+    free(entry->headers);
+    free(entry);
+}
+
+void responseCacheClear(ResponseCache *cache) {
+    for (int i = 0; i < RESPONSE_CACHE_SHARDS; i++) {
+        ResponseCacheShard *shard = &cache->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+        while (shard->head) {
+            removeEntry(shard, shard->head);
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+void freeResponseCache(ResponseCache *cache) {
+    if (!cache) return;
+
+    responseCacheClear(cache);
+
+    for (int i = 0; i < RESPONSE_CACHE_SHARDS; i++) {
+        free(cache->shards[i].buckets);
+        pthread_mutex_destroy(&cache->shards[i].lock);
+    }
+
+    for (int i = 0; i < cache->ruleCount; i++) {
+        free(cache->rules[i].path);
+    }
+    free(cache->rules);
+
+    freeSingleFlight(&cache->flights);
+    free(cache);
+}
+
+void setCacheTtl(ResponseCache *cache, HttpMethod method, const char *path, int ttlSeconds) {
+    for (int i = 0; i < cache->ruleCount; i++) {
+        if (cache->rules[i].method == method && strcmp(cache->rules[i].path, path) == 0) {
+            cache->rules[i].ttlSeconds = ttlSeconds;
+            return;
+        }
+    }
+
+    if (cache->ruleCount >= cache->ruleCapacity) {
+        cache->ruleCapacity = cache->ruleCapacity ? cache->ruleCapacity * 2 : 8;
+        cache->rules = realloc(cache->rules, sizeof(ResponseCacheRule) * cache->ruleCapacity);
+
+        if (!cache->rules) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    cache->rules[cache->ruleCount++] = (ResponseCacheRule) {
+        .method = method,
+        .path = strdup(path),
+        .ttlSeconds = ttlSeconds,
+    };
+}
+
+static int ttlFor(ResponseCache *cache, HttpMethod method, const char *path, size_t pathLength) {
+    for (int i = 0; i < cache->ruleCount; i++) {
+        ResponseCacheRule rule = cache->rules[i];
+
+        if (rule.method == method && strlen(rule.path) == pathLength && strncmp(rule.path, path, pathLength) == 0) {
+            return rule.ttlSeconds;
+        }
+    }
+
+    return cache->defaultTtl;
+}
+
+static ResponseCacheShard *shardFor(ResponseCache *cache, uint64_t hash) {
+    return &cache->shards[hash & (RESPONSE_CACHE_SHARDS - 1)];
+}
+
+static ResponseCacheEntry *findEntry(ResponseCacheShard *shard, const char *key, uint64_t hash) {
+    ResponseCacheEntry *entry = shard->buckets[(hash >> 4) & (shard->bucketCount - 1)];
+    while (entry && !(entry->hash == hash && strcmp(entry->key, key) == 0)) {
+        entry = entry->bucketNext;
+    }
+
+    return entry;
+}
+
+bool responseCacheLookup(ResponseCache *cache, const char *key, HttpResponse *response, time_t now) {
+    uint64_t hash = hashBytes(key, strlen(key));
+    ResponseCacheShard *shard = shardFor(cache, hash);
+
+    pthread_mutex_lock(&shard->lock);
+
+    ResponseCacheEntry *entry = findEntry(shard, key, hash);
+    if (!entry) {
+        pthread_mutex_unlock(&shard->lock);
+        return false;
+    }
+
+    if (now >= entry->expiresAt) {
+        removeEntry(shard, entry);
+        pthread_mutex_unlock(&shard->lock);
+        return false;
+    }
+
+    unlinkEntry(shard, entry);
+    pushFront(shard, entry);
+
+    // the copy belongs to the response so the entry can be evicted while it is being written
+    char *block = malloc(entry->blockLength);
+    if (!block) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(block, entry->block, entry->blockLength);
+
+    *response = (HttpResponse) {
+        .content = block,
+        .status = entry->status,
+        .contentType = block + entry->bodyLength + 1,
+        .headers = entry->headers ? strdup(entry->headers) : NULL,
+        .contentLength = entry->bodyLength,
+        .ownsContent = true,
+    };
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return true;
+}
+
+void responseCacheStore(ResponseCache *cache, const char *key, const HttpResponse *response, int ttlSeconds, time_t now) {
+    size_t bodyLength = response->contentLength ? response->contentLength : strlen(response->content);
+    const char *contentType = response->contentType ? response->contentType : "";
+    size_t typeLength = strlen(contentType);
+
+    size_t blockLength = bodyLength + 1 + typeLength + 1;
+    char *block = malloc(blockLength);
+    ResponseCacheEntry *entry = malloc(sizeof(ResponseCacheEntry));
+    if (!block || !entry) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(block, response->content, bodyLength);
+    block[bodyLength] = '\0';
+    memcpy(block + bodyLength + 1, contentType, typeLength + 1);
+
+    size_t pathLength = 0;
+    const char *path = keyPath(key, &pathLength);
+
+    *entry = (ResponseCacheEntry) {
+        .key = strdup(key),
+        .hash = hashBytes(key, strlen(key)),
+        .pathHash = hashBytes(path, pathLength),
+        .status = response->status,
+        .block = block,
+        .bodyLength = bodyLength,
+        .blockLength = blockLength,
+        .headers = response->headers ? strdup(response->headers) : NULL,
+        .expiresAt = now + ttlSeconds,
+    };
+    entry->size = sizeof(ResponseCacheEntry) + strlen(key) + blockLength + (entry->headers ? strlen(entry->headers) : 0);
+
+    ResponseCacheShard *shard = shardFor(cache, entry->hash);
+
+    // a single response larger than the shard would evict everything else and still not fit
+    if (entry->size > shard->maxBytes) {
+        free(entry->key);
+        free(entry->block);
+        free(entry->headers);
+        free(entry);
+        return;
+    }
+
+    pthread_mutex_lock(&shard->lock);
+
+    ResponseCacheEntry *existing = findEntry(shard, key, entry->hash);
+    if (existing) {
+        removeEntry(shard, existing);
+    }
+
+    ResponseCacheEntry **bucket = &shard->buckets[(entry->hash >> 4) & (shard->bucketCount - 1)];
+    entry->bucketNext = *bucket;
+    *bucket = entry;
+
+    pushFront(shard, entry);
+    shard->bytes += entry->size;
+
+    while (shard->bytes > shard->maxBytes && shard->tail != entry) {
+        removeEntry(shard, shard->tail);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+}
+
+void responseCacheInvalidate(ResponseCache *cache, const char *path) {
+    size_t pathLength = strlen(path);
+    uint64_t pathHash = hashBytes(path, pathLength);
+
+    // variants of one path differ by query and so live in any shard
+    for (int i = 0; i < RESPONSE_CACHE_SHARDS; i++) {
+        ResponseCacheShard *shard = &cache->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+
+        ResponseCacheEntry *entry = shard->head;
+        while (entry) {
+            ResponseCacheEntry *nextEntry = entry->next;
+
+            size_t entryPathLength = 0;
+            const char *entryPath = keyPath(entry->key, &entryPathLength);
+
+            if (entry->pathHash == pathHash && entryPathLength == pathLength && strncmp(entryPath, path, pathLength) == 0) {
+                removeEntry(shard, entry);
+            }
+
+            entry = nextEntry;
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+// responses marked as per-user, or streamed from a file, are never shared
+static bool isStorable(const HttpResponse *response) {
+    if (response->status != HTTP_OK || !response->content || response->bodyFile) return false;
+    if (findResponseHeader(response, "Set-Cookie")) return false;
+
+    const char *cacheControl = findResponseHeader(response, "Cache-Control");
+    if (cacheControl) {
+        size_t length = strcspn(cacheControl, "\r");
+        for (size_t i = 0; i < length; i++) {
+            if (strncasecmp(cacheControl + i, "no-store", 8) == 0 || strncasecmp(cacheControl + i, "private", 7) == 0) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+HttpResponse responseCache(RequestContext ctx, MiddlewareHandler *n) {
+    ResponseCache *cache = ctx.app->responseCache;
+    HttpRequest request = ctx.request;
+
+    if (!cache || request.method != HTTP_GET) {
+        return next(ctx, n);
+    }
+
+    // a credentialed request may see data no one else should, so it bypasses the shared cache
+    if (findHeader(&request, "Authorization") || findHeader(&request, "Cookie")) {
+        return next(ctx, n);
+    }
+
+    size_t pathLength = 0;
+    const char *path = keyPath(request.resource, &pathLength);
+
+    int ttl = ttlFor(cache, request.method, path, pathLength);
+    if (ttl <= 0) {
+        return next(ctx, n);
+    }
+
+    const char *method = httpMethodToStr(request.method);
+    size_t keyLength = strlen(method) + 1 + strlen(request.resource) + 1;
+
+    char *key = malloc(keyLength);
+    if (!key) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(key, keyLength, "%s %s", method, request.resource);
+
+    time_t now = monotonicSeconds();
+
+    // a hit skips the remaining middleware and the controller entirely
+    HttpResponse response;
+    if (responseCacheLookup(cache, key, &response, now)) {
+        free(key);
+        return response;
+    }
+
+    // on a cold key only the leader runs the controller, the others wait for its response
+    bool leader = true;
+    response = nextShared(&cache->flights, key, ctx, n, &leader);
+
+    if (leader && isStorable(&response)) {
+        responseCacheStore(cache, key, &response, ttl, now);
+    }
+
+    free(key);
+
+    return response;
+}
@@ -543,6 +543,9 @@ void freeRouter(Router *router) {
     }
 
     free(router->routes);
+    router->routes = NULL;
+    router->routeCount = 0;
+    router->routeCapacity = 0;
 }
 
 Route route(Router *router, HttpMethod method, char *path, Controller controller) {
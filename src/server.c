@@ -8,6 +8,23 @@
 #include <pthread.h>
 #include <termios.h>
 #include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <strings.h>
+#include <stdint.h>
+#include <time.h>
+#include <signal.h>
+#include <limits.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/signalfd.h>
+#endif
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
 
 #include "include/server.h"
 #include "include/http.h"
@@ -15,25 +32,57 @@
 #include "include/request_context.h"
 #include "include/sql.h"
 #include "include/app.h"
+#include "include/environment.h"
+#include "include/bind_address.h"
+#include "include/stream.h"
+#include "include/websocket.h"
+#include "include/jobs.h"
+#include "include/coroutine.h"
+#include "include/io_loop.h"
+#include "include/buffer_pool.h"
+#include "include/utils.h"
 
 typedef enum {
     STATE_RUNNING,
-    STATE_RESTARTING,
+    STATE_RESTARTING, // rebuild with make, then reload into ./build/a
+    STATE_RELOADING,  // reload into the executable already on disk
     STATE_SHUTDOWN
 } ServerState;
 
-volatile ServerState serverState = STATE_RUNNING;
+ServerState serverState = STATE_RUNNING;
 
-#define BUFFER_SIZE 4096
+// a second shutdown signal, the server stops waiting for open connections
+static bool shutdownForced = false;
+
+// the listening socket handed from one process image to the next on reload
+#define LISTEN_FD_ENV "LAVANDULA_LISTEN_FD"
+
+// the terminal settings to put back on shutdown, or before a reload sets them again
+static struct termios savedTerminal;
+static int savedInputFlags;
+static bool terminalChanged = false;
 
 void set_nonblocking_input() {
     struct termios ttystate;
 
-    tcgetattr(STDIN_FILENO, &ttystate);
+    if (tcgetattr(STDIN_FILENO, &ttystate) < 0) return;
+    savedTerminal = ttystate;
+    savedInputFlags = fcntl(STDIN_FILENO, F_GETFL);
+    terminalChanged = true;
+
     ttystate.c_lflag &= ~(ICANON | ECHO);
     tcsetattr(STDIN_FILENO, TCSANOW, &ttystate);
 
-    fcntl(STDIN_FILENO, F_SETFL, O_NONBLOCK);
+    fcntl(STDIN_FILENO, F_SETFL, savedInputFlags | O_NONBLOCK);
+}
+
+// the terminal is shared with the shell, which expects it back the way it was
+static void restore_input() {
+    if (!terminalChanged) return;
+
+    tcsetattr(STDIN_FILENO, TCSANOW, &savedTerminal);
+    fcntl(STDIN_FILENO, F_SETFL, savedInputFlags);
+    terminalChanged = false;
 }
 
 HttpResponse defaultNotFoundController(RequestContext context) {
@@ -56,12 +105,27 @@ Server initServer(int port) {
     Server server;
     server.port = port;
     server.fileDescriptor = -1;
+    server.bindAddress = NULL;
+    server.unixSocketMode = UNIX_SOCKET_MODE;
+    server.shutdownTimeoutMillis = SHUTDOWN_TIMEOUT_MILLIS;
+    server.limits = serverLimits();
 
     server.router = initRouter();
 
     return server;
 }
 
+ServerLimits serverLimits(void) {
+    return (ServerLimits) {
+        .backlog = SOMAXCONN,
+        .maxConnections = 1024,
+        .readTimeoutMillis = 10000,
+        .writeTimeoutMillis = 10000,
+        .maxRequestSize = 1024 * 1024,
+        .blockingThreads = 8,
+    };
+}
+
 void freeServer(Server *server) {
     if (!server) return;
 
@@ -70,70 +134,628 @@ void freeServer(Server *server) {
         server->fileDescriptor = -1;
     }
 
+    free(server->bindAddress);
+    server->bindAddress = NULL;
+
     freeRouter(&server->router);
 }
 
-void* key_listener(void* arg) {
-    (void)arg;
-
-    while (serverState == STATE_RUNNING) {
-        int ch = getchar();
-        if (ch != EOF) {
-            if (ch == 'r') {
-                printf("restarting server...\n");
-                serverState = STATE_RESTARTING;
-                return NULL;
-            } else if (ch == 'q') {
-                printf("shutting down server...\n");
-                serverState = STATE_SHUTDOWN;
-                return NULL;
+static uint64_t monotonicMillis(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// The part of a response the socket did not take at once. It is sent from the event loop as the
+// socket becomes writable, so a slow client holds up nobody but itself.
+typedef struct {
+    char   *bytes;       // the rest of the head, and of a body held in memory
+    size_t  length;
+    size_t  sent;
+
+    int     file;        // a body sent from this file after bytes, -1 for none
+    off_t   fileOffset;
+    size_t  fileEnd;
+} UnsentResponse;
+
+static void freeUnsent(UnsentResponse *unsent) {
+    if (!unsent) return;
+
+    if (unsent->file >= 0) {
+        close(unsent->file);
+    }
+    free(unsent->bytes);
+    free(unsent);
+}
+
+// a copy of what is left of iov, which may be nothing
+static UnsentResponse *keepUnsent(const struct iovec *iov, int count) {
+    UnsentResponse *unsent = calloc(1, sizeof(UnsentResponse));
+    if (!unsent) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < count; i++) {
+        unsent->length += iov[i].iov_len;
+    }
+
+    if (unsent->length) {
+        unsent->bytes = malloc(unsent->length);
+        if (!unsent->bytes) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+
+        size_t copied = 0;
+        for (int i = 0; i < count; i++) {
+            memcpy(unsent->bytes + copied, iov[i].iov_base, iov[i].iov_len);
+            copied += iov[i].iov_len;
+        }
+    }
+
+    unsent->file = -1;
+
+    return unsent;
+}
+
+// Writes what the socket takes of iov without waiting for it. *iov and *count are left describing
+// the rest, none once all of it has gone. False on an error.
+static bool writeAvailable(int fd, struct iovec **iov, int *count) {
+    while (*count > 0) {
+        ssize_t written = writev(fd, *iov, *count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        while (*count > 0 && (size_t)written >= (*iov)->iov_len) {
+            written -= (*iov)->iov_len;
+            (*iov)++;
+            (*count)--;
+        }
+
+        if (*count > 0) {
+            (*iov)->iov_base = (char *)(*iov)->iov_base + written;
+            (*iov)->iov_len -= written;
+        }
+    }
+
+    return true;
+}
+
+// Writes iov, or as much of it as the socket takes now. The rest is copied into *unsent, which is
+// left NULL when there is none. False on an error.
+static bool writeOrKeep(int fd, struct iovec *iov, int count, UnsentResponse **unsent) {
+    *unsent = NULL;
+    if (!writeAvailable(fd, &iov, &count)) return false;
+
+    if (count > 0) {
+        *unsent = keepUnsent(iov, count);
+    }
+
+    return true;
+}
+
+// sends the file from *offset up to end, in the kernel where sendfile(2) is available, as far as
+// the socket takes it without waiting. False on an error or a file shorter than end
+static bool sendFileAvailable(int clientSocket, int fd, off_t *offset, size_t end) {
+#ifdef __linux__
+    while ((size_t)*offset < end) {
+        ssize_t sent = sendfile(clientSocket, fd, offset, end - *offset);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        if (sent == 0) return false;
+    }
+#else
+    char chunk[16384];
+    while ((size_t)*offset < end) {
+        size_t wanted = end - *offset < sizeof(chunk) ? end - *offset : sizeof(chunk);
+        ssize_t bytesRead = pread(fd, chunk, wanted, *offset);
+        if (bytesRead <= 0) return false;
+
+        // what the socket does not take is read again next time
+        ssize_t sent = write(clientSocket, chunk, bytesRead);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        *offset += sent;
+    }
+#endif
+
+    return true;
+}
+
+// sends what the socket takes of unsent, false on an error. Done once nothing is left
+static bool sendUnsent(int fd, UnsentResponse *unsent, bool *done) {
+    *done = false;
+
+    if (unsent->sent < unsent->length) {
+        struct iovec rest = { unsent->bytes + unsent->sent, unsent->length - unsent->sent };
+        struct iovec *iov = &rest;
+        int count = 1;
+
+        if (!writeAvailable(fd, &iov, &count)) return false;
+
+        unsent->sent = unsent->length - (count ? rest.iov_len : 0);
+        if (count) return true;
+    }
+
+    if (unsent->file >= 0) {
+        if (!sendFileAvailable(fd, unsent->file, &unsent->fileOffset, unsent->fileEnd)) return false;
+        if ((size_t)unsent->fileOffset < unsent->fileEnd) return true;
+    }
+
+    *done = true;
+    return true;
+}
+
+static void logRequest(AccessLog *log, const HttpRequest *request, const struct sockaddr *clientAddr,
+                       const struct timespec *acceptedAt, int status, size_t bytes) {
+    struct timespec now, wallClock;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    clock_gettime(CLOCK_REALTIME, &wallClock);
+
+    uint64_t durationMicros = (now.tv_sec - acceptedAt->tv_sec) * 1000000ULL + (now.tv_nsec - acceptedAt->tv_nsec) / 1000;
+
+    AccessLogRecord record = {
+        .timestampMillis = (int64_t)wallClock.tv_sec * 1000 + wallClock.tv_nsec / 1000000 - (int64_t)(durationMicros / 1000),
+        .method = request->method,
+        .status = status,
+        .bytes = bytes,
+        .durationMicros = durationMicros,
+    };
+
+    formatClientAddress(clientAddr, record.clientIp, sizeof(record.clientIp));
+    snprintf(record.path, sizeof(record.path), "%s", request->resource ? request->resource : "");
+
+    logAccess(log, &record);
+}
+
+static bool isCorsPreflight(const HttpRequest *request) {
+    return request->method == HTTP_OPTIONS && findHeader(request, "Access-Control-Request-Method");
+}
+
+// answers a preflight from the pre-rendered block without touching the router or middleware,
+// what the socket does not take at once goes in *unsent. Returns the status that was sent
+static int sendCorsPreflight(const CorsHeaders *cors, int clientSocket, const char *origin, UnsentResponse **unsent) {
+    static char forbidden[] = "HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+    struct iovec iov[3];
+    int count = corsPreflightResponse(cors, origin, iov);
+
+    if (count == 0) {
+        iov[0].iov_base = forbidden;
+        iov[0].iov_len = sizeof(forbidden) - 1;
+        count = 1;
+    }
+
+    if (!writeOrKeep(clientSocket, iov, count, unsent)) {
+        perror("write preflight failed");
+    }
+
+    return iov[0].iov_base == forbidden ? HTTP_FORBIDDEN : HTTP_NO_CONTENT;
+}
+
+static const int handledSignals[] = { SIGTERM, SIGINT, SIGHUP };
+
+static sigset_t handledSignalSet(void) {
+    sigset_t set;
+    sigemptyset(&set);
+
+    for (size_t i = 0; i < sizeof(handledSignals) / sizeof(handledSignals[0]); i++) {
+        sigaddset(&set, handledSignals[i]);
+    }
+
+    return set;
+}
+
+#ifdef __linux__
+static pthread_t loopThread;
+
+// A process-directed signal goes to any thread that has not blocked it, such as a
+// background thread started before runServer. Pass it on to the event loop's thread,
+// which keeps it blocked, so it becomes pending there and shows up on the signalfd.
+static void forwardSignal(int signal) {
+    pthread_kill(loopThread, signal);
+}
+#else
+static int signalPipe[2] = { -1, -1 };
+
+static void forwardSignal(int signal) {
+    int savedErrno = errno;
+
+    unsigned char value = (unsigned char)signal;
+    ssize_t written = write(signalPipe[1], &value, 1);
+    (void)written;
+
+    errno = savedErrno;
+}
+#endif
+
+// SIGTERM, SIGINT and SIGHUP become readable on the returned descriptor, so the event loop
+// handles them between requests rather than in a signal handler
+static int openSignalFd(void) {
+    struct sigaction action = { .sa_handler = forwardSignal, .sa_flags = SA_RESTART };
+    sigemptyset(&action.sa_mask);
+
+    sigset_t set = handledSignalSet();
+
+#ifdef __linux__
+    loopThread = pthread_self();
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    int fd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd < 0) {
+        perror("signalfd failed");
+        exit(EXIT_FAILURE);
+    }
+#else
+    if (pipe(signalPipe) < 0) {
+        perror("pipe failed");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        fcntl(signalPipe[i], F_SETFL, fcntl(signalPipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(signalPipe[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    int fd = signalPipe[0];
+#endif
+
+    for (size_t i = 0; i < sizeof(handledSignals) / sizeof(handledSignals[0]); i++) {
+        sigaction(handledSignals[i], &action, NULL);
+    }
+
+#ifndef __linux__
+    // a reload keeps them blocked across exec, see reloadServer
+    pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+#endif
+
+    return fd;
+}
+
+// puts back the default dispositions, so a signal after runServer has returned acts as usual
+static void closeSignalFd(int fd) {
+    sigset_t set = handledSignalSet();
+
+    for (size_t i = 0; i < sizeof(handledSignals) / sizeof(handledSignals[0]); i++) {
+        signal(handledSignals[i], SIG_DFL);
+    }
+    pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+
+#ifndef __linux__
+    close(signalPipe[1]);
+    signalPipe[1] = -1;
+#endif
+    close(fd);
+}
+
+// the next pending signal, or 0 if there is none
+static int readSignal(int fd) {
+#ifdef __linux__
+    struct signalfd_siginfo info;
+    if (read(fd, &info, sizeof(info)) != sizeof(info)) return 0;
+
+    return (int)info.ssi_signo;
+#else
+    unsigned char value;
+    if (read(fd, &value, 1) != 1) return 0;
+
+    return value;
+#endif
+}
+
+static void handleSignal(int signal) {
+    if (signal == SIGHUP) {
+        if (serverState == STATE_RUNNING) {
+            serverState = STATE_RELOADING;
+        }
+    } else if (signal == SIGTERM || signal == SIGINT) {
+        if (serverState == STATE_SHUTDOWN) {
+            shutdownForced = true;
+        } else {
+            printf("shutting down server...\n");
+            serverState = STATE_SHUTDOWN;
+        }
+    }
+}
+
+static void handleSignals(int fd) {
+    int signal;
+    while ((signal = readSignal(fd)) != 0) {
+        handleSignal(signal);
+    }
+}
+
+// acts on the signals that arrived while a request was being answered,
+// true if the loop should look at the new state before the next request
+static bool interrupted(int signalFd) {
+    ServerState state = serverState;
+    bool forced = shutdownForced;
+
+    handleSignals(signalFd);
+
+    return serverState != state || shutdownForced != forced;
+}
+
+// the listening socket a previous image of this process left open for us, or -1
+static int inheritedListener(const BindAddress *bindAddress) {
+    const char *value = getenv(LISTEN_FD_ENV);
+    if (!value) return -1;
+
+    // not for any process we start ourselves
+    int fd = atoi(value);
+    unsetenv(LISTEN_FD_ENV);
+
+    int type;
+    socklen_t typeLength = sizeof(type);
+    struct sockaddr_storage address;
+    socklen_t addressLength = sizeof(address);
+
+    if (fd < 0 ||
+        getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &typeLength) < 0 || type != SOCK_STREAM ||
+        getsockname(fd, (struct sockaddr *)&address, &addressLength) < 0) {
+        fprintf(stderr, "Ignoring %s=%s, it is not a listening socket.\n", LISTEN_FD_ENV, value);
+        return -1;
+    }
+
+    if (!sameBindAddress((struct sockaddr *)&address, (const struct sockaddr *)&bindAddress->address)) {
+        // the new build listens somewhere else, let go of the old address
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static bool currentExecutable(char *path, size_t size) {
+#if defined(__linux__)
+    ssize_t length = readlink("/proc/self/exe", path, size - 1);
+    if (length < 0) return false;
+    path[length] = '\0';
+
+    // a deploy that renamed a new binary over ours leaves the link pointing at the old, deleted inode
+    static const char deleted[] = " (deleted)";
+    size_t suffixLength = sizeof(deleted) - 1;
+    if ((size_t)length > suffixLength && strcmp(path + length - suffixLength, deleted) == 0) {
+        path[length - suffixLength] = '\0';
+    }
+
+    return true;
+#elif defined(__APPLE__)
+    uint32_t length = (uint32_t)size;
+    return _NSGetExecutablePath(path, &length) == 0;
+#else
+    (void)path;
+    (void)size;
+    return false;
+#endif
+}
+
+// the arguments this process was started with, NULL terminated, the caller frees the array and its first string
+static char **commandLine(const char *executable) {
+    char *data = NULL;
+    size_t length = 0;
+
+#ifdef __linux__
+    FILE *file = fopen("/proc/self/cmdline", "rb");
+    if (file) {
+        size_t capacity = 0;
+        char chunk[1024];
+        size_t chunkLength;
+
+        while ((chunkLength = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            if (length + chunkLength + 1 > capacity) {
+                capacity = (length + chunkLength + 1) * 2;
+                data = realloc(data, capacity);
+                if (!data) {
+                    fprintf(stderr, "Fatal: out of memory\n");
+                    exit(EXIT_FAILURE);
+                }
             }
+
+            memcpy(data + length, chunk, chunkLength);
+            length += chunkLength;
         }
-        usleep(10000);
+
+        fclose(file);
     }
-    return NULL;
+#endif
+
+    if (!data) {
+        data = strdup(executable);
+        if (!data) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        length = strlen(data) + 1;
+    }
+    data[length] = '\0';
+
+    int count = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (data[i] == '\0') count++;
+    }
+
+    char **args = malloc(sizeof(char *) * (count + 1));
+    if (!args) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int index = 0;
+    for (size_t i = 0; i < length && index < count; i += strlen(data + i) + 1) {
+        args[index++] = data + i;
+    }
+    args[index] = NULL;
+
+    return args;
 }
 
+// Replaces this process image with a new one that keeps serving on the same listening socket.
+// The socket is never closed, so clients connecting in the meantime wait in its backlog
+// instead of being refused. Only returns if the new image could not be started.
+static void reloadServer(App *app, bool rebuild) {
+    char executable[PATH_MAX];
 
-void runServer(App *app) {
-    if (!app) return;
+    if (rebuild) {
+        if (system("make -s") != 0) {
+            fprintf(stderr, "Build failed, still serving the previous build.\n");
+            return;
+        }
+
+        snprintf(executable, sizeof(executable), "./build/a");
+    } else {
+        if (!currentExecutable(executable, sizeof(executable))) {
+            fprintf(stderr, "Cannot reload, the path of the running executable is unknown.\n");
+            return;
+        }
+    }
 
-    pthread_t thread_id;
-    set_nonblocking_input();
+    char **args = commandLine(executable);
 
-    if (pthread_create(&thread_id, NULL, key_listener, NULL)) {
-        perror("Failed to create thread");
-        return;
+    // the new image starts with empty queues, write out what this one still holds
+    // and finish the jobs already queued
+    drainJobQueue(app->jobs);
+    if (app->accessLog) {
+        drainAccessLog(app->accessLog);
+    }
+    fflush(stdout);
+    fflush(stderr);
+
+    int fd = app->server.fileDescriptor;
+    int flags = fcntl(fd, F_GETFD);
+    if (flags >= 0) {
+        fcntl(fd, F_SETFD, flags & ~FD_CLOEXEC);
+    }
+
+    char value[16];
+    snprintf(value, sizeof(value), "%d", fd);
+    setenv(LISTEN_FD_ENV, value, 1);
+
+    // a signal arriving before the new image has installed its handlers would kill it,
+    // blocked signals stay pending across exec instead
+    sigset_t set = handledSignalSet();
+    sigset_t previous;
+    pthread_sigmask(SIG_BLOCK, &set, &previous);
+
+    // the new image saves the terminal settings again, they must be the shell's
+    bool hadTerminal = terminalChanged;
+    restore_input();
+
+    execv(executable, args);
+
+    perror("Reload failed");
+    unsetenv(LISTEN_FD_ENV);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (hadTerminal) {
+        set_nonblocking_input();
+    }
+
+    free(args[0]);
+    free(args);
+}
+
+// 'r' and 'q' from the terminal, only when the server was started from one outside production
+static bool useKeyControls(App *app) {
+    if (!isatty(STDIN_FILENO)) return false;
+
+    return !app->environment || strcmp(app->environment, PRODUCTION) != 0;
+}
+
+// returns false once stdin is closed
+static bool readKeys(void) {
+    char keys[64];
+    ssize_t count = read(STDIN_FILENO, keys, sizeof(keys));
+    if (count == 0) return false;
+
+    for (ssize_t i = 0; i < count && serverState == STATE_RUNNING; i++) {
+        if (keys[i] == 'r') {
+            printf("restarting server...\n");
+            serverState = STATE_RESTARTING;
+        } else if (keys[i] == 'q') {
+            printf("shutting down server...\n");
+            serverState = STATE_SHUTDOWN;
+        }
     }
 
-    app->server.fileDescriptor = socket(AF_INET, SOCK_STREAM, 0);
+    return true;
+}
+
+// a socket file left behind by a server that is no longer running is removed, one that still answers is in use
+static bool removeStaleSocket(const struct sockaddr_un *address) {
+    struct stat info;
+    if (stat(address->sun_path, &info) < 0) return true;
+    if (!S_ISSOCK(info.st_mode)) return false;
+
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0) return false;
+
+    bool inUse = connect(probe, (const struct sockaddr *)address, sizeof(*address)) == 0 || errno != ECONNREFUSED;
+    close(probe);
+
+    return !inUse && unlink(address->sun_path) == 0;
+}
+
+static void listenOn(App *app, const BindAddress *bindAddress, bool keyControls) {
+    int family = bindAddress->address.ss_family;
+
+    app->server.fileDescriptor = socket(family, SOCK_STREAM, 0);
     if (app->server.fileDescriptor < 0) {
         perror("socket failed");
         exit(EXIT_FAILURE);
     }
 
     int opt = 1;
-    if (setsockopt(app->server.fileDescriptor, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+    if (family != AF_UNIX && setsockopt(app->server.fileDescriptor, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+        perror("setsockopt failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // the default differs between systems, Linux accepts IPv4 on "::" and the BSDs do not
+    int ipv6Only = !bindAddress->dualStack;
+    if (family == AF_INET6 && setsockopt(app->server.fileDescriptor, IPPROTO_IPV6, IPV6_V6ONLY, &ipv6Only, sizeof(ipv6Only)) < 0) {
         perror("setsockopt failed");
         exit(EXIT_FAILURE);
     }
 
-    struct sockaddr_in address = {0};
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
-    address.sin_port = htons(app->server.port);
+    char url[160];
+    formatListenUrl(bindAddress, url, sizeof(url));
+
+    if (family == AF_UNIX && !removeStaleSocket((const struct sockaddr_un *)&bindAddress->address)) {
+        fprintf(stderr, "%s is in use, or is not a socket.\n", url);
+        exit(EXIT_FAILURE);
+    }
+
+    // Linux creates the socket file with the socket's own mode less the umask, so narrowing it first means the
+    // file never exists with wider permissions than asked for; the umask itself is process-wide and left alone
+    if (family == AF_UNIX) {
+        fchmod(app->server.fileDescriptor, app->server.unixSocketMode);
+    }
+
+    int bound = bind(app->server.fileDescriptor, (const struct sockaddr *)&bindAddress->address, bindAddress->length);
+    if (bound == 0 && family == AF_UNIX && chmod(((const struct sockaddr_un *)&bindAddress->address)->sun_path, app->server.unixSocketMode) < 0) {
+        fprintf(stderr, "Failed to set the permissions of %s: %s\n", url, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
 
-    if (bind(app->server.fileDescriptor, (struct sockaddr *)&address, sizeof(address)) < 0) {
-        if (errno == EADDRINUSE) {
+    if (bound < 0) {
+        if (errno == EADDRINUSE && family != AF_UNIX) {
             fprintf(stderr, "Port %d is already in use. Please choose a different port.\n", app->server.port);
         } else {
-            fprintf(stderr, "Failed to bind to port %d: %s\n", app->server.port, strerror(errno));
+            fprintf(stderr, "Failed to bind to %s: %s\n", url, strerror(errno));
         }
 
         exit(EXIT_FAILURE);
     }
 
-    if (listen(app->server.fileDescriptor, 10) < 0) {
+    if (listen(app->server.fileDescriptor, app->server.limits.backlog) < 0) {
         perror("listen failed");
         exit(EXIT_FAILURE);
     }
@@ -142,135 +764,1366 @@ void runServer(App *app) {
     printf("┌───────────────────────────────────────────────┐\n");
     printf("│         🌿 Lavandula Server is RUNNING        │\n");
     printf("├───────────────────────────────────────────────┤\n");
-    printf("│ Listening on: http://127.0.0.1:%-12d   │\n", app->server.port);
+    printf("│ Listening on: %-32s│\n", url);
     printf("│                                               │\n");
     printf("│ Controls:                                     │\n");
-    printf("│   • Press 'r' to reload the server            │\n");
-    printf("│   • Press 'q' to shut down                    │\n");
+    if (keyControls) {
+        printf("│   • Press 'r' to reload the server            │\n");
+        printf("│   • Press 'q' to shut down                    │\n");
+    }
+    printf("│   • Send SIGHUP to reload without rebuilding  │\n");
+    printf("│   • Send SIGTERM or Ctrl+C to shut down       │\n");
     printf("└───────────────────────────────────────────────┘\n\n");
+}
 
+typedef struct BlockingPool BlockingPool;
 
-    int flags = fcntl(app->server.fileDescriptor, F_GETFL, 0);
-    if (flags == -1) {
-        perror("fcntl get flags failed");
-        exit(EXIT_FAILURE);
-    }
-    if (fcntl(app->server.fileDescriptor, F_SETFL, flags | O_NONBLOCK) == -1) {
-        perror("fcntl set non-blocking failed");
-        exit(EXIT_FAILURE);
-    }
+// one request from parsing it until its response is written, moved to the heap while a
+// blocking worker runs its controller or its coroutine is suspended
+typedef struct Exchange {
+    App               *app;
+    RequestTrace       trace;
+    HttpParser         parser;
+    const char        *origin;
+    Route             *route;
+    bool               servedStatic;
+    bool               routeOfAnyMethodExists;
+    RequestContext     context;
+    struct timespec    dispatchStart;
+    HttpResponse       response;
 
-    while (serverState == STATE_RUNNING) {
-        struct sockaddr_in clientAddr;
-        socklen_t clientLen = sizeof(clientAddr);
+    BlockingPool      *pool;
+    Coroutine         *coroutine;      // a useAsync request, suspended while it awaits
+    bool               abandoned;      // the connection closed while a worker had it
+    struct Exchange   *next;
+} Exchange;
 
-        int clientSocket = accept(app->server.fileDescriptor, (struct sockaddr *)&clientAddr, &clientLen);
-        if (clientSocket < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                usleep(10000);
-                continue;
-            } else {
-                perror("accept failed");
-                continue;
-            }
-        }
+// Runs the controllers of useBlocking routes, and what useAsync ones await with awaitJob, off the
+// event loop. Workers put finished exchanges on a list and wake the loop, which writes the
+// responses or resumes the coroutines.
+struct BlockingPool {
+    JobQueue          *workers;
+    pthread_mutex_t    lock;
+    Exchange          *finished;
+    int                wakeFds[2];
+};
 
-        char buffer[BUFFER_SIZE] = {0}; // oops
-        ssize_t bytesRead = read(clientSocket, buffer, sizeof(buffer) - 1);
-        if (bytesRead < 0) {
-            perror("read failed");
-            close(clientSocket);
-            continue;
-        }
+// a connection from accepting it until its response has been sent
+typedef struct {
+    int                fd;
+    struct sockaddr_storage address;
+    struct timespec    acceptedAt;
+    uint64_t           acceptStart;    // traceNow() before and after accept, when tracing
+    uint64_t           readStart;
+    // to receive the whole request, then for a streamed response to make progress, 0 for none
+    uint64_t           deadlineMillis;
 
-        HttpParser parser = parseRequest(buffer);
-        HttpRequest request = parser.request;
+    char              *buffer;         // NUL terminated
+    size_t             length;
+    size_t             capacity;
 
-        char *pathOnly = strdup(request.resource);
-        char *queryStart = strchr(pathOnly, '?');
-        if (queryStart) {
-            *queryStart = '\0';
-        }
+    size_t             scanned;        // bytes already searched for the end of the headers
+    size_t             headerLength;   // 0 until the headers have all arrived
+    size_t             contentLength;  // decoded so far when the body is chunked
 
-        Route *route = findRoute(app->server.router, request.method, pathOnly);
-        bool routeOfAnyMethodExists = pathExists(app->server.router, pathOnly);
+    bool               chunked;
+    ChunkedDecoder     chunks;
 
-        if (!route && !routeOfAnyMethodExists) {
-            Route *notFoundRoute = findRoute(app->server.router, request.method, "/404");
+    ResponseStream    *stream;         // set once the headers of a streamed response are sent
+    WebSocket         *webSocket;      // set once the connection is upgraded, its frames go out on stream
+    Exchange          *exchange;       // at a blocking worker, the connection waits for it
+    UnsentResponse    *unsent;         // sent before anything else, until deadlineMillis
+} Connection;
 
-            if (notFoundRoute) {
-                route = notFoundRoute;
-            }
-        }
+typedef enum {
+    REQUEST_INCOMPLETE,
+    REQUEST_COMPLETE,
+    REQUEST_CLOSED,
+    REQUEST_INVALID,
+    REQUEST_TOO_LARGE,
+    HEADERS_TOO_LARGE,
+} RequestProgress;
 
-        free(pathOnly);
+// the listener, the signals, the terminal, published events and finished blocking requests
+// come first in the poll set, then one entry per connection
+#define FIXED_POLL_FDS 5
 
-        RequestContext context = requestContext(app, request);
+typedef struct {
+    Connection    *items;
+    struct pollfd *fds;
+    int            count;
+    int            capacity;
 
-        context.hasBody = parser.isValid && request.bodyLength > 0;
-        context.body = context.hasBody ? jsonParse(request.body) : NULL;
+    BlockingPool  *blocking;        // NULL unless a route is marked with useBlocking
+    IoLoop        *io;
+    BufferPool    *buffers;         // where each connection's request buffer comes from
+} Connections;
 
-        HttpResponse response;
-        if (route) {
-            app->middleware.current = 0;
+// what the client sent goes to its WebSocket, a partial frame header stays at the front of the buffer
+static void consumeWebSocket(Connection *connection) {
+    size_t used = webSocketReceive(connection->webSocket, (unsigned char *)connection->buffer, connection->length);
 
-            MiddlewareHandler combinedMiddleware = combineMiddleware(&app->middleware, route->middleware);
-            response = next(context, &combinedMiddleware);
-            
-            free(combinedMiddleware.handlers);
-        } else {
-            app->middleware.current = 0;
-            app->middleware.finalHandler = routeOfAnyMethodExists ? defaultMethodNotAllowedController : defaultNotFoundController;
-            response = next(context, &app->middleware);
-        }
+    memmove(connection->buffer, connection->buffer + used, connection->length - used);
+    connection->length -= used;
+}
 
-        freeJsonBuilder(context.body);
+// The connection carries the WebSocket's frames from here on, both ways. Returns false if the
+// handshake could not be sent, closing the connection then releases the socket.
+static bool upgradeConnection(Connection *connection, WebSocket *socket, bool written) {
+    connection->stream = socket->stream;
+    connection->webSocket = socket;
+    if (!written) return false;
 
-        if (!response.content) {
-            response.content = strdup("");
-        }
+    // the client may already have sent frames behind the handshake
+    size_t request = connection->headerLength + connection->contentLength;
+    size_t early = connection->length > request ? connection->length - request : 0;
+    memmove(connection->buffer, connection->buffer + request, early);
+    connection->length = early;
 
-        int contentLength = strlen(response.content);
+    // open until either side closes it
+    connection->deadlineMillis = 0;
 
-        const char *statusText = httpStatusCodeToStr(response.status);
+    webSocketOpened(socket);
+    if (early) {
+        consumeWebSocket(connection);
+    }
 
-        char header[512];
-        snprintf(header, sizeof(header),
-                "HTTP/1.1 %d %s\r\n"
-                "Content-Type: %s\r\n"
-                "Content-Length: %d\r\n"
-                "Connection: close\r\n"
-                "\r\n",
-                response.status, statusText, response.contentType, contentLength
-        );
+    return true;
+}
 
-        if (write(clientSocket, header, strlen(header)) == -1) {
-            perror("write header failed");
-            exit(EXIT_FAILURE);
-        }
-        if (write(clientSocket, response.content, contentLength) == -1) {
-            perror("write content failed");
-            exit(EXIT_FAILURE);
-        }
+// Runs the middleware and the controller, on the event loop or on a blocking worker
+static void runPipeline(Exchange *exchange) {
+    App *app = exchange->app;
 
-        close(clientSocket);
+    int span = exchange->servedStatic ? -1 : traceBegin(TRACE_MIDDLEWARE);
+
+    if (exchange->servedStatic) {
+        // static mounts are answered before any middleware runs
+    } else if (exchange->route) {
+        MiddlewareHandler combinedMiddleware = combineMiddleware(&app->middleware, exchange->route->middleware);
+        exchange->response = next(exchange->context, &combinedMiddleware);
+
+        free(combinedMiddleware.handlers);
+    } else {
+        app->middleware.current = 0;
+        app->middleware.finalHandler = exchange->routeOfAnyMethodExists ? defaultMethodNotAllowedController : defaultNotFoundController;
+        exchange->response = next(exchange->context, &app->middleware);
     }
 
-    freeServer(&app->server);
-    pthread_join(thread_id, NULL);
+    traceEnd(span);
 
-    if (serverState == STATE_RESTARTING) {
-        int result = system("make -s");
-        if (result != 0) {
-            fprintf(stderr, "Build failed.\n");
-            exit(1);
-        }
+    freeJsonBuilder(exchange->context.body);
+}
 
-        char *args[] = {"./build/a", NULL};
-        execvp(args[0], args);
-        perror("execvp failed");
-        exit(1);
-    } else if (serverState == STATE_SHUTDOWN) {
-        exit(0);
+// from a worker, the loop takes it up again in completeBlocking
+static void returnToLoop(Exchange *exchange) {
+    BlockingPool *pool = exchange->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    bool first = pool->finished == NULL;
+    exchange->next = pool->finished;
+    pool->finished = exchange;
+    pthread_mutex_unlock(&pool->lock);
+
+    // one wake-up is enough for everything finished before the loop gets to it
+    if (first) {
+        wakeUp(pool->wakeFds);
     }
+}
+
+// the job a useBlocking request runs as, the event loop writes the response once it is back
+static void runBlockingExchange(JobContext ctx) {
+    Exchange *exchange = ctx.arg;
+
+    markBlockingWorker();
+
+    if (ctx.app->tracer) traceResume(&exchange->trace);
+    runPipeline(exchange);
+    if (ctx.app->tracer) traceSuspend();
+
+    returnToLoop(exchange);
+}
+
+// what a useAsync request awaits with awaitJob, its coroutine is resumed once it is back
+static void runAwaitedJob(JobContext ctx) {
+    Exchange *exchange = ctx.arg;
+    CoroutineWait *wait = coroutineWait(exchange->coroutine);
+
+    wait->job((JobContext){ .app = wait->app, .db = wait->app ? wait->app->dbContext : NULL, .arg = wait->jobArg });
+
+    returnToLoop(exchange);
+}
+
+static void runAsyncExchange(void *arg) {
+    runPipeline(arg);
+}
+
+// Sets up what a suspended useAsync request waits for. The fd and deadline it awaits take the
+// connection's place in the poll set, a job goes to the blocking pool.
+static void awaitCoroutine(Connection *connection, Exchange *exchange) {
+    CoroutineWait *wait = coroutineWait(exchange->coroutine);
+
+    if (wait->kind != AWAIT_JOB) {
+        connection->deadlineMillis = wait->deadlineMillis;
+        return;
+    }
+
+    connection->deadlineMillis = 0;
+
+    // the queue holds one request per connection, so this is not expected. Run here if it happens
+    if (!submitJob(exchange->pool->workers, exchange->app, runAwaitedJob, exchange)) {
+        runAwaitedJob((JobContext){ .app = exchange->app, .arg = exchange });
+    }
+}
+
+// frees what the pipeline produced for a connection that is no longer there to receive it
+static void discardExchange(Exchange *exchange) {
+    HttpResponse *response = &exchange->response;
+
+    free(response->headers);
+    releaseResponseContent(response);
+    if (response->bodyFile) {
+        close(response->fileDescriptor);
+    }
+
+    // closing the stream releases the producer's state or the WebSocket
+    if (response->webSocket) {
+        closeStream(response->webSocket->stream);
+    } else if (response->producer) {
+        closeStream(openStream(response));
+    }
+
+    freeParser(&exchange->parser);
+}
+
+// Runs a suspended useAsync request to the end without waiting for anything, its awaits fail
+// straight away. One waiting on a worker is only marked, completeBlocking cancels it once it is back.
+static void cancelExchange(Exchange *exchange) {
+    CoroutineWait *wait = coroutineWait(exchange->coroutine);
+    if (wait->kind == AWAIT_JOB) {
+        exchange->abandoned = true;
+        return;
+    }
+
+    wait->cancelled = true;
+    while (!coroutineResume(exchange->coroutine)) {}
+    freeCoroutine(exchange->coroutine);
+
+    discardExchange(exchange);
+    free(exchange);
+}
+
+// Sends the response the pipeline produced, as far as the socket takes it now. Returns true when
+// it goes on from the event loop, as a stream or as what is left of it in connection->unsent.
+// Otherwise the caller closes the connection.
+static bool finishExchange(App *app, Connections *open, Connection *connection, Exchange *exchange) {
+    int clientSocket = connection->fd;
+    const struct sockaddr *clientAddr = (const struct sockaddr *)&connection->address;
+
+    HttpRequest request = exchange->parser.request;
+    HttpResponse response = exchange->response;
+    const char *origin = exchange->origin;
+
+    bool streamed = response.producer != NULL;
+
+    if (!response.content && !streamed) {
+        response.content = strdup("");
+        response.ownsContent = true;
+    }
+
+    int span = app->compressor ? traceBegin(TRACE_COMPRESS) : -1;
+    compressResponse(app->compressor, &request, &response);
+    traceEnd(span);
+
+    if (app->metrics) {
+        struct timespec dispatchEnd;
+        clock_gettime(CLOCK_MONOTONIC, &dispatchEnd);
+
+        uint64_t micros = (dispatchEnd.tv_sec - exchange->dispatchStart.tv_sec) * 1000000ULL +
+            (dispatchEnd.tv_nsec - exchange->dispatchStart.tv_nsec) / 1000;
+
+        // label by the route pattern, never the raw resource, to keep the series count bounded
+        const char *routeLabel = exchange->servedStatic ? "static" : exchange->route ? exchange->route->path : "unmatched";
+        recordRequest(app->metrics, routeLabel, request.method, response.status, micros);
+    }
+
+    size_t contentLength = 0;
+    if (!streamed) {
+        contentLength = response.contentLength ? response.contentLength : strlen(response.content);
+    }
+
+    // the connection is handed over to a WebSocket after the headers
+    bool upgraded = response.webSocket != NULL;
+
+    // a 304 keeps the headers of the full response but never has a body
+    bool hasBody = response.status != HTTP_NOT_MODIFIED && response.status != HTTP_NO_CONTENT && !upgraded;
+    if (!hasBody) {
+        contentLength = 0;
+    }
+
+    const char *statusText = httpStatusCodeToStr(response.status);
+
+    // a streamed body has no length up front, chunked encoding marks where it ends
+    char length[48];
+    if (streamed && hasBody) {
+        snprintf(length, sizeof(length), "Transfer-Encoding: chunked");
+    } else {
+        snprintf(length, sizeof(length), "Content-Length: %zu", contentLength);
+    }
+
+    char header[512];
+    int headerLength;
+    if (upgraded) {
+        headerLength = snprintf(header, sizeof(header),
+            "HTTP/1.1 101 Switching Protocols\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n");
+    } else {
+        headerLength = snprintf(header, sizeof(header),
+            "HTTP/1.1 %d %s\r\n"
+            "Content-Type: %s\r\n"
+            "%s\r\n"
+            "Connection: close\r\n",
+            response.status, statusText, response.contentType, length
+        );
+    }
+
+    struct iovec iov[7];
+    int iovCount = 0;
+
+    iov[iovCount++] = (struct iovec){ header, headerLength };
+
+    if (response.headers) {
+        iov[iovCount++] = (struct iovec){ response.headers, strlen(response.headers) };
+    }
+
+    if (origin) {
+        iovCount += corsResponseHeaders(app->cors, origin, &iov[iovCount]);
+    }
+
+    iov[iovCount++] = (struct iovec){ "\r\n", 2 };
+
+    if (hasBody && !response.bodyFile && !streamed) {
+        iov[iovCount++] = (struct iovec){ response.content, contentLength };
+    }
+
+    span = traceBegin(TRACE_WRITE);
+
+    uint64_t writeDeadline = monotonicMillis() + app->server.limits.writeTimeoutMillis;
+
+    // the last thing sent on the connection may go out with its close, failures are reported then.
+    // Otherwise what the socket does not take at once is kept and sent as it becomes writable
+    bool written = !streamed && !upgraded && !response.bodyFile &&
+        ioSendAndClose(open->io, clientSocket, iov, iovCount, writeDeadline);
+    if (!written) {
+        written = writeOrKeep(clientSocket, iov, iovCount, &connection->unsent);
+        if (!written) {
+            perror("write response failed");
+        }
+    }
+
+    if (response.bodyFile && written && hasBody) {
+        off_t offset = 0;
+
+        // behind the rest of the head, or the rest of the file once the socket is full
+        if (!connection->unsent && !sendFileAvailable(clientSocket, response.fileDescriptor, &offset, contentLength)) {
+            perror("sendfile failed");
+            close(response.fileDescriptor);
+        } else if (connection->unsent || (size_t)offset < contentLength) {
+            if (!connection->unsent) {
+                connection->unsent = keepUnsent(NULL, 0);
+            }
+            connection->unsent->file = response.fileDescriptor;
+            connection->unsent->fileOffset = offset;
+            connection->unsent->fileEnd = contentLength;
+        } else {
+            close(response.fileDescriptor);
+        }
+    } else if (response.bodyFile) {
+        close(response.fileDescriptor);
+    }
+
+    traceEnd(span);
+
+    if (app->accessLog) {
+        // not known yet when the connection was accepted through io_uring
+        if (connection->address.ss_family == AF_UNSPEC) {
+            socklen_t addressLength = sizeof(connection->address);
+            getpeername(clientSocket, (struct sockaddr *)&connection->address, &addressLength);
+        }
+        logRequest(app->accessLog, &request, clientAddr, &connection->acceptedAt, response.status,
+            headerLength + (response.headers ? strlen(response.headers) : 0) + contentLength);
+    }
+
+    traceFinish(app->tracer, &exchange->trace, request.method, request.resource, response.status);
+
+    free(response.headers);
+    releaseResponseContent(&response);
+
+    freeParser(&exchange->parser);
+
+    if (upgraded) {
+        if (!upgradeConnection(connection, response.webSocket, written)) return false;
+
+        // its frames wait for the rest of the handshake
+        if (connection->unsent) {
+            connection->deadlineMillis = writeDeadline;
+        }
+        return true;
+    }
+
+    if (streamed) {
+        // the producer runs from the event loop as the client takes the body. Opened either way,
+        // closing it releases the producer's state
+        ResponseStream *stream = openStream(&response);
+        if (written && hasBody) {
+            connection->stream = stream;
+        } else {
+            closeStream(stream);
+        }
+    }
+
+    if (!connection->stream && !connection->unsent) return false;
+
+    releaseBuffer(open->buffers, connection->buffer, connection->capacity);
+    connection->buffer = NULL;
+    // what is left of the response has until the deadline it was written with, a stream's body
+    // the time of a write
+    connection->deadlineMillis = connection->unsent ? writeDeadline :
+        monotonicMillis() + app->server.limits.writeTimeoutMillis;
+
+    return true;
+}
+
+// Answers the request a connection has finished sending. Returns true when the response goes on
+// from the event loop, or when a blocking worker has the request (connection->exchange is set then).
+// Otherwise the caller closes the connection.
+static bool handleConnection(App *app, Connections *open, Connection *connection) {
+    BlockingPool *blocking = open->blocking;
+    int clientSocket = connection->fd;
+    Exchange exchange = { .app = app };
+
+    // from here on every phase of the request is recorded into its trace
+    if (app->tracer) {
+        traceStart(&exchange.trace, connection->acceptStart);
+        traceAddSpan(&exchange.trace, TRACE_ACCEPT, connection->acceptStart, connection->readStart);
+        traceAddSpan(&exchange.trace, TRACE_READ, connection->readStart, traceNow());
+    }
+
+    int span = traceBegin(TRACE_PARSE);
+    exchange.parser = parseRequest(connection->buffer);
+    HttpParser *parser = &exchange.parser;
+
+    // decoded as it arrived, the parser only sees the headers
+    if (connection->chunked && parser->isValid) {
+        parser->request.body = malloc(connection->contentLength + 1);
+        if (!parser->request.body) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(parser->request.body, connection->buffer + connection->headerLength, connection->contentLength);
+        parser->request.body[connection->contentLength] = '\0';
+        parser->request.bodyLength = connection->contentLength;
+    }
+
+    HttpRequest request = parser->request;
+    traceEnd(span);
+
+    exchange.origin = app->cors ? findHeader(&request, "Origin") : NULL;
+    if (exchange.origin && isCorsPreflight(&request)) {
+        int status = sendCorsPreflight(app->cors, clientSocket, exchange.origin, &connection->unsent);
+        traceFinish(app->tracer, &exchange.trace, request.method, request.resource, status);
+
+        freeParser(parser);
+        if (!connection->unsent) return false;
+
+        connection->deadlineMillis = monotonicMillis() + app->server.limits.writeTimeoutMillis;
+        return true;
+    }
+
+    char *pathOnly = strdup(request.resource);
+    char *queryStart = strchr(pathOnly, '?');
+    if (queryStart) {
+        *queryStart = '\0';
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &exchange.dispatchStart);
+
+    if (request.method == HTTP_GET && app->staticFiles && app->staticFiles->mountCount > 0) {
+        span = traceBegin(TRACE_STATIC);
+        exchange.servedStatic = serveStaticMount(app->staticFiles, &request, pathOnly, &exchange.response);
+        traceEnd(span);
+    }
+
+    span = traceBegin(TRACE_ROUTE);
+    Route *route = findRoute(app->server.router, request.method, pathOnly);
+    exchange.routeOfAnyMethodExists = pathExists(app->server.router, pathOnly);
+
+    if (!route && !exchange.routeOfAnyMethodExists) {
+        Route *notFoundRoute = findRoute(app->server.router, request.method, "/404");
+
+        if (notFoundRoute) {
+            route = notFoundRoute;
+        }
+    }
+    exchange.route = route;
+    traceEnd(span);
+
+    free(pathOnly);
+
+    exchange.context = requestContext(app, request);
+
+    exchange.context.hasBody = parser->isValid && request.bodyLength > 0;
+    exchange.context.body = exchange.context.hasBody && !exchange.servedStatic ? jsonParse(request.body) : NULL;
+
+    if (blocking && route && !exchange.servedStatic && route->middleware->blocking) {
+        Exchange *handed = malloc(sizeof(Exchange));
+        if (!handed) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        *handed = exchange;
+        handed->pool = blocking;
+
+        // the trace goes with the request
+        if (app->tracer) traceSuspend();
+
+        if (submitJob(blocking->workers, app, runBlockingExchange, handed)) {
+            connection->exchange = handed;
+            // the controller may take as long as it needs, the write deadline starts once it is done
+            connection->deadlineMillis = 0;
+            return true;
+        }
+
+        // the queue holds one request per connection, so this is not expected. Answered here if it happens
+        exchange = *handed;
+        free(handed);
+        if (app->tracer) traceResume(&exchange.trace);
+    } else if (blocking && route && !exchange.servedStatic && route->middleware->async) {
+        Exchange *handed = malloc(sizeof(Exchange));
+        if (!handed) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        *handed = exchange;
+        handed->pool = blocking;
+
+        if (app->tracer) traceResume(&handed->trace);
+        handed->coroutine = coroutineStart(runAsyncExchange, handed);
+
+        if (!coroutineDone(handed->coroutine)) {
+            if (app->tracer) traceSuspend();
+
+            connection->exchange = handed;
+            awaitCoroutine(connection, handed);
+            return true;
+        }
+
+        // answered without awaiting anything
+        freeCoroutine(handed->coroutine);
+        bool streaming = finishExchange(app, open, connection, handed);
+        free(handed);
+
+        return streaming;
+    }
+
+    runPipeline(&exchange);
+
+    return finishExchange(app, open, connection, &exchange);
+}
+
+// the value of a header in a complete header block, NULL when there is none.
+// the parser validates it again, this only decides how much more to read
+static const char *headerValue(const char *headers, size_t length, const char *name) {
+    size_t nameLength = strlen(name);
+
+    for (const char *line = headers; line && line + nameLength < headers + length; ) {
+        if (strncasecmp(line, name, nameLength) == 0 && line[nameLength] == ':') {
+            const char *value = line + nameLength + 1;
+            while (*value == ' ' || *value == '\t') value++;
+
+            return value;
+        }
+
+        line = strchr(line, '\n');
+        if (line) line++;
+    }
+
+    return NULL;
+}
+
+// how the body is framed, from a complete header block
+static RequestProgress readFraming(Connection *connection, size_t maxRequestSize) {
+    const char *contentLength = headerValue(connection->buffer, connection->headerLength, "content-length");
+    const char *transferEncoding = headerValue(connection->buffer, connection->headerLength, "transfer-encoding");
+
+    if (transferEncoding) {
+        // both could be read differently by a proxy in front, the way requests are smuggled
+        if (contentLength) return REQUEST_INVALID;
+
+        // chunked has to be the last coding, and is the only one understood
+        const char *end = strstr(transferEncoding, "\r\n");
+        if (!end) return REQUEST_INVALID;
+        while (end > transferEncoding && (end[-1] == ' ' || end[-1] == '\t')) end--;
+        if (end - transferEncoding != 7 || strncasecmp(transferEncoding, "chunked", 7) != 0) return REQUEST_INVALID;
+
+        connection->chunked = true;
+        return REQUEST_INCOMPLETE;
+    }
+
+    if (contentLength) {
+        char *end;
+        unsigned long long length = strtoull(contentLength, &end, 10);
+        if (end == contentLength) return REQUEST_INVALID;
+
+        connection->contentLength = length > SIZE_MAX ? SIZE_MAX : (size_t)length;
+        if (connection->contentLength > maxRequestSize - connection->headerLength) return REQUEST_TOO_LARGE;
+    }
+
+    return REQUEST_INCOMPLETE;
+}
+
+// whether the headers and the whole body have arrived, a chunked body is decoded as it does
+static RequestProgress requestProgress(Connection *connection, size_t maxRequestSize) {
+    if (!connection->headerLength) {
+        // the terminator can straddle two reads
+        size_t from = connection->scanned > 3 ? connection->scanned - 3 : 0;
+        char *end = strstr(connection->buffer + from, "\r\n\r\n");
+        connection->scanned = connection->length;
+
+        if (!end) return REQUEST_INCOMPLETE;
+
+        connection->headerLength = end + 4 - connection->buffer;
+
+        RequestProgress framing = readFraming(connection, maxRequestSize);
+        if (framing != REQUEST_INCOMPLETE) return framing;
+    }
+
+    if (connection->chunked) {
+        char *body = connection->buffer + connection->headerLength;
+        ChunkedProgress progress = decodeChunked(&connection->chunks, body, connection->length - connection->headerLength);
+
+        // only the decoded body is kept, so the size limit applies to it and not the framing
+        connection->contentLength = connection->chunks.decoded;
+        connection->length = connection->headerLength + connection->contentLength;
+        connection->buffer[connection->length] = '\0';
+
+        if (progress == CHUNKED_INVALID) return REQUEST_INVALID;
+
+        return progress == CHUNKED_COMPLETE ? REQUEST_COMPLETE : REQUEST_INCOMPLETE;
+    }
+
+    return connection->length >= connection->headerLength + connection->contentLength ? REQUEST_COMPLETE : REQUEST_INCOMPLETE;
+}
+
+// reads whatever the client has sent so far without blocking
+static RequestProgress readRequest(Connections *open, Connection *connection, size_t maxRequestSize) {
+    for (;;) {
+        RequestProgress progress = requestProgress(connection, maxRequestSize);
+        if (progress != REQUEST_INCOMPLETE) return progress;
+
+        if (connection->length + 1 == connection->capacity) {
+            if (connection->capacity > maxRequestSize) {
+                return connection->headerLength ? REQUEST_TOO_LARGE : HEADERS_TOO_LARGE;
+            }
+
+            size_t capacity = connection->capacity * 2;
+            if (capacity > maxRequestSize + 1) capacity = maxRequestSize + 1;
+
+            // a request larger than a pooled buffer is kept whole on the heap, the parser reads it in one piece
+            connection->buffer = growBuffer(open->buffers, connection->buffer, connection->capacity, capacity);
+            connection->capacity = capacity;
+        }
+
+        ssize_t bytesRead = ioRead(open->io, connection->fd, connection->buffer + connection->length,
+            connection->capacity - 1 - connection->length);
+        if (bytesRead == 0) return REQUEST_CLOSED;
+        if (bytesRead < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return REQUEST_INCOMPLETE;
+            return REQUEST_CLOSED;
+        }
+
+        connection->length += bytesRead;
+        connection->buffer[connection->length] = '\0';
+    }
+}
+
+// a bodiless error response, sent only if the socket takes it straight away
+static void rejectConnection(int fd, HttpStatusCode status) {
+    char response[160];
+    int length = snprintf(response, sizeof(response),
+        "HTTP/1.1 %d %s\r\nContent-Length: 0\r\nConnection: close\r\n%s\r\n",
+        status, httpStatusCodeToStr(status), status == HTTP_SERVICE_UNAVAILABLE ? "Retry-After: 1\r\n" : "");
+
+#ifdef MSG_NOSIGNAL
+    ssize_t sent = send(fd, response, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+#else
+    ssize_t sent = send(fd, response, length, MSG_DONTWAIT);
+#endif
+    (void)sent;
+}
+
+static void closeConnection(Connections *open, int index) {
+    Connection *connection = &open->items[index];
+
+    // the worker still finishes it, the response is then dropped
+    if (connection->exchange && connection->exchange->coroutine) {
+        cancelExchange(connection->exchange);
+    } else if (connection->exchange) {
+        connection->exchange->abandoned = true;
+    }
+
+    ioClose(open->io, connection->fd);
+    releaseBuffer(open->buffers, connection->buffer, connection->capacity);
+    closeStream(connection->stream);
+    freeUnsent(connection->unsent);
+
+    open->items[index] = open->items[--open->count];
+}
+
+// Sends what a streamed response has queued and asks its producer for more, until the socket
+// is full or the producer waits. Returns false once the body is complete or the client is gone.
+static bool flushStream(App *app, Connection *connection) {
+    ResponseStream *stream = connection->stream;
+
+    // bounded, so one fast client with a busy producer does not hold up the rest
+    for (int round = 0; round < 64; round++) {
+        if (streamReady(stream)) {
+            streamProduce(stream);
+        }
+
+        if (stream->aborted) return false;
+
+        if (streamPending(stream) == 0) {
+            if (stream->ended) return connection->webSocket && webSocketListening(connection->webSocket);
+            if (!streamReady(stream)) break;
+            continue;
+        }
+
+        struct iovec iov[STREAM_MAX_IOVECS];
+        int iovCount = streamIovecs(stream, iov, STREAM_MAX_IOVECS);
+
+        ssize_t sent = writev(connection->fd, iov, iovCount);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+
+        streamSent(stream, sent);
+        connection->deadlineMillis = monotonicMillis() + app->server.limits.writeTimeoutMillis;
+    }
+
+    // an idle stream waits for its producer as long as the client stays, a stalled one only as long as a write may.
+    // A WebSocket's closing handshake also only gets as long as a write
+    if (streamPending(stream) == 0 && !streamReady(stream) && !stream->ended) {
+        connection->deadlineMillis = 0;
+    }
+
+    return true;
+}
+
+// Sends what is left of a response, then carries on with its stream if it has one. Returns false
+// once the response is complete or the client is gone.
+static bool flushConnection(App *app, Connection *connection) {
+    if (connection->unsent) {
+        bool done;
+        if (!sendUnsent(connection->fd, connection->unsent, &done)) {
+            perror("write response failed");
+            return false;
+        }
+        if (!done) return true;
+
+        freeUnsent(connection->unsent);
+        connection->unsent = NULL;
+        if (!connection->stream) return false;
+
+        connection->deadlineMillis = monotonicMillis() + app->server.limits.writeTimeoutMillis;
+    }
+
+    return connection->stream && flushStream(app, connection);
+}
+
+// what a streamed response's client sends is read and ignored, only its hanging up matters
+static bool clientStillThere(IoLoop *io, int fd) {
+    char discard[512];
+
+    for (;;) {
+        ssize_t bytesRead = ioRead(io, fd, discard, sizeof(discard));
+        if (bytesRead > 0) continue;
+        if (bytesRead == 0) return false;
+        if (errno == EINTR) continue;
+
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+// reads frames from a WebSocket's client, returns false once it has hung up
+static bool readWebSocket(IoLoop *io, Connection *connection) {
+    // bounded like flushStream, poll reports whatever is left
+    for (int round = 0; round < 16; round++) {
+        // after the closing handshake only the last frames going out matter
+        if (!webSocketListening(connection->webSocket)) {
+            return streamPending(connection->stream) > 0 && clientStillThere(io, connection->fd);
+        }
+
+        ssize_t bytesRead = ioRead(io, connection->fd, connection->buffer + connection->length,
+            connection->capacity - connection->length);
+        if (bytesRead == 0) return false;
+        if (bytesRead < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        connection->length += bytesRead;
+        consumeWebSocket(connection);
+    }
+
+    return true;
+}
+
+// Reads from one connection, then answers it once the request is complete or rejects it.
+// An expired connection that still has no complete request gets 408.
+static void serviceConnection(App *app, Connections *open, int index, bool expired) {
+    Connection *connection = &open->items[index];
+
+    switch (readRequest(open, connection, app->server.limits.maxRequestSize)) {
+        case REQUEST_INCOMPLETE:
+            if (!expired) return;
+            rejectConnection(connection->fd, HTTP_REQUEST_TIMEOUT);
+            break;
+        case REQUEST_COMPLETE:
+            if (handleConnection(app, open, connection) &&
+                (connection->exchange || flushConnection(app, connection))) return;
+            break;
+        case REQUEST_INVALID:
+            rejectConnection(connection->fd, HTTP_BAD_REQUEST);
+            break;
+        case REQUEST_TOO_LARGE:
+            rejectConnection(connection->fd, HTTP_PAYLOAD_TOO_LARGE);
+            break;
+        case HEADERS_TOO_LARGE:
+            rejectConnection(connection->fd, HTTP_REQUEST_HEADER_FIELDS_TOO_LARGE);
+            break;
+        case REQUEST_CLOSED:
+            break;
+    }
+
+    closeConnection(open, index);
+}
+
+// writes the response of a request that was at a worker or suspended, once it is ready
+static void completeExchange(App *app, Connections *open, int index) {
+    Connection *connection = &open->items[index];
+    Exchange *exchange = connection->exchange;
+    connection->exchange = NULL;
+
+    if (app->tracer) traceResume(&exchange->trace);
+    bool streaming = finishExchange(app, open, connection, exchange);
+    free(exchange);
+
+    if (!streaming || !flushConnection(app, connection)) {
+        closeConnection(open, index);
+    }
+}
+
+// carries on with a useAsync request once what it awaited has happened
+static void resumeExchange(App *app, Connections *open, int index) {
+    Connection *connection = &open->items[index];
+    Exchange *exchange = connection->exchange;
+
+    if (app->tracer) traceResume(&exchange->trace);
+    bool done = coroutineResume(exchange->coroutine);
+    if (app->tracer) traceSuspend();
+
+    if (!done) {
+        awaitCoroutine(connection, exchange);
+        return;
+    }
+
+    freeCoroutine(exchange->coroutine);
+    completeExchange(app, open, index);
+}
+
+// writes the responses the blocking workers have finished since the last wake-up, and resumes
+// the coroutines whose jobs are done
+static void completeBlocking(App *app, Connections *open) {
+    BlockingPool *pool = open->blocking;
+
+    clearWakeUps(pool->wakeFds[0]);
+
+    pthread_mutex_lock(&pool->lock);
+    Exchange *finished = pool->finished;
+    pool->finished = NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    while (finished) {
+        Exchange *exchange = finished;
+        finished = exchange->next;
+
+        int index = -1;
+        for (int i = 0; i < open->count && !exchange->abandoned; i++) {
+            if (open->items[i].exchange == exchange) {
+                index = i;
+                break;
+            }
+        }
+
+        if (index >= 0 && exchange->coroutine) {
+            resumeExchange(app, open, index);
+        } else if (index >= 0) {
+            completeExchange(app, open, index);
+        } else if (exchange->coroutine) {
+            coroutineWait(exchange->coroutine)->kind = AWAIT_NONE;
+            cancelExchange(exchange);
+        } else {
+            discardExchange(exchange);
+            free(exchange);
+        }
+    }
+}
+
+// accepts what is queued on the listener. Past maxConnections each new connection gets
+// an immediate 503 instead of waiting, so a burst is shed rather than left to time out
+static void acceptConnections(App *app, Connections *open, int signalFd, uint64_t wakeByMillis) {
+    // bounded, so signals and the open connections are still seen while a flood arrives
+    for (int accepted = 0; accepted < 64; accepted++) {
+        struct sockaddr_storage clientAddr;
+        socklen_t clientLen = sizeof(clientAddr);
+
+        uint64_t acceptStart = app->tracer ? traceNow() : 0;
+        int clientSocket = ioAccept(open->io, app->server.fileDescriptor, &clientAddr, &clientLen);
+        if (clientSocket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("accept failed");
+            }
+            return;
+        }
+
+        if (open->count == open->capacity) {
+            rejectConnection(clientSocket, HTTP_SERVICE_UNAVAILABLE);
+            close(clientSocket);
+            continue;
+        }
+
+        Connection *connection = &open->items[open->count++];
+        *connection = (Connection) {
+            .fd = clientSocket,
+            .address = clientAddr,
+            .acceptStart = acceptStart,
+            .readStart = app->tracer ? traceNow() : 0,
+            .deadlineMillis = monotonicMillis() + app->server.limits.readTimeoutMillis,
+            .buffer = takeBuffer(open->buffers),
+            .capacity = POOL_BUFFER_SIZE,
+        };
+        clock_gettime(CLOCK_MONOTONIC, &connection->acceptedAt);
+        ioAdopt(open->io, clientSocket);
+        connection->buffer[0] = '\0';
+
+        // the request often arrives with the connection, so try before waiting for it
+        if (wakeByMillis && monotonicMillis() >= wakeByMillis) return;
+        serviceConnection(app, open, open->count - 1, false);
+
+        if (interrupted(signalFd)) return;
+    }
+}
+
+// whether a coroutine waits for a nextShared flight that is done now, it only waits for coroutines
+// on the loop so the flight was finished on this thread
+static bool flightLanded(const Exchange *exchange) {
+    if (!exchange || !exchange->coroutine) return false;
+
+    const CoroutineWait *wait = coroutineWait(exchange->coroutine);
+    return wait->kind == AWAIT_FLIGHT && wait->flight->done;
+}
+
+// Waits for the next thing to do and does it: a signal, a key, new connections or data
+// from open ones. Connections whose read deadline has passed are closed with 408.
+// Returns after one round, or at wakeByMillis (0 for no bound).
+static void pollConnections(App *app, Connections *open, int signalFd, bool *keyControls, bool accepting,
+                            uint64_t wakeByMillis) {
+    uint64_t now = monotonicMillis();
+    uint64_t nextDeadline = wakeByMillis;
+    for (int i = 0; i < open->count; i++) {
+        // a coroutine whose flight was finished by another is resumed without waiting
+        if (flightLanded(open->items[i].exchange)) {
+            nextDeadline = now;
+            break;
+        }
+
+        uint64_t deadline = open->items[i].deadlineMillis;
+        if (deadline && (!nextDeadline || deadline < nextDeadline)) {
+            nextDeadline = deadline;
+        }
+    }
+
+    int timeout = -1;
+    if (nextDeadline) {
+        timeout = nextDeadline > now ? (int)(nextDeadline - now) : 0;
+    }
+
+    struct pollfd *fds = open->fds;
+    fds[0] = (struct pollfd){ .fd = accepting ? app->server.fileDescriptor : -1, .events = POLLIN };
+    fds[1] = (struct pollfd){ .fd = signalFd, .events = POLLIN };
+    fds[2] = (struct pollfd){ .fd = *keyControls ? STDIN_FILENO : -1, .events = POLLIN };
+    fds[3] = (struct pollfd){ .fd = app->events ? eventHubFd(app->events) : -1, .events = POLLIN };
+    fds[4] = (struct pollfd){ .fd = open->blocking ? open->blocking->wakeFds[0] : -1, .events = POLLIN };
+    for (int i = 0; i < open->count; i++) {
+        const ResponseStream *stream = open->items[i].stream;
+
+        // nothing to read until the worker is done with its request, or until what a suspended
+        // coroutine awaits is ready
+        if (open->items[i].exchange) {
+            const Coroutine *coroutine = open->items[i].exchange->coroutine;
+            const CoroutineWait *wait = coroutine ? coroutineWait((Coroutine *)coroutine) : NULL;
+
+            fds[FIXED_POLL_FDS + i] = wait && wait->kind == AWAIT_FD ?
+                (struct pollfd){ .fd = wait->fd, .events = wait->events } : (struct pollfd){ .fd = -1 };
+            continue;
+        }
+
+        // the rest of a response goes out before anything else happens on the connection
+        if (open->items[i].unsent) {
+            fds[FIXED_POLL_FDS + i] = (struct pollfd){ .fd = open->items[i].fd, .events = POLLOUT };
+            continue;
+        }
+
+        short events = POLLIN;
+        if (stream && (streamPending(stream) || streamReady(stream))) {
+            events |= POLLOUT;
+        }
+        fds[FIXED_POLL_FDS + i] = (struct pollfd){ .fd = open->items[i].fd, .events = events };
+    }
+
+    int ready = ioWait(open->io, fds, FIXED_POLL_FDS + open->count, timeout);
+    if (ready < 0) {
+        if (errno != EINTR) {
+            perror("poll failed");
+        }
+        return;
+    }
+
+    if (fds[1].revents & POLLIN) {
+        handleSignals(signalFd);
+    }
+
+    if (fds[2].revents & (POLLIN | POLLHUP)) {
+        *keyControls = readKeys();
+    }
+
+    if (fds[3].revents & POLLIN) {
+        deliverEvents(app->events);
+    }
+    // backwards, as closing one moves the last connection into its place
+    now = monotonicMillis();
+    for (int i = open->count - 1; i >= 0; i--) {
+        // requests are answered one after another, so the time can run out part way through
+        if (wakeByMillis) {
+            now = monotonicMillis();
+            if (now >= wakeByMillis) return;
+        }
+
+        short revents = fds[FIXED_POLL_FDS + i].revents;
+        uint64_t deadline = open->items[i].deadlineMillis;
+        bool expired = deadline && deadline <= now;
+
+        if (open->items[i].exchange) {
+            Exchange *exchange = open->items[i].exchange;
+            if (flightLanded(exchange)) {
+                coroutineWait(exchange->coroutine)->ready = true;
+                resumeExchange(app, open, i);
+                continue;
+            }
+            if (!exchange->coroutine || !(revents || expired)) continue;
+
+            CoroutineWait *wait = coroutineWait(exchange->coroutine);
+            if (wait->kind != AWAIT_FD) continue;
+
+            wait->ready = revents && !(revents & POLLNVAL);
+            resumeExchange(app, open, i);
+            continue;
+        }
+
+        if (open->items[i].unsent) {
+            bool alive = !expired && !(revents & POLLERR);
+            if (alive && revents) {
+                alive = flushConnection(app, &open->items[i]);
+            }
+            if (!alive) {
+                closeConnection(open, i);
+            }
+            continue;
+        }
+
+        if (open->items[i].stream) {
+            Connection *connection = &open->items[i];
+
+            bool alive = !expired && !(revents & POLLERR);
+            if (alive && (revents & (POLLIN | POLLHUP))) {
+                alive = connection->webSocket ? readWebSocket(open->io, connection) : clientStillThere(open->io, connection->fd);
+            }
+            // also for chunks written from elsewhere since the poll began, such as published events
+            if (alive && (revents & POLLOUT || streamPending(connection->stream) || connection->stream->aborted)) {
+                alive = flushStream(app, connection);
+            }
+            if (!alive) {
+                closeConnection(open, i);
+            }
+            continue;
+        }
+
+        bool readable = revents != 0;
+
+        if (readable || expired) {
+            serviceConnection(app, open, i, expired);
+
+            if (interrupted(signalFd)) return;
+        }
+    }
+
+    // after the connections, completing closes some and so moves others within the poll set
+    if (fds[4].revents & POLLIN) {
+        completeBlocking(app, open);
+    }
+
+    // io_uring accepts ahead, what it already has is served even once the listener is no longer polled
+    if ((accepting && (fds[0].revents & POLLIN)) || ioAcceptQueued(open->io)) {
+        acceptConnections(app, open, signalFd, wakeByMillis);
+    }
+}
+
+// An idle stream, such as an event feed waiting for its next event, would hold up a reload or
+// shutdown for good. It is finished instead, and its client reconnects to whoever serves next.
+// WebSockets are told the server is going away.
+static void endIdleStreams(App *app, Connections *open) {
+    for (int i = 0; i < open->count; i++) {
+        Connection *connection = &open->items[i];
+        ResponseStream *stream = connection->stream;
+        if (!stream || stream->ended) continue;
+
+        if (connection->webSocket) {
+            webSocketClose(connection->webSocket, WEBSOCKET_GOING_AWAY, "server restarting");
+        } else if (stream->paused) {
+            streamEnd(stream);
+        } else {
+            continue;
+        }
+
+        connection->deadlineMillis = monotonicMillis() + app->server.limits.writeTimeoutMillis;
+    }
+}
+
+// a pool for the useBlocking and useAsync routes, NULL when there are none
+static BlockingPool *openBlockingPool(App *app, int capacity) {
+    Router *router = &app->server.router;
+
+    bool needed = false;
+    for (int i = 0; i < router->routeCount; i++) {
+        const MiddlewareHandler *middleware = router->routes[i].middleware;
+        if (middleware && (middleware->blocking || middleware->async)) {
+            needed = true;
+        }
+    }
+    if (!needed) return NULL;
+
+    BlockingPool *pool = calloc(1, sizeof(BlockingPool));
+    if (!pool) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // a connection waits for at most one request, so the queue never fills
+    int threads = app->server.limits.blockingThreads > 0 ? app->server.limits.blockingThreads : 8;
+    pool->workers = initJobQueue(threads, capacity);
+    pthread_mutex_init(&pool->lock, NULL);
+    openWakeFds(pool->wakeFds);
+
+    return pool;
+}
+
+// waits for the requests still at a worker, their connections are closed by now
+static void closeBlockingPool(BlockingPool *pool) {
+    if (!pool) return;
+
+    freeJobQueue(pool->workers);
+
+    while (pool->finished) {
+        Exchange *exchange = pool->finished;
+        pool->finished = exchange->next;
+
+        discardExchange(exchange);
+        free(exchange);
+    }
+
+    closeWakeFds(pool->wakeFds);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+// the connection cap, lowered to fit the descriptors this process may open
+static int connectionCapacity(const ServerLimits *limits) {
+    int capacity = limits->maxConnections > 0 ? limits->maxConnections : 1;
+
+    struct rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur != RLIM_INFINITY) {
+        // leave room for the listener, log files, the database and static files
+        rlim_t available = files.rlim_cur > 64 ? files.rlim_cur - 64 : 1;
+
+        if ((rlim_t)capacity > available) {
+            fprintf(stderr, "Serving at most %d connections at once, the open file limit is %llu.\n",
+                (int)available, (unsigned long long)files.rlim_cur);
+            capacity = (int)available;
+        }
+    }
+
+    return capacity;
+}
+
+void runServer(App *app) {
+    if (!app) return;
+
+    // a client that disconnects mid-response is an error on that write, not the end of the process
+    signal(SIGPIPE, SIG_IGN);
+
+    int signalFd = openSignalFd();
+
+    bool keyControls = useKeyControls(app);
+    if (keyControls) {
+        set_nonblocking_input();
+    }
+
+    BindAddress bindAddress;
+    if (!resolveBindAddress(app->server.bindAddress, app->server.port, &bindAddress)) {
+        fprintf(stderr, "Cannot bind to '%s', it is not an IP address, a network interface or unix:<path>.\n",
+            app->server.bindAddress);
+        exit(EXIT_FAILURE);
+    }
+
+    app->server.fileDescriptor = inheritedListener(&bindAddress);
+    if (app->server.fileDescriptor >= 0) {
+        // the previous image may have used another backlog, listen again to apply ours
+        listen(app->server.fileDescriptor, app->server.limits.backlog);
+
+        char url[160];
+        formatListenUrl(&bindAddress, url, sizeof(url));
+        printf("Reloaded, still listening on %s\n", url);
+    } else {
+        listenOn(app, &bindAddress, keyControls);
+    }
+
+    int flags = fcntl(app->server.fileDescriptor, F_GETFL, 0);
+    if (flags == -1) {
+        perror("fcntl get flags failed");
+        exit(EXIT_FAILURE);
+    }
+    if (fcntl(app->server.fileDescriptor, F_SETFL, flags | O_NONBLOCK) == -1) {
+        perror("fcntl set non-blocking failed");
+        exit(EXIT_FAILURE);
+    }
+
+    Connections open = { .capacity = connectionCapacity(&app->server.limits) };
+    open.items = malloc(sizeof(Connection) * open.capacity);
+    open.fds = malloc(sizeof(struct pollfd) * (FIXED_POLL_FDS + open.capacity));
+    if (!open.items || !open.fds) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    open.blocking = openBlockingPool(app, open.capacity);
+
+    open.buffers = initBufferPool(POOL_BUFFER_SIZE);
+    open.io = openIoLoop(open.capacity);
+    ioListen(open.io, app->server.fileDescriptor);
+    ioWatch(open.io, signalFd);
+    ioWatch(open.io, keyControls ? STDIN_FILENO : -1);
+    ioWatch(open.io, app->events ? eventHubFd(app->events) : -1);
+    ioWatch(open.io, open.blocking ? open.blocking->wakeFds[0] : -1);
+
+    serverState = STATE_RUNNING;
+
+    while (serverState != STATE_SHUTDOWN) {
+        bool reloading = serverState == STATE_RESTARTING || serverState == STATE_RELOADING;
+        if (reloading) {
+            endIdleStreams(app, &open);
+        }
+
+        // a reload waits for the open connections, new ones queue in the backlog for the next image
+        if (reloading && open.count == 0 && !ioAcceptQueued(open.io)) {
+            // A request whose connection closed can still be at a blocking worker, or a cancelled
+            // coroutine waiting on one. Exec would stop it part way, so it finishes first.
+            if (open.blocking) {
+                drainJobQueue(open.blocking->workers);
+                completeBlocking(app, &open);
+            }
+
+            // responses and closes still queued on the ring go out before exec
+            ioDrain(open.io);
+            reloadServer(app, serverState == STATE_RESTARTING);
+
+            // still here, so keep serving with this image
+            serverState = STATE_RUNNING;
+            continue;
+        }
+
+        pollConnections(app, &open, signalFd, &keyControls, !reloading, 0);
+    }
+
+    // Take what was already queued when the shutdown began, then answer the open connections
+    // until the shutdown timeout. A second SIGTERM or SIGINT stops waiting.
+    uint64_t deadline = monotonicMillis() + (app->server.shutdownTimeoutMillis > 0 ? app->server.shutdownTimeoutMillis : 0);
+    acceptConnections(app, &open, signalFd, deadline);
+
+    while (open.count > 0 || ioAcceptQueued(open.io)) {
+        endIdleStreams(app, &open);
+
+        if (monotonicMillis() >= deadline) {
+            fprintf(stderr, "Shutdown timeout reached, closing %d open connection(s).\n", open.count);
+            break;
+        }
+
+        pollConnections(app, &open, signalFd, &keyControls, false, deadline);
+
+        if (shutdownForced) {
+            fprintf(stderr, "Shutting down without waiting for %d open connection(s).\n", open.count);
+            break;
+        }
+    }
+
+    // told to come back, rather than left to guess why the connection closed.
+    // A stream, or a response still being sent, is part way through, so it is just cut off
+    while (open.count > 0) {
+        if (!open.items[open.count - 1].stream && !open.items[open.count - 1].unsent) {
+            rejectConnection(open.items[open.count - 1].fd, HTTP_SERVICE_UNAVAILABLE);
+        }
+        closeConnection(&open, open.count - 1);
+    }
+    while (ioAcceptQueued(open.io)) {
+        struct sockaddr_storage address;
+        socklen_t addressLength = sizeof(address);
+        int fd = ioAccept(open.io, app->server.fileDescriptor, &address, &addressLength);
+
+        rejectConnection(fd, HTTP_SERVICE_UNAVAILABLE);
+        close(fd);
+    }
+    closeIoLoop(open.io);
+    closeBlockingPool(open.blocking);
+    freeBufferPool(open.buffers);
+    free(open.items);
+    free(open.fds);
+
+    close(app->server.fileDescriptor);
+    app->server.fileDescriptor = -1;
+
+    // only on shutdown, a reload keeps serving on the same socket file
+    if (bindAddress.address.ss_family == AF_UNIX) {
+        unlink(((struct sockaddr_un *)&bindAddress.address)->sun_path);
+    }
+
+    restore_input();
+    closeSignalFd(signalFd);
+
+    fflush(stdout);
+    fflush(stderr);
 }
\ No newline at end of file
@@ -16,7 +16,8 @@ DbContext *createSqlLite3DbContext(char *dbPath) {
     context->type = SQLITE;
 
     sqlite3 *db;
-    int rc = sqlite3_open(dbPath, &db);
+    // serialized, as job threads share the connection with the server
+    int rc = sqlite3_open_v2(dbPath, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, NULL);
     if (rc != SQLITE_OK) {
         printf("Cannot open database: %s\n", sqlite3_errmsg(db));
         return NULL;
@@ -157,9 +158,34 @@ DbResult *dbQueryRows(DbContext *db, const char *query, DbParam *params, int par
     return result;
 }
 
+void freeDbResult(DbResult *result) {
+    if (!result) return;
+
+    for (int i = 0; i < result->rowCount; i++) {
+        DbRow *row = &result->rows[i];
+
+        for (int j = 0; j < row->colCount; j++) {
+            free(row->colNames[j]);
+            free(row->colValues[j]);
+        }
+
+        free(row->colNames);
+        free(row->colValues);
+    }
+
+    free(result->rows);
+    free(result);
+}
+
 bool dbClose(DbContext *db) {
-    if (db->type == SQLITE) {
-        sqlite3_close((sqlite3 *)db->connection);
+    if (db->type == SQLITE && db->connection) {
+        // SQLITE_BUSY while a statement has not been finalized
+        if (sqlite3_close((sqlite3 *)db->connection) != SQLITE_OK) {
+            fprintf(stderr, "Failed to close database: %s\n", sqlite3_errmsg((sqlite3 *)db->connection));
+            return false;
+        }
+
+        db->connection = NULL;
     }
 
     return true;
@@ -0,0 +1,270 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/sse.h"
+#include "include/app.h"
+#include "include/utils.h"
+
+struct EventSubscriber {
+    EventHub       *hub;
+    char           *topic;
+    ResponseStream *stream;
+    size_t          index;  // in its topic's subscribers, SIZE_MAX until it has joined
+};
+
+EventHub *initEventHub(void) {
+    EventHub *hub = calloc(1, sizeof(EventHub));
+    if (!hub) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_init(&hub->lock, NULL);
+    openWakeFds(hub->wakeFds);
+
+    return hub;
+}
+
+static void freePublished(PublishedEvent *event) {
+    while (event) {
+        PublishedEvent *next = event->next;
+
+        releaseChunk(event->frame);
+        free(event->topic);
+        free(event);
+
+        event = next;
+    }
+}
+
+void freeEventHub(EventHub *hub) {
+    if (!hub) return;
+
+    freePublished(hub->head);
+
+    // the server has closed every stream by now, and with them the subscriptions
+    for (size_t i = 0; i < hub->topicCount; i++) {
+        free(hub->topics[i].name);
+        free(hub->topics[i].subscribers);
+    }
+    free(hub->topics);
+
+    closeWakeFds(hub->wakeFds);
+
+    pthread_mutex_destroy(&hub->lock);
+    free(hub);
+}
+
+int eventHubFd(const EventHub *hub) {
+    return hub->wakeFds[0];
+}
+
+static EventTopic *findTopic(const EventHub *hub, const char *name) {
+    for (size_t i = 0; i < hub->topicCount; i++) {
+        if (strcmp(hub->topics[i].name, name) == 0) return &hub->topics[i];
+    }
+
+    return NULL;
+}
+
+// "event: name\ndata: line\n" for each line of data, then a blank line
+static char *formatEvent(const char *name, const char *data, size_t *length) {
+    size_t lines = 1;
+    for (const char *c = data; *c; c++) {
+        if (*c == '\n') lines++;
+    }
+
+    size_t capacity = (name ? strlen(name) + 8 : 0) + strlen(data) + lines * 7 + 2;
+    char *event = malloc(capacity);
+    if (!event) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    char *out = event;
+    if (name) {
+        // a CR or LF in the name would start a field of its own, so they are left out
+        memcpy(out, "event: ", 7);
+        out += 7;
+        for (const char *c = name; *c; c++) {
+            if (*c != '\r' && *c != '\n') *out++ = *c;
+        }
+        *out++ = '\n';
+    }
+
+    const char *line = data;
+    for (;;) {
+        const char *end = strchr(line, '\n');
+        size_t lineLength = end ? (size_t)(end - line) : strlen(line);
+
+        // a CR would end the line early for the client
+        if (lineLength && line[lineLength - 1] == '\r') lineLength--;
+
+        memcpy(out, "data: ", 6);
+        memcpy(out + 6, line, lineLength);
+        out[6 + lineLength] = '\n';
+        out += lineLength + 7;
+
+        if (!end) break;
+        line = end + 1;
+    }
+
+    *out++ = '\n';
+    *length = out - event;
+
+    return event;
+}
+
+void publishEvent(EventHub *hub, const char *topic, const char *name, const char *data) {
+    if (!hub) return;
+
+    // framed here, off the server's thread, and then shared by every subscriber
+    size_t length;
+    char *text = formatEvent(name, data ? data : "", &length);
+
+    PublishedEvent *event = malloc(sizeof(PublishedEvent));
+    if (!event) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    *event = (PublishedEvent){ .topic = strdup(topic), .frame = frameChunk(text, length) };
+    free(text);
+
+    pthread_mutex_lock(&hub->lock);
+    bool wasEmpty = hub->head == NULL;
+    if (hub->tail) {
+        hub->tail->next = event;
+    } else {
+        hub->head = event;
+    }
+    hub->tail = event;
+    pthread_mutex_unlock(&hub->lock);
+
+    // already awake otherwise
+    if (wasEmpty) {
+        wakeUp(hub->wakeFds);
+    }
+}
+
+void deliverEvents(EventHub *hub) {
+    clearWakeUps(hub->wakeFds[0]);
+
+    pthread_mutex_lock(&hub->lock);
+    PublishedEvent *events = hub->head;
+    hub->head = hub->tail = NULL;
+    pthread_mutex_unlock(&hub->lock);
+
+    for (PublishedEvent *event = events; event; event = event->next) {
+        EventTopic *topic = findTopic(hub, event->topic);
+        if (!topic) continue;
+
+        for (size_t i = 0; i < topic->count; i++) {
+            ResponseStream *stream = topic->subscribers[i]->stream;
+            if (stream->ended) continue;
+
+            // a client that stopped reading is cut off rather than buffered for without end
+            if (streamPending(stream) + event->frame->length > SSE_MAX_PENDING) {
+                hub->dropped++;
+                streamAbort(stream);
+                continue;
+            }
+
+            streamWriteChunk(stream, event->frame);
+        }
+    }
+
+    freePublished(events);
+}
+
+static void joinTopic(EventSubscriber *subscriber) {
+    EventHub *hub = subscriber->hub;
+
+    EventTopic *topic = findTopic(hub, subscriber->topic);
+    if (!topic) {
+        if (hub->topicCount == hub->topicCapacity) {
+            hub->topicCapacity = hub->topicCapacity ? hub->topicCapacity * 2 : 8;
+            hub->topics = realloc(hub->topics, hub->topicCapacity * sizeof(EventTopic));
+            if (!hub->topics) {
+                fprintf(stderr, "Fatal: out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        topic = &hub->topics[hub->topicCount++];
+        *topic = (EventTopic){ .name = strdup(subscriber->topic) };
+    }
+
+    if (topic->count == topic->capacity) {
+        topic->capacity = topic->capacity ? topic->capacity * 2 : 16;
+        topic->subscribers = realloc(topic->subscribers, topic->capacity * sizeof(EventSubscriber *));
+        if (!topic->subscribers) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    subscriber->index = topic->count;
+    topic->subscribers[topic->count++] = subscriber;
+}
+
+// called once the stream has its headers out, from then on it only receives what is published
+static StreamStatus startSubscription(ResponseStream *stream, void *state) {
+    EventSubscriber *subscriber = state;
+
+    if (subscriber->index == SIZE_MAX) {
+        subscriber->stream = stream;
+        joinTopic(subscriber);
+
+        // a comment, so the client and any proxy see the stream is live
+        streamWrite(stream, ": subscribed\n\n", 14);
+    }
+
+    return STREAM_PAUSE;
+}
+
+static void endSubscription(void *state) {
+    EventSubscriber *subscriber = state;
+
+    if (subscriber->index != SIZE_MAX) {
+        EventTopic *topic = findTopic(subscriber->hub, subscriber->topic);
+
+        // the last subscriber takes its place
+        EventSubscriber *moved = topic->subscribers[--topic->count];
+        topic->subscribers[subscriber->index] = moved;
+        moved->index = subscriber->index;
+    }
+
+    free(subscriber->topic);
+    free(subscriber);
+}
+
+HttpResponse subscribeEvents(RequestContext ctx, const char *topic) {
+    EventHub *hub = ctx.app->events;
+    if (!hub) {
+        fprintf(stderr, "subscribeEvents: call useServerSentEvents before subscribing to %s\n", topic);
+        return internalServerError("", TEXT_PLAIN);
+    }
+
+    EventSubscriber *subscriber = malloc(sizeof(EventSubscriber));
+    if (!subscriber) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    *subscriber = (EventSubscriber){ .hub = hub, .topic = strdup(topic), .index = SIZE_MAX };
+
+    HttpResponse response = streamResponse("text/event-stream", startSubscription, endSubscription, subscriber);
+
+    addResponseHeader(&response, "Cache-Control", "no-cache");
+    // nginx would otherwise hold events back to fill its buffer
+    addResponseHeader(&response, "X-Accel-Buffering", "no");
+
+    return response;
+}
+
+size_t topicSubscribers(const EventHub *hub, const char *topic) {
+    const EventTopic *found = findTopic(hub, topic);
+
+    return found ? found->count : 0;
+}
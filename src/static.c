@@ -0,0 +1,484 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "include/static.h"
+#include "include/router.h"
+#include "include/app.h"
+#include "include/compress.h"
+
+#ifdef __APPLE__
+#define statModified(st) ((st).st_mtimespec)
+#else
+#define statModified(st) ((st).st_mtim)
+#endif
+
+typedef struct {
+    const char *extension;
+    const char *mimeType;
+} MimeType;
+
+static const MimeType mimeTypes[] = {
+    { "html",  "text/html; charset=utf-8" },
+    { "htm",   "text/html; charset=utf-8" },
+    { "css",   "text/css; charset=utf-8" },
+    { "js",    "text/javascript; charset=utf-8" },
+    { "mjs",   "text/javascript; charset=utf-8" },
+    { "json",  "application/json" },
+    { "map",   "application/json" },
+    { "txt",   "text/plain; charset=utf-8" },
+    { "xml",   "application/xml" },
+    { "csv",   "text/csv" },
+    { "svg",   "image/svg+xml" },
+    { "png",   "image/png" },
+    { "jpg",   "image/jpeg" },
+    { "jpeg",  "image/jpeg" },
+    { "gif",   "image/gif" },
+    { "webp",  "image/webp" },
+    { "avif",  "image/avif" },
+    { "ico",   "image/x-icon" },
+    { "woff",  "font/woff" },
+    { "woff2", "font/woff2" },
+    { "ttf",   "font/ttf" },
+    { "otf",   "font/otf" },
+    { "wasm",  "application/wasm" },
+    { "pdf",   "application/pdf" },
+    { "zip",   "application/zip" },
+    { "mp4",   "video/mp4" },
+    { "webm",  "video/webm" },
+    { "mp3",   "audio/mpeg" },
+    { "wav",   "audio/wav" },
+};
+
+const char *mimeTypeForPath(const char *path) {
+    const char *dot = strrchr(path, '.');
+    const char *slash = strrchr(path, '/');
+
+    if (dot && (!slash || dot > slash)) {
+        for (size_t i = 0; i < sizeof(mimeTypes) / sizeof(mimeTypes[0]); i++) {
+            if (strcasecmp(dot + 1, mimeTypes[i].extension) == 0) {
+                return mimeTypes[i].mimeType;
+            }
+        }
+    }
+
+    return "application/octet-stream";
+}
+
+static uint64_t hashPath(const char *path) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+StaticFiles *initStaticFiles(void) {
+    StaticFiles *files = calloc(1, sizeof(StaticFiles));
+    if (!files) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    files->mountCapacity = 1;
+    files->mounts = malloc(sizeof(StaticMount) * files->mountCapacity);
+
+    files->bucketCount = 256;
+    files->buckets = calloc(files->bucketCount, sizeof(StaticCacheEntry *));
+
+    if (!files->mounts || !files->buckets) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_init(&files->lock, NULL);
+
+    return files;
+}
+
+static void unlinkEntry(StaticFiles *files, StaticCacheEntry *entry) {
+    if (entry->prev) entry->prev->next = entry->next;
+    else files->head = entry->next;
+
+    if (entry->next) entry->next->prev = entry->prev;
+    else files->tail = entry->prev;
+
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+static void pushFront(StaticFiles *files, StaticCacheEntry *entry) {
+    entry->prev = NULL;
+    entry->next = files->head;
+
+    if (files->head) files->head->prev = entry;
+    files->head = entry;
+
+    if (!files->tail) files->tail = entry;
+}
+
+// lets go of one reference, the last one frees the entry. Needs no lock, it is out of the cache by then
+static void releaseEntry(void *owner) {
+    StaticCacheEntry *entry = owner;
+    if (__atomic_sub_fetch(&entry->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+
+    free(entry->data);
+    free(entry->path);
+    free(entry);
+}
+
+// drops the entry from the cache, responses still holding it keep it until they are written
+static void removeEntry(StaticFiles *files, StaticCacheEntry *entry) {
+    StaticCacheEntry **slot = &files->buckets[entry->hash & (files->bucketCount - 1)];
+    while (*slot && *slot != entry) {
+        slot = &(*slot)->bucketNext;
+    }
+    if (*slot) *slot = entry->bucketNext;
+
+    unlinkEntry(files, entry);
+    files->cachedBytes -= entry->size;
+
+    releaseEntry(entry);
+}
+
+void freeStaticFiles(StaticFiles *files) {
+    if (!files) return;
+
+    while (files->head) {
+        removeEntry(files, files->head);
+    }
+
+    for (int i = 0; i < files->mountCount; i++) {
+        free(files->mounts[i].prefix);
+        free(files->mounts[i].directory);
+    }
+
+    free(files->mounts);
+    free(files->buckets);
+    pthread_mutex_destroy(&files->lock);
+    free(files);
+}
+
+void addStaticMount(StaticFiles *files, const char *prefix, const char *directory) {
+    if (files->mountCount >= files->mountCapacity) {
+        files->mountCapacity *= 2;
+        files->mounts = realloc(files->mounts, sizeof(StaticMount) * files->mountCapacity);
+
+        if (!files->mounts) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // stored without a trailing slash so "/assets" and "/assets/" behave the same
+    char *normalizedPrefix = strdup(prefix);
+    size_t prefixLength = strlen(normalizedPrefix);
+    while (prefixLength > 0 && normalizedPrefix[prefixLength - 1] == '/') {
+        normalizedPrefix[--prefixLength] = '\0';
+    }
+
+    files->mounts[files->mountCount++] = (StaticMount) {
+        .prefix = normalizedPrefix,
+        .directory = strdup(directory),
+    };
+}
+
+// Reads the whole file, as long as it is still the one st describes. It is read rather than mapped,
+// a mapping of a file truncated while it is served would fault.
+static void *readWholeFile(const char *filePath, const struct stat *st) {
+    int fd = open(filePath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    struct stat current;
+    if (fstat(fd, &current) < 0 || current.st_ino != st->st_ino || current.st_size != st->st_size) {
+        close(fd);
+        return NULL;
+    }
+
+    char *data = malloc(st->st_size);
+    if (!data) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    off_t filled = 0;
+    while (filled < st->st_size) {
+        ssize_t n = read(fd, data + filled, st->st_size - filled);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        filled += n;
+    }
+    close(fd);
+
+    if (filled != st->st_size) {
+        free(data);
+        return NULL;
+    }
+
+    return data;
+}
+
+// The cached contents of the file while they still match what is on disk, read again otherwise.
+// The caller gets a reference of its own, released with releaseEntry once the response is written.
+static StaticCacheEntry *cachedFile(StaticFiles *files, const char *filePath, const struct stat *st) {
+    uint64_t hash = hashPath(filePath);
+
+    pthread_mutex_lock(&files->lock);
+
+    StaticCacheEntry *entry = files->buckets[hash & (files->bucketCount - 1)];
+    while (entry && !(entry->hash == hash && strcmp(entry->path, filePath) == 0)) {
+        entry = entry->bucketNext;
+    }
+
+    if (entry) {
+        bool unchanged = entry->inode == st->st_ino && entry->size == st->st_size &&
+            entry->modified.tv_sec == statModified(*st).tv_sec &&
+            entry->modified.tv_nsec == statModified(*st).tv_nsec;
+
+        if (unchanged) {
+            unlinkEntry(files, entry);
+            pushFront(files, entry);
+            __atomic_add_fetch(&entry->refs, 1, __ATOMIC_RELAXED);
+
+            pthread_mutex_unlock(&files->lock);
+            return entry;
+        }
+
+        removeEntry(files, entry);
+    }
+
+    pthread_mutex_unlock(&files->lock);
+
+    // read without the lock, hits on other files need not wait for the disk
+    void *data = readWholeFile(filePath, st);
+    if (!data) return NULL;
+
+    entry = malloc(sizeof(StaticCacheEntry));
+    if (!entry) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *entry = (StaticCacheEntry) {
+        .path = strdup(filePath),
+        .hash = hash,
+        .inode = st->st_ino,
+        .size = st->st_size,
+        .modified = statModified(*st),
+        .data = data,
+        // the cache's and the caller's
+        .refs = 2,
+    };
+
+    pthread_mutex_lock(&files->lock);
+
+    // another request may have read the same file meanwhile, the newer read replaces it
+    StaticCacheEntry *existing = files->buckets[hash & (files->bucketCount - 1)];
+    while (existing && !(existing->hash == hash && strcmp(existing->path, filePath) == 0)) {
+        existing = existing->bucketNext;
+    }
+    if (existing) removeEntry(files, existing);
+
+    StaticCacheEntry **bucket = &files->buckets[hash & (files->bucketCount - 1)];
+    entry->bucketNext = *bucket;
+    *bucket = entry;
+
+    pushFront(files, entry);
+    files->cachedBytes += entry->size;
+
+    while (files->cachedBytes > STATIC_CACHE_MAX_BYTES && files->tail != entry) {
+        removeEntry(files, files->tail);
+    }
+
+    pthread_mutex_unlock(&files->lock);
+
+    return entry;
+}
+
+// ETag and If-None-Match may hold a list of tags, a weak match is enough for GET
+static bool etagMatches(const char *ifNoneMatch, const char *etag) {
+    if (strcmp(ifNoneMatch, "*") == 0) return true;
+
+    size_t etagLength = strlen(etag);
+    const char *p = ifNoneMatch;
+
+    while (*p) {
+        while (*p == ' ' || *p == ',') p++;
+        if (strncmp(p, "W/", 2) == 0) p += 2;
+
+        if (strncmp(p, etag, etagLength) == 0 && (p[etagLength] == '\0' || p[etagLength] == ',' || p[etagLength] == ' ')) {
+            return true;
+        }
+
+        while (*p && *p != ',') p++;
+    }
+
+    return false;
+}
+
+// a precompressed sibling is only trusted while it is at least as new as the file it was built from
+static bool freshSibling(const char *siblingPath, const struct stat *original, struct stat *sibling) {
+    if (stat(siblingPath, sibling) < 0 || !S_ISREG(sibling->st_mode)) return false;
+
+    struct timespec siblingModified = statModified(*sibling);
+    struct timespec originalModified = statModified(*original);
+
+    return siblingModified.tv_sec > originalModified.tv_sec ||
+        (siblingModified.tv_sec == originalModified.tv_sec && siblingModified.tv_nsec >= originalModified.tv_nsec);
+}
+
+static HttpResponse serveRegularFile(StaticFiles *files, const HttpRequest *request, const char *filePath, struct stat st) {
+    const char *contentType = mimeTypeForPath(filePath);
+    bool compressible = isCompressibleType(contentType);
+
+    // serve file.br or file.gz in place of file when the client takes that encoding
+    char siblingPath[4096];
+    ContentEncoding encoding = ENCODING_IDENTITY;
+    const char *acceptEncoding = request ? findHeader(request, "Accept-Encoding") : NULL;
+
+    if (compressible && acceptEncoding) {
+        struct stat brotli, gzip;
+        unsigned available = 0;
+
+        snprintf(siblingPath, sizeof(siblingPath), "%s.br", filePath);
+        if (freshSibling(siblingPath, &st, &brotli)) available |= ENCODING_MASK(ENCODING_BR);
+
+        snprintf(siblingPath, sizeof(siblingPath), "%s.gz", filePath);
+        if (freshSibling(siblingPath, &st, &gzip)) available |= ENCODING_MASK(ENCODING_GZIP);
+
+        encoding = negotiateEncoding(acceptEncoding, available);
+        if (encoding != ENCODING_IDENTITY) {
+            snprintf(siblingPath, sizeof(siblingPath), "%s.%s", filePath, encoding == ENCODING_BR ? "br" : "gz");
+            filePath = siblingPath;
+            st = encoding == ENCODING_BR ? brotli : gzip;
+        }
+    }
+
+    char etag[64];
+    snprintf(etag, sizeof(etag), "\"%llx-%llx-%lx\"",
+        (unsigned long long)st.st_size, (unsigned long long)statModified(st).tv_sec, (long)statModified(st).tv_nsec);
+
+    struct tm modified;
+    char lastModified[64];
+    gmtime_r(&statModified(st).tv_sec, &modified);
+    strftime(lastModified, sizeof(lastModified), "%a, %d %b %Y %H:%M:%S GMT", &modified);
+
+    HttpResponse response = {
+        .status = HTTP_OK,
+        .contentType = (char *)contentType,
+    };
+
+    addResponseHeader(&response, "ETag", etag);
+    addResponseHeader(&response, "Last-Modified", lastModified);
+
+    if (compressible) {
+        addResponseHeader(&response, "Vary", "Accept-Encoding");
+    }
+    if (encoding != ENCODING_IDENTITY) {
+        addResponseHeader(&response, "Content-Encoding", contentEncodingName(encoding));
+    }
+
+    const char *ifNoneMatch = request ? findHeader(request, "If-None-Match") : NULL;
+    if (ifNoneMatch && etagMatches(ifNoneMatch, etag)) {
+        response.status = HTTP_NOT_MODIFIED;
+        response.content = "";
+        return response;
+    }
+
+    if (st.st_size == 0) {
+        response.content = "";
+        return response;
+    }
+
+    if (files && st.st_size <= STATIC_CACHE_MAX_FILE) {
+        StaticCacheEntry *entry = cachedFile(files, filePath, &st);
+        if (entry) {
+            response.content = entry->data;
+            response.contentLength = st.st_size;
+            response.releaseContent = releaseEntry;
+            response.contentOwner = entry;
+            return response;
+        }
+    }
+
+    // large or unreadable files are streamed by the server with sendfile(2)
+    int fd = open(filePath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        free(response.headers);
+        return notFound("Not Found", TEXT_PLAIN);
+    }
+
+    response.content = "";
+    response.contentLength = st.st_size;
+    response.bodyFile = true;
+    response.fileDescriptor = fd;
+
+    return response;
+}
+
+HttpResponse serveFile(StaticFiles *files, const HttpRequest *request, const char *filePath) {
+    struct stat st;
+    if (stat(filePath, &st) < 0 || !S_ISREG(st.st_mode)) {
+        return notFound("Not Found", TEXT_PLAIN);
+    }
+
+    return serveRegularFile(files, request, filePath, st);
+}
+
+static bool isSafeRelativePath(const char *path) {
+    // reject any ".." segment so requests cannot climb out of the mounted directory
+    const char *segment = path;
+    while (*segment) {
+        const char *end = strchr(segment, '/');
+        size_t length = end ? (size_t)(end - segment) : strlen(segment);
+
+        if (length == 2 && segment[0] == '.' && segment[1] == '.') return false;
+        if (!end) break;
+
+        segment = end + 1;
+    }
+
+    return strchr(path, '\\') == NULL;
+}
+
+bool serveStaticMount(StaticFiles *files, const HttpRequest *request, const char *path, HttpResponse *response) {
+    if (!files) return false;
+
+    for (int i = 0; i < files->mountCount; i++) {
+        StaticMount mount = files->mounts[i];
+        size_t prefixLength = strlen(mount.prefix);
+
+        if (strncmp(path, mount.prefix, prefixLength) != 0) continue;
+        if (path[prefixLength] != '/' && path[prefixLength] != '\0') continue;
+
+        const char *relative = path + prefixLength;
+        while (*relative == '/') relative++;
+
+        if (!isSafeRelativePath(relative)) return false;
+
+        bool directoryIndex = *relative == '\0' || relative[strlen(relative) - 1] == '/';
+
+        char filePath[4096];
+        int length = snprintf(filePath, sizeof(filePath), "%s/%s%s", mount.directory, relative, directoryIndex ? "index.html" : "");
+        if (length < 0 || (size_t)length >= sizeof(filePath)) return false;
+
+        struct stat st;
+        if (stat(filePath, &st) < 0 || !S_ISREG(st.st_mode)) continue;
+
+        *response = serveRegularFile(files, request, filePath, st);
+        return true;
+    }
+
+    return false;
+}
+
+HttpResponse staticFile(RequestContext ctx, const char *filePath) {
+    return serveFile(ctx.app->staticFiles, &ctx.request, filePath);
+}
@@ -0,0 +1,253 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/stream.h"
+
+HttpResponse streamResponse(char *contentType, StreamProducer producer, void (*release)(void *state), void *state) {
+    return (HttpResponse) {
+        .status = HTTP_OK,
+        .contentType = contentType,
+        .producer = producer,
+        .streamState = state,
+        .releaseStream = release,
+    };
+}
+
+// a chunk is at least this big, so a producer's small writes share one
+#define MIN_CHUNK_CAPACITY 4096
+
+static StreamChunk *newChunk(size_t capacity) {
+    StreamChunk *chunk = malloc(sizeof(StreamChunk) + capacity);
+    if (!chunk) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *chunk = (StreamChunk){ .refs = 1, .capacity = capacity };
+
+    return chunk;
+}
+
+void releaseChunk(StreamChunk *chunk) {
+    if (chunk && --chunk->refs == 0) {
+        free(chunk);
+    }
+}
+
+static void enqueue(ResponseStream *stream, StreamChunk *chunk) {
+    if (stream->first + stream->count == stream->capacity) {
+        if (stream->first > 0) {
+            memmove(stream->queue, stream->queue + stream->first, stream->count * sizeof(StreamChunk *));
+            stream->first = 0;
+        } else {
+            stream->capacity = stream->capacity ? stream->capacity * 2 : 16;
+            stream->queue = realloc(stream->queue, stream->capacity * sizeof(StreamChunk *));
+            if (!stream->queue) {
+                fprintf(stderr, "Fatal: out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    stream->queue[stream->first + stream->count++] = chunk;
+    stream->pending += chunk->length;
+}
+
+// room for bytes at the end of the queue, in the last chunk if it is this stream's own
+static char *reserve(ResponseStream *stream, size_t bytes) {
+    StreamChunk *last = stream->count ? stream->queue[stream->first + stream->count - 1] : NULL;
+
+    if (!last || last->shared || last->capacity - last->length < bytes) {
+        last = newChunk(bytes > MIN_CHUNK_CAPACITY ? bytes : MIN_CHUNK_CAPACITY);
+        enqueue(stream, last);
+    }
+
+    char *end = last->data + last->length;
+    last->length += bytes;
+    stream->pending += bytes;
+
+    return end;
+}
+
+// "size\r\n" data "\r\n"
+static size_t frame(char *out, const void *data, size_t length, int sizeLength, const char *size) {
+    memcpy(out, size, sizeLength);
+    memcpy(out + sizeLength, data, length);
+    memcpy(out + sizeLength + length, "\r\n", 2);
+
+    return sizeLength + length + 2;
+}
+
+bool streamWrite(ResponseStream *stream, const void *data, size_t length) {
+    if (stream->ended) return false;
+
+    // an empty chunk would end the body
+    if (length == 0) return true;
+
+    if (stream->raw) {
+        memcpy(reserve(stream, length), data, length);
+        return true;
+    }
+
+    char size[24];
+    int sizeLength = snprintf(size, sizeof(size), "%zx\r\n", length);
+
+    frame(reserve(stream, sizeLength + length + 2), data, length, sizeLength, size);
+
+    return true;
+}
+
+StreamChunk *frameChunk(const void *data, size_t length) {
+    char size[24];
+    int sizeLength = snprintf(size, sizeof(size), "%zx\r\n", length);
+
+    StreamChunk *chunk = newChunk(sizeLength + length + 2);
+    chunk->shared = true;
+    chunk->length = length ? frame(chunk->data, data, length, sizeLength, size) : 0;
+
+    return chunk;
+}
+
+bool streamWriteChunk(ResponseStream *stream, StreamChunk *chunk) {
+    if (stream->ended) return false;
+    if (chunk->length == 0) return true;
+
+    chunk->refs++;
+    enqueue(stream, chunk);
+
+    return true;
+}
+
+bool streamPrintf(ResponseStream *stream, const char *format, ...) {
+    char small[512];
+
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(small, sizeof(small), format, args);
+    va_end(args);
+
+    if (length < 0) return false;
+    if ((size_t)length < sizeof(small)) return streamWrite(stream, small, length);
+
+    char *large = malloc(length + 1);
+    if (!large) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    va_start(args, format);
+    vsnprintf(large, length + 1, format, args);
+    va_end(args);
+
+    bool written = streamWrite(stream, large, length);
+    free(large);
+
+    return written;
+}
+
+size_t streamPending(const ResponseStream *stream) {
+    return stream->pending;
+}
+
+void streamResume(ResponseStream *stream) {
+    stream->paused = false;
+}
+
+void streamEnd(ResponseStream *stream) {
+    if (stream->ended) return;
+
+    if (!stream->raw) {
+        memcpy(reserve(stream, 5), "0\r\n\r\n", 5);
+    }
+    stream->ended = true;
+}
+
+void streamAbort(ResponseStream *stream) {
+    stream->ended = true;
+    stream->aborted = true;
+}
+
+ResponseStream *openStream(const HttpResponse *response) {
+    ResponseStream *stream = calloc(1, sizeof(ResponseStream));
+    if (!stream) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    stream->producer = response->producer;
+    stream->state = response->streamState;
+    stream->release = response->releaseStream;
+
+    return stream;
+}
+
+bool streamReady(const ResponseStream *stream) {
+    return stream->producer && !stream->ended && !stream->paused && streamPending(stream) < STREAM_HIGH_WATER;
+}
+
+void streamProduce(ResponseStream *stream) {
+    switch (stream->producer(stream, stream->state)) {
+        case STREAM_MORE:
+            break;
+        case STREAM_PAUSE:
+            stream->paused = true;
+            break;
+        case STREAM_DONE:
+            streamEnd(stream);
+            break;
+    }
+}
+
+int streamIovecs(const ResponseStream *stream, struct iovec *iov, int max) {
+    int used = 0;
+
+    for (size_t i = 0; i < stream->count && used < max; i++) {
+        const StreamChunk *chunk = stream->queue[stream->first + i];
+        size_t skip = i == 0 ? stream->offset : 0;
+
+        iov[used++] = (struct iovec){ (char *)chunk->data + skip, chunk->length - skip };
+    }
+
+    return used;
+}
+
+void streamSent(ResponseStream *stream, size_t bytes) {
+    stream->pending -= bytes;
+
+    while (bytes > 0) {
+        StreamChunk *chunk = stream->queue[stream->first];
+        size_t left = chunk->length - stream->offset;
+
+        if (bytes < left) {
+            stream->offset += bytes;
+            return;
+        }
+
+        bytes -= left;
+        releaseChunk(chunk);
+        stream->first++;
+        stream->count--;
+        stream->offset = 0;
+    }
+
+    if (stream->count == 0) {
+        stream->first = 0;
+    }
+}
+
+void closeStream(ResponseStream *stream) {
+    if (!stream) return;
+
+    if (stream->release) {
+        stream->release(stream->state);
+    }
+
+    for (size_t i = 0; i < stream->count; i++) {
+        releaseChunk(stream->queue[stream->first + i]);
+    }
+
+    free(stream->queue);
+    free(stream);
+}
@@ -0,0 +1,263 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "include/tracing.h"
+#include "include/app.h"
+
+static __thread RequestTrace *currentTrace = NULL;
+
+static uint32_t nextThreadId = 1;
+static __thread uint32_t localThreadId = 0;
+
+static const char *phaseNames[] = {
+    [TRACE_ACCEPT]         = "accept",
+    [TRACE_READ]           = "read",
+    [TRACE_PARSE]          = "parse",
+    [TRACE_ROUTE]          = "route",
+    [TRACE_STATIC]         = "static",
+    [TRACE_JSON_PARSE]     = "json_parse",
+    [TRACE_MIDDLEWARE]     = "middleware",
+    [TRACE_CONTROLLER]     = "controller",
+    [TRACE_JSON_STRINGIFY] = "json_stringify",
+    [TRACE_COMPRESS]       = "compress",
+    [TRACE_WRITE]          = "write",
+};
+
+Tracer *initTracer(uint64_t slowThresholdMicros) {
+    Tracer *tracer = calloc(1, sizeof(Tracer));
+    if (!tracer) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    tracer->ring = calloc(TRACE_RING_SIZE, sizeof(RequestTrace));
+    if (!tracer->ring) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    tracer->slowThresholdNanos = slowThresholdMicros * 1000;
+    tracer->originNanos = traceNow();
+    pthread_mutex_init(&tracer->lock, NULL);
+
+    return tracer;
+}
+
+void freeTracer(Tracer *tracer) {
+    if (!tracer) return;
+
+    pthread_mutex_destroy(&tracer->lock);
+    free(tracer->ring);
+    free(tracer);
+}
+
+uint64_t traceNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+const char *tracePhaseName(TracePhase phase) {
+    if ((int)phase < 0 || (int)phase >= (int)(sizeof(phaseNames) / sizeof(phaseNames[0]))) return "unknown";
+
+    return phaseNames[phase];
+}
+
+void traceStart(RequestTrace *trace, uint64_t startNanos) {
+    memset(trace, 0, sizeof(*trace));
+    trace->startNanos = startNanos;
+
+    if (localThreadId == 0) {
+        localThreadId = __atomic_fetch_add(&nextThreadId, 1, __ATOMIC_RELAXED);
+    }
+    trace->threadId = localThreadId;
+
+    currentTrace = trace;
+}
+
+void traceSuspend(void) {
+    currentTrace = NULL;
+}
+
+void traceResume(RequestTrace *trace) {
+    currentTrace = trace;
+}
+
+void traceAddSpan(RequestTrace *trace, TracePhase phase, uint64_t startNanos, uint64_t endNanos) {
+    if (!trace) return;
+
+    if (trace->spanCount == TRACE_MAX_SPANS) {
+        trace->droppedSpans++;
+        return;
+    }
+
+    trace->spans[trace->spanCount++] = (TraceSpan){ phase, startNanos, endNanos };
+}
+
+int traceBegin(TracePhase phase) {
+    RequestTrace *trace = currentTrace;
+    if (!trace) return -1;
+
+    if (trace->spanCount == TRACE_MAX_SPANS) {
+        trace->droppedSpans++;
+        return -1;
+    }
+
+    // the end is filled in by traceEnd, so spans stay in the order they started
+    trace->spans[trace->spanCount] = (TraceSpan){ phase, traceNow(), 0 };
+
+    return trace->spanCount++;
+}
+
+void traceEnd(int span) {
+    RequestTrace *trace = currentTrace;
+    if (!trace || span < 0) return;
+
+    trace->spans[span].endNanos = traceNow();
+}
+
+int formatTrace(const RequestTrace *trace, char *out, size_t size) {
+    int length = snprintf(out, size, "#%llu %s %s %d %.3fms:",
+        (unsigned long long)trace->id, httpMethodToStr(trace->method), trace->path, trace->status,
+        (trace->endNanos - trace->startNanos) / 1e6);
+
+    for (int i = 0; i < trace->spanCount && length > 0 && (size_t)length < size; i++) {
+        const TraceSpan *span = &trace->spans[i];
+        length += snprintf(out + length, size - length, "%s %s %.3fms", i ? "," : "",
+            tracePhaseName(span->phase), (span->endNanos - span->startNanos) / 1e6);
+    }
+
+    if (length < 0) return 0;
+
+    return (size_t)length < size ? length : (int)size - 1;
+}
+
+void traceFinish(Tracer *tracer, RequestTrace *trace, HttpMethod method, const char *path, int status) {
+    currentTrace = NULL;
+    if (!tracer) return;
+
+    trace->endNanos = traceNow();
+    trace->method = method;
+    trace->status = status;
+    // the query string may carry tokens or keys, the trace is served and dumped without it
+    path = path ? path : "";
+    snprintf(trace->path, sizeof(trace->path), "%.*s", (int)strcspn(path, "?"), path);
+
+    // a span left open by an early return ends with the request
+    for (int i = 0; i < trace->spanCount; i++) {
+        if (trace->spans[i].endNanos == 0) {
+            trace->spans[i].endNanos = trace->endNanos;
+        }
+    }
+
+    pthread_mutex_lock(&tracer->lock);
+    trace->id = ++tracer->finished;
+    tracer->ring[(trace->id - 1) & (TRACE_RING_SIZE - 1)] = *trace;
+    pthread_mutex_unlock(&tracer->lock);
+
+    if (tracer->slowThresholdNanos && trace->endNanos - trace->startNanos >= tracer->slowThresholdNanos) {
+        char line[1024];
+        if (formatTrace(trace, line, sizeof(line)) > 0) {
+            fprintf(stderr, "slow request %s\n", line);
+        }
+    }
+}
+
+typedef struct {
+    char  *data;
+    size_t length;
+    size_t capacity;
+} TextBuffer;
+
+static void appendf(TextBuffer *buffer, const char *format, ...) {
+    for (;;) {
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(buffer->data + buffer->length, buffer->capacity - buffer->length, format, args);
+        va_end(args);
+
+        if (written < 0) return;
+
+        if ((size_t)written < buffer->capacity - buffer->length) {
+            buffer->length += written;
+            return;
+        }
+
+        buffer->capacity = buffer->capacity * 2 + written;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+        if (!buffer->data) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static void appendJsonString(TextBuffer *buffer, const char *value) {
+    appendf(buffer, "\"");
+    for (const unsigned char *p = (const unsigned char *)value; *p; p++) {
+        if (*p == '"' || *p == '\\') appendf(buffer, "\\%c", *p);
+        else if (*p < 0x20) appendf(buffer, "\\u%04x", *p);
+        else appendf(buffer, "%c", *p);
+    }
+    appendf(buffer, "\"");
+}
+
+// a complete ("X") event, timestamps in microseconds
+static void appendEvent(TextBuffer *buffer, const Tracer *tracer, const RequestTrace *trace, const char *name,
+                        uint64_t startNanos, uint64_t endNanos) {
+    appendf(buffer, ",{\"name\":\"%s\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,"
+        "\"args\":{\"request\":%llu}}",
+        name, (startNanos - tracer->originNanos) / 1e3, (endNanos - startNanos) / 1e3,
+        trace->threadId, (unsigned long long)trace->id);
+}
+
+char *renderChromeTrace(Tracer *tracer) {
+    TextBuffer buffer = { .data = malloc(4096), .capacity = 4096 };
+    if (!buffer.data) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    appendf(&buffer, "{\"traceEvents\":[");
+
+    pthread_mutex_lock(&tracer->lock);
+
+    uint64_t first = tracer->finished > TRACE_RING_SIZE ? tracer->finished - TRACE_RING_SIZE : 0;
+    for (uint64_t id = first + 1; id <= tracer->finished; id++) {
+        const RequestTrace *trace = &tracer->ring[(id - 1) & (TRACE_RING_SIZE - 1)];
+
+        // the enclosing request, named after what it was for
+        appendf(&buffer, "%s{\"name\":", id > first + 1 ? "," : "");
+        char name[TRACE_MAX_PATH + 16];
+        snprintf(name, sizeof(name), "%s %s", httpMethodToStr(trace->method), trace->path);
+        appendJsonString(&buffer, name);
+        appendf(&buffer, ",\"cat\":\"request\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,"
+            "\"args\":{\"request\":%llu,\"status\":%d,\"droppedSpans\":%d}}",
+            (trace->startNanos - tracer->originNanos) / 1e3, (trace->endNanos - trace->startNanos) / 1e3,
+            trace->threadId, (unsigned long long)trace->id, trace->status, trace->droppedSpans);
+
+        for (int i = 0; i < trace->spanCount; i++) {
+            const TraceSpan *span = &trace->spans[i];
+            appendEvent(&buffer, tracer, trace, tracePhaseName(span->phase), span->startNanos, span->endNanos);
+        }
+    }
+
+    pthread_mutex_unlock(&tracer->lock);
+
+    appendf(&buffer, "],\"displayTimeUnit\":\"ms\"}");
+
+    return buffer.data;
+}
+
+HttpResponse traceController(RequestContext ctx) {
+    HttpResponse response = ok(renderChromeTrace(ctx.app->tracer), APPLICATION_JSON);
+    response.ownsContent = true;
+
+    addResponseHeader(&response, "Cache-Control", "no-store");
+
+    return response;
+}
@@ -1,6 +1,12 @@
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "include/utils.h"
 
@@ -29,4 +35,43 @@ char *readFile(const char *path) {
     fclose(fptr);
 
     return buff;
+}
+
+void openWakeFds(int fds[2]) {
+#ifdef __linux__
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd >= 0) {
+        fds[0] = fds[1] = fd;
+        return;
+    }
+#endif
+    if (pipe(fds) < 0) {
+        perror("wake-up pipe failed");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    }
+}
+
+void closeWakeFds(int fds[2]) {
+    close(fds[0]);
+    if (fds[1] != fds[0]) {
+        close(fds[1]);
+    }
+}
+
+void wakeUp(const int fds[2]) {
+    uint64_t one = 1;
+    ssize_t written = write(fds[1], &one, sizeof(one));
+    (void)written;
+}
+
+void clearWakeUps(int fd) {
+    uint64_t wakes;
+    while (read(fd, &wakes, sizeof(wakes)) > 0) {
+        // a pipe may hold several wake-ups
+    }
 }
\ No newline at end of file
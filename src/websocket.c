@@ -0,0 +1,503 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "include/websocket.h"
+#include "include/app.h"
+#include "include/base64.h"
+#include "include/crypto.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define WEBSOCKET_AVX2
+#endif
+
+// payloads shorter than this are not worth the vector setup
+#define WEBSOCKET_SIMD_THRESHOLD 64
+
+enum {
+    OPCODE_CONTINUATION = 0x0,
+    OPCODE_TEXT         = 0x1,
+    OPCODE_BINARY       = 0x2,
+    OPCODE_CLOSE        = 0x8,
+    OPCODE_PING         = 0x9,
+    OPCODE_PONG         = 0xa,
+};
+
+void webSocketAccept(const char *key, char out[WEBSOCKET_ACCEPT_SIZE]) {
+    Sha1Context ctx;
+    sha1Init(&ctx);
+    sha1Update(&ctx, key, strlen(key));
+    sha1Update(&ctx, WEBSOCKET_GUID, strlen(WEBSOCKET_GUID));
+
+    unsigned char digest[SHA1_DIGEST_SIZE];
+    sha1Final(&ctx, digest);
+
+    char *encoded = base64EncodeBytes(digest, sizeof(digest), NULL);
+    snprintf(out, WEBSOCKET_ACCEPT_SIZE, "%s", encoded);
+    free(encoded);
+}
+
+#ifdef WEBSOCKET_AVX2
+
+// 32 bytes per XOR. 32 is a multiple of 4, so the mask lines up the same way in every block
+__attribute__((target("avx2")))
+static size_t unmaskAvx2(unsigned char *data, size_t length, uint32_t key) {
+    const __m256i mask = _mm256_set1_epi32((int)key);
+
+    size_t done = 0;
+    for (; done + 32 <= length; done += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(data + done));
+        _mm256_storeu_si256((__m256i *)(data + done), _mm256_xor_si256(block, mask));
+    }
+
+    return done;
+}
+
+#endif
+
+void webSocketUnmask(unsigned char *data, size_t length, const unsigned char mask[4], size_t offset) {
+    // the mask as it falls on data[0]
+    unsigned char rotated[8];
+    for (int i = 0; i < 8; i++) {
+        rotated[i] = mask[(offset + i) & 3];
+    }
+
+    size_t done = 0;
+
+#ifdef WEBSOCKET_AVX2
+    if (length >= WEBSOCKET_SIMD_THRESHOLD && __builtin_cpu_supports("avx2")) {
+        uint32_t key;
+        memcpy(&key, rotated, sizeof(key));
+        done = unmaskAvx2(data, length, key);
+    }
+#endif
+
+    // a word at a time, memcpy keeps the unaligned loads defined
+    uint64_t key;
+    memcpy(&key, rotated, sizeof(key));
+    for (; done + 8 <= length; done += 8) {
+        uint64_t word;
+        memcpy(&word, data + done, sizeof(word));
+        word ^= key;
+        memcpy(data + done, &word, sizeof(word));
+    }
+
+    for (; done < length; done++) {
+        data[done] ^= rotated[done & 3];
+    }
+}
+
+static bool validUtf8(const unsigned char *text, size_t length) {
+    size_t i = 0;
+
+    while (i < length) {
+        // runs of ASCII, eight bytes at a time
+        if (length - i >= 8) {
+            uint64_t word;
+            memcpy(&word, text + i, sizeof(word));
+            if ((word & 0x8080808080808080ULL) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+
+        unsigned char c = text[i];
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+
+        size_t extra;
+        uint32_t codepoint;
+        if ((c & 0xe0) == 0xc0) {
+            extra = 1;
+            codepoint = c & 0x1f;
+        } else if ((c & 0xf0) == 0xe0) {
+            extra = 2;
+            codepoint = c & 0x0f;
+        } else if ((c & 0xf8) == 0xf0) {
+            extra = 3;
+            codepoint = c & 0x07;
+        } else {
+            return false;
+        }
+
+        if (length - i <= extra) return false;
+
+        for (size_t j = 1; j <= extra; j++) {
+            if ((text[i + j] & 0xc0) != 0x80) return false;
+            codepoint = (codepoint << 6) | (text[i + j] & 0x3f);
+        }
+
+        // overlong encodings, UTF-16 surrogates and past the last code point
+        static const uint32_t shortest[] = { 0, 0x80, 0x800, 0x10000 };
+        if (codepoint < shortest[extra] || codepoint > 0x10ffff || (codepoint >= 0xd800 && codepoint <= 0xdfff)) {
+            return false;
+        }
+
+        i += extra + 1;
+    }
+
+    return true;
+}
+
+// server frames are never masked and never fragmented
+static bool sendFrame(WebSocket *socket, int opcode, const void *data, size_t length) {
+    if (socket->stream->ended) return false;
+
+    unsigned char header[10];
+    size_t headerLength = 2;
+
+    header[0] = 0x80 | opcode;
+    if (length < 126) {
+        header[1] = (unsigned char)length;
+    } else if (length <= 0xffff) {
+        header[1] = 126;
+        header[2] = (unsigned char)(length >> 8);
+        header[3] = (unsigned char)length;
+        headerLength = 4;
+    } else {
+        header[1] = 127;
+        for (int i = 0; i < 8; i++) {
+            header[2 + i] = (unsigned char)((uint64_t)length >> (56 - i * 8));
+        }
+        headerLength = 10;
+    }
+
+    streamWrite(socket->stream, header, headerLength);
+    streamWrite(socket->stream, data, length);
+
+    return true;
+}
+
+bool webSocketSend(WebSocket *socket, const void *data, size_t length, bool binary) {
+    return sendFrame(socket, binary ? OPCODE_BINARY : OPCODE_TEXT, data, length);
+}
+
+bool webSocketSendText(WebSocket *socket, const char *text) {
+    return sendFrame(socket, OPCODE_TEXT, text, strlen(text));
+}
+
+static void sendClose(WebSocket *socket, int code, const char *reason) {
+    unsigned char payload[125];
+    payload[0] = (unsigned char)(code >> 8);
+    payload[1] = (unsigned char)code;
+
+    size_t reasonLength = reason ? strlen(reason) : 0;
+    if (reasonLength > sizeof(payload) - 2) reasonLength = sizeof(payload) - 2;
+    if (reasonLength) {
+        memcpy(payload + 2, reason, reasonLength);
+    }
+
+    // nothing is sent after a close frame
+    if (sendFrame(socket, OPCODE_CLOSE, payload, reasonLength + 2)) {
+        streamEnd(socket->stream);
+    }
+}
+
+void webSocketClose(WebSocket *socket, int code, const char *reason) {
+    if (socket->stream->ended) return;
+
+    if (!socket->closeCode) {
+        socket->closeCode = code;
+    }
+
+    // the connection stays until the client answers with its own close frame
+    sendClose(socket, code, reason);
+    socket->awaitingClose = true;
+}
+
+static void releaseWebSocket(void *state) {
+    WebSocket *socket = state;
+
+    if (socket->opened && socket->handlers.onClose) {
+        socket->handlers.onClose(socket, socket->closeCode ? socket->closeCode : WEBSOCKET_ABNORMAL);
+    }
+
+    free(socket->message);
+    free(socket);
+}
+
+static bool headerHasToken(const HttpRequest *request, const char *name, const char *token) {
+    const char *value = findHeader(request, name);
+    if (!value) return false;
+
+    // a comma separated list, "keep-alive, Upgrade"
+    size_t tokenLength = strlen(token);
+    for (const char *c = value; *c; c++) {
+        if (strncasecmp(c, token, tokenLength) == 0 &&
+            (c == value || c[-1] == ',' || c[-1] == ' ') &&
+            (c[tokenLength] == '\0' || c[tokenLength] == ',' || c[tokenLength] == ' ')) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+HttpResponse acceptWebSocket(RequestContext ctx, WebSocketHandlers handlers, void *data) {
+    const HttpRequest *request = &ctx.request;
+
+    if (request->method != HTTP_GET || !headerHasToken(request, "Upgrade", "websocket") ||
+        !headerHasToken(request, "Connection", "upgrade")) {
+        HttpResponse response = upgradeRequired("", TEXT_PLAIN);
+        addResponseHeader(&response, "Upgrade", "websocket");
+        addResponseHeader(&response, "Sec-WebSocket-Version", "13");
+        return response;
+    }
+
+    const char *version = findHeader(request, "Sec-WebSocket-Version");
+    if (!version || strcmp(version, "13") != 0) {
+        HttpResponse response = upgradeRequired("", TEXT_PLAIN);
+        addResponseHeader(&response, "Sec-WebSocket-Version", "13");
+        return response;
+    }
+
+    // 16 random bytes in base64
+    const char *key = findHeader(request, "Sec-WebSocket-Key");
+    size_t keyLength = 0;
+    unsigned char *decodedKey = key ? base64DecodeBytes(key, strlen(key), &keyLength) : NULL;
+    free(decodedKey);
+    if (!decodedKey || keyLength != 16) {
+        return badRequest("", TEXT_PLAIN);
+    }
+
+    WebSocket *socket = calloc(1, sizeof(WebSocket));
+    if (!socket) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    socket->handlers = handlers;
+    socket->data = data;
+    socket->maxMessage = ctx.app ? ctx.app->server.limits.maxRequestSize : 1024 * 1024;
+
+    socket->stream = openStream(&(HttpResponse){ .releaseStream = releaseWebSocket, .streamState = socket });
+    socket->stream->raw = true;
+
+    char accept[WEBSOCKET_ACCEPT_SIZE];
+    webSocketAccept(key, accept);
+
+    HttpResponse response = switchingProtocols("", TEXT_PLAIN);
+    response.webSocket = socket;
+    addResponseHeader(&response, "Sec-WebSocket-Accept", accept);
+
+    return response;
+}
+
+bool webSocketListening(const WebSocket *socket) {
+    return !socket->stream->ended || socket->awaitingClose;
+}
+
+void webSocketOpened(WebSocket *socket) {
+    socket->opened = true;
+
+    if (socket->handlers.onOpen) {
+        socket->handlers.onOpen(socket);
+    }
+}
+
+// codes a peer may put in a close frame: the assigned 1xxx ones that are not
+// reserved for local use, and the ranges kept for libraries and applications
+static bool validCloseCode(int code) {
+    if (code >= 3000 && code <= 4999) return true;
+    if (code >= 1000 && code <= 1003) return true;
+    return code >= 1007 && code <= 1014;
+}
+
+// the client broke the protocol, it is told why and disconnected
+static void failWebSocket(WebSocket *socket, int code) {
+    if (!socket->closeCode) {
+        socket->closeCode = code;
+    }
+
+    sendClose(socket, code, NULL);
+    socket->awaitingClose = false;
+}
+
+// returns the header's length, 0 until all of it has arrived
+static size_t readFrameHeader(WebSocket *socket, const unsigned char *data, size_t length) {
+    if (length < 2) return 0;
+
+    bool final = data[0] & 0x80;
+    int opcode = data[0] & 0x0f;
+    bool masked = data[1] & 0x80;
+    uint64_t payloadLength = data[1] & 0x7f;
+
+    bool control = opcode >= OPCODE_CLOSE;
+    bool knownOpcode = opcode <= OPCODE_BINARY || (opcode >= OPCODE_CLOSE && opcode <= OPCODE_PONG);
+
+    // no extensions are negotiated, so the reserved bits stay clear. Clients always mask
+    if ((data[0] & 0x70) || !knownOpcode || !masked ||
+        (control && (!final || payloadLength > sizeof(socket->control))) ||
+        (opcode == OPCODE_CONTINUATION && !socket->messageOpcode) ||
+        ((opcode == OPCODE_TEXT || opcode == OPCODE_BINARY) && socket->messageOpcode)) {
+        failWebSocket(socket, WEBSOCKET_PROTOCOL_ERROR);
+        return length;
+    }
+
+    size_t headerLength = 2;
+    if (payloadLength == 126) headerLength += 2;
+    if (payloadLength == 127) headerLength += 8;
+    headerLength += 4;
+
+    if (length < headerLength) return 0;
+
+    if (payloadLength == 126) {
+        payloadLength = ((uint64_t)data[2] << 8) | data[3];
+    } else if (payloadLength == 127) {
+        payloadLength = 0;
+        for (int i = 0; i < 8; i++) {
+            payloadLength = (payloadLength << 8) | data[2 + i];
+        }
+    }
+
+    if (!control && payloadLength > socket->maxMessage - socket->messageLength) {
+        failWebSocket(socket, WEBSOCKET_TOO_BIG);
+        return length;
+    }
+
+    socket->inFrame = true;
+    socket->opcode = opcode;
+    socket->final = final;
+    socket->remaining = payloadLength;
+    socket->maskOffset = 0;
+    memcpy(socket->mask, data + headerLength - 4, 4);
+
+    if (opcode == OPCODE_TEXT || opcode == OPCODE_BINARY) {
+        socket->messageOpcode = opcode;
+    }
+    if (control) {
+        socket->controlLength = 0;
+    }
+
+    return headerLength;
+}
+
+static void readPayload(WebSocket *socket, const unsigned char *data, size_t length) {
+    unsigned char *target;
+
+    if (socket->opcode >= OPCODE_CLOSE) {
+        target = socket->control + socket->controlLength;
+        socket->controlLength += length;
+    } else {
+        if (socket->messageLength + length + 1 > socket->messageCapacity) {
+            size_t capacity = socket->messageCapacity ? socket->messageCapacity : 4096;
+            while (capacity < socket->messageLength + length + 1) capacity *= 2;
+
+            socket->message = realloc(socket->message, capacity);
+            if (!socket->message) {
+                fprintf(stderr, "Fatal: out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+            socket->messageCapacity = capacity;
+        }
+
+        target = (unsigned char *)socket->message + socket->messageLength;
+        socket->messageLength += length;
+    }
+
+    memcpy(target, data, length);
+    webSocketUnmask(target, length, socket->mask, socket->maskOffset);
+
+    socket->maskOffset += length;
+    socket->remaining -= length;
+}
+
+static void finishFrame(WebSocket *socket) {
+    socket->inFrame = false;
+
+    switch (socket->opcode) {
+        case OPCODE_CLOSE: {
+            if (socket->controlLength == 1) {
+                failWebSocket(socket, WEBSOCKET_PROTOCOL_ERROR);
+                return;
+            }
+
+            // the answer to the server's own close frame
+            if (socket->awaitingClose) {
+                socket->awaitingClose = false;
+                return;
+            }
+
+            // answered with the same code, once it and the reason check out
+            int code = socket->controlLength >= 2 ? (socket->control[0] << 8) | socket->control[1] : 0;
+            if (code && !validCloseCode(code)) {
+                failWebSocket(socket, WEBSOCKET_PROTOCOL_ERROR);
+                return;
+            }
+            if (code && !validUtf8(socket->control + 2, socket->controlLength - 2)) {
+                failWebSocket(socket, WEBSOCKET_INVALID_DATA);
+                return;
+            }
+            if (!socket->closeCode) {
+                socket->closeCode = code ? code : WEBSOCKET_NO_STATUS;
+            }
+            sendClose(socket, code ? code : WEBSOCKET_NORMAL, NULL);
+            return;
+        }
+        case OPCODE_PING:
+            sendFrame(socket, OPCODE_PONG, socket->control, socket->controlLength);
+            return;
+        case OPCODE_PONG:
+            return;
+    }
+
+    if (!socket->final) return;
+
+    // a message that crossed the server's close frame is dropped
+    if (socket->stream->ended) {
+        socket->messageOpcode = 0;
+        socket->messageLength = 0;
+        return;
+    }
+
+    bool binary = socket->messageOpcode == OPCODE_BINARY;
+    if (!binary && !validUtf8((const unsigned char *)socket->message, socket->messageLength)) {
+        failWebSocket(socket, WEBSOCKET_INVALID_DATA);
+        return;
+    }
+
+    // an empty message never grew the buffer
+    char empty = '\0';
+    char *message = socket->message ? socket->message : &empty;
+    message[socket->messageLength] = '\0';
+
+    size_t length = socket->messageLength;
+    socket->messageOpcode = 0;
+    socket->messageLength = 0;
+
+    if (socket->handlers.onMessage) {
+        socket->handlers.onMessage(socket, message, length, binary);
+    }
+}
+
+size_t webSocketReceive(WebSocket *socket, const unsigned char *data, size_t length) {
+    size_t position = 0;
+
+    // once the closing handshake is done nothing the client sends matters
+    while (position < length && webSocketListening(socket)) {
+        if (!socket->inFrame) {
+            size_t headerLength = readFrameHeader(socket, data + position, length - position);
+            if (headerLength == 0) break;
+
+            position += headerLength;
+            if (!socket->inFrame) break;
+        }
+
+        size_t available = length - position;
+        size_t take = socket->remaining < available ? (size_t)socket->remaining : available;
+        if (take) {
+            readPayload(socket, data + position, take);
+            position += take;
+        }
+
+        if (socket->remaining == 0) {
+            finishFrame(socket);
+        }
+    }
+
+    return webSocketListening(socket) ? position : length;
+}
@@ -0,0 +1,153 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../src/include/lavandula_test.h"
+#include "../src/include/access_log.h"
+
+static AccessLogRecord sampleRecord(const char *path, int status) {
+    AccessLogRecord record = {
+        .timestampMillis = 1760000000123LL,
+        .method = HTTP_GET,
+        .status = status,
+        .bytes = 512,
+        .durationMicros = 1500,
+        .clientIp = "127.0.0.1",
+    };
+    snprintf(record.path, sizeof(record.path), "%s", path);
+
+    return record;
+}
+
+static char *readAll(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *content = calloc(1, size + 1);
+    size_t length = fread(content, 1, size, file);
+    content[length] = '\0';
+    fclose(file);
+
+    return content;
+}
+
+static int countLines(const char *text) {
+    int lines = 0;
+    for (const char *p = text; *p; p++) {
+        if (*p == '\n') lines++;
+    }
+
+    return lines;
+}
+
+void testFormatAccessLogRecord() {
+    AccessLogRecord record = sampleRecord("/search?q=\"a\\b\"", 200);
+
+    char line[1024];
+    int length = formatAccessLogRecord(&record, line, sizeof(line));
+
+    const char *expected = "{\"time\":\"2025-10-09T08:53:20.123Z\",\"ip\":\"127.0.0.1\",\"method\":\"GET\","
+        "\"path\":\"/search?q=\\\"a\\\\b\\\"\",\"status\":200,\"bytes\":512,\"durationMicros\":1500}\n";
+
+    expect(strcmp(line, expected), toBe(0));
+    expect(length, toBe((int)strlen(expected)));
+}
+
+void testAccessLogWritesRecords() {
+    char path[] = "/tmp/lavandula_access_XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+
+    AccessLog *log = initAccessLog(path, 0);
+    expectNotNull(log);
+    expect((fcntl(log->fileDescriptor, F_GETFD) & FD_CLOEXEC) != 0, toBe(true));
+
+    for (int i = 0; i < 10; i++) {
+        AccessLogRecord record = sampleRecord("/items", 200 + i);
+        logAccess(log, &record);
+    }
+
+    // freeing flushes whatever the writer has not written yet
+    freeAccessLog(log);
+
+    char *content = readAll(path);
+    expect(countLines(content), toBe(10));
+    expectNotNull(strstr(content, "\"status\":209"));
+
+    free(content);
+    unlink(path);
+}
+
+void testAccessLogCountsDrops() {
+    char path[] = "/tmp/lavandula_access_XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+
+    AccessLog *log = initAccessLog(path, 0);
+
+    // hold the writer off so the ring fills up
+    pthread_mutex_lock(&log->drainLock);
+
+    AccessLogRecord record = sampleRecord("/busy", 200);
+    for (int i = 0; i < ACCESS_LOG_RING_SIZE + 25; i++) {
+        logAccess(log, &record);
+    }
+
+    expect(accessLogDropped(log), toBe(25));
+    pthread_mutex_unlock(&log->drainLock);
+
+    freeAccessLog(log);
+
+    char *content = readAll(path);
+    expect(countLines(content), toBe(ACCESS_LOG_RING_SIZE + 1));
+    expectNotNull(strstr(content, "{\"event\":\"dropped\",\"count\":25,\"total\":25}\n"));
+
+    free(content);
+    unlink(path);
+}
+
+void testAccessLogRotates() {
+    char path[] = "/tmp/lavandula_access_XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+
+    char rotated[64];
+    snprintf(rotated, sizeof(rotated), "%s.1", path);
+
+    // each line is a bit over 150 bytes, so this forces a rotation
+    AccessLog *log = initAccessLog(path, 1000);
+
+    AccessLogRecord record = sampleRecord("/rotate", 200);
+    for (int i = 0; i < 10; i++) {
+        logAccess(log, &record);
+    }
+
+    freeAccessLog(log);
+
+    struct stat st;
+    expect(stat(rotated, &st), toBe(0));
+    expect(st.st_size <= 1000, toBe(true));
+
+    char *current = readAll(path);
+    char *previous = readAll(rotated);
+    expect(countLines(current) + countLines(previous), toBe(10));
+
+    free(current);
+    free(previous);
+    unlink(path);
+    unlink(rotated);
+}
+
+void runAccessLogTests() {
+    runTest(testFormatAccessLogRecord);
+    runTest(testAccessLogWritesRecords);
+    runTest(testAccessLogCountsDrops);
+    runTest(testAccessLogRotates);
+}
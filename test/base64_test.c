@@ -266,6 +266,144 @@ void testBase64DecodeNullTerminated() {
     free(decoded);
 }
 
+// Length-explicit API tests
+static char *referenceEncode(const unsigned char *data, size_t length) {
+    static const char map[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char *out = malloc((length + 2) / 3 * 4 + 1);
+    size_t c = 0;
+
+    for (size_t i = 0; i < length; i += 3) {
+        unsigned int b0 = data[i];
+        unsigned int b1 = i + 1 < length ? data[i + 1] : 0;
+        unsigned int b2 = i + 2 < length ? data[i + 2] : 0;
+
+        out[c++] = map[b0 >> 2];
+        out[c++] = map[((b0 & 0x03) << 4) | (b1 >> 4)];
+        out[c++] = i + 1 < length ? map[((b1 & 0x0f) << 2) | (b2 >> 6)] : '=';
+        out[c++] = i + 2 < length ? map[b2 & 0x3f] : '=';
+    }
+    out[c] = '\0';
+
+    return out;
+}
+
+void testBase64BinaryRoundTrip() {
+    const unsigned char data[] = {0x00, 0xff, 0x00, 0x10, 0x80};
+    size_t encodedLength = 0;
+    char *encoded = base64EncodeBytes(data, sizeof(data), &encodedLength);
+
+    expect(strcmp(encoded, "AP8AEIA="), toBe(0));
+    expect(encodedLength, toBe(8));
+
+    size_t decodedLength = 0;
+    unsigned char *decoded = base64DecodeBytes(encoded, encodedLength, &decodedLength);
+    expect(decodedLength, toBe(sizeof(data)));
+    expect(memcmp(decoded, data, sizeof(data)), toBe(0));
+
+    free(encoded);
+    free(decoded);
+}
+
+void testBase64DecodeRejectsInvalidCharacters() {
+    expectNull(base64Decode("Zm9v!mFy"));
+    expectNull(base64Decode("Zm 9v"));
+}
+
+void testBase64DecodeRejectsBadPadding() {
+    expectNull(base64Decode("Zg="));
+    expectNull(base64Decode("Z==="));
+    expectNull(base64Decode("Zm=v"));
+    expectNull(base64Decode("Zm9vY"));
+}
+
+void testBase64DecodeRejectsNonCanonicalTrailingBits() {
+    expectNull(base64Decode("QR=="));
+    expectNull(base64Decode("QUJ="));
+    expectNull(base64Decode("QR"));
+    expectNull(base64UrlDecode("Zm9", 3, NULL));
+
+    char *decoded = base64Decode("QUI=");
+    expect(strcmp(decoded, "AB"), toBe(0));
+    free(decoded);
+
+    // the same tails behind input long enough for the vectorised path
+    unsigned char data[121];
+    memset(data, 0x41, sizeof(data));
+
+    char *encoded = base64EncodeBytes(data, sizeof(data), NULL);
+    size_t length = strlen(encoded);
+    expect(strcmp(encoded + length - 4, "QQ=="), toBe(0));
+
+    encoded[length - 3] = 'R';
+    expectNull(base64DecodeBytes(encoded, length, NULL));
+
+    free(encoded);
+}
+
+void testBase64DecodeUnpadded() {
+    char *decoded = base64Decode("Zm9vYg");
+    expect(strcmp(decoded, "foob"), toBe(0));
+    free(decoded);
+}
+
+void testBase64LargeInputsMatchReference() {
+    // long enough to take the vectorised path where available, at every tail length
+    unsigned char data[300];
+    unsigned int seed = 12345;
+    for (size_t i = 0; i < sizeof(data); i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (unsigned char)(seed >> 16);
+    }
+
+    bool allMatch = true;
+    for (size_t length = 0; length <= sizeof(data); length++) {
+        char *expected = referenceEncode(data, length);
+        char *encoded = base64EncodeBytes(data, length, NULL);
+
+        size_t decodedLength = 0;
+        unsigned char *decoded = base64DecodeBytes(encoded, strlen(encoded), &decodedLength);
+
+        if (strcmp(expected, encoded) != 0 || decodedLength != length || memcmp(decoded, data, length) != 0) {
+            allMatch = false;
+        }
+
+        free(expected);
+        free(encoded);
+        free(decoded);
+    }
+
+    expect(allMatch, toBe(true));
+}
+
+void testBase64LargeInputRejectsInvalidCharacter() {
+    unsigned char data[120];
+    memset(data, 0xab, sizeof(data));
+
+    char *encoded = base64EncodeBytes(data, sizeof(data), NULL);
+    encoded[7] = '*';
+    expectNull(base64DecodeBytes(encoded, strlen(encoded), NULL));
+
+    encoded[7] = 'q';
+    encoded[150] = '-';
+    expectNull(base64DecodeBytes(encoded, strlen(encoded), NULL));
+
+    free(encoded);
+}
+
+void testBase64UrlEncodeNoPadding() {
+    char *encoded = base64UrlEncode((const unsigned char *)"fo", 2);
+    expect(strcmp(encoded, "Zm8"), toBe(0));
+    free(encoded);
+}
+
+void testBase64UrlDecodeAcceptsPadding() {
+    size_t length = 0;
+    unsigned char *decoded = base64UrlDecode("Zm8=", 4, &length);
+    expect(length, toBe(2));
+    expect(memcmp(decoded, "fo", 2), toBe(0));
+    free(decoded);
+}
+
 void runBase64Tests(){
     // Basic encoding tests
     runTest(testBase64EncodeEmpty);
@@ -314,4 +452,15 @@ void runBase64Tests(){
     runTest(testBase64EncodeTab);
     runTest(testBase64EncodeNullTerminated);
     runTest(testBase64DecodeNullTerminated);
+
+    // Length-explicit and base64url tests
+    runTest(testBase64BinaryRoundTrip);
+    runTest(testBase64DecodeRejectsInvalidCharacters);
+    runTest(testBase64DecodeRejectsBadPadding);
+    runTest(testBase64DecodeRejectsNonCanonicalTrailingBits);
+    runTest(testBase64DecodeUnpadded);
+    runTest(testBase64LargeInputsMatchReference);
+    runTest(testBase64LargeInputRejectsInvalidCharacter);
+    runTest(testBase64UrlEncodeNoPadding);
+    runTest(testBase64UrlDecodeAcceptsPadding);
 }
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+
+#include "../src/include/lavandula_test.h"
+#include "../src/include/bind_address.h"
+
+void testResolveDefaultBindAddress() {
+    BindAddress address;
+    expect(resolveBindAddress(NULL, 3000, &address), toBe(true));
+
+    char url[128];
+    formatListenUrl(&address, url, sizeof(url));
+    expect(strcmp(url, "http://127.0.0.1:3000"), toBe(0));
+    expect(address.dualStack, toBe(false));
+}
+
+void testResolveIpv4BindAddress() {
+    BindAddress address;
+    expect(resolveBindAddress("0.0.0.0", 8080, &address), toBe(true));
+
+    const struct sockaddr_in *ipv4 = (const struct sockaddr_in *)&address.address;
+    expect(ipv4->sin_family, toBe(AF_INET));
+    expect(ntohs(ipv4->sin_port), toBe(8080));
+    expect(ipv4->sin_addr.s_addr, toBe(htonl(INADDR_ANY)));
+    expect(address.length, toBe((socklen_t)sizeof(struct sockaddr_in)));
+
+    expect(resolveBindAddress("localhost", 8080, &address), toBe(true));
+    expect(ipv4->sin_addr.s_addr, toBe(htonl(INADDR_LOOPBACK)));
+}
+
+void testResolveIpv6BindAddress() {
+    BindAddress address;
+    char url[128];
+
+    expect(resolveBindAddress("::", 3000, &address), toBe(true));
+    expect(address.address.ss_family, toBe(AF_INET6));
+    expect(address.dualStack, toBe(true));
+
+    formatListenUrl(&address, url, sizeof(url));
+    expect(strcmp(url, "http://[::]:3000"), toBe(0));
+
+    // a specific address only takes IPv6 clients
+    expect(resolveBindAddress("[::1]", 3000, &address), toBe(true));
+    expect(address.dualStack, toBe(false));
+
+    formatListenUrl(&address, url, sizeof(url));
+    expect(strcmp(url, "http://[::1]:3000"), toBe(0));
+}
+
+void testResolveUnixBindAddress() {
+    BindAddress address;
+    expect(resolveBindAddress("unix:/tmp/lavandula.sock", 3000, &address), toBe(true));
+    expect(address.address.ss_family, toBe(AF_UNIX));
+
+    char url[128];
+    formatListenUrl(&address, url, sizeof(url));
+    expect(strcmp(url, "unix:/tmp/lavandula.sock"), toBe(0));
+
+    expect(resolveBindAddress("unix:", 3000, &address), toBe(false));
+
+    char tooLong[256] = "unix:/tmp/";
+    memset(tooLong + strlen(tooLong), 'a', 200);
+    expect(resolveBindAddress(tooLong, 3000, &address), toBe(false));
+}
+
+void testResolveInterfaceBindAddress() {
+    BindAddress address;
+
+    // the loopback interface is "lo" on Linux and "lo0" on the BSDs
+    bool resolved = resolveBindAddress("lo", 3000, &address) || resolveBindAddress("lo0", 3000, &address);
+    expect(resolved, toBe(true));
+
+    char url[128];
+    formatListenUrl(&address, url, sizeof(url));
+    expect(strcmp(url, "http://127.0.0.1:3000"), toBe(0));
+
+    expect(resolveBindAddress("no-such-interface", 3000, &address), toBe(false));
+    expect(resolveBindAddress("300.1.1.1", 3000, &address), toBe(false));
+}
+
+void testSameBindAddress() {
+    BindAddress a, b;
+
+    resolveBindAddress("127.0.0.1", 3000, &a);
+    resolveBindAddress("localhost", 3000, &b);
+    expect(sameBindAddress((struct sockaddr *)&a.address, (struct sockaddr *)&b.address), toBe(true));
+
+    resolveBindAddress("127.0.0.1", 3001, &b);
+    expect(sameBindAddress((struct sockaddr *)&a.address, (struct sockaddr *)&b.address), toBe(false));
+
+    resolveBindAddress("::1", 3000, &b);
+    expect(sameBindAddress((struct sockaddr *)&a.address, (struct sockaddr *)&b.address), toBe(false));
+
+    resolveBindAddress("unix:/tmp/a.sock", 0, &a);
+    resolveBindAddress("unix:/tmp/a.sock", 0, &b);
+    expect(sameBindAddress((struct sockaddr *)&a.address, (struct sockaddr *)&b.address), toBe(true));
+}
+
+void testFormatClientAddress() {
+    char text[64];
+
+    struct sockaddr_in ipv4 = { .sin_family = AF_INET };
+    inet_pton(AF_INET, "10.1.2.3", &ipv4.sin_addr);
+    formatClientAddress((struct sockaddr *)&ipv4, text, sizeof(text));
+    expect(strcmp(text, "10.1.2.3"), toBe(0));
+
+    // an IPv4 client of a dual-stack listener
+    struct sockaddr_in6 mapped = { .sin6_family = AF_INET6 };
+    inet_pton(AF_INET6, "::ffff:192.168.0.7", &mapped.sin6_addr);
+    formatClientAddress((struct sockaddr *)&mapped, text, sizeof(text));
+    expect(strcmp(text, "192.168.0.7"), toBe(0));
+
+    struct sockaddr_in6 ipv6 = { .sin6_family = AF_INET6 };
+    inet_pton(AF_INET6, "2001:db8::1", &ipv6.sin6_addr);
+    formatClientAddress((struct sockaddr *)&ipv6, text, sizeof(text));
+    expect(strcmp(text, "2001:db8::1"), toBe(0));
+
+    struct sockaddr_un local = { .sun_family = AF_UNIX };
+    formatClientAddress((struct sockaddr *)&local, text, sizeof(text));
+    expect(strcmp(text, "unix"), toBe(0));
+}
+
+void runBindAddressTests() {
+    runTest(testResolveDefaultBindAddress);
+    runTest(testResolveIpv4BindAddress);
+    runTest(testResolveIpv6BindAddress);
+    runTest(testResolveUnixBindAddress);
+    runTest(testResolveInterfaceBindAddress);
+    runTest(testSameBindAddress);
+    runTest(testFormatClientAddress);
+}
@@ -0,0 +1,81 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/include/lavandula_test.h"
+#include "../src/include/buffer_pool.h"
+
+void testBufferPoolReusesReturnedBuffers() {
+    BufferPool *pool = initBufferPool(POOL_BUFFER_SIZE);
+
+    char *first = takeBuffer(pool);
+    char *second = takeBuffer(pool);
+    expect(first != second, toBe(true));
+    expect(pool->inUse, toBe(2));
+
+    releaseBuffer(pool, first, POOL_BUFFER_SIZE);
+    expect(pool->inUse, toBe(1));
+
+    // the most recently returned one comes back first, while it is still in the cache
+    expect(takeBuffer(pool) == first, toBe(true));
+    expect(pool->slabCount, toBe(1));
+
+    freeBufferPool(pool);
+}
+
+void testBufferPoolGrowsBySlabs() {
+    BufferPool *pool = initBufferPool(256);
+    char *buffers[POOL_SLAB_BUFFERS + 1];
+
+    for (int i = 0; i < POOL_SLAB_BUFFERS + 1; i++) {
+        buffers[i] = takeBuffer(pool);
+        memset(buffers[i], i, 256);
+    }
+    expect(pool->slabCount, toBe(2));
+
+    // none of them overlap
+    for (int i = 0; i < POOL_SLAB_BUFFERS + 1; i++) {
+        expect(buffers[i][0] == (char)i && buffers[i][255] == (char)i, toBe(true));
+    }
+
+    for (int i = 0; i < POOL_SLAB_BUFFERS + 1; i++) {
+        releaseBuffer(pool, buffers[i], 256);
+    }
+    expect(pool->inUse, toBe(0));
+
+    // returned buffers are used before another slab is
+    for (int i = 0; i < POOL_SLAB_BUFFERS + 1; i++) {
+        buffers[i] = takeBuffer(pool);
+    }
+    expect(pool->slabCount, toBe(2));
+
+    freeBufferPool(pool);
+}
+
+void testGrowBufferMovesToTheHeap() {
+    BufferPool *pool = initBufferPool(POOL_BUFFER_SIZE);
+
+    char *buffer = takeBuffer(pool);
+    strcpy(buffer, "GET / HTTP/1.1\r\n");
+
+    buffer = growBuffer(pool, buffer, POOL_BUFFER_SIZE, POOL_BUFFER_SIZE * 2);
+    expect(strcmp(buffer, "GET / HTTP/1.1\r\n"), toBe(0));
+    expect(pool->inUse, toBe(0));
+
+    buffer = growBuffer(pool, buffer, POOL_BUFFER_SIZE * 2, POOL_BUFFER_SIZE * 4);
+    expect(strcmp(buffer, "GET / HTTP/1.1\r\n"), toBe(0));
+
+    // freed rather than pooled, the sanitizer would report it otherwise
+    releaseBuffer(pool, buffer, POOL_BUFFER_SIZE * 4);
+    releaseBuffer(pool, NULL, POOL_BUFFER_SIZE);
+    expect(pool->inUse, toBe(0));
+
+    freeBufferPool(pool);
+}
+
+void runBufferPoolTests() {
+    runTest(testBufferPoolReusesReturnedBuffers);
+    runTest(testBufferPoolGrowsBySlabs);
+    runTest(testGrowBufferMovesToTheHeap);
+}
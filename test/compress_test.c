@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "../src/include/lavandula_test.h"
+#include "../src/include/compress.h"
+
+static char *repeatedJson(size_t count) {
+    const char *item = "{\"id\":1,\"name\":\"lavandula\",\"tags\":[\"c\",\"web\"]},";
+    size_t itemLength = strlen(item);
+
+    char *json = malloc(itemLength * count + 3);
+    json[0] = '[';
+    for (size_t i = 0; i < count; i++) {
+        memcpy(json + 1 + i * itemLength, item, itemLength);
+    }
+    json[itemLength * count] = ']';
+    json[itemLength * count + 1] = '\0';
+
+    return json;
+}
+
+static unsigned char *inflateBody(const unsigned char *data, size_t length, int windowBits, size_t capacity, size_t *outLength) {
+    z_stream stream = {0};
+    inflateInit2(&stream, windowBits);
+
+    unsigned char *out = malloc(capacity);
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = length;
+    stream.next_out = out;
+    stream.avail_out = capacity;
+
+    int status = inflate(&stream, Z_FINISH);
+    *outLength = stream.total_out;
+    inflateEnd(&stream);
+
+    if (status != Z_STREAM_END) {
+        free(out);
+        return NULL;
+    }
+
+    return out;
+}
+
+static HttpRequest getRequest(Header *acceptEncoding) {
+    HttpRequest request = {0};
+    request.method = HTTP_GET;
+    request.resource = "/items";
+    request.headers = acceptEncoding;
+    request.headerCount = acceptEncoding ? 1 : 0;
+
+    return request;
+}
+
+void testNegotiateEncoding() {
+    unsigned zlib = ENCODING_MASK(ENCODING_GZIP) | ENCODING_MASK(ENCODING_DEFLATE);
+    unsigned all = zlib | ENCODING_MASK(ENCODING_BR);
+
+    expect(negotiateEncoding(NULL, all), toBe(ENCODING_IDENTITY));
+    expect(negotiateEncoding("gzip, deflate, br", all), toBe(ENCODING_BR));
+    expect(negotiateEncoding("gzip, deflate, br", zlib), toBe(ENCODING_GZIP));
+    expect(negotiateEncoding("deflate", zlib), toBe(ENCODING_DEFLATE));
+    expect(negotiateEncoding("gzip;q=0.5, deflate;q=0.8", zlib), toBe(ENCODING_DEFLATE));
+    expect(negotiateEncoding("gzip;q=0, deflate;q=0", zlib), toBe(ENCODING_IDENTITY));
+    expect(negotiateEncoding("*", zlib), toBe(ENCODING_GZIP));
+    expect(negotiateEncoding("*;q=0.1, gzip;q=0", zlib), toBe(ENCODING_DEFLATE));
+    expect(negotiateEncoding("identity", all), toBe(ENCODING_IDENTITY));
+    expect(negotiateEncoding("br", zlib), toBe(ENCODING_IDENTITY));
+}
+
+void testCompressBodyRoundTrip() {
+    char *json = repeatedJson(100);
+    size_t length = strlen(json);
+
+    size_t gzipLength = 0;
+    unsigned char *gzip = compressBody(json, length, ENCODING_GZIP, &gzipLength);
+    expectNotNull(gzip);
+    expect(gzipLength < length, toBe(true));
+    expect(gzip[0] == 0x1f && gzip[1] == 0x8b, toBe(true));
+
+    size_t inflatedLength = 0;
+    unsigned char *inflated = inflateBody(gzip, gzipLength, 15 + 16, length, &inflatedLength);
+    expectNotNull(inflated);
+    expect(inflatedLength, toBe(length));
+    expect(memcmp(inflated, json, length), toBe(0));
+    free(inflated);
+
+    size_t deflateLength = 0;
+    unsigned char *deflated = compressBody(json, length, ENCODING_DEFLATE, &deflateLength);
+    inflated = inflateBody(deflated, deflateLength, 15, length, &inflatedLength);
+    expectNotNull(inflated);
+    expect(memcmp(inflated, json, length), toBe(0));
+
+    free(inflated);
+    free(deflated);
+    free(gzip);
+    free(json);
+}
+
+void testCompressResponse() {
+    Compressor *compressor = initCompressor(0);
+
+    Header acceptEncoding = { .name = "Accept-Encoding", .value = "gzip, deflate" };
+    HttpRequest request = getRequest(&acceptEncoding);
+
+    char *json = repeatedJson(100);
+    HttpResponse response = { .content = json, .status = HTTP_OK, .contentType = APPLICATION_JSON };
+    addResponseHeader(&response, "ETag", "\"v1\"");
+
+    compressResponse(compressor, &request, &response);
+
+    expect(response.ownsContent, toBe(true));
+    expect(response.contentLength < strlen(json), toBe(true));
+    expectNotNull(strstr(response.headers, "Content-Encoding: gzip\r\n"));
+    expectNotNull(strstr(response.headers, "Vary: Accept-Encoding\r\n"));
+    expectNotNull(strstr(response.headers, "ETag: W/\"v1\"\r\n"));
+    expect(compressor->head != NULL, toBe(true));
+
+    // the second identical body is served from the cache
+    HttpResponse again = { .content = json, .status = HTTP_OK, .contentType = APPLICATION_JSON };
+    compressResponse(compressor, &request, &again);
+    expect(again.contentLength, toBe(response.contentLength));
+    expect(memcmp(again.content, response.content, response.contentLength), toBe(0));
+    expect(compressor->head == compressor->tail, toBe(true));
+
+    free(again.content);
+    free(again.headers);
+    free(response.content);
+    free(response.headers);
+    free(json);
+    freeCompressor(compressor);
+}
+
+void testCompressResponseReplacesStaleCacheEntry() {
+    Compressor *compressor = initCompressor(0);
+
+    Header acceptEncoding = { .name = "Accept-Encoding", .value = "gzip" };
+    HttpRequest request = getRequest(&acceptEncoding);
+
+    char *first = repeatedJson(100);
+    char *second = repeatedJson(120);
+
+    HttpResponse response = { .content = first, .status = HTTP_OK, .contentType = APPLICATION_JSON };
+    compressResponse(compressor, &request, &response);
+    free(response.content);
+    free(response.headers);
+
+    response = (HttpResponse){ .content = second, .status = HTTP_OK, .contentType = APPLICATION_JSON };
+    compressResponse(compressor, &request, &response);
+
+    // same resource, new body, so the entry is replaced rather than a stale body served
+    expect(compressor->head == compressor->tail, toBe(true));
+    expect(compressor->head->sourceLength, toBe(strlen(second)));
+
+    size_t inflatedLength = 0;
+    unsigned char *inflated = inflateBody((unsigned char *)response.content, response.contentLength, 15 + 16, strlen(second), &inflatedLength);
+    expect(inflatedLength, toBe(strlen(second)));
+    free(inflated);
+
+    free(response.content);
+    free(response.headers);
+    free(first);
+    free(second);
+    freeCompressor(compressor);
+}
+
+void testCompressResponseSkips() {
+    Compressor *compressor = initCompressor(0);
+
+    Header acceptEncoding = { .name = "Accept-Encoding", .value = "gzip" };
+    HttpRequest request = getRequest(&acceptEncoding);
+
+    // below the threshold
+    HttpResponse small = { .content = "{\"ok\":true}", .status = HTTP_OK, .contentType = APPLICATION_JSON };
+    compressResponse(compressor, &request, &small);
+    expect(small.ownsContent, toBe(false));
+    expectNull(small.headers);
+
+    // not a text type
+    char *json = repeatedJson(100);
+    HttpResponse binary = { .content = json, .status = HTTP_OK, .contentType = "image/png" };
+    compressResponse(compressor, &request, &binary);
+    expect(binary.ownsContent, toBe(false));
+
+    // the client does not accept any encoding, the response still varies on it
+    HttpRequest plain = getRequest(NULL);
+    HttpResponse identity = { .content = json, .status = HTTP_OK, .contentType = APPLICATION_JSON };
+    compressResponse(compressor, &plain, &identity);
+    expect(identity.ownsContent, toBe(false));
+    expectNotNull(strstr(identity.headers, "Vary: Accept-Encoding"));
+    free(identity.headers);
+
+    // per-user responses are compressed but never cached
+    HttpResponse personal = { .content = json, .status = HTTP_OK, .contentType = APPLICATION_JSON };
+    addResponseHeader(&personal, "Cache-Control", "private");
+    compressResponse(compressor, &request, &personal);
+    expect(personal.ownsContent, toBe(true));
+    expectNull(compressor->head);
+
+    free(personal.content);
+    free(personal.headers);
+    free(json);
+    freeCompressor(compressor);
+}
+
+void runCompressTests() {
+    runTest(testNegotiateEncoding);
+    runTest(testCompressBodyRoundTrip);
+    runTest(testCompressResponse);
+    runTest(testCompressResponseReplacesStaleCacheEntry);
+    runTest(testCompressResponseSkips);
+}
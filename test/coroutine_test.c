@@ -0,0 +1,180 @@
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/include/lavandula_test.h"
+#include "../src/include/app.h"
+#include "../src/include/coroutine.h"
+
+static int steps;
+
+static void sleepTwice(void *arg) {
+    (void)arg;
+
+    steps++;
+    awaitSleep(10);
+    steps++;
+    awaitSleep(10);
+    steps++;
+}
+
+// fills enough of its stack that a shared or reused one would show
+static void useStack(void *arg) {
+    char local[8192];
+    memset(local, *(char *)arg, sizeof(local));
+
+    awaitSleep(0);
+
+    for (size_t i = 0; i < sizeof(local); i++) {
+        if (local[i] != *(char *)arg) {
+            steps = -1;
+        }
+    }
+}
+
+static void readPipe(void *arg) {
+    int *fds = arg;
+    char byte;
+
+    steps = awaitReadable(fds[0], 1000) && read(fds[0], &byte, 1) == 1 ? byte : 0;
+}
+
+static void timesOut(void *arg) {
+    steps = awaitReadable(*(int *)arg, 10) ? 1 : 2;
+}
+
+static void addOne(JobContext ctx) {
+    (*(int *)ctx.arg)++;
+}
+
+static void runsJob(void *arg) {
+    awaitJob(NULL, addOne, arg);
+    awaitJob(NULL, addOne, arg);
+}
+
+// as the server does with a request whose connection has gone
+static void keepsAwaiting(void *arg) {
+    (void)arg;
+
+    for (int i = 0; i < 5; i++) {
+        if (!awaitReadable(-1, -1)) steps++;
+    }
+}
+
+void testCoroutineSuspendsAndResumes() {
+    steps = 0;
+    Coroutine *coroutine = coroutineStart(sleepTwice, NULL);
+
+    expect(steps, toBe(1));
+    expect(coroutineDone(coroutine), toBe(false));
+    expect(coroutineWait(coroutine)->kind, toBe(AWAIT_FD));
+    expect(coroutineWait(coroutine)->fd, toBe(-1));
+    expect(coroutineWait(coroutine)->deadlineMillis > 0, toBe(true));
+
+    expect(coroutineResume(coroutine), toBe(false));
+    expect(steps, toBe(2));
+    expect(coroutineResume(coroutine), toBe(true));
+    expect(steps, toBe(3));
+    expect(coroutineWait(coroutine)->kind, toBe(AWAIT_NONE));
+
+    freeCoroutine(coroutine);
+    expectNull(currentCoroutine());
+}
+
+void testCoroutinesKeepTheirOwnStacks() {
+    steps = 0;
+    char fills[3] = { 'a', 'b', 'c' };
+    Coroutine *coroutines[3];
+
+    for (int i = 0; i < 3; i++) {
+        coroutines[i] = coroutineStart(useStack, &fills[i]);
+    }
+    for (int i = 2; i >= 0; i--) {
+        expect(coroutineResume(coroutines[i]), toBe(true));
+        freeCoroutine(coroutines[i]);
+    }
+    expect(steps, toBe(0));
+
+    // pooled stacks are reused, whatever they held before
+    for (int i = 0; i < 3; i++) {
+        coroutines[i] = coroutineStart(useStack, &fills[2 - i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        coroutineResume(coroutines[i]);
+        freeCoroutine(coroutines[i]);
+    }
+    expect(steps, toBe(0));
+}
+
+void testAwaitReadable() {
+    int fds[2];
+    expect(pipe(fds), toBe(0));
+
+    steps = 0;
+    Coroutine *coroutine = coroutineStart(readPipe, fds);
+    expect(coroutineWait(coroutine)->fd, toBe(fds[0]));
+    expect(coroutineWait(coroutine)->events, toBe(POLLIN));
+
+    expect(write(fds[1], "x", 1), toBe(1));
+    coroutineWait(coroutine)->ready = true;
+    expect(coroutineResume(coroutine), toBe(true));
+    expect(steps, toBe('x'));
+    freeCoroutine(coroutine);
+
+    // the resumer decides it timed out
+    coroutine = coroutineStart(timesOut, &fds[0]);
+    coroutineWait(coroutine)->ready = false;
+    coroutineResume(coroutine);
+    expect(steps, toBe(2));
+    freeCoroutine(coroutine);
+
+    // outside a coroutine it blocks instead
+    timesOut(&fds[0]);
+    expect(steps, toBe(2));
+    expect(write(fds[1], "y", 1), toBe(1));
+    readPipe(fds);
+    expect(steps, toBe('y'));
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void testAwaitJob() {
+    int count = 0;
+    Coroutine *coroutine = coroutineStart(runsJob, &count);
+
+    // whoever resumes it runs the job, the server hands it to a worker
+    while (!coroutineDone(coroutine)) {
+        CoroutineWait *wait = coroutineWait(coroutine);
+        expect(wait->kind, toBe(AWAIT_JOB));
+
+        wait->job((JobContext){ .arg = wait->jobArg });
+        coroutineResume(coroutine);
+    }
+    expect(count, toBe(2));
+    freeCoroutine(coroutine);
+
+    runsJob(&count);
+    expect(count, toBe(4));
+}
+
+void testCancelledCoroutineRunsToTheEnd() {
+    steps = 0;
+    Coroutine *coroutine = coroutineStart(keepsAwaiting, NULL);
+
+    coroutineWait(coroutine)->cancelled = true;
+    expect(coroutineResume(coroutine), toBe(true));
+    expect(steps, toBe(5));
+
+    freeCoroutine(coroutine);
+}
+
+void runCoroutineTests() {
+    runTest(testCoroutineSuspendsAndResumes);
+    runTest(testCoroutinesKeepTheirOwnStacks);
+    runTest(testAwaitReadable);
+    runTest(testAwaitJob);
+    runTest(testCancelledCoroutineRunsToTheEnd);
+}
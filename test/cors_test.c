@@ -186,6 +186,86 @@ void testAllowHeaderWithDynamicStrings() {
     freeCorsPolicy(config);
 }
 
+static char *joinIov(struct iovec *iov, int count) {
+    size_t length = 0;
+    for (int i = 0; i < count; i++) length += iov[i].iov_len;
+
+    char *joined = malloc(length + 1);
+    length = 0;
+    for (int i = 0; i < count; i++) {
+        memcpy(joined + length, iov[i].iov_base, iov[i].iov_len);
+        length += iov[i].iov_len;
+    }
+    joined[length] = '\0';
+
+    return joined;
+}
+
+void testCompiledPolicyMatchesOrigins() {
+    CorsConfig config = corsPolicy();
+    allowOrigin(&config, "https://a.example");
+    allowOrigin(&config, "https://b.example");
+
+    CorsHeaders *cors = compileCorsPolicy(&config);
+    expectNotNull(cors);
+    expect(corsOriginAllowed(cors, "https://a.example"), toBe(true));
+    expect(corsOriginAllowed(cors, "https://b.example"), toBe(true));
+    expect(corsOriginAllowed(cors, "https://c.example"), toBe(false));
+    expect(corsOriginAllowed(cors, "https://a.example.evil"), toBe(false));
+
+    freeCorsHeaders(cors);
+    freeCorsPolicy(config);
+}
+
+void testCompileUnconfiguredPolicy() {
+    CorsConfig config = {0};
+    expectNull(compileCorsPolicy(&config));
+}
+
+void testCorsResponseHeadersEchoOrigin() {
+    CorsConfig config = corsPolicy();
+    allowOrigin(&config, "https://a.example");
+
+    CorsHeaders *cors = compileCorsPolicy(&config);
+    struct iovec iov[3];
+
+    int count = corsResponseHeaders(cors, "https://a.example", iov);
+    expect(count, toBe(3));
+
+    char *headers = joinIov(iov, count);
+    expect(strcmp(headers, "Access-Control-Allow-Origin: https://a.example\r\nVary: Origin\r\n"), toBe(0));
+    free(headers);
+
+    expect(corsResponseHeaders(cors, "https://other.example", iov), toBe(0));
+
+    freeCorsHeaders(cors);
+    freeCorsPolicy(config);
+}
+
+void testCorsPreflightResponse() {
+    CorsConfig config = corsAllowAll();
+    allowHeader(&config, "Content-Type");
+    allowHeader(&config, "Authorization");
+
+    CorsHeaders *cors = compileCorsPolicy(&config);
+    struct iovec iov[3];
+
+    int count = corsPreflightResponse(cors, "https://anything.example", iov);
+    expect(count, toBe(3));
+
+    char *response = joinIov(iov, count);
+    const char *statusAndOrigin = "HTTP/1.1 204 No Content\r\nAccess-Control-Allow-Origin: *\r\n";
+    expect(strncmp(response, statusAndOrigin, strlen(statusAndOrigin)), toBe(0));
+    expectNotNull(strstr(response, "Access-Control-Allow-Methods: GET, POST, PUT, PATCH, DELETE, OPTIONS\r\n"));
+    expectNotNull(strstr(response, "Access-Control-Allow-Headers: Content-Type, Authorization\r\n"));
+    expectNull(strstr(response, "Vary: Origin"));
+    expect(strcmp(response + strlen(response) - 4, "\r\n\r\n"), toBe(0));
+    free(response);
+
+    freeCorsHeaders(cors);
+    freeCorsPolicy(config);
+}
+
 void runCorsTests() {
     runTest(testCorsPolicyInit);
     runTest(testAllowOrigin);
@@ -200,4 +280,8 @@ void runCorsTests() {
     runTest(testCorsAllowAll);
     runTest(testAllowOriginWithDynamicStrings);
     runTest(testAllowHeaderWithDynamicStrings);
+    runTest(testCompiledPolicyMatchesOrigins);
+    runTest(testCompileUnconfiguredPolicy);
+    runTest(testCorsResponseHeadersEchoOrigin);
+    runTest(testCorsPreflightResponse);
 }
\ No newline at end of file
@@ -147,6 +147,75 @@ void testParseRequestNoHeaders() {
     freeParser(&parser);
 }
 
+void testParseRequestWithLongHeaderValue() {
+    char value[MAX_HEADER_VALUE * 2];
+    memset(value, 'x', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+
+    char requestStr[MAX_HEADER_VALUE * 3];
+    snprintf(requestStr, sizeof(requestStr), "GET / HTTP/1.1\r\nAuthorization: %s\r\nHost: localhost\r\n\r\n", value);
+    HttpParser parser = parseRequest(requestStr);
+
+    expect(parser.request.headerCount, toBe(2));
+    expect(strcmp(findHeader(&parser.request, "authorization"), value), toBe(0));
+    expect(strlen(parser.request.headers[0].value), toBe(MAX_HEADER_VALUE - 1));
+    expectNull(parser.request.headers[1].longValue);
+    expect(strcmp(findHeader(&parser.request, "Host"), "localhost"), toBe(0));
+
+    freeParser(&parser);
+}
+
+void testDecodeChunkedBody() {
+    char body[] = "5\r\nhello\r\n7;name=value\r\n, world\r\n0\r\n\r\n";
+    ChunkedDecoder decoder = {0};
+
+    expect(decodeChunked(&decoder, body, strlen(body)), toBe(CHUNKED_COMPLETE));
+    expect(decoder.decoded, toBe(12));
+    expect(strncmp(body, "hello, world", 12), toBe(0));
+}
+
+void testDecodeChunkedBodyAcrossReads() {
+    const char *wire = "A\r\n0123456789\r\n3\r\nabc\r\n0\r\nExpires: never\r\n\r\n";
+    size_t wireLength = strlen(wire);
+
+    // fed one byte at a time, as a slow client would send it
+    char body[128];
+    ChunkedDecoder decoder = {0};
+    size_t length = 0;
+    ChunkedProgress progress = CHUNKED_INCOMPLETE;
+
+    for (size_t i = 0; i < wireLength; i++) {
+        expect(progress, toBe(CHUNKED_INCOMPLETE));
+
+        body[length++] = wire[i];
+        progress = decodeChunked(&decoder, body, length);
+        length = decoder.decoded;
+    }
+
+    expect(progress, toBe(CHUNKED_COMPLETE));
+    expect(decoder.decoded, toBe(13));
+    expect(strncmp(body, "0123456789abc", 13), toBe(0));
+}
+
+void testDecodeInvalidChunkedBody() {
+    char missingSize[] = "\r\nhello\r\n";
+    ChunkedDecoder decoder = {0};
+    expect(decodeChunked(&decoder, missingSize, strlen(missingSize)), toBe(CHUNKED_INVALID));
+
+    char notHex[] = "5x\r\nhello\r\n";
+    decoder = (ChunkedDecoder){0};
+    expect(decodeChunked(&decoder, notHex, strlen(notHex)), toBe(CHUNKED_INVALID));
+
+    // more data than the chunk size said
+    char overrun[] = "2\r\nhello\r\n";
+    decoder = (ChunkedDecoder){0};
+    expect(decodeChunked(&decoder, overrun, strlen(overrun)), toBe(CHUNKED_INVALID));
+
+    char overflow[] = "fffffffffffffffffff\r\n";
+    decoder = (ChunkedDecoder){0};
+    expect(decodeChunked(&decoder, overflow, strlen(overflow)), toBe(CHUNKED_INVALID));
+}
+
 void runHttpTests() {
     runTest(testHttpMethodToString);
     runTest(testParseSimpleGetRequest);
@@ -157,4 +226,8 @@ void runHttpTests() {
     // runTest(testParseOptionsRequest); // fails
     runTest(testParseRequestWithQueryParameters);
     runTest(testParseRequestNoHeaders);
+    runTest(testParseRequestWithLongHeaderValue);
+    runTest(testDecodeChunkedBody);
+    runTest(testDecodeChunkedBodyAcrossReads);
+    runTest(testDecodeInvalidChunkedBody);
 }
\ No newline at end of file
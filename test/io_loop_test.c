@@ -0,0 +1,148 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../src/include/lavandula_test.h"
+#include "../src/include/io_loop.h"
+
+// waits a few rounds, io_uring may take one to arm what it waits for
+static int waitFor(IoLoop *loop, struct pollfd *fds, int count) {
+    int ready = 0;
+    for (int round = 0; round < 5 && ready == 0; round++) {
+        ready = ioWait(loop, fds, count, 100);
+    }
+
+    return ready;
+}
+
+static void nonBlockingPair(int fds[2]) {
+    expect(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), toBe(0));
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+}
+
+void testIoWaitReportsReadyFds() {
+    IoLoop *loop = openIoLoop(16);
+    int fds[2];
+    expect(pipe(fds), toBe(0));
+
+    struct pollfd wait[2] = { { .fd = fds[0], .events = POLLIN }, { .fd = -1 } };
+    expect(ioWait(loop, wait, 2, 0), toBe(0));
+
+    expect(write(fds[1], "x", 1), toBe(1));
+    expect(waitFor(loop, wait, 2), toBe(1));
+    expect(wait[0].revents & POLLIN, toBe(POLLIN));
+    expect(wait[1].revents, toBe(0));
+
+    // level triggered, still readable until it is read
+    expect(waitFor(loop, wait, 2), toBe(1));
+
+    char byte;
+    expect(read(fds[0], &byte, 1), toBe(1));
+    expect(ioWait(loop, wait, 2, 10), toBe(0));
+
+    close(fds[0]);
+    close(fds[1]);
+    closeIoLoop(loop);
+}
+
+void testIoReadsAdoptedSocket() {
+    IoLoop *loop = openIoLoop(16);
+    int fds[2];
+    nonBlockingPair(fds);
+    ioAdopt(loop, fds[0]);
+
+    char buffer[64];
+    struct pollfd wait = { .fd = fds[0], .events = POLLIN };
+
+    expect(write(fds[1], "hello", 5), toBe(5));
+    expect(waitFor(loop, &wait, 1), toBe(1));
+    expect(ioRead(loop, fds[0], buffer, 3), toBe(3));
+    expect(ioRead(loop, fds[0], buffer + 3, sizeof(buffer) - 3), toBe(2));
+    expect(memcmp(buffer, "hello", 5), toBe(0));
+    expect(ioRead(loop, fds[0], buffer, sizeof(buffer)), toBe(-1));
+
+    // the peer hanging up reads as the end
+    close(fds[1]);
+    expect(waitFor(loop, &wait, 1), toBe(1));
+    expect(ioRead(loop, fds[0], buffer, sizeof(buffer)), toBe(0));
+
+    ioClose(loop, fds[0]);
+    closeIoLoop(loop);
+}
+
+void testIoSendAndClose() {
+    IoLoop *loop = openIoLoop(16);
+    int fds[2];
+    nonBlockingPair(fds);
+    ioAdopt(loop, fds[0]);
+
+    struct iovec iov[2] = { { "HTTP/1.1 200 OK\r\n", 17 }, { "\r\n", 2 } };
+    if (!ioSendAndClose(loop, fds[0], iov, 2, 0)) {
+        expect(writev(fds[0], iov, 2), toBe(19));
+    }
+    ioClose(loop, fds[0]);
+    ioDrain(loop);
+
+    // everything, then the end
+    char buffer[64];
+    size_t length = 0;
+    ssize_t count;
+    while ((count = read(fds[1], buffer + length, sizeof(buffer) - length)) > 0) {
+        length += count;
+    }
+    expect(count, toBe(0));
+    expect(length, toBe(19));
+    expect(memcmp(buffer, "HTTP/1.1 200 OK\r\n\r\n", 19), toBe(0));
+
+    close(fds[1]);
+    closeIoLoop(loop);
+}
+
+void testIoAcceptsFromListener() {
+    IoLoop *loop = openIoLoop(16);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t length = sizeof(address);
+    expect(bind(listener, (struct sockaddr *)&address, length), toBe(0));
+    expect(listen(listener, 8), toBe(0));
+    getsockname(listener, (struct sockaddr *)&address, &length);
+    fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+    ioListen(loop, listener);
+
+    struct sockaddr_storage peer;
+    socklen_t peerLength = sizeof(peer);
+    struct pollfd wait = { .fd = listener, .events = POLLIN };
+    expect(ioWait(loop, &wait, 1, 0), toBe(0));
+    expect(ioAccept(loop, listener, &peer, &peerLength), toBe(-1));
+
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    expect(connect(client, (struct sockaddr *)&address, sizeof(address)), toBe(0));
+
+    expect(waitFor(loop, &wait, 1), toBe(1));
+    int accepted = ioAccept(loop, listener, &peer, &peerLength);
+    expect(accepted >= 0, toBe(true));
+    expect((fcntl(accepted, F_GETFL) & O_NONBLOCK) != 0, toBe(true));
+    expect((fcntl(accepted, F_GETFD) & FD_CLOEXEC) != 0, toBe(true));
+    expect(ioAcceptQueued(loop), toBe(false));
+
+    close(accepted);
+    close(client);
+    // no longer polled, so no longer accepted from
+    ioWait(loop, NULL, 0, 0);
+    close(listener);
+    closeIoLoop(loop);
+}
+
+void runIoLoopTests() {
+    runTest(testIoWaitReportsReadyFds);
+    runTest(testIoReadsAdoptedSocket);
+    runTest(testIoSendAndClose);
+    runTest(testIoAcceptsFromListener);
+}
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/include/lavandula_test.h"
+#include "../src/include/app.h"
+#include "../src/include/jobs.h"
+
+static int finished;
+
+static void countJob(JobContext ctx) {
+    __atomic_add_fetch((int *)ctx.arg, 1, __ATOMIC_RELAXED);
+}
+
+// waits for the test to let it go, holding its worker
+static void blockingJob(JobContext ctx) {
+    while (!__atomic_load_n((bool *)ctx.arg, __ATOMIC_ACQUIRE)) {
+        usleep(1000);
+    }
+    __atomic_add_fetch(&finished, 1, __ATOMIC_RELAXED);
+}
+
+// a job that queues another one
+static void chainJob(JobContext ctx) {
+    enqueueJob(ctx.app, countJob, ctx.arg);
+}
+
+void testEnqueuedJobsAllRun() {
+    App app = { .jobs = initJobQueue(4, 256) };
+
+    int count = 0;
+    int queued = 0;
+    for (int i = 0; i < 2000; i++) {
+        // full now and then, the workers catch up
+        while (!enqueueJob(&app, countJob, &count)) {
+            usleep(100);
+        }
+        queued++;
+    }
+    enqueueJob(&app, chainJob, &count);
+    queued++;
+
+    drainJobQueue(app.jobs);
+    expect(count, toBe(queued));
+    expect(app.jobs->queued, toBe(0));
+    expect(app.jobs->running, toBe(0));
+    expect(app.jobs->completed, toBe((uint64_t)queued + 1));
+
+    freeJobQueue(app.jobs);
+}
+
+void testFullQueueRejects() {
+    App app = { .jobs = initJobQueue(2, 4) };
+    bool release = false;
+    finished = 0;
+
+    // two running and four waiting fill it
+    int accepted = 0;
+    for (int i = 0; i < 2; i++) {
+        if (enqueueJob(&app, blockingJob, &release)) accepted++;
+    }
+    while (__atomic_load_n(&app.jobs->running, __ATOMIC_ACQUIRE) < 2) {
+        usleep(1000);
+    }
+    for (int i = 0; i < 6; i++) {
+        if (enqueueJob(&app, blockingJob, &release)) accepted++;
+    }
+    expect(accepted, toBe(6));
+    expect(app.jobs->rejected, toBe(2));
+
+    __atomic_store_n(&release, true, __ATOMIC_RELEASE);
+
+    // freeing runs what is still queued first
+    freeJobQueue(app.jobs);
+    expect(finished, toBe(6));
+}
+
+void testStealingFromABusyWorker() {
+    App app = { .jobs = initJobQueue(2, 64) };
+    bool release = false;
+    finished = 0;
+
+    // every other job lands behind the blocked one, the idle worker takes them
+    int count = 0;
+    enqueueJob(&app, blockingJob, &release);
+    for (int i = 0; i < 20; i++) {
+        enqueueJob(&app, countJob, &count);
+    }
+
+    for (int i = 0; i < 1000 && __atomic_load_n(&count, __ATOMIC_ACQUIRE) < 20; i++) {
+        usleep(1000);
+    }
+    expect(count, toBe(20));
+    expect(app.jobs->workers[0].stolen + app.jobs->workers[1].stolen > 0, toBe(true));
+
+    __atomic_store_n(&release, true, __ATOMIC_RELEASE);
+    freeJobQueue(app.jobs);
+}
+
+void testParseJobSchedule() {
+    JobSchedule schedule;
+
+    expect(parseJobSchedule("*/15 9-17 * * 1-5", &schedule), toBe(true));
+    expect(schedule.minutes, toBe((1ULL << 0) | (1ULL << 15) | (1ULL << 30) | (1ULL << 45)));
+    expect(schedule.hours, toBe(0x3fe00));
+    expect(schedule.anyDay, toBe(true));
+    expect(schedule.anyWeekday, toBe(false));
+    expect(schedule.weekdays, toBe(0x3e));
+
+    expect(parseJobSchedule("0 0 * * 7", &schedule), toBe(true));
+    expect(schedule.weekdays, toBe(1));
+
+    expect(parseJobSchedule("@every 30s", &schedule), toBe(true));
+    expect(schedule.intervalSeconds, toBe(30));
+    expect(parseJobSchedule("@every 2h", &schedule), toBe(true));
+    expect(schedule.intervalSeconds, toBe(7200));
+
+    expect(parseJobSchedule("@daily", &schedule), toBe(true));
+    expect(schedule.minutes, toBe(1));
+    expect(schedule.hours, toBe(1));
+
+    expect(parseJobSchedule("60 * * * *", &schedule), toBe(false));
+    expect(parseJobSchedule("* * * *", &schedule), toBe(false));
+    expect(parseJobSchedule("* * * * * *", &schedule), toBe(false));
+    expect(parseJobSchedule("1,,2 * * * *", &schedule), toBe(false));
+    expect(parseJobSchedule("5-1 * * * *", &schedule), toBe(false));
+    expect(parseJobSchedule("@every 10x", &schedule), toBe(false));
+    expect(parseJobSchedule("@sometimes", &schedule), toBe(false));
+}
+
+static time_t localTime(int year, int month, int day, int hour, int minute) {
+    struct tm tm = {
+        .tm_year = year - 1900, .tm_mon = month - 1, .tm_mday = day,
+        .tm_hour = hour, .tm_min = minute, .tm_isdst = -1,
+    };
+
+    return mktime(&tm);
+}
+
+void testNextScheduledRun() {
+    JobSchedule schedule;
+
+    // Friday 2025-03-14 17:50, the next weekday slot is Monday 09:00
+    parseJobSchedule("*/15 9-17 * * 1-5", &schedule);
+    expect(nextScheduledRun(&schedule, localTime(2025, 3, 14, 17, 50)), toBe(localTime(2025, 3, 17, 9, 0)));
+    expect(nextScheduledRun(&schedule, localTime(2025, 3, 14, 10, 0)), toBe(localTime(2025, 3, 14, 10, 15)));
+
+    // either day field matches when both are given
+    parseJobSchedule("0 12 13 * 5", &schedule);
+    expect(nextScheduledRun(&schedule, localTime(2025, 3, 1, 0, 0)), toBe(localTime(2025, 3, 7, 12, 0)));
+
+    parseJobSchedule("0 0 29 2 *", &schedule);
+    expect(nextScheduledRun(&schedule, localTime(2025, 1, 1, 0, 0)), toBe(localTime(2028, 2, 29, 0, 0)));
+
+    parseJobSchedule("0 0 31 2 *", &schedule);
+    expect(nextScheduledRun(&schedule, localTime(2025, 1, 1, 0, 0)), toBe(0));
+
+    parseJobSchedule("@every 90s", &schedule);
+    expect(nextScheduledRun(&schedule, 1000), toBe(1090));
+}
+
+static void scheduledJob(JobContext ctx) {
+    __atomic_add_fetch((int *)ctx.arg, 1, __ATOMIC_RELAXED);
+}
+
+void testScheduledJobRuns() {
+    App app = { .jobs = initJobQueue(1, 8) };
+
+    int runs = 0;
+    expect(scheduleJob(&app, "@every 1s", scheduledJob, &runs), toBe(true));
+    expect(scheduleJob(&app, "61 * * * *", scheduledJob, &runs), toBe(false));
+
+    for (int i = 0; i < 300 && __atomic_load_n(&runs, __ATOMIC_ACQUIRE) == 0; i++) {
+        usleep(10000);
+    }
+    expect(runs > 0, toBe(true));
+
+    freeJobQueue(app.jobs);
+}
+
+void runJobsTests() {
+    runTest(testEnqueuedJobsAllRun);
+    runTest(testFullQueueRejects);
+    runTest(testStealingFromABusyWorker);
+    runTest(testParseJobSchedule);
+    runTest(testNextScheduledRun);
+    runTest(testScheduledJobRuns);
+}
@@ -0,0 +1,355 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/include/lavandula_test.h"
+#include "../src/include/crypto.h"
+#include "../src/include/base64.h"
+#include "../src/include/jwt.h"
+#include "../src/include/app.h"
+
+// the example token from jwt.io, signed with "your-256-bit-secret"
+#define JWT_IO_TOKEN \
+    "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9." \
+    "eyJzdWIiOiIxMjM0NTY3ODkwIiwibmFtZSI6IkpvaG4gRG9lIiwiaWF0IjoxNTE2MjM5MDIyfQ." \
+    "SflKxwRJSMeKKF2QT4fwpMeJf36POk6yJV_adQssw5c"
+
+// an HS256 token around payload as it is written, for claims signJwt cannot hold
+static char *signPayload(const char *secret, const char *payload) {
+    static const char header[] = "{\"alg\":\"HS256\",\"typ\":\"JWT\"}";
+    char *encodedHeader = base64UrlEncode((const unsigned char *)header, strlen(header));
+    char *encodedPayload = base64UrlEncode((const unsigned char *)payload, strlen(payload));
+
+    char input[1024];
+    snprintf(input, sizeof(input), "%s.%s", encodedHeader, encodedPayload);
+
+    unsigned char mac[SHA256_DIGEST_SIZE];
+    hmacSha256(secret, strlen(secret), input, strlen(input), mac);
+    char *signature = base64UrlEncode(mac, sizeof(mac));
+
+    char *token = malloc(strlen(input) + strlen(signature) + 2);
+    sprintf(token, "%s.%s", input, signature);
+
+    free(encodedHeader);
+    free(encodedPayload);
+    free(signature);
+
+    return token;
+}
+
+static void toHex(const unsigned char *digest, size_t length, char *out) {
+    for (size_t i = 0; i < length; i++) {
+        sprintf(out + i * 2, "%02x", digest[i]);
+    }
+}
+
+void testSha256Abc() {
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char hex[SHA256_DIGEST_SIZE * 2 + 1];
+
+    sha256("abc", 3, digest);
+    toHex(digest, sizeof(digest), hex);
+
+    expect(strcmp(hex, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"), toBe(0));
+}
+
+void testSha256MultiBlock() {
+    const char *input = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char hex[SHA256_DIGEST_SIZE * 2 + 1];
+
+    // feed it in uneven pieces to exercise the block buffering
+    Sha256Context ctx;
+    sha256Init(&ctx);
+    sha256Update(&ctx, input, 5);
+    sha256Update(&ctx, input + 5, 50);
+    sha256Update(&ctx, input + 55, strlen(input) - 55);
+    sha256Final(&ctx, digest);
+    toHex(digest, sizeof(digest), hex);
+
+    expect(strcmp(hex, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"), toBe(0));
+}
+
+void testHmacSha256() {
+    // RFC 4231 test case 2
+    const char *data = "what do ya want for nothing?";
+    unsigned char mac[SHA256_DIGEST_SIZE];
+    char hex[SHA256_DIGEST_SIZE * 2 + 1];
+
+    hmacSha256("Jefe", 4, data, strlen(data), mac);
+    toHex(mac, sizeof(mac), hex);
+
+    expect(strcmp(hex, "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843"), toBe(0));
+}
+
+void testBase64UrlRoundTrip() {
+    const unsigned char data[] = {0xfb, 0xff, 0x00, 0x3e, 0x3f};
+
+    char *encoded = base64UrlEncode(data, sizeof(data));
+    expect(strcmp(encoded, "-_8APj8"), toBe(0));
+
+    size_t length = 0;
+    unsigned char *decoded = base64UrlDecode(encoded, strlen(encoded), &length);
+    expect(length, toBe(sizeof(data)));
+    expect(memcmp(decoded, data, sizeof(data)), toBe(0));
+
+    free(encoded);
+    free(decoded);
+}
+
+void testBase64UrlRejectsStandardAlphabet() {
+    expectNull(base64UrlDecode("ab+/", 4, NULL));
+    expectNull(base64UrlDecode("abcde", 5, NULL));
+}
+
+void testVerifyJwtKnownToken() {
+    JwtAuthenticator *auth = initJwtAuth("your-256-bit-secret", 4);
+
+    JsonBuilder *claims = verifyJwt(auth, JWT_IO_TOKEN, 1516239022);
+    expectNotNull(claims);
+    expect(strcmp(jsonGetString(claims, "sub"), "1234567890"), toBe(0));
+    expect(jsonGetInteger(claims, "iat"), toBe(1516239022));
+    expect(auth->cache.count, toBe(1));
+
+    freeJsonBuilder(claims);
+    freeJwtAuth(auth);
+}
+
+void testVerifyJwtWrongSecret() {
+    JwtAuthenticator *auth = initJwtAuth("not-the-secret", 4);
+
+    expectNull(verifyJwt(auth, JWT_IO_TOKEN, 1516239022));
+    expect(auth->cache.count, toBe(0));
+
+    freeJwtAuth(auth);
+}
+
+void testVerifyJwtTamperedPayload() {
+    JwtAuthenticator *auth = initJwtAuth("your-256-bit-secret", 4);
+
+    char *token = strdup(JWT_IO_TOKEN);
+    char *payload = strchr(token, '.') + 1;
+    payload[4] = payload[4] == 'A' ? 'B' : 'A';
+
+    expectNull(verifyJwt(auth, token, 1516239022));
+
+    free(token);
+    freeJwtAuth(auth);
+}
+
+void testVerifyJwtRejectsAlgNone() {
+    JwtAuthenticator *auth = initJwtAuth("secret", 4);
+
+    // {"alg":"none"}.{"sub":"x"}.
+    expectNull(verifyJwt(auth, "eyJhbGciOiJub25lIn0.eyJzdWIiOiJ4In0.", 0));
+
+    freeJwtAuth(auth);
+}
+
+void testSignAndVerifyJwt() {
+    JwtAuthenticator *auth = initJwtAuth("secret", 4);
+
+    JsonBuilder *claims = jsonBuilder();
+    jsonPutString(claims, "sub", "alice");
+    jsonPutInteger(claims, "exp", 2000000000);
+
+    char *token = signJwt(auth, claims);
+    freeJsonBuilder(claims);
+
+    JsonBuilder *verified = verifyJwt(auth, token, 1900000000);
+    expectNotNull(verified);
+    expect(strcmp(jsonGetString(verified, "sub"), "alice"), toBe(0));
+    freeJsonBuilder(verified);
+
+    free(token);
+    freeJwtAuth(auth);
+}
+
+void testVerifyJwtExpired() {
+    JwtAuthenticator *auth = initJwtAuth("secret", 4);
+
+    JsonBuilder *claims = jsonBuilder();
+    jsonPutString(claims, "sub", "alice");
+    jsonPutInteger(claims, "exp", 1000);
+
+    char *token = signJwt(auth, claims);
+    freeJsonBuilder(claims);
+
+    expectNull(verifyJwt(auth, token, 999999));
+    expect(auth->cache.count, toBe(0));
+
+    free(token);
+    freeJwtAuth(auth);
+}
+
+void testVerifyJwtExpiryPast2038() {
+    JwtAuthenticator *auth = initJwtAuth("secret", 4);
+    char *token = signPayload("secret", "{\"sub\":\"alice\",\"exp\":4102444800,\"nbf\":2200000000}");
+
+    expectNull(verifyJwt(auth, token, 2100000000));
+
+    JsonBuilder *verified = verifyJwt(auth, token, 4000000000);
+    expectNotNull(verified);
+    freeJsonBuilder(verified);
+
+    expectNull(verifyJwt(auth, token, 4102444800));
+
+    free(token);
+    freeJwtAuth(auth);
+}
+
+void testVerifyJwtRejectsOutOfRangeTimes() {
+    JwtAuthenticator *auth = initJwtAuth("secret", 4);
+    const char *payloads[] = {
+        "{\"exp\":-1}",
+        "{\"exp\":1e300}",
+        "{\"nbf\":99999999999999999999}",
+    };
+
+    for (size_t i = 0; i < sizeof(payloads) / sizeof(payloads[0]); i++) {
+        char *token = signPayload("secret", payloads[i]);
+        expectNull(verifyJwt(auth, token, 1000));
+        free(token);
+    }
+
+    // an exp inside another claim is not the token's own
+    char *token = signPayload("secret", "{\"act\":{\"exp\":1},\"sub\":\"exp\"}");
+    JsonBuilder *verified = verifyJwt(auth, token, 1000);
+    expectNotNull(verified);
+    freeJsonBuilder(verified);
+    free(token);
+
+    freeJwtAuth(auth);
+}
+
+void testVerifyJwtRejectsMalformedTimes() {
+    JwtAuthenticator *auth = initJwtAuth("secret", 4);
+    const char *payloads[] = {
+        "{\"exp\":\"9999999999\"}",
+        "{\"exp\":null}",
+        "{\"nbf\":true}",
+        "{\"exp\":nan}",
+    };
+
+    // a NumericDate that cannot be read must not leave the token without an expiry
+    for (size_t i = 0; i < sizeof(payloads) / sizeof(payloads[0]); i++) {
+        char *token = signPayload("secret", payloads[i]);
+        expectNull(verifyJwt(auth, token, 1000));
+        free(token);
+    }
+
+    freeJwtAuth(auth);
+}
+
+static HttpResponse claimsController(RequestContext ctx) {
+    return ok(ctx.claims ? "claims" : "none", TEXT_PLAIN);
+}
+
+void testJwtAuthAcceptsLongToken() {
+    App app = {0};
+    app.jwtAuth = initJwtAuth("secret", 4);
+
+    MiddlewareFunc handlers[] = { jwtAuth };
+    MiddlewareHandler middleware = {
+        .handlers = handlers,
+        .count = 1,
+        .capacity = 1,
+        .finalHandler = claimsController,
+    };
+
+    // a token far longer than MAX_HEADER_VALUE reaches jwtAuth whole
+    char payload[600];
+    snprintf(payload, sizeof(payload), "{\"sub\":\"alice\",\"roles\":\"%0400d\"}", 0);
+    char *token = signPayload("secret", payload);
+    expect(strlen(token) > MAX_HEADER_VALUE, toBe(true));
+
+    char request[1024];
+    snprintf(request, sizeof(request), "GET / HTTP/1.1\r\nAuthorization: Bearer %s\r\n\r\n", token);
+    free(token);
+
+    HttpParser parser = parseRequest(request);
+    HttpResponse response = next(requestContext(&app, parser.request), &middleware);
+    expect(response.status, toBe(HTTP_OK));
+    expect(strcmp(response.content, "claims"), toBe(0));
+    free(response.headers);
+    freeParser(&parser);
+
+    // what the inline value alone holds is not the token that was sent
+    Header header = { .name = "Authorization" };
+    memset(header.value, 'a', MAX_HEADER_VALUE - 1);
+    memcpy(header.value, "Bearer ", 7);
+
+    HttpRequest cut = { .method = HTTP_GET, .resource = "/", .headers = &header, .headerCount = 1 };
+    middleware.current = 0;
+    response = next(requestContext(&app, cut), &middleware);
+    expect(response.status, toBe(HTTP_UNAUTHORIZED));
+    free(response.headers);
+
+    freeJwtAuth(app.jwtAuth);
+}
+
+void testJwtCacheExpiresAtExp() {
+    JwtAuthenticator *auth = initJwtAuth("secret", 4);
+
+    JsonBuilder *claims = jsonBuilder();
+    jsonPutInteger(claims, "exp", 2000);
+
+    char *token = signJwt(auth, claims);
+    freeJsonBuilder(claims);
+
+    JsonBuilder *verified = verifyJwt(auth, token, 1000);
+    expectNotNull(verified);
+    freeJsonBuilder(verified);
+    expect(auth->cache.count, toBe(1));
+
+    // the cached entry must not outlive the token
+    expectNull(verifyJwt(auth, token, 2000));
+    expect(auth->cache.count, toBe(0));
+
+    free(token);
+    freeJwtAuth(auth);
+}
+
+void testJwtCacheEvictsLeastRecentlyUsed() {
+    JwtAuthenticator *auth = initJwtAuth("secret", 2);
+    char *tokens[3];
+
+    for (int i = 0; i < 3; i++) {
+        JsonBuilder *claims = jsonBuilder();
+        jsonPutInteger(claims, "n", i);
+        tokens[i] = signJwt(auth, claims);
+        freeJsonBuilder(claims);
+
+        JsonBuilder *verified = verifyJwt(auth, tokens[i], 0);
+        freeJsonBuilder(verified);
+    }
+
+    expect(auth->cache.count, toBe(2));
+    expect(strcmp(auth->cache.head->token, tokens[2]), toBe(0));
+    expect(strcmp(auth->cache.tail->token, tokens[1]), toBe(0));
+
+    for (int i = 0; i < 3; i++) {
+        free(tokens[i]);
+    }
+    freeJwtAuth(auth);
+}
+
+void runJwtTests() {
+    runTest(testSha256Abc);
+    runTest(testSha256MultiBlock);
+    runTest(testHmacSha256);
+    runTest(testBase64UrlRoundTrip);
+    runTest(testBase64UrlRejectsStandardAlphabet);
+    runTest(testVerifyJwtKnownToken);
+    runTest(testVerifyJwtWrongSecret);
+    runTest(testVerifyJwtTamperedPayload);
+    runTest(testVerifyJwtRejectsAlgNone);
+    runTest(testSignAndVerifyJwt);
+    runTest(testVerifyJwtExpired);
+    runTest(testVerifyJwtExpiryPast2038);
+    runTest(testVerifyJwtRejectsOutOfRangeTimes);
+    runTest(testVerifyJwtRejectsMalformedTimes);
+    runTest(testJwtAuthAcceptsLongToken);
+    runTest(testJwtCacheExpiresAtExp);
+    runTest(testJwtCacheEvictsLeastRecentlyUsed);
+}
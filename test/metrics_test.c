@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../src/include/lavandula_test.h"
+#include "../src/include/metrics.h"
+
+void testMetricsBucketBounds() {
+    // exact below the first power of two split
+    for (uint64_t v = 0; v < 8; v++) {
+        expect(metricsBucketIndex(v), toBe((int)v));
+        expect(metricsBucketUpperBound((int)v), toBe(v));
+    }
+
+    // every value falls inside its bucket, and the bucket is at most 12.5% wide
+    uint64_t values[] = { 8, 9, 15, 16, 17, 100, 1000, 4095, 4096, 123456, 10000000 };
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        int index = metricsBucketIndex(values[i]);
+        uint64_t upper = metricsBucketUpperBound(index);
+        uint64_t lower = index > 0 ? metricsBucketUpperBound(index - 1) + 1 : 0;
+
+        expect(values[i] >= lower && values[i] <= upper, toBe(true));
+        expect((upper - lower + 1) * 8 <= lower, toBe(true));
+    }
+
+    expect(metricsBucketIndex(UINT64_MAX), toBe(METRICS_BUCKETS - 1));
+}
+
+void testMetricsQuantile() {
+    uint64_t buckets[METRICS_BUCKETS] = {0};
+
+    // 990 fast requests at 100us and 10 slow ones at 50ms
+    buckets[metricsBucketIndex(100)] = 990;
+    buckets[metricsBucketIndex(50000)] = 10;
+
+    uint64_t p50 = metricsQuantile(buckets, 1000, 0.5);
+    uint64_t p999 = metricsQuantile(buckets, 1000, 0.999);
+
+    expect(p50 >= 100 && p50 < 113, toBe(true));
+    expect(p999 >= 50000 && p999 < 56250, toBe(true));
+    expect(metricsQuantile(buckets, 0, 0.99), toBe(0));
+}
+
+void testRenderMetrics() {
+    Metrics *metrics = initMetrics();
+
+    recordRequest(metrics, "/api/items", HTTP_GET, 200, 150);
+    recordRequest(metrics, "/api/items", HTTP_GET, 200, 250);
+    recordRequest(metrics, "/api/items", HTTP_GET, 404, 20);
+    recordRequest(metrics, "/say \"hi\"", HTTP_POST, 201, 3000000);
+
+    char *text = renderMetrics(metrics);
+
+    expectNotNull(strstr(text, "# TYPE lavandula_http_requests_total counter\n"));
+    expectNotNull(strstr(text, "lavandula_http_requests_total{route=\"/api/items\",method=\"GET\",status=\"200\"} 2\n"));
+    expectNotNull(strstr(text, "lavandula_http_requests_total{route=\"/api/items\",method=\"GET\",status=\"404\"} 1\n"));
+    expectNotNull(strstr(text, "route=\"/say \\\"hi\\\"\""));
+    expectNotNull(strstr(text, "lavandula_http_request_duration_seconds_bucket{route=\"/api/items\",method=\"GET\",status=\"200\",le=\"0.0005\"} 2\n"));
+    expectNotNull(strstr(text, "lavandula_http_request_duration_seconds_bucket{route=\"/say \\\"hi\\\"\",method=\"POST\",status=\"201\",le=\"2.5\"} 0\n"));
+    expectNotNull(strstr(text, "lavandula_http_request_duration_seconds_bucket{route=\"/say \\\"hi\\\"\",method=\"POST\",status=\"201\",le=\"5\"} 1\n"));
+    expectNotNull(strstr(text, "lavandula_http_request_duration_seconds_sum{route=\"/api/items\",method=\"GET\",status=\"200\"} 0.000400\n"));
+    expectNotNull(strstr(text, "quantile=\"0.99\"}"));
+    expectNotNull(strstr(text, "lavandula_metrics_dropped_total 0\n"));
+
+    free(text);
+    freeMetrics(metrics);
+}
+
+static void *recordFromThread(void *arg) {
+    Metrics *metrics = arg;
+    for (int i = 0; i < 1000; i++) {
+        recordRequest(metrics, "/threaded", HTTP_GET, 200, 10);
+    }
+
+    return NULL;
+}
+
+void testMetricsMergesThreads() {
+    Metrics *metrics = initMetrics();
+
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) {
+        pthread_create(&threads[i], NULL, recordFromThread, metrics);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // every thread kept its own shard
+    int shards = 0;
+    for (MetricsShard *shard = metrics->shards; shard; shard = shard->next) {
+        shards++;
+    }
+    expect(shards, toBe(4));
+
+    char *text = renderMetrics(metrics);
+    expectNotNull(strstr(text, "lavandula_http_requests_total{route=\"/threaded\",method=\"GET\",status=\"200\"} 4000\n"));
+
+    free(text);
+    freeMetrics(metrics);
+}
+
+void runMetricsTests() {
+    runTest(testMetricsBucketBounds);
+    runTest(testMetricsQuantile);
+    runTest(testRenderMetrics);
+    runTest(testMetricsMergesThreads);
+}
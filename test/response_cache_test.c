@@ -0,0 +1,355 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "../src/include/lavandula_test.h"
+#include "../src/include/lavandula.h"
+#include "../src/include/coroutine.h"
+
+static int controllerCalls = 0;
+
+static HttpResponse countingController(RequestContext ctx) {
+    (void)ctx;
+    controllerCalls++;
+
+    HttpResponse response = ok("[{\"id\":1}]", APPLICATION_JSON);
+    addResponseHeader(&response, "X-Served-By", "controller");
+
+    return response;
+}
+
+static HttpResponse privateController(RequestContext ctx) {
+    (void)ctx;
+    controllerCalls++;
+
+    HttpResponse response = ok("me", TEXT_PLAIN);
+    addResponseHeader(&response, "Cache-Control", "private, max-age=60");
+
+    return response;
+}
+
+static HttpResponse dispatch(App *app, char *resource, Controller controller, Header *header) {
+    MiddlewareFunc handlers[] = { responseCache };
+    MiddlewareHandler middleware = {
+        .handlers = handlers,
+        .count = 1,
+        .capacity = 1,
+        .finalHandler = controller,
+    };
+
+    HttpRequest request = { .method = HTTP_GET, .resource = resource };
+    if (header) {
+        request.headers = header;
+        request.headerCount = 1;
+    }
+
+    return next(requestContext(app, request), &middleware);
+}
+
+static void freeResponse(HttpResponse response) {
+    free(response.headers);
+    if (response.ownsContent) {
+        free(response.content);
+    }
+}
+
+void testResponseCacheSkipsControllerOnHit() {
+    App app = {0};
+    app.responseCache = initResponseCache(0, 0);
+    setCacheTtl(app.responseCache, HTTP_GET, "/foodbanks", 60);
+    controllerCalls = 0;
+
+    HttpResponse first = dispatch(&app, "/foodbanks?page=1", countingController, NULL);
+    HttpResponse second = dispatch(&app, "/foodbanks?page=1", countingController, NULL);
+
+    expect(controllerCalls, toBe(1));
+    expect(second.status, toBe(HTTP_OK));
+    expect(second.ownsContent, toBe(true));
+    expect(strcmp(second.content, "[{\"id\":1}]"), toBe(0));
+    expect(strcmp(second.contentType, APPLICATION_JSON), toBe(0));
+    expect(strcmp(second.headers, "X-Served-By: controller\r\n"), toBe(0));
+
+    // a different query is a different entry
+    HttpResponse other = dispatch(&app, "/foodbanks?page=2", countingController, NULL);
+    expect(controllerCalls, toBe(2));
+
+    freeResponse(first);
+    freeResponse(second);
+    freeResponse(other);
+    freeResponseCache(app.responseCache);
+}
+
+void testResponseCacheOnlyCachesConfiguredRoutes() {
+    App app = {0};
+    app.responseCache = initResponseCache(0, 0);
+    controllerCalls = 0;
+
+    freeResponse(dispatch(&app, "/uncached", countingController, NULL));
+    freeResponse(dispatch(&app, "/uncached", countingController, NULL));
+    expect(controllerCalls, toBe(2));
+
+    freeResponseCache(app.responseCache);
+}
+
+void testResponseCacheExpires() {
+    ResponseCache *cache = initResponseCache(0, 0);
+
+    HttpResponse response = ok("body", TEXT_PLAIN);
+    responseCacheStore(cache, "GET /a", &response, 5, 100);
+
+    HttpResponse cached;
+    expect(responseCacheLookup(cache, "GET /a", &cached, 104), toBe(true));
+    freeResponse(cached);
+
+    expect(responseCacheLookup(cache, "GET /a", &cached, 105), toBe(false));
+
+    freeResponseCache(cache);
+}
+
+void testResponseCacheInvalidatePath() {
+    ResponseCache *cache = initResponseCache(0, 0);
+    HttpResponse response = ok("body", TEXT_PLAIN);
+
+    responseCacheStore(cache, "GET /items?page=1", &response, 60, 0);
+    responseCacheStore(cache, "GET /items?page=2", &response, 60, 0);
+    responseCacheStore(cache, "GET /items/1", &response, 60, 0);
+
+    responseCacheInvalidate(cache, "/items");
+
+    HttpResponse cached;
+    expect(responseCacheLookup(cache, "GET /items?page=1", &cached, 1), toBe(false));
+    expect(responseCacheLookup(cache, "GET /items?page=2", &cached, 1), toBe(false));
+    expect(responseCacheLookup(cache, "GET /items/1", &cached, 1), toBe(true));
+    freeResponse(cached);
+
+    freeResponseCache(cache);
+}
+
+void testResponseCacheRespectsMemoryCap() {
+    // 16 shards of 1KB each
+    ResponseCache *cache = initResponseCache(0, 16 * 1024);
+
+    char body[400];
+    memset(body, 'x', sizeof(body) - 1);
+    body[sizeof(body) - 1] = '\0';
+    HttpResponse response = ok(body, TEXT_PLAIN);
+
+    char key[32];
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "GET /page/%d", i);
+        responseCacheStore(cache, key, &response, 60, 0);
+    }
+
+    for (int i = 0; i < RESPONSE_CACHE_SHARDS; i++) {
+        expect(cache->shards[i].bytes <= cache->shards[i].maxBytes, toBe(true));
+    }
+
+    // the most recent entry always survives
+    HttpResponse cached;
+    expect(responseCacheLookup(cache, "GET /page/199", &cached, 1), toBe(true));
+    freeResponse(cached);
+
+    freeResponseCache(cache);
+}
+
+void testResponseCacheBypassesPrivateResponses() {
+    App app = {0};
+    app.responseCache = initResponseCache(60, 0);
+    controllerCalls = 0;
+
+    freeResponse(dispatch(&app, "/me", privateController, NULL));
+    freeResponse(dispatch(&app, "/me", privateController, NULL));
+    expect(controllerCalls, toBe(2));
+
+    // credentialed requests never read or fill the shared cache
+    Header authorization = { .name = "Authorization", .value = "Bearer token" };
+    freeResponse(dispatch(&app, "/list", countingController, &authorization));
+    freeResponse(dispatch(&app, "/list", countingController, &authorization));
+    expect(controllerCalls, toBe(4));
+
+    freeResponseCache(app.responseCache);
+}
+
+static pthread_mutex_t slowCallsLock = PTHREAD_MUTEX_INITIALIZER;
+static int slowCalls = 0;
+
+static HttpResponse slowController(RequestContext ctx) {
+    (void)ctx;
+
+    pthread_mutex_lock(&slowCallsLock);
+    slowCalls++;
+    pthread_mutex_unlock(&slowCallsLock);
+
+    // long enough for every other thread to arrive while this one is still running
+    usleep(200 * 1000);
+
+    return ok("slow body", TEXT_PLAIN);
+}
+
+typedef struct {
+    App         *app;
+    HttpResponse response;
+} CoalesceArgs;
+
+static void *dispatchSlow(void *arg) {
+    CoalesceArgs *args = arg;
+
+    // as the server's blocking pool threads are, the only ones nextShared coalesces on
+    markBlockingWorker();
+    args->response = dispatch(args->app, "/slow", slowController, NULL);
+
+    return NULL;
+}
+
+void testResponseCacheCoalescesConcurrentMisses() {
+    App app = {0};
+    app.responseCache = initResponseCache(60, 0);
+    slowCalls = 0;
+
+    pthread_t threads[8];
+    CoalesceArgs args[8];
+
+    for (int i = 0; i < 8; i++) {
+        args[i] = (CoalesceArgs){ .app = &app };
+        pthread_create(&threads[i], NULL, dispatchSlow, &args[i]);
+    }
+
+    for (int i = 0; i < 8; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    expect(slowCalls, toBe(1));
+
+    for (int i = 0; i < 8; i++) {
+        expect(args[i].response.status, toBe(HTTP_OK));
+        expect(strcmp(args[i].response.content, "slow body"), toBe(0));
+        freeResponse(args[i].response);
+    }
+
+    // every flight has finished and been cleaned up
+    for (int i = 0; i < SINGLE_FLIGHT_BUCKETS; i++) {
+        expectNull(app.responseCache->flights.buckets[i]);
+    }
+
+    freeResponseCache(app.responseCache);
+}
+
+void testNextSharedDoesNotWaitOffBlockingWorkers() {
+    App app = {0};
+    SingleFlight group;
+    initSingleFlight(&group);
+    slowCalls = 0;
+
+    MiddlewareHandler middleware = { .finalHandler = slowController };
+    HttpRequest request = { .method = HTTP_GET, .resource = "/slow" };
+
+    bool leader = false;
+    HttpResponse response = nextShared(&group, "GET /slow", requestContext(&app, request), &middleware, &leader);
+
+    // run straight through, no flight is left behind for a later caller to wait on
+    expect(leader, toBe(true));
+    expect(slowCalls, toBe(1));
+    for (int i = 0; i < SINGLE_FLIGHT_BUCKETS; i++) {
+        expectNull(group.buckets[i]);
+    }
+
+    freeResponse(response);
+    freeSingleFlight(&group);
+}
+
+static HttpResponse awaitingController(RequestContext ctx) {
+    (void)ctx;
+    slowCalls++;
+
+    // suspends the request, the next one for the same key arrives meanwhile
+    awaitSleep(10);
+
+    return ok("async body", TEXT_PLAIN);
+}
+
+static void dispatchAsync(void *arg) {
+    CoalesceArgs *args = arg;
+    args->response = dispatch(args->app, "/async", awaitingController, NULL);
+}
+
+void testResponseCacheOverlappingAsyncMisses() {
+    App app = {0};
+    app.responseCache = initResponseCache(60, 0);
+    slowCalls = 0;
+
+    CoalesceArgs first = { .app = &app };
+    CoalesceArgs second = { .app = &app };
+
+    // both start on this thread as the event loop would, the second suspends on the first's flight
+    Coroutine *leading = coroutineStart(dispatchAsync, &first);
+    Coroutine *following = coroutineStart(dispatchAsync, &second);
+    expect(coroutineDone(leading) || coroutineDone(following), toBe(false));
+    expect(coroutineWait(following)->kind, toBe(AWAIT_FLIGHT));
+    expect(coroutineWait(following)->flight->done, toBe(false));
+
+    while (!coroutineResume(leading)) {}
+
+    // what the event loop checks before resuming it
+    expect(coroutineWait(following)->flight->done, toBe(true));
+    coroutineWait(following)->ready = true;
+    expect(coroutineResume(following), toBe(true));
+
+    expect(slowCalls, toBe(1));
+    expect(strcmp(first.response.content, "async body"), toBe(0));
+    expect(strcmp(second.response.content, "async body"), toBe(0));
+    for (int i = 0; i < SINGLE_FLIGHT_BUCKETS; i++) {
+        expectNull(app.responseCache->flights.buckets[i]);
+    }
+
+    freeCoroutine(leading);
+    freeCoroutine(following);
+    freeResponse(first.response);
+    freeResponse(second.response);
+    freeResponseCache(app.responseCache);
+}
+
+void testResponseCacheCancelledAsyncFollower() {
+    App app = {0};
+    app.responseCache = initResponseCache(60, 0);
+    slowCalls = 0;
+
+    CoalesceArgs first = { .app = &app };
+    CoalesceArgs second = { .app = &app };
+
+    Coroutine *leading = coroutineStart(dispatchAsync, &first);
+    Coroutine *following = coroutineStart(dispatchAsync, &second);
+
+    // the follower's client goes away while the leader is still running, as cancelExchange does it
+    coroutineWait(following)->cancelled = true;
+    expect(coroutineResume(following), toBe(true));
+    expect(second.response.status, toBe(HTTP_SERVICE_UNAVAILABLE));
+
+    // the leader still finishes, and the flight nobody waits for is cleaned up
+    while (!coroutineResume(leading)) {}
+    expect(slowCalls, toBe(1));
+    expect(strcmp(first.response.content, "async body"), toBe(0));
+    for (int i = 0; i < SINGLE_FLIGHT_BUCKETS; i++) {
+        expectNull(app.responseCache->flights.buckets[i]);
+    }
+
+    freeCoroutine(leading);
+    freeCoroutine(following);
+    freeResponse(first.response);
+    freeResponse(second.response);
+    freeResponseCache(app.responseCache);
+}
+
+void runResponseCacheTests() {
+    runTest(testResponseCacheSkipsControllerOnHit);
+    runTest(testResponseCacheOnlyCachesConfiguredRoutes);
+    runTest(testResponseCacheExpires);
+    runTest(testResponseCacheInvalidatePath);
+    runTest(testResponseCacheRespectsMemoryCap);
+    runTest(testResponseCacheBypassesPrivateResponses);
+    runTest(testResponseCacheCoalescesConcurrentMisses);
+    runTest(testNextSharedDoesNotWaitOffBlockingWorkers);
+    runTest(testResponseCacheOverlappingAsyncMisses);
+    runTest(testResponseCacheCancelledAsyncFollower);
+}
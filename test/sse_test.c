@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/include/lavandula_test.h"
+#include "../src/include/app.h"
+#include "../src/include/sse.h"
+
+// what the server does with the response of a subscribing controller
+static ResponseStream *subscribe(App *app, const char *topic) {
+    RequestContext ctx = { .app = app };
+
+    HttpResponse response = subscribeEvents(ctx, topic);
+    free(response.headers);
+
+    ResponseStream *stream = openStream(&response);
+    streamProduce(stream);
+
+    return stream;
+}
+
+static char *pendingText(const ResponseStream *stream) {
+    static char text[4096];
+    size_t length = 0;
+
+    struct iovec iov[STREAM_MAX_IOVECS];
+    int count = streamIovecs(stream, iov, STREAM_MAX_IOVECS);
+    for (int i = 0; i < count && length + iov[i].iov_len < sizeof(text); i++) {
+        memcpy(text + length, iov[i].iov_base, iov[i].iov_len);
+        length += iov[i].iov_len;
+    }
+    text[length] = '\0';
+
+    return text;
+}
+
+void testPublishEventToSubscribers() {
+    App app = { .events = initEventHub() };
+
+    ResponseStream *first = subscribe(&app, "orders");
+    ResponseStream *second = subscribe(&app, "orders");
+    ResponseStream *other = subscribe(&app, "users");
+    expect(topicSubscribers(app.events, "orders"), toBe(2));
+
+    streamSent(first, streamPending(first));
+    streamSent(second, streamPending(second));
+    streamSent(other, streamPending(other));
+
+    publishEvent(app.events, "orders", "update", "{\"id\":1}\nsecond line");
+    deliverEvents(app.events);
+
+    const char *expected = "30\r\nevent: update\ndata: {\"id\":1}\ndata: second line\n\n\r\n";
+    expect(strcmp(pendingText(first), expected), toBe(0));
+    expect(strcmp(pendingText(second), expected), toBe(0));
+    expect(streamPending(other), toBe(0));
+
+    // framed once, both streams queue the same chunk
+    expect(first->queue[first->first] == second->queue[second->first], toBe(true));
+
+    closeStream(first);
+    expect(topicSubscribers(app.events, "orders"), toBe(1));
+
+    publishEvent(app.events, "orders", NULL, "hi");
+    deliverEvents(app.events);
+    expect(strstr(pendingText(second), "data: hi\n\n") != NULL, toBe(true));
+
+    closeStream(second);
+    closeStream(other);
+    expect(topicSubscribers(app.events, "orders"), toBe(0));
+
+    freeEventHub(app.events);
+}
+
+void testEventNameCannotAddFields() {
+    App app = { .events = initEventHub() };
+
+    ResponseStream *stream = subscribe(&app, "orders");
+    streamSent(stream, streamPending(stream));
+
+    publishEvent(app.events, "orders", "update\r\ndata: forged\nid: 7", "real");
+    deliverEvents(app.events);
+
+    const char *text = pendingText(stream);
+    expect(strstr(text, "event: updatedata: forgedid: 7\ndata: real\n\n") != NULL, toBe(true));
+    expect(strstr(text, "\ndata: forged") == NULL, toBe(true));
+
+    closeStream(stream);
+    freeEventHub(app.events);
+}
+
+void testSlowSubscriberIsDropped() {
+    App app = { .events = initEventHub() };
+    ResponseStream *stream = subscribe(&app, "ticks");
+
+    char *data = malloc(64 * 1024);
+    memset(data, 'x', 64 * 1024 - 1);
+    data[64 * 1024 - 1] = '\0';
+
+    // nothing is sent, as for a client that stopped reading
+    for (int i = 0; i < 32; i++) {
+        publishEvent(app.events, "ticks", NULL, data);
+    }
+    deliverEvents(app.events);
+
+    expect(stream->aborted, toBe(true));
+    expect(streamPending(stream) <= SSE_MAX_PENDING, toBe(true));
+    expect(app.events->dropped, toBe(1));
+
+    free(data);
+    closeStream(stream);
+    freeEventHub(app.events);
+}
+
+void testSubscribeWithoutHub() {
+    App app = {0};
+    RequestContext ctx = { .app = &app };
+
+    HttpResponse response = subscribeEvents(ctx, "orders");
+    expect(response.status, toBe(HTTP_INTERNAL_SERVER_ERROR));
+    expectNull(response.producer);
+}
+
+void runSseTests() {
+    runTest(testPublishEventToSubscribers);
+    runTest(testEventNameCannotAddFields);
+    runTest(testSlowSubscriberIsDropped);
+    runTest(testSubscribeWithoutHub);
+}
@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../src/include/lavandula_test.h"
+#include "../src/include/static.h"
+
+static char staticRoot[64];
+
+static void writeFile(const char *name, const char *content) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", staticRoot, name);
+
+    FILE *file = fopen(path, "w");
+    fputs(content, file);
+    fclose(file);
+}
+
+static void removeFile(const char *name) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", staticRoot, name);
+    unlink(path);
+}
+
+static HttpRequest requestWithHeader(Header *header) {
+    HttpRequest request = {0};
+    request.method = HTTP_GET;
+    request.headers = header;
+    request.headerCount = header ? 1 : 0;
+
+    return request;
+}
+
+static bool hasHeaderLine(HttpResponse *response, const char *line) {
+    return response->headers && strstr(response->headers, line) != NULL;
+}
+
+static void freeResponse(HttpResponse response) {
+    free(response.headers);
+    releaseResponseContent(&response);
+}
+
+static void extractEtag(HttpResponse *response, char *etag, size_t size) {
+    const char *start = strstr(response->headers, "ETag: ") + 6;
+    size_t length = strcspn(start, "\r");
+    if (length >= size) length = size - 1;
+
+    memcpy(etag, start, length);
+    etag[length] = '\0';
+}
+
+void testMimeTypeForPath() {
+    expect(strcmp(mimeTypeForPath("/index.html"), "text/html; charset=utf-8"), toBe(0));
+    expect(strcmp(mimeTypeForPath("app.JS"), "text/javascript; charset=utf-8"), toBe(0));
+    expect(strcmp(mimeTypeForPath("logo.png"), "image/png"), toBe(0));
+    expect(strcmp(mimeTypeForPath("archive.tar.unknown"), "application/octet-stream"), toBe(0));
+    expect(strcmp(mimeTypeForPath("dir.d/Makefile"), "application/octet-stream"), toBe(0));
+}
+
+void testServeFileSetsValidators() {
+    writeFile("hello.txt", "hello world");
+
+    StaticFiles *files = initStaticFiles();
+    HttpRequest request = requestWithHeader(NULL);
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/hello.txt", staticRoot);
+
+    HttpResponse response = serveFile(files, &request, path);
+    expect(response.status, toBe(HTTP_OK));
+    expect(response.contentLength, toBe(11));
+    expect(memcmp(response.content, "hello world", 11), toBe(0));
+    expect(hasHeaderLine(&response, "ETag: \""), toBe(true));
+    expect(hasHeaderLine(&response, "Last-Modified: "), toBe(true));
+    expect(strcmp(response.contentType, "text/plain; charset=utf-8"), toBe(0));
+
+    freeResponse(response);
+    freeStaticFiles(files);
+    removeFile("hello.txt");
+}
+
+void testServeFileNotModified() {
+    writeFile("cached.css", "body{}");
+
+    StaticFiles *files = initStaticFiles();
+    HttpRequest request = requestWithHeader(NULL);
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/cached.css", staticRoot);
+
+    HttpResponse first = serveFile(files, &request, path);
+    char etag[64];
+    extractEtag(&first, etag, sizeof(etag));
+    freeResponse(first);
+
+    Header ifNoneMatch = { .name = "If-None-Match" };
+    snprintf(ifNoneMatch.value, sizeof(ifNoneMatch.value), "W/\"other\", %s", etag);
+    request = requestWithHeader(&ifNoneMatch);
+
+    HttpResponse second = serveFile(files, &request, path);
+    expect(second.status, toBe(HTTP_NOT_MODIFIED));
+    expect(second.contentLength, toBe(0));
+    freeResponse(second);
+
+    freeStaticFiles(files);
+    removeFile("cached.css");
+}
+
+void testServeFileCachesContents() {
+    writeFile("app.js", "console.log(1)");
+
+    StaticFiles *files = initStaticFiles();
+    HttpRequest request = requestWithHeader(NULL);
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/app.js", staticRoot);
+
+    HttpResponse first = serveFile(files, &request, path);
+    HttpResponse second = serveFile(files, &request, path);
+
+    // a repeat request is served from the cache, both responses share its contents
+    expect(files->cachedBytes, toBe(14));
+    expect(first.ownsContent || second.ownsContent, toBe(false));
+    expect(first.content == second.content, toBe(true));
+    expect(memcmp(second.content, "console.log(1)", 14), toBe(0));
+    expect(files->head->refs, toBe(3));
+
+    freeResponse(first);
+    freeResponse(second);
+    expect(files->head->refs, toBe(1));
+    freeStaticFiles(files);
+    removeFile("app.js");
+}
+
+void testServedContentOutlivesCacheEntry() {
+    writeFile("page.html", "<p>old</p>");
+
+    StaticFiles *files = initStaticFiles();
+    HttpRequest request = requestWithHeader(NULL);
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/page.html", staticRoot);
+
+    HttpResponse pending = serveFile(files, &request, path);
+
+    // the edit drops the cached entry while the first response is still waiting to be written
+    writeFile("page.html", "<p>newer</p>");
+    HttpResponse fresh = serveFile(files, &request, path);
+    freeStaticFiles(files);
+
+    expect(memcmp(pending.content, "<p>old</p>", 10), toBe(0));
+    expect(memcmp(fresh.content, "<p>newer</p>", 12), toBe(0));
+
+    freeResponse(pending);
+    freeResponse(fresh);
+    removeFile("page.html");
+}
+
+void testLargeFileIsOpenedCloseOnExec() {
+    char *large = malloc(STATIC_CACHE_MAX_FILE + 2);
+    memset(large, 'a', STATIC_CACHE_MAX_FILE + 1);
+    large[STATIC_CACHE_MAX_FILE + 1] = '\0';
+    writeFile("large.txt", large);
+    free(large);
+
+    StaticFiles *files = initStaticFiles();
+    HttpRequest request = requestWithHeader(NULL);
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/large.txt", staticRoot);
+
+    // sent with sendfile on a worker, it must not survive into the process a reload execs
+    HttpResponse response = serveFile(files, &request, path);
+    expect(response.bodyFile, toBe(true));
+    expect(fcntl(response.fileDescriptor, F_GETFD) & FD_CLOEXEC, toBe(FD_CLOEXEC));
+
+    close(response.fileDescriptor);
+    freeResponse(response);
+    freeStaticFiles(files);
+    removeFile("large.txt");
+}
+
+void testStaticMountServesIndexAndRejectsTraversal() {
+    writeFile("index.html", "<h1>home</h1>");
+
+    StaticFiles *files = initStaticFiles();
+    addStaticMount(files, "/assets/", staticRoot);
+    HttpRequest request = requestWithHeader(NULL);
+
+    HttpResponse response = {0};
+    expect(serveStaticMount(files, &request, "/assets", &response), toBe(true));
+    expect(response.status, toBe(HTTP_OK));
+    expect(response.contentLength, toBe(13));
+    freeResponse(response);
+
+    response = (HttpResponse){0};
+    expect(serveStaticMount(files, &request, "/assets/../etc/passwd", &response), toBe(false));
+    expect(serveStaticMount(files, &request, "/assets/missing.txt", &response), toBe(false));
+    expect(serveStaticMount(files, &request, "/assetsfoo/index.html", &response), toBe(false));
+
+    freeStaticFiles(files);
+    removeFile("index.html");
+}
+
+void testServeFilePrefersPrecompressedSibling() {
+    writeFile("site.css", "body { color: red; }");
+    writeFile("site.css.gz", "pretend gzip");
+
+    StaticFiles *files = initStaticFiles();
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/site.css", staticRoot);
+
+    Header acceptEncoding = { .name = "Accept-Encoding", .value = "gzip, br" };
+    HttpRequest request = requestWithHeader(&acceptEncoding);
+
+    HttpResponse response = serveFile(files, &request, path);
+    expect(response.contentLength, toBe(12));
+    expect(memcmp(response.content, "pretend gzip", 12), toBe(0));
+    expect(hasHeaderLine(&response, "Content-Encoding: gzip\r\n"), toBe(true));
+    expect(hasHeaderLine(&response, "Vary: Accept-Encoding\r\n"), toBe(true));
+    expect(strcmp(response.contentType, "text/css; charset=utf-8"), toBe(0));
+    freeResponse(response);
+
+    // a client that does not take gzip gets the original
+    request = requestWithHeader(NULL);
+    response = serveFile(files, &request, path);
+    expect(response.contentLength, toBe(20));
+    expect(hasHeaderLine(&response, "Content-Encoding"), toBe(false));
+    freeResponse(response);
+
+    freeStaticFiles(files);
+    removeFile("site.css");
+    removeFile("site.css.gz");
+}
+
+void runStaticTests() {
+    snprintf(staticRoot, sizeof(staticRoot), "/tmp/lavandula_static_XXXXXX");
+    if (!mkdtemp(staticRoot)) {
+        perror("mkdtemp");
+        return;
+    }
+
+    runTest(testMimeTypeForPath);
+    runTest(testServeFileSetsValidators);
+    runTest(testServeFileNotModified);
+    runTest(testServeFileCachesContents);
+    runTest(testServedContentOutlivesCacheEntry);
+    runTest(testLargeFileIsOpenedCloseOnExec);
+    runTest(testStaticMountServesIndexAndRejectsTraversal);
+    runTest(testServeFilePrefersPrecompressedSibling);
+
+    rmdir(staticRoot);
+}
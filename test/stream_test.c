@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/include/lavandula_test.h"
+#include "../src/include/stream.h"
+
+static bool released = false;
+
+static void release(void *state) {
+    (void)state;
+    released = true;
+}
+
+static StreamStatus countdown(ResponseStream *stream, void *state) {
+    int *remaining = state;
+    streamPrintf(stream, "%d", (*remaining)--);
+
+    return *remaining ? STREAM_MORE : STREAM_DONE;
+}
+
+static StreamStatus idle(ResponseStream *stream, void *state) {
+    (void)stream;
+    (void)state;
+
+    return STREAM_PAUSE;
+}
+
+static bool pendingIs(const ResponseStream *stream, const char *expected) {
+    if (streamPending(stream) != strlen(expected)) return false;
+
+    struct iovec iov[STREAM_MAX_IOVECS];
+    int count = streamIovecs(stream, iov, STREAM_MAX_IOVECS);
+
+    for (int i = 0; i < count; i++) {
+        if (memcmp(iov[i].iov_base, expected, iov[i].iov_len) != 0) return false;
+        expected += iov[i].iov_len;
+    }
+
+    return true;
+}
+
+void testStreamFramesChunks() {
+    int remaining = 3;
+    HttpResponse response = streamResponse(TEXT_PLAIN, countdown, release, &remaining);
+    expect(response.status, toBe(HTTP_OK));
+
+    ResponseStream *stream = openStream(&response);
+    released = false;
+
+    while (streamReady(stream)) {
+        streamProduce(stream);
+    }
+
+    expect(stream->ended, toBe(true));
+    expect(pendingIs(stream, "1\r\n3\r\n1\r\n2\r\n1\r\n1\r\n0\r\n\r\n"), toBe(true));
+
+    // nothing can follow the last chunk
+    expect(streamWrite(stream, "late", 4), toBe(false));
+
+    closeStream(stream);
+    expect(released, toBe(true));
+}
+
+void testStreamPauseAndResume() {
+    HttpResponse response = streamResponse("text/event-stream", idle, NULL, NULL);
+    ResponseStream *stream = openStream(&response);
+
+    streamProduce(stream);
+    expect(streamReady(stream), toBe(false));
+
+    // written from outside the producer while it waits, as a broadcast would
+    expect(streamWrite(stream, "data: hi\n\n", 10), toBe(true));
+    expect(pendingIs(stream, "a\r\ndata: hi\n\n\r\n"), toBe(true));
+
+    // an empty chunk would end the body, so it is not written
+    expect(streamWrite(stream, "", 0), toBe(true));
+    expect(streamPending(stream), toBe(15));
+
+    streamSent(stream, 15);
+    expect(streamPending(stream), toBe(0));
+
+    streamResume(stream);
+    expect(streamReady(stream), toBe(true));
+
+    streamEnd(stream);
+    expect(streamReady(stream), toBe(false));
+    expect(pendingIs(stream, "0\r\n\r\n"), toBe(true));
+
+    closeStream(stream);
+}
+
+void testStreamHighWater() {
+    HttpResponse response = streamResponse(TEXT_PLAIN, idle, NULL, NULL);
+    ResponseStream *stream = openStream(&response);
+
+    char block[1024];
+    memset(block, 'x', sizeof(block));
+    while (streamPending(stream) < STREAM_HIGH_WATER) {
+        streamWrite(stream, block, sizeof(block));
+    }
+
+    // a client that is not keeping up is not given more to fall behind on
+    expect(streamReady(stream), toBe(false));
+
+    streamSent(stream, streamPending(stream) - 100);
+    expect(streamReady(stream), toBe(true));
+
+    closeStream(stream);
+}
+
+void runStreamTests() {
+    runTest(testStreamFramesChunks);
+    runTest(testStreamPauseAndResume);
+    runTest(testStreamHighWater);
+}
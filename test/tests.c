@@ -10,6 +10,21 @@ void runAuthTests();
 void runJsonTests();
 void runBase64Tests();
 void runCorsTests();
+void runJwtTests();
+void runStaticTests();
+void runCompressTests();
+void runResponseCacheTests();
+void runMetricsTests();
+void runAccessLogTests();
+void runTracingTests();
+void runBindAddressTests();
+void runStreamTests();
+void runSseTests();
+void runWebSocketTests();
+void runJobsTests();
+void runCoroutineTests();
+void runIoLoopTests();
+void runBufferPoolTests();
 
 int main() {
     testsRan = 0;
@@ -25,6 +40,21 @@ int main() {
     runJsonTests();
     runBase64Tests();
     runCorsTests();
+    runJwtTests();
+    runStaticTests();
+    runCompressTests();
+    runResponseCacheTests();
+    runMetricsTests();
+    runAccessLogTests();
+    runTracingTests();
+    runBindAddressTests();
+    runStreamTests();
+    runSseTests();
+    runWebSocketTests();
+    runJobsTests();
+    runCoroutineTests();
+    runIoLoopTests();
+    runBufferPoolTests();
 
     printf("=== Lavandula Test Results ===\n");
     testResults();
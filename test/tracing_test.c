@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/include/lavandula_test.h"
+#include "../src/include/lavandula.h"
+
+static HttpResponse jsonController(RequestContext ctx) {
+    (void)ctx;
+
+    JsonBuilder *inner = jsonBuilder();
+    jsonPutInteger(inner, "id", 1);
+
+    JsonBuilder *root = jsonBuilder();
+    jsonPutString(root, "name", "lavandula");
+    jsonPutObject(root, "inner", inner);
+
+    HttpResponse response = ok(jsonStringify(root), APPLICATION_JSON);
+    response.ownsContent = true;
+    freeJsonBuilder(root);
+
+    return response;
+}
+
+static int countPhase(const RequestTrace *trace, TracePhase phase) {
+    int count = 0;
+    for (int i = 0; i < trace->spanCount; i++) {
+        if (trace->spans[i].phase == phase) count++;
+    }
+
+    return count;
+}
+
+void testTraceRecordsSpansInOrder() {
+    Tracer *tracer = initTracer(0);
+
+    RequestTrace trace;
+    traceStart(&trace, traceNow());
+
+    int parse = traceBegin(TRACE_PARSE);
+    traceEnd(parse);
+
+    App app = {0};
+    MiddlewareHandler middleware = { .finalHandler = jsonController };
+    HttpRequest request = { .method = HTTP_GET, .resource = "/items" };
+
+    int chain = traceBegin(TRACE_MIDDLEWARE);
+    HttpResponse response = next(requestContext(&app, request), &middleware);
+    traceEnd(chain);
+
+    traceFinish(tracer, &trace, HTTP_GET, "/items", response.status);
+    free(response.content);
+
+    expect(tracer->finished, toBe((uint64_t)1));
+
+    const RequestTrace *kept = &tracer->ring[0];
+    expect(kept->id, toBe((uint64_t)1));
+    expect(kept->status, toBe(HTTP_OK));
+    expect(strcmp(kept->path, "/items"), toBe(0));
+
+    expect(kept->spanCount, toBe(4));
+    expect(kept->spans[0].phase, toBe(TRACE_PARSE));
+    expect(kept->spans[1].phase, toBe(TRACE_MIDDLEWARE));
+    expect(kept->spans[2].phase, toBe(TRACE_CONTROLLER));
+
+    // one span for the document, not one per nested object
+    expect(kept->spans[3].phase, toBe(TRACE_JSON_STRINGIFY));
+    expect(countPhase(kept, TRACE_JSON_STRINGIFY), toBe(1));
+
+    // nested spans sit inside their parent
+    expect(kept->spans[2].startNanos >= kept->spans[1].startNanos, toBe(true));
+    expect(kept->spans[2].endNanos <= kept->spans[1].endNanos, toBe(true));
+
+    for (int i = 0; i < kept->spanCount; i++) {
+        expect(kept->spans[i].endNanos >= kept->spans[i].startNanos, toBe(true));
+    }
+
+    freeTracer(tracer);
+}
+
+void testTraceIsInertWithoutARequest() {
+    expect(traceBegin(TRACE_PARSE), toBe(-1));
+    traceEnd(-1);
+
+    // JSON work outside a traced request records nothing
+    JsonBuilder *builder = jsonParse("{\"a\":1}");
+    char *json = jsonStringify(builder);
+    expectNotNull(json);
+
+    free(json);
+    freeJsonBuilder(builder);
+}
+
+void testTraceDropsSpansPastTheLimit() {
+    Tracer *tracer = initTracer(0);
+
+    RequestTrace trace;
+    traceStart(&trace, traceNow());
+
+    for (int i = 0; i < TRACE_MAX_SPANS + 5; i++) {
+        traceEnd(traceBegin(TRACE_JSON_PARSE));
+    }
+
+    // left open, closed by traceFinish
+    expect(traceBegin(TRACE_WRITE), toBe(-1));
+
+    traceFinish(tracer, &trace, HTTP_POST, "/bulk", HTTP_OK);
+
+    expect(tracer->ring[0].spanCount, toBe(TRACE_MAX_SPANS));
+    expect(tracer->ring[0].droppedSpans, toBe(6));
+
+    freeTracer(tracer);
+}
+
+void testTraceFormatsBreakdown() {
+    RequestTrace trace = {
+        .id = 7,
+        .method = HTTP_GET,
+        .path = "/slow",
+        .status = 200,
+        .startNanos = 1000000,
+        .endNanos = 13500000,
+        .spanCount = 2,
+        .spans = {
+            { TRACE_READ, 1000000, 1250000 },
+            { TRACE_CONTROLLER, 1500000, 13000000 },
+        },
+    };
+
+    char line[256];
+    int length = formatTrace(&trace, line, sizeof(line));
+
+    expect(length, toBe((int)strlen(line)));
+    expect(strcmp(line, "#7 GET /slow 200 12.500ms: read 0.250ms, controller 11.500ms"), toBe(0));
+}
+
+void testTraceRendersChromeTraceEvents() {
+    Tracer *tracer = initTracer(0);
+
+    RequestTrace trace;
+    uint64_t start = traceNow();
+    traceStart(&trace, start);
+    traceAddSpan(&trace, TRACE_ACCEPT, start, start + 1000);
+    traceFinish(tracer, &trace, HTTP_GET, "/a\"b", HTTP_OK);
+
+    char *json = renderChromeTrace(tracer);
+
+    // the request event is named after the request, escaped
+    expect(strncmp(json, "{\"traceEvents\":[{\"name\":\"GET /a\\\"b\"", 34), toBe(0));
+    expectNotNull(strstr(json, "\"name\":\"accept\",\"cat\":\"request\",\"ph\":\"X\""));
+    expectNotNull(strstr(json, "\"dur\":1.000"));
+
+    free(json);
+    freeTracer(tracer);
+}
+
+void testTraceDropsTheQueryString() {
+    Tracer *tracer = initTracer(0);
+
+    RequestTrace trace;
+    traceStart(&trace, traceNow());
+    traceFinish(tracer, &trace, HTTP_GET, "/login?token=secret", HTTP_OK);
+
+    char *json = renderChromeTrace(tracer);
+    expectNotNull(strstr(json, "\"name\":\"GET /login\""));
+    expectNull(strstr(json, "secret"));
+
+    free(json);
+    freeTracer(tracer);
+}
+
+void runTracingTests() {
+    runTest(testTraceRecordsSpansInOrder);
+    runTest(testTraceIsInertWithoutARequest);
+    runTest(testTraceDropsSpansPastTheLimit);
+    runTest(testTraceFormatsBreakdown);
+    runTest(testTraceRendersChromeTraceEvents);
+    runTest(testTraceDropsTheQueryString);
+}
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <poll.h>
 #include "../src/include/lavandula_test.h"
 #include "../src/include/utils.h"
 
@@ -83,6 +84,24 @@ void testReadFileUtf8Content() {
     remove("utf8_test.tmp");
 }
 
+void testWakeFds() {
+    int fds[2];
+    openWakeFds(fds);
+
+    struct pollfd wake = { .fd = fds[0], .events = POLLIN };
+    expect(poll(&wake, 1, 0), toBe(0));
+
+    // several wake-ups before the reader gets to them are cleared at once
+    wakeUp(fds);
+    wakeUp(fds);
+    expect(poll(&wake, 1, 0), toBe(1));
+
+    clearWakeUps(fds[0]);
+    expect(poll(&wake, 1, 0), toBe(0));
+
+    closeWakeFds(fds);
+}
+
 void runUtilsTests() {
     runTest(testReadFileExists);
     runTest(testReadFileNonexistent);
@@ -90,4 +109,5 @@ void runUtilsTests() {
     runTest(testReadFileWithNewlines);
     runTest(testReadFileLargeContent);
     runTest(testReadFileUtf8Content);
+    runTest(testWakeFds);
 }
\ No newline at end of file
@@ -0,0 +1,345 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/include/lavandula_test.h"
+#include "../src/include/app.h"
+#include "../src/include/crypto.h"
+#include "../src/include/websocket.h"
+
+static char received[256];
+static int messages;
+static int closedWith;
+
+static void recordMessage(WebSocket *socket, const char *data, size_t length, bool binary) {
+    (void)socket;
+    (void)binary;
+
+    snprintf(received, sizeof(received), "%.*s", (int)length, data);
+    messages++;
+}
+
+static void recordClose(WebSocket *socket, int code) {
+    (void)socket;
+    closedWith = code;
+}
+
+static HttpRequest handshakeRequest(Header *headers, size_t count) {
+    return (HttpRequest){ .method = HTTP_GET, .resource = "/chat", .headers = headers, .headerCount = count };
+}
+
+// an upgraded socket, as the server holds it once the 101 is out
+static WebSocket *openSocket(App *app) {
+    Header headers[] = {
+        { .name = "Upgrade", .value = "websocket" },
+        { .name = "Connection", .value = "keep-alive, Upgrade" },
+        { .name = "Sec-WebSocket-Version", .value = "13" },
+        { .name = "Sec-WebSocket-Key", .value = "dGhlIHNhbXBsZSBub25jZQ==" },
+    };
+    RequestContext ctx = { .app = app, .request = handshakeRequest(headers, 4) };
+
+    WebSocketHandlers handlers = { .onMessage = recordMessage, .onClose = recordClose };
+    HttpResponse response = acceptWebSocket(ctx, handlers, NULL);
+    free(response.headers);
+
+    webSocketOpened(response.webSocket);
+
+    received[0] = '\0';
+    messages = 0;
+    closedWith = 0;
+
+    return response.webSocket;
+}
+
+// a frame as a client sends it, always masked
+static size_t clientFrame(unsigned char *out, int firstByte, const char *payload, size_t length) {
+    static const unsigned char mask[4] = { 0x37, 0xfa, 0x21, 0x3d };
+
+    size_t header = 2;
+    out[0] = firstByte;
+    if (length < 126) {
+        out[1] = 0x80 | length;
+    } else {
+        out[1] = 0x80 | 126;
+        out[2] = length >> 8;
+        out[3] = length & 0xff;
+        header = 4;
+    }
+
+    memcpy(out + header, mask, 4);
+    for (size_t i = 0; i < length; i++) {
+        out[header + 4 + i] = payload[i] ^ mask[i & 3];
+    }
+
+    return header + 4 + length;
+}
+
+static size_t pendingBytes(const ResponseStream *stream, unsigned char *out) {
+    size_t length = 0;
+
+    struct iovec iov[STREAM_MAX_IOVECS];
+    int count = streamIovecs(stream, iov, STREAM_MAX_IOVECS);
+    for (int i = 0; i < count; i++) {
+        memcpy(out + length, iov[i].iov_base, iov[i].iov_len);
+        length += iov[i].iov_len;
+    }
+
+    return length;
+}
+
+void testSha1() {
+    unsigned char digest[SHA1_DIGEST_SIZE];
+    char hex[SHA1_DIGEST_SIZE * 2 + 1];
+
+    sha1("abc", 3, digest);
+    for (int i = 0; i < SHA1_DIGEST_SIZE; i++) sprintf(hex + i * 2, "%02x", digest[i]);
+    expect(strcmp(hex, "a9993e364706816aba3e25717850c26c9cd0d89d"), toBe(0));
+
+    // two blocks once padded
+    const char *longer = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    sha1(longer, strlen(longer), digest);
+    for (int i = 0; i < SHA1_DIGEST_SIZE; i++) sprintf(hex + i * 2, "%02x", digest[i]);
+    expect(strcmp(hex, "84983e441c3bd26ebaae4aa1f95129e5e54670f1"), toBe(0));
+}
+
+void testWebSocketAccept() {
+    char accept[WEBSOCKET_ACCEPT_SIZE];
+
+    // the example from RFC 6455
+    webSocketAccept("dGhlIHNhbXBsZSBub25jZQ==", accept);
+    expect(strcmp(accept, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo="), toBe(0));
+}
+
+void testUnmaskMatchesByteAtATime() {
+    const unsigned char mask[4] = { 0x01, 0x80, 0xfe, 0x5a };
+
+    size_t lengths[] = { 0, 1, 7, 8, 31, 64, 100, 1000 };
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        for (size_t offset = 0; offset < 4; offset++) {
+            size_t length = lengths[l];
+            unsigned char *data = malloc(length + 1);
+            unsigned char *expected = malloc(length + 1);
+
+            for (size_t i = 0; i < length; i++) {
+                data[i] = (unsigned char)(i * 31 + 7);
+                expected[i] = data[i] ^ mask[(offset + i) & 3];
+            }
+
+            webSocketUnmask(data, length, mask, offset);
+            expect(memcmp(data, expected, length), toBe(0));
+
+            free(data);
+            free(expected);
+        }
+    }
+}
+
+void testHandshakeValidation() {
+    App app = {0};
+    app.server.limits.maxRequestSize = 1024;
+
+    Header noUpgrade[] = { { .name = "Sec-WebSocket-Version", .value = "13" }, { .name = "Sec-WebSocket-Key", .value = "dGhlIHNhbXBsZSBub25jZQ==" } };
+    RequestContext ctx = { .app = &app, .request = handshakeRequest(noUpgrade, 2) };
+    HttpResponse response = acceptWebSocket(ctx, (WebSocketHandlers){0}, NULL);
+    expect(response.status, toBe(HTTP_UPGRADE_REQUIRED));
+    expectNull(response.webSocket);
+    free(response.headers);
+
+    Header shortKey[] = {
+        { .name = "Upgrade", .value = "websocket" }, { .name = "Connection", .value = "Upgrade" },
+        { .name = "Sec-WebSocket-Version", .value = "13" }, { .name = "Sec-WebSocket-Key", .value = "c2hvcnQ=" },
+    };
+    ctx.request = handshakeRequest(shortKey, 4);
+    response = acceptWebSocket(ctx, (WebSocketHandlers){0}, NULL);
+    expect(response.status, toBe(HTTP_BAD_REQUEST));
+    expectNull(response.webSocket);
+    free(response.headers);
+
+    WebSocket *socket = openSocket(&app);
+    expect(socket->stream->raw, toBe(true));
+    closeStream(socket->stream);
+}
+
+void testReceiveFramesInPieces() {
+    App app = {0};
+    app.server.limits.maxRequestSize = 1024;
+    WebSocket *socket = openSocket(&app);
+
+    unsigned char frame[64];
+    size_t length = clientFrame(frame, 0x81, "Hello", 5);
+
+    // a partial header is left for the next read, a partial payload is taken
+    expect(webSocketReceive(socket, frame, 1), toBe(0));
+    expect(webSocketReceive(socket, frame, 8), toBe(8));
+    expect(messages, toBe(0));
+    expect(webSocketReceive(socket, frame + 8, length - 8), toBe(length - 8));
+    expect(messages, toBe(1));
+    expect(strcmp(received, "Hello"), toBe(0));
+
+    // "Hel" then "lo" as a continuation
+    size_t first = clientFrame(frame, 0x01, "Hel", 3);
+    size_t second = clientFrame(frame + first, 0x80, "lo", 2);
+    expect(webSocketReceive(socket, frame, first + second), toBe(first + second));
+    expect(messages, toBe(2));
+    expect(strcmp(received, "Hello"), toBe(0));
+
+    closeStream(socket->stream);
+    expect(closedWith, toBe(WEBSOCKET_ABNORMAL));
+}
+
+void testPingAndClose() {
+    App app = {0};
+    app.server.limits.maxRequestSize = 1024;
+    WebSocket *socket = openSocket(&app);
+
+    unsigned char frame[64];
+    size_t length = clientFrame(frame, 0x89, "hi", 2);
+    webSocketReceive(socket, frame, length);
+
+    unsigned char sent[64];
+    expect(pendingBytes(socket->stream, sent), toBe(4));
+    expect(memcmp(sent, "\x8a\x02hi", 4), toBe(0));
+    streamSent(socket->stream, 4);
+
+    // 1000 comes back and the socket closes
+    length = clientFrame(frame, 0x88, "\x03\xe8", 2);
+    webSocketReceive(socket, frame, length);
+
+    expect(pendingBytes(socket->stream, sent), toBe(4));
+    expect(memcmp(sent, "\x88\x02\x03\xe8", 4), toBe(0));
+    expect(socket->stream->ended, toBe(true));
+    expect(webSocketSendText(socket, "late"), toBe(false));
+
+    closeStream(socket->stream);
+    expect(closedWith, toBe(WEBSOCKET_NORMAL));
+}
+
+void testServerStartsClose() {
+    App app = {0};
+    app.server.limits.maxRequestSize = 1024;
+    WebSocket *socket = openSocket(&app);
+
+    webSocketClose(socket, WEBSOCKET_GOING_AWAY, "bye");
+    expect(socket->stream->ended, toBe(true));
+    expect(webSocketListening(socket), toBe(true));
+
+    // a message already on its way is dropped, the client's close frame ends the handshake
+    unsigned char frame[64];
+    webSocketReceive(socket, frame, clientFrame(frame, 0x81, "late", 4));
+    expect(messages, toBe(0));
+    webSocketReceive(socket, frame, clientFrame(frame, 0x88, "\x03\xe9", 2));
+    expect(webSocketListening(socket), toBe(false));
+
+    closeStream(socket->stream);
+    expect(closedWith, toBe(WEBSOCKET_GOING_AWAY));
+}
+
+void testProtocolErrors() {
+    App app = {0};
+    app.server.limits.maxRequestSize = 16;
+    unsigned char frame[64];
+    unsigned char sent[64];
+
+    // unmasked
+    WebSocket *socket = openSocket(&app);
+    unsigned char unmasked[] = { 0x81, 0x01, 'x' };
+    webSocketReceive(socket, unmasked, sizeof(unmasked));
+    pendingBytes(socket->stream, sent);
+    expect((sent[2] << 8) | sent[3], toBe(WEBSOCKET_PROTOCOL_ERROR));
+    closeStream(socket->stream);
+    expect(closedWith, toBe(WEBSOCKET_PROTOCOL_ERROR));
+
+    // a continuation with no message to continue
+    socket = openSocket(&app);
+    webSocketReceive(socket, frame, clientFrame(frame, 0x80, "x", 1));
+    expect(closedWith == 0 && socket->closeCode == WEBSOCKET_PROTOCOL_ERROR, toBe(true));
+    closeStream(socket->stream);
+
+    // past maxRequestSize
+    socket = openSocket(&app);
+    webSocketReceive(socket, frame, clientFrame(frame, 0x82, "0123456789abcdefg", 17));
+    expect(socket->closeCode, toBe(WEBSOCKET_TOO_BIG));
+    closeStream(socket->stream);
+
+    // text that is not UTF-8
+    socket = openSocket(&app);
+    webSocketReceive(socket, frame, clientFrame(frame, 0x81, "\xc3\x28", 2));
+    expect(socket->closeCode, toBe(WEBSOCKET_INVALID_DATA));
+    expect(messages, toBe(0));
+    closeStream(socket->stream);
+}
+
+void testInvalidCloseFrames() {
+    App app = {0};
+    app.server.limits.maxRequestSize = 1024;
+    unsigned char frame[64];
+    unsigned char sent[64];
+
+    // below 1000, reserved for local use, unassigned, past the application range
+    const char *codes[] = { "\x03\xe7", "\x03\xec", "\x03\xed", "\x03\xf7", "\x03\xf8", "\x07\xd0", "\x13\x88" };
+    for (size_t i = 0; i < sizeof(codes) / sizeof(codes[0]); i++) {
+        WebSocket *socket = openSocket(&app);
+        webSocketReceive(socket, frame, clientFrame(frame, 0x88, codes[i], 2));
+        pendingBytes(socket->stream, sent);
+        expect((sent[2] << 8) | sent[3], toBe(WEBSOCKET_PROTOCOL_ERROR));
+        closeStream(socket->stream);
+        expect(closedWith, toBe(WEBSOCKET_PROTOCOL_ERROR));
+    }
+
+    // an application code is echoed
+    WebSocket *socket = openSocket(&app);
+    webSocketReceive(socket, frame, clientFrame(frame, 0x88, "\x0f\xa0", 2));
+    pendingBytes(socket->stream, sent);
+    expect((sent[2] << 8) | sent[3], toBe(4000));
+    closeStream(socket->stream);
+
+    // a reason that is not UTF-8
+    socket = openSocket(&app);
+    webSocketReceive(socket, frame, clientFrame(frame, 0x88, "\x03\xe8\xc3\x28", 4));
+    pendingBytes(socket->stream, sent);
+    expect((sent[2] << 8) | sent[3], toBe(WEBSOCKET_INVALID_DATA));
+    closeStream(socket->stream);
+    expect(closedWith, toBe(WEBSOCKET_INVALID_DATA));
+}
+
+void testSendFrameHeaders() {
+    App app = {0};
+    app.server.limits.maxRequestSize = 1024;
+    WebSocket *socket = openSocket(&app);
+
+    unsigned char *sent = malloc(70000);
+
+    webSocketSendText(socket, "hey");
+    expect(pendingBytes(socket->stream, sent), toBe(5));
+    expect(memcmp(sent, "\x81\x03hey", 5), toBe(0));
+    streamSent(socket->stream, 5);
+
+    char *large = calloc(1, 300);
+    webSocketSend(socket, large, 300, true);
+    expect(pendingBytes(socket->stream, sent), toBe(304));
+    expect(memcmp(sent, "\x82\x7e\x01\x2c", 4), toBe(0));
+    streamSent(socket->stream, 304);
+    free(large);
+
+    large = calloc(1, 65536);
+    webSocketSend(socket, large, 65536, true);
+    expect(pendingBytes(socket->stream, sent), toBe(65546));
+    expect(memcmp(sent, "\x82\x7f\x00\x00\x00\x00\x00\x01\x00\x00", 10), toBe(0));
+    free(large);
+
+    free(sent);
+    closeStream(socket->stream);
+}
+
+void runWebSocketTests() {
+    runTest(testSha1);
+    runTest(testWebSocketAccept);
+    runTest(testUnmaskMatchesByteAtATime);
+    runTest(testHandshakeValidation);
+    runTest(testReceiveFramesInPieces);
+    runTest(testPingAndClose);
+    runTest(testServerStartsClose);
+    runTest(testProtocolErrors);
+    runTest(testInvalidCloseFrames);
+    runTest(testSendFrameHeaders);
+}